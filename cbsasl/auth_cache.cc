@@ -0,0 +1,178 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "util.h"
+
+#include <cbcrypto/cbcrypto.h>
+#include <cbsasl/auth_cache.h>
+#include <platform/random.h>
+
+#include <array>
+#include <iterator>
+#include <stdexcept>
+
+namespace cb {
+namespace sasl {
+namespace server {
+
+AuthCache::AuthCache(size_t capacity) : capacity(capacity) {
+    if (capacity == 0) {
+        throw std::invalid_argument(
+                "AuthCache::AuthCache: capacity must be non-zero");
+    }
+
+    std::array<char, 32> key;
+    cb::RandomGenerator randomGenerator;
+    if (!randomGenerator.getBytes(key.data(), key.size())) {
+        throw std::runtime_error(
+                "AuthCache::AuthCache: Failed to generate HMAC key");
+    }
+    hmacKey.assign(key.data(), key.size());
+}
+
+AuthCache& AuthCache::instance() {
+    static AuthCache cache;
+    return cache;
+}
+
+void AuthCache::setTtl(std::chrono::seconds ttl) {
+    AuthCache::ttl.store(ttl);
+    if (ttl.count() == 0) {
+        invalidate();
+    }
+}
+
+std::string AuthCache::makeKey(Domain domain,
+                               const std::string& username) const {
+    std::string ret;
+    ret.reserve(username.size() + 1);
+    ret.push_back(char(domain));
+    ret.append(username);
+    return ret;
+}
+
+std::string AuthCache::makeDigest(const std::string& key,
+                                  const std::string& secret) const {
+    std::string data;
+    data.reserve(key.size() + 1 + secret.size());
+    data.append(key);
+    data.push_back('\0');
+    data.append(secret);
+    return cb::crypto::HMAC(cb::crypto::Algorithm::SHA256, hmacKey, data);
+}
+
+bool AuthCache::lookup(Domain domain,
+                       const std::string& username,
+                       const std::string& secret,
+                       std::chrono::steady_clock::time_point now) {
+    if (ttl.load().count() == 0) {
+        return false;
+    }
+
+    const auto key = makeKey(domain, username);
+    // Calculate the digest before grabbing the lock
+    const auto digest = makeDigest(key, secret);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    auto iter = index.find(key);
+    if (iter == index.end()) {
+        misses++;
+        return false;
+    }
+
+    const auto& entry = *iter->second;
+    if (entry.expiry <= now) {
+        erase(iter->second);
+        misses++;
+        return false;
+    }
+
+    if (cbsasl_secure_compare(entry.digest.data(),
+                              entry.digest.size(),
+                              digest.data(),
+                              digest.size()) != 0) {
+        // The user may have changed the password; leave the entry so that
+        // a client using the wrong password can't evict it
+        misses++;
+        return false;
+    }
+
+    hits++;
+    return true;
+}
+
+void AuthCache::insert(uint64_t generation,
+                       Domain domain,
+                       const std::string& username,
+                       const std::string& secret,
+                       std::chrono::steady_clock::time_point now) {
+    const auto currentTtl = ttl.load();
+    if (currentTtl.count() == 0) {
+        return;
+    }
+
+    auto key = makeKey(domain, username);
+    auto digest = makeDigest(key, secret);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    if (generation != AuthCache::generation.load()) {
+        // The password database was reloaded while the credentials
+        // were verified
+        return;
+    }
+
+    auto iter = index.find(key);
+    if (iter != index.end()) {
+        erase(iter->second);
+    }
+
+    // Make room by dropping the expired entries, and then the ones
+    // closest to expiry
+    while (!entries.empty() &&
+           (entries.size() >= capacity || entries.front().expiry <= now)) {
+        erase(entries.begin());
+        evictions++;
+    }
+
+    entries.push_back(Entry{key, std::move(digest), now + currentTtl});
+    index[std::move(key)] = std::prev(entries.end());
+}
+
+void AuthCache::invalidate() {
+    std::lock_guard<std::mutex> guard(mutex);
+    generation++;
+    index.clear();
+    entries.clear();
+}
+
+AuthCache::Stats AuthCache::getStats() const {
+    Stats ret;
+    ret.hits = hits.load();
+    ret.misses = misses.load();
+    ret.evictions = evictions.load();
+    std::lock_guard<std::mutex> guard(mutex);
+    ret.size = entries.size();
+    return ret;
+}
+
+void AuthCache::erase(std::list<Entry>::iterator iter) {
+    index.erase(iter->key);
+    entries.erase(iter);
+}
+
+} // namespace server
+} // namespace sasl
+} // namespace cb
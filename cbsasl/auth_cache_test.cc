@@ -0,0 +1,94 @@
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <cbsasl/auth_cache.h>
+#include <folly/portability/GTest.h>
+
+using cb::sasl::Domain;
+using cb::sasl::server::AuthCache;
+using namespace std::chrono_literals;
+
+class AuthCacheTest : public ::testing::Test {
+protected:
+    void insert(const std::string& user, const std::string& password) {
+        cache.insert(cache.getGeneration(), Domain::Local, user, password, now);
+    }
+
+    bool lookup(const std::string& user, const std::string& password) {
+        return cache.lookup(Domain::Local, user, password, now);
+    }
+
+    AuthCache cache{4};
+    std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+};
+
+TEST_F(AuthCacheTest, Lookup) {
+    EXPECT_FALSE(lookup("user", "password"));
+    insert("user", "password");
+    EXPECT_TRUE(lookup("user", "password"));
+    EXPECT_FALSE(lookup("user", "Password"));
+    EXPECT_FALSE(lookup("user2", "password"));
+    // The domain is part of the key
+    EXPECT_FALSE(cache.lookup(Domain::External, "user", "password", now));
+
+    const auto stats = cache.getStats();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(4u, stats.misses);
+    EXPECT_EQ(1u, stats.size);
+}
+
+TEST_F(AuthCacheTest, Expiry) {
+    cache.setTtl(10s);
+    insert("user", "password");
+    now += 9s;
+    EXPECT_TRUE(lookup("user", "password"));
+    now += 1s;
+    EXPECT_FALSE(lookup("user", "password"));
+    EXPECT_EQ(0u, cache.getStats().size);
+}
+
+TEST_F(AuthCacheTest, Disabled) {
+    cache.setTtl(0s);
+    insert("user", "password");
+    EXPECT_FALSE(lookup("user", "password"));
+    EXPECT_EQ(0u, cache.getStats().size);
+}
+
+TEST_F(AuthCacheTest, Bounded) {
+    for (int ii = 0; ii < 6; ++ii) {
+        insert("user" + std::to_string(ii), "password");
+        now += 1s;
+    }
+    const auto stats = cache.getStats();
+    EXPECT_EQ(4u, stats.size);
+    EXPECT_EQ(2u, stats.evictions);
+    // The oldest entries are evicted first
+    EXPECT_FALSE(lookup("user0", "password"));
+    EXPECT_FALSE(lookup("user1", "password"));
+    EXPECT_TRUE(lookup("user5", "password"));
+}
+
+TEST_F(AuthCacheTest, Invalidate) {
+    insert("user", "password");
+    const auto generation = cache.getGeneration();
+    cache.invalidate();
+    EXPECT_FALSE(lookup("user", "password"));
+
+    // A verification started before the invalidation isn't cached
+    cache.insert(generation, Domain::Local, "user", "password", now);
+    EXPECT_FALSE(lookup("user", "password"));
+}
@@ -19,6 +19,7 @@
 #include "cbsasl/pwfile.h"
 #include "check_password.h"
 
+#include <cbsasl/auth_cache.h>
 #include <cbsasl/logging.h>
 #include <platform/dirutils.h>
 #include <cstring>
@@ -93,6 +94,16 @@ std::pair<Error, cb::const_char_buffer> ServerBackend::start(
     this->username.assign(username);
     const std::string userpw(password, pwlen);
 
+    // A client which recently authenticated with the same password
+    // doesn't need to be verified again (the cache is only populated
+    // after the legacy user failed, and is invalidated when the password
+    // database changes so the outcome would be the same)
+    auto& cache = server::AuthCache::instance();
+    if (cache.lookup(Domain::Local, this->username, userpw)) {
+        return std::make_pair<Error, cb::const_char_buffer>(Error::OK, {});
+    }
+    const auto generation = cache.getGeneration();
+
     if (try_legacy_user(userpw)) {
         return std::make_pair<Error, cb::const_char_buffer>(Error::OK, {});
     }
@@ -102,8 +113,11 @@ std::pair<Error, cb::const_char_buffer> ServerBackend::start(
         return std::pair<Error, cb::const_char_buffer>{Error::NO_USER, {}};
     }
 
-    return std::make_pair<Error, cb::const_char_buffer>(
-            cb::sasl::plain::check_password(&context, user, userpw), {});
+    const auto ret = cb::sasl::plain::check_password(&context, user, userpw);
+    if (ret == Error::OK) {
+        cache.insert(generation, Domain::Local, this->username, userpw);
+    }
+    return std::pair<Error, cb::const_char_buffer>{ret, {}};
 }
 
 std::pair<Error, cb::const_char_buffer> ClientBackend::start() {
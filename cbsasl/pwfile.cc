@@ -17,6 +17,7 @@
 #include "pwfile.h"
 #include "password_database.h"
 
+#include <cbsasl/auth_cache.h>
 #include <cbsasl/logging.h>
 #include <platform/timeutils.h>
 #include <chrono>
@@ -61,6 +62,8 @@ cb::sasl::Error parse_user_db(const std::string content, bool file) {
                 cb::time2text(std::chrono::steady_clock::now() - start));
         cb::sasl::logging::log(cb::sasl::logging::Level::Debug, logmessage);
         pwmgr.swap(db);
+        // The cached authentications may no longer be valid
+        cb::sasl::server::AuthCache::instance().invalidate();
     } catch (std::exception& e) {
         std::string message("Failed loading [");
         message.append(content);
@@ -51,8 +51,11 @@ const char* je_malloc_conf =
 #ifndef __APPLE__
         "background_thread:true,"
 #endif
-        /* Use just one arena, instead of the default based on number of CPUs.
-           Helps to minimize heap fragmentation. */
+        /* Use just one automatic arena, instead of the default based on
+           number of CPUs. Helps to minimize heap fragmentation. This arena
+           only serves non-bucket allocations; each bucket allocates from its
+           own arena(s) created via cb::ArenaMalloc, which is also where the
+           bucket's memory usage is read from. */
         "narenas:1,"
         /* Start with profiling enabled but inactive; this allows us to
            turn it on/off at runtime. */
@@ -24,6 +24,7 @@
 #include "listening_port.h"
 #include "mc_time.h"
 #include "mcaudit.h"
+#include "mcbp_executors.h"
 #include "memcached.h"
 #include "protocol/mcbp/dcp_snapshot_marker_codec.h"
 #include "protocol/mcbp/engine_wrapper.h"
@@ -52,6 +53,7 @@
 #include <utilities/logtags.h>
 #include <gsl/gsl>
 
+#include <algorithm>
 #include <cctype>
 #include <exception>
 #ifndef WIN32
@@ -610,6 +612,157 @@ bool Connection::processAllReadyCookies() {
     return active;
 }
 
+/// Upper bound for the number of GET commands looked up in one batch
+static const size_t MaxGetBatchSize = 64;
+/// Upper bound for the amount of the input buffer scanned for a batch
+static const size_t MaxGetBatchBytes = 16 * 1024;
+
+static bool isGetOpcode(uint8_t opcode) {
+    switch (cb::mcbp::ClientOpcode(opcode)) {
+    case cb::mcbp::ClientOpcode::Get:
+    case cb::mcbp::ClientOpcode::Getq:
+    case cb::mcbp::ClientOpcode::Getk:
+    case cb::mcbp::ClientOpcode::Getkq:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Connection::executeGetBatch(size_t maxActiveCommands) {
+    if (cookies.size() != 1 || !cookies.front()->empty()) {
+        return false;
+    }
+
+    auto* input = bufferevent_get_input(bev.get());
+    const auto window =
+            std::min(evbuffer_get_length(input), MaxGetBatchBytes);
+    if (window < 2 * sizeof(cb::mcbp::Header)) {
+        return false;
+    }
+
+    // Only look beyond the first header (and pay for making the window
+    // contiguous) if the next command is a GET
+    const auto* first = reinterpret_cast<const cb::mcbp::Header*>(
+            evbuffer_pullup(input, sizeof(cb::mcbp::Header)));
+    if (first == nullptr) {
+        throw std::runtime_error(
+                "Connection::executeGetBatch(): Failed to reallocate event "
+                "input buffer: " +
+                std::to_string(sizeof(cb::mcbp::Header)));
+    }
+    if (first->getMagic() != uint8_t(cb::mcbp::Magic::ClientRequest) ||
+        !isGetOpcode(first->getOpcode())) {
+        return false;
+    }
+
+    const auto* data = evbuffer_pullup(input, window);
+    if (data == nullptr) {
+        throw std::runtime_error(
+                "Connection::executeGetBatch(): Failed to reallocate event "
+                "input buffer: " +
+                std::to_string(window));
+    }
+
+    // Locate the run of complete GET frames at the head of the buffer.
+    // Only plain client requests are considered; anything carrying
+    // framing extras takes the normal path.
+    const auto limit = std::min(
+            {MaxGetBatchSize, maxActiveCommands, size_t(numEvents)});
+    std::vector<const cb::mcbp::Header*> frames;
+    size_t offset = 0;
+    while (frames.size() < limit &&
+           offset + sizeof(cb::mcbp::Header) <= window) {
+        const auto* header =
+                reinterpret_cast<const cb::mcbp::Header*>(data + offset);
+        if (header->getMagic() != uint8_t(cb::mcbp::Magic::ClientRequest) ||
+            !isGetOpcode(header->getOpcode())) {
+            break;
+        }
+        const auto framesize = sizeof(*header) + header->getBodylen();
+        if (offset + framesize > window) {
+            break;
+        }
+        frames.push_back(header);
+        offset += framesize;
+    }
+
+    if (frames.size() < 2) {
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Cookie>> batch;
+    batch.reserve(frames.size());
+    size_t drainSize = 0;
+    for (const auto* header : frames) {
+        std::unique_ptr<Cookie> cookie;
+        if (batch.empty()) {
+            cookie = std::move(cookies.back());
+            cookies.pop_back();
+        } else {
+            cookie = std::make_unique<Cookie>(*this);
+        }
+
+        cookie->initialize(*header, isTracingEnabled());
+        if (cookie->validate() != cb::mcbp::Status::Success) {
+            // End the batch here and leave the packet in the buffer;
+            // the normal path reports the error (and closes the
+            // connection)
+            if (batch.empty()) {
+                cookie->reset();
+                cookies.push_back(std::move(cookie));
+                return false;
+            }
+            break;
+        }
+        drainSize += cookie->getPacket().size();
+        // We drain the packets before the commands complete
+        cookie->preserveRequest();
+        batch.push_back(std::move(cookie));
+    }
+
+    // Commands failing the access checks are left to report the failure
+    // when they get executed
+    std::vector<cb::EngineGetRequest> requests;
+    std::vector<Cookie*> targets;
+    requests.reserve(batch.size());
+    targets.reserve(batch.size());
+    for (auto& cookie : batch) {
+        if (authorize_request_packet(*cookie)) {
+            requests.push_back({cookie.get(),
+                                cookie->getRequestKey(),
+                                cookie->getRequest().getVBucket(),
+                                DocStateFilter::Alive});
+            targets.push_back(cookie.get());
+        }
+    }
+
+    if (!requests.empty()) {
+        auto results = bucket_get_multi(*this, requests);
+        for (size_t ii = 0; ii < results.size(); ++ii) {
+            if (results[ii].first == cb::engine_errc::would_block) {
+                // The engine notifies the cookie once the document is
+                // available, and the command performs the lookup again
+                // when it gets executed.
+                targets[ii]->setEwouldblock(true);
+            } else {
+                targets[ii]->setPrefetchedItem(std::move(results[ii]));
+            }
+        }
+    }
+
+    for (auto& cookie : batch) {
+        cookies.push_back(std::move(cookie));
+    }
+
+    if (evbuffer_drain(input, drainSize) == -1) {
+        throw std::runtime_error(
+                "Connection::executeGetBatch(): Failed to drain buffer");
+    }
+
+    return true;
+}
+
 void Connection::executeCommandPipeline() {
     numEvents = max_reqs_per_event;
     const auto maxActiveCommands =
@@ -630,6 +783,14 @@ void Connection::executeCommandPipeline() {
         bool stop = false;
         while (!stop && cookies.size() < maxActiveCommands &&
                isPacketAvailable() && numEvents > 0) {
+            if (!active && executeGetBatch(maxActiveCommands)) {
+                // Execute the batch in the same way as the commands
+                // already in the pipeline
+                active = processAllReadyCookies();
+                stop = active && !cookies.back()->mayReorder();
+                continue;
+            }
+
             std::unique_ptr<Cookie> cookie;
             if (cookies.back()->empty()) {
                 // we want to reuse the cookie
@@ -941,9 +1102,20 @@ void Connection::ssl_read_callback(bufferevent* bev, void* ctx) {
                     certResult.second);
         }
     } else {
-        LOG_INFO("{}: Using SSL cipher:{}",
+        stats.ssl_handshakes++;
+        const bool reused = SSL_session_reused(ssl_st);
+        if (reused) {
+            stats.ssl_sessions_reused++;
+        }
+        const bool ktls = isKtlsSendEnabled(ssl_st);
+        if (ktls) {
+            stats.ssl_ktls_conns++;
+        }
+        LOG_INFO("{}: Using SSL cipher:{} session reused:{} ktls:{}",
                  instance.getId(),
-                 SSL_get_cipher_name(ssl_st));
+                 SSL_get_cipher_name(ssl_st),
+                 reused,
+                 ktls);
     }
 
     // update the callback to call the normal read callback
@@ -1399,7 +1571,7 @@ void Connection::sendResponseHeaders(Cookie& cookie,
     response.setOpaque(request.getOpaque());
     response.setCas(cookie.getCas());
 
-    if (cookie.isTracingEnabled()) {
+    if (cookie.isTracingRequested()) {
         // When tracing is enabled we'll be using the alternative
         // response header where we inject the framing header.
         // For now we'll just hard-code the adding of the bytes
@@ -1475,6 +1647,7 @@ void Connection::sendResponse(Cookie& cookie,
                               cb::const_char_buffer value,
                               uint8_t datatype,
                               std::unique_ptr<SendBuffer> sendbuffer) {
+    const auto sendStart = std::chrono::steady_clock::now();
     sendResponseHeaders(cookie, status, extras, key, value.size(), datatype);
     if (sendbuffer) {
         if (sendbuffer->getPayload().size() != value.size()) {
@@ -1486,6 +1659,10 @@ void Connection::sendResponse(Cookie& cookie,
     } else {
         cookie.getConnection().copyToOutputStream(value);
     }
+    if (cookie.isTracingEnabled()) {
+        auto& tracer = cookie.getTracer();
+        tracer.end(tracer.begin(cb::tracing::Code::Send, sendStart));
+    }
 }
 
 ENGINE_ERROR_CODE Connection::add_packet_to_send_pipe(
@@ -2315,6 +2492,12 @@ ENGINE_ERROR_CODE Connection::abort(uint32_t opaque,
     return add_packet_to_send_pipe(builder.getFrame()->getFrame());
 }
 
+bool Connection::want_more_messages() {
+    // Same condition as the step loop in executeCommandsCallback
+    return state == State::running &&
+           getSendQueueSize() < Settings::instance().getMaxPacketSize();
+}
+
 ////////////////////////////////////////////////////////////////////////////
 //                                                                        //
 //               End DCP Message producer interface                       //
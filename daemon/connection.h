@@ -747,6 +747,8 @@ public:
                             uint64_t prepared_seqno,
                             uint64_t abort_seqno) override;
 
+    bool want_more_messages() override;
+
 protected:
     /**
      * Protected constructor so that it may only be used by MockSubclasses
@@ -1055,6 +1057,19 @@ protected:
      */
     bool processAllReadyCookies();
 
+    /**
+     * If the input buffer starts with a run of (complete) GET commands,
+     * look up all of their documents with a single call to the engine
+     * and then execute them. Only used when there are no commands in
+     * flight.
+     *
+     * @param maxActiveCommands the maximum number of cookies allowed
+     * @return true if a batch was started (and its packets drained from
+     *         the input buffer), false if the caller should process the
+     *         next packet on its own
+     */
+    bool executeGetBatch(size_t maxActiveCommands);
+
     /**
      * Execute commands in the pipeline.
      *
@@ -20,11 +20,13 @@
 #include "buckets.h"
 #include "connection.h"
 #include "cookie_trace_context.h"
+#include "front_end_thread.h"
 #include "mcaudit.h"
 #include "mcbp.h"
 #include "mcbp_executors.h"
 #include "memcached.h"
 #include "opentracing.h"
+#include "request_trace_ring.h"
 #include "protocol/mcbp/engine_errc_2_mcbp.h"
 #include "sendbuffer.h"
 #include "settings.h"
@@ -125,6 +127,7 @@ bool Cookie::execute() {
 
     // Reset ewouldblock state!
     setEwouldblock(false);
+    const auto executeStart = std::chrono::steady_clock::now();
     const auto& header = getHeader();
     if (header.isResponse()) {
         execute_response_packet(*this, header.getResponse());
@@ -133,6 +136,9 @@ bool Cookie::execute() {
         // so it must be a request
         execute_request_packet(*this, header.getRequest());
     }
+    if (isTracingEnabled()) {
+        tracer.end(tracer.begin(cb::tracing::Code::Execute, executeStart));
+    }
 
     if (isEwouldblock()) {
         return false;
@@ -394,13 +400,52 @@ void Cookie::maybeLogSlowCommand(
     }
 }
 
+void Cookie::maybeRecordTrace(
+        std::chrono::steady_clock::duration elapsed) const {
+    const auto index = connection.getThread().index;
+    if (index >= request_trace_rings.size()) {
+        return;
+    }
+
+    const auto opcode = getRequest().getClientOpcode();
+    RequestTraceRecord::Reason reason;
+    if (Settings::instance().isRequestTraceSlowOpsEnabled() &&
+        elapsed > cb::mcbp::sla::getSlowOpThreshold(opcode)) {
+        reason = RequestTraceRecord::Reason::Slow;
+    } else if (traceSampled) {
+        reason = RequestTraceRecord::Reason::Sampled;
+    } else {
+        return;
+    }
+
+    request_trace_rings[index]->push(
+            RequestTraceRecord{reason,
+                               tracer,
+                               elapsed,
+                               connection.getId(),
+                               getHeader().getOpaque(),
+                               uint8_t(opcode),
+                               uint16_t(connection.getBucketIndex())});
+}
+
 Cookie::Cookie(Connection& conn) : connection(conn) {
 }
 
 void Cookie::initialize(const cb::mcbp::Header& header, bool tracing_enabled) {
     reset();
-    setTracingEnabled(tracing_enabled ||
-                      Settings::instance().alwaysCollectTraceInfo());
+    const auto& settings = Settings::instance();
+    tracingRequested = tracing_enabled || settings.alwaysCollectTraceInfo();
+    bool collect = tracingRequested;
+    const auto index = connection.getThread().index;
+    if (index < request_trace_rings.size()) {
+        // Only the sampled commands are traced for the ring. A slow command
+        // which isn't traced is still recorded (see maybeRecordTrace), with
+        // just the Request span giving its total duration.
+        traceSampled = request_trace_rings[index]->sample(
+                settings.getRequestTraceSampleRate());
+        collect = collect || traceSampled;
+    }
+    setTracingEnabled(collect);
     setPacket(header);
     start = std::chrono::steady_clock::now();
     tracer.begin(cb::tracing::Code::Request, start);
@@ -468,6 +513,9 @@ cb::mcbp::Status Cookie::validate() {
     } // We don't currently have any validators for response packets
 
     validated = true;
+    if (isTracingEnabled()) {
+        tracer.end(tracer.begin(cb::tracing::Code::Parse, start));
+    }
     return cb::mcbp::Status::Success;
 }
 
@@ -480,11 +528,15 @@ void Cookie::reset() {
     cas = 0;
     commandContext.reset();
     tracer.clear();
+    tracingRequested = false;
+    traceSampled = false;
     ewouldblock = false;
     openTracingContext.clear();
     authorized = false;
     reorder = connection.allowUnorderedExecution();
     inflated_input_payload.reset();
+    prefetched = false;
+    prefetchedItem.second.reset();
 }
 
 void Cookie::setOpenTracingContext(cb::const_byte_buffer context) {
@@ -540,6 +592,7 @@ void Cookie::collectTimings() {
 
     // Log operations taking longer than the "slow" threshold for the opcode.
     maybeLogSlowCommand(elapsed);
+    maybeRecordTrace(elapsed);
 
     if (isOpenTracingEnabled()) {
         OpenTracing::pushTraceLog(extractTraceContext());
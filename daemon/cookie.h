@@ -21,6 +21,7 @@
 #include <memcached/dockey.h>
 #include <memcached/engine_error.h>
 #include <memcached/tracer.h>
+#include <memcached/types.h>
 #include <nlohmann/json.hpp>
 #include <platform/compression/buffer.h>
 #include <platform/sized_buffer.h>
@@ -396,6 +397,16 @@ public:
      */
     void maybeLogSlowCommand(std::chrono::steady_clock::duration elapsed) const;
 
+    /**
+     * Did the client (or always_collect_trace_info) ask for trace
+     * information for this command? Tracing may also be enabled to feed
+     * the request trace ring, but the server duration is only returned to
+     * the client if it was requested.
+     */
+    bool isTracingRequested() const {
+        return tracingRequested;
+    }
+
     uint8_t getRefcount() {
         return refcount;
     }
@@ -444,6 +455,34 @@ public:
         authorized = true;
     }
 
+    /**
+     * Store the result of a lookup performed on behalf of this cookie's
+     * GET as part of a batch (see Connection::executeGetBatch), so that
+     * the command doesn't have to call into the engine again when it
+     * gets executed.
+     */
+    void setPrefetchedItem(
+            std::pair<cb::engine_errc, cb::unique_item_ptr> result) {
+        prefetchedItem = std::move(result);
+        prefetched = true;
+    }
+
+    /**
+     * Take the result stored by setPrefetchedItem (if any)
+     *
+     * @param result where to move the result
+     * @return true if a prefetched result was available
+     */
+    bool takePrefetchedItem(
+            std::pair<cb::engine_errc, cb::unique_item_ptr>& result) {
+        if (!prefetched) {
+            return false;
+        }
+        result = std::move(prefetchedItem);
+        prefetched = false;
+        return true;
+    }
+
     /**
      * Mark this cookie as a barrier. A barrier command cannot be executed in
      * parallel with other commands. For more information see
@@ -494,8 +533,22 @@ protected:
 
     void collectTimings();
 
+    /**
+     * Add the trace for the command to the request trace ring of the
+     * front end thread if it was sampled or exceeded the slow threshold
+     *
+     * @param elapsed the time elapsed while executing the command
+     */
+    void maybeRecordTrace(std::chrono::steady_clock::duration elapsed) const;
+
     bool validated = false;
 
+    /// Trace information was requested for this command
+    bool tracingRequested = false;
+
+    /// This command was sampled for the request trace ring
+    bool traceSampled = false;
+
     bool reorder = false;
 
     /// The tracing context provided by the client to use as the
@@ -579,4 +632,8 @@ protected:
     bool authorized = false;
 
     cb::compression::Buffer inflated_input_payload;
+
+    /// see setPrefetchedItem/takePrefetchedItem
+    bool prefetched = false;
+    std::pair<cb::engine_errc, cb::unique_item_ptr> prefetchedItem;
 };
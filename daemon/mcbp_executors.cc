@@ -789,6 +789,7 @@ void initialize_mbcp_lookup_map() {
                   update_user_permissions_executor);
     setup_handler(cb::mcbp::ClientOpcode::RbacRefresh, rbac_refresh_executor);
     setup_handler(cb::mcbp::ClientOpcode::AuthProvider, auth_provider_executor);
+    setup_handler(cb::mcbp::ClientOpcode::GetMetrics, get_metrics_executor);
     setup_handler(cb::mcbp::ClientOpcode::GetClusterConfig,
                   get_cluster_config_executor);
     setup_handler(cb::mcbp::ClientOpcode::SetClusterConfig,
@@ -824,16 +825,33 @@ void initialize_mbcp_lookup_map() {
                   adjust_timeofday_executor);
 }
 
+static McbpPrivilegeChains& getPrivilegeChains() {
+    static McbpPrivilegeChains privilegeChains;
+    return privilegeChains;
+}
+
+bool authorize_request_packet(Cookie& cookie) {
+    if (cookie.isAuthorized()) {
+        return true;
+    }
+
+    const auto opcode = cookie.getRequest().getClientOpcode();
+    if (getPrivilegeChains().invoke(opcode, cookie) ==
+        cb::rbac::PrivilegeAccess::Ok) {
+        cookie.setAuthorized();
+        return true;
+    }
+    return false;
+}
+
 void execute_client_request_packet(Cookie& cookie,
                                    const cb::mcbp::Request& request) {
     auto* c = &cookie.getConnection();
 
-    static McbpPrivilegeChains privilegeChains;
-
     const auto opcode = request.getClientOpcode();
     auto res = cb::rbac::PrivilegeAccess::Ok;
     if (!cookie.isAuthorized()) {
-        res = privilegeChains.invoke(opcode, cookie);
+        res = getPrivilegeChains().invoke(opcode, cookie);
     }
 
     switch (res) {
@@ -30,5 +30,14 @@ void initialize_mbcp_lookup_map();
 
 void execute_request_packet(Cookie& cookie, const cb::mcbp::Request& request);
 
+/**
+ * Run the privilege checks for the client request in the cookie without
+ * executing it, marking the cookie as authorized if they pass. Failures
+ * are not reported; they're dealt with when the command gets executed.
+ *
+ * @return true if the cookie is authorized to execute its command
+ */
+bool authorize_request_packet(Cookie& cookie);
+
 void execute_response_packet(Cookie& cookie,
                              const cb::mcbp::Response& response);
@@ -340,6 +340,10 @@ McbpPrivilegeChains::McbpPrivilegeChains() {
     setup(cb::mcbp::ClientOpcode::AuthProvider,
           require<Privilege::SecurityManagement>);
 
+    /* Metrics for the selected bucket */
+    setup(cb::mcbp::ClientOpcode::GetMetrics,
+          require<Privilege::SimpleStats>);
+
     /// @todo change priv to CollectionManagement
     setup(cb::mcbp::ClientOpcode::CollectionsSetManifest,
           require<Privilege::BucketManagement>);
@@ -955,6 +955,27 @@ static Status auth_provider_validator(Cookie& cookie) {
                                         PROTOCOL_BINARY_RAW_BYTES);
 }
 
+static Status get_metrics_validator(Cookie& cookie) {
+    auto status = McbpValidator::verify_header(cookie,
+                                               0,
+                                               ExpectedKeyLen::Any,
+                                               ExpectedValueLen::Zero,
+                                               ExpectedCas::NotSet,
+                                               PROTOCOL_BINARY_RAW_BYTES);
+    if (status != Status::Success) {
+        return status;
+    }
+
+    const auto key = cookie.getRequest().getKey();
+    const std::string format{reinterpret_cast<const char*>(key.data()),
+                             key.size()};
+    if (!format.empty() && format != "prometheus" && format != "schema") {
+        cookie.setErrorContext("Unsupported format: " + format);
+        return Status::Einval;
+    }
+    return Status::Success;
+}
+
 static Status drop_privilege_validator(Cookie& cookie) {
     return McbpValidator::verify_header(cookie,
                                         0,
@@ -2257,6 +2278,7 @@ McbpValidator::McbpValidator() {
           update_user_permissions_validator);
     setup(cb::mcbp::ClientOpcode::RbacRefresh, configuration_refresh_validator);
     setup(cb::mcbp::ClientOpcode::AuthProvider, auth_provider_validator);
+    setup(cb::mcbp::ClientOpcode::GetMetrics, get_metrics_validator);
     setup(cb::mcbp::ClientOpcode::DropPrivilege, drop_privilege_validator);
     setup(cb::mcbp::ClientOpcode::GetClusterConfig,
           get_cluster_config_validator);
@@ -53,6 +53,7 @@
 #include "tracing.h"
 #include "utilities/terminate_handler.h"
 
+#include <cbsasl/auth_cache.h>
 #include <cbsasl/logging.h>
 #include <cbsasl/mechanism.h>
 #include <event2/thread.h>
@@ -254,6 +255,9 @@ static void stats_init() {
     stats.total_conns.reset();
     stats.daemon_conns.reset();
     stats.rejected_conns.reset();
+    stats.ssl_handshakes.reset();
+    stats.ssl_sessions_reused.reset();
+    stats.ssl_ktls_conns.reset();
     stats.curr_conns.store(0, std::memory_order_relaxed);
 }
 
@@ -271,6 +275,9 @@ void stats_reset(Cookie& cookie) {
     }
     stats.total_conns.reset();
     stats.rejected_conns.reset();
+    stats.ssl_handshakes.reset();
+    stats.ssl_sessions_reused.reset();
+    stats.ssl_ktls_conns.reset();
     threadlocal_stats_reset(cookie.getConnection().getBucket().stats);
     bucket_reset_stats(cookie);
 }
@@ -356,6 +363,11 @@ static void scramsha_fallback_salt_changed_listener(const std::string&,
     cb::sasl::server::set_scramsha_fallback_salt(s.getScramshaFallbackSalt());
 }
 
+static void sasl_auth_cache_ttl_changed_listener(const std::string&,
+                                                 Settings& s) {
+    cb::sasl::server::AuthCache::instance().setTtl(s.getSaslAuthCacheTtl());
+}
+
 static void opcode_attributes_override_changed_listener(const std::string&,
                                                         Settings& s) {
     try {
@@ -417,6 +429,8 @@ static void settings_init() {
                                            interfaces_changed_listener);
     settings.addChangeListener(
             "scramsha_fallback_salt", scramsha_fallback_salt_changed_listener);
+    settings.addChangeListener("sasl_auth_cache_ttl",
+                               sasl_auth_cache_ttl_changed_listener);
     settings.addChangeListener(
             "active_external_users_push_interval",
             [](const std::string&, Settings& s) -> void {
@@ -521,6 +535,14 @@ static void settings_init() {
                                [](const std::string&, Settings&) -> void {
                                    invalidateSslCache();
                                });
+    settings.addChangeListener("ssl_session_tickets",
+                               [](const std::string&, Settings&) -> void {
+                                   invalidateSslCache();
+                               });
+    settings.addChangeListener("ssl_ktls",
+                               [](const std::string&, Settings&) -> void {
+                                   invalidateSslCache();
+                               });
     settings.addChangeListener("ssl_cipher_list",
                                [](const std::string&, Settings&) -> void {
                                    invalidateSslCache();
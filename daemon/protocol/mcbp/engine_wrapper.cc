@@ -186,6 +186,20 @@ cb::EngineErrorItemPair bucket_get(Cookie& cookie,
     return ret;
 }
 
+std::vector<cb::EngineErrorItemPair> bucket_get_multi(
+        Connection& c, const std::vector<cb::EngineGetRequest>& requests) {
+    auto ret = c.getBucketEngine()->get_multi(requests);
+    for (const auto& r : ret) {
+        if (r.first == cb::engine_errc::disconnect) {
+            LOG_WARNING("{}: {} bucket_get_multi return ENGINE_DISCONNECT",
+                        c.getId(),
+                        c.getDescription());
+            break;
+        }
+    }
+    return ret;
+}
+
 BucketCompressionMode bucket_get_compression_mode(Cookie& cookie) {
     auto& c = cookie.getConnection();
     return c.getBucketEngine()->getCompressionMode();
@@ -352,6 +366,18 @@ ENGINE_ERROR_CODE bucket_get_stats(Cookie& cookie,
     return ret;
 }
 
+cb::engine_errc bucket_get_metrics(Cookie& cookie,
+                                   cb::metrics::Collector& collector) {
+    auto& c = cookie.getConnection();
+    auto ret = c.getBucketEngine()->get_metrics(&cookie, collector);
+    if (ret == cb::engine_errc::disconnect) {
+        LOG_WARNING("{}: {} bucket_get_metrics return ENGINE_DISCONNECT",
+                    c.getId(),
+                    c.getDescription());
+    }
+    return ret;
+}
+
 ENGINE_ERROR_CODE dcpAddStream(Cookie& cookie,
                                uint32_t opaque,
                                Vbid vbid,
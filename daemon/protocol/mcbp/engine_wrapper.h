@@ -85,6 +85,14 @@ cb::EngineErrorItemPair bucket_get(
         Vbid vbucket,
         DocStateFilter documentStateFilter = DocStateFilter::Alive);
 
+/**
+ * Look up a batch of documents in the connection's bucket with a single
+ * call into the engine. Each request carries the cookie which should be
+ * notified if its lookup returns would_block.
+ */
+std::vector<cb::EngineErrorItemPair> bucket_get_multi(
+        Connection& c, const std::vector<cb::EngineGetRequest>& requests);
+
 cb::EngineErrorItemPair bucket_get_if(
         Cookie& cookie,
         const DocKey& key,
@@ -130,6 +138,9 @@ ENGINE_ERROR_CODE bucket_get_stats(Cookie& cookie,
                                    cb::const_byte_buffer value,
                                    const AddStatFn& add_stat);
 
+cb::engine_errc bucket_get_metrics(Cookie& cookie,
+                                   cb::metrics::Collector& collector);
+
 /**
  * Calls the underlying engine DCP add-stream
  *
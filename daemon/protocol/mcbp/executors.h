@@ -61,3 +61,5 @@ void get_cluster_config_executor(Cookie&);
 void set_cluster_config_executor(Cookie&);
 
 void adjust_timeofday_executor(Cookie&);
+
+void get_metrics_executor(Cookie&);
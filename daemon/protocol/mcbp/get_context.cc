@@ -28,8 +28,10 @@
 #include <gsl/gsl>
 
 ENGINE_ERROR_CODE GetCommandContext::getItem() {
-    const auto key = cookie.getRequestKey();
-    auto ret = bucket_get(cookie, key, vbucket);
+    cb::EngineErrorItemPair ret;
+    if (!cookie.takePrefetchedItem(ret)) {
+        ret = bucket_get(cookie, cookie.getRequestKey(), vbucket);
+    }
     if (ret.first == cb::engine_errc::success) {
         it = std::move(ret.second);
         if (!bucket_get_item_info(connection, it.get(), &info)) {
@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "engine_wrapper.h"
+#include "executors.h"
+
+#include <daemon/buckets.h>
+#include <daemon/cookie.h>
+#include <mcbp/protocol/request.h>
+#include <memcached/metrics.h>
+#include <nlohmann/json.hpp>
+
+void get_metrics_executor(Cookie& cookie) {
+    // The validator only lets through the supported formats
+    const auto key = cookie.getRequest().getKey();
+    const std::string format{reinterpret_cast<const char*>(key.data()),
+                             key.size()};
+
+    auto& connection = cookie.getConnection();
+    cb::metrics::Collector collector;
+    auto ret = bucket_get_metrics(cookie, collector);
+    ret = connection.remapErrorCode(ret);
+    switch (ret) {
+    case cb::engine_errc::success:
+        break;
+    case cb::engine_errc::disconnect:
+        connection.shutdown();
+        return;
+    default:
+        cookie.sendResponse(ret);
+        return;
+    }
+
+    std::string payload;
+    auto datatype = cb::mcbp::Datatype::Raw;
+    if (format.empty()) {
+        payload = collector.toBinary();
+    } else if (format == "prometheus") {
+        payload = collector.toPrometheus(
+                "kv_",
+                "bucket=\"" + std::string{connection.getBucket().name} + "\"");
+    } else {
+        payload = collector.toSchema().dump();
+        datatype = cb::mcbp::Datatype::JSON;
+    }
+
+    cookie.sendResponse(cb::mcbp::Status::Success,
+                        {},
+                        {},
+                        {payload.data(), payload.size()},
+                        datatype,
+                        0);
+}
@@ -27,11 +27,13 @@
 #include <daemon/mc_time.h>
 #include <daemon/mcaudit.h>
 #include <daemon/memcached.h>
+#include <daemon/request_trace_ring.h>
 #include <daemon/runtime.h>
 #include <daemon/settings.h>
 #include <daemon/stats.h>
 #include <daemon/stats_tasks.h>
 #include <daemon/topkeys.h>
+#include <cbsasl/auth_cache.h>
 #include <mcbp/protocol/framebuilder.h>
 #include <mcbp/protocol/header.h>
 #include <memcached/audit_interface.h>
@@ -150,6 +152,17 @@ static ENGINE_ERROR_CODE server_stats(const AddStatFn& add_stat_callback,
 
         add_stat(cookie, add_stat_callback, "auth_cmds", thread_stats.auth_cmds);
         add_stat(cookie, add_stat_callback, "auth_errors", thread_stats.auth_errors);
+        const auto authCache = cb::sasl::server::AuthCache::instance().getStats();
+        add_stat(cookie, add_stat_callback, "auth_cache_hits", authCache.hits);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "auth_cache_misses",
+                 authCache.misses);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "auth_cache_evictions",
+                 authCache.evictions);
+        add_stat(cookie, add_stat_callback, "auth_cache_size", authCache.size);
         add_stat(cookie, add_stat_callback, "get_hits", thread_stats.get_hits);
         add_stat(cookie, add_stat_callback, "get_misses", thread_stats.get_misses);
         add_stat(cookie, add_stat_callback, "delete_misses",
@@ -166,6 +179,12 @@ static ENGINE_ERROR_CODE server_stats(const AddStatFn& add_stat_callback,
         add_stat(cookie, add_stat_callback, "bytes_written",
                  thread_stats.bytes_written);
         add_stat(cookie, add_stat_callback, "rejected_conns", stats.rejected_conns);
+        add_stat(cookie, add_stat_callback, "ssl_handshakes", stats.ssl_handshakes);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "ssl_sessions_reused",
+                 stats.ssl_sessions_reused);
+        add_stat(cookie, add_stat_callback, "ssl_ktls_conns", stats.ssl_ktls_conns);
         add_stat(cookie,
                  add_stat_callback,
                  "threads",
@@ -556,6 +575,34 @@ static ENGINE_ERROR_CODE stat_tracing_executor(const std::string& arg,
     }
 }
 
+/**
+ * Handler for the <code>stats request_traces</code> command used to
+ * retrieve the content of the request trace rings. The records of each
+ * front end thread are returned as a JSON array keyed by the thread index.
+ *
+ * @param arg - should be empty
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_request_traces_executor(const std::string& arg,
+                                                      Cookie& cookie) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    try {
+        for (size_t ii = 0; ii < request_trace_rings.size(); ++ii) {
+            auto records = nlohmann::json::array();
+            for (const auto& record : request_trace_rings[ii]->snapshot()) {
+                records.push_back(record.to_json());
+            }
+            append_stats(std::to_string(ii), records.dump(), &cookie);
+        }
+        return ENGINE_SUCCESS;
+    } catch (const std::bad_alloc&) {
+        return ENGINE_ENOMEM;
+    }
+}
+
 static ENGINE_ERROR_CODE stat_all_stats(const std::string& arg,
                                         Cookie& cookie) {
     auto value = cookie.getRequest().getValue();
@@ -603,7 +650,8 @@ static std::unordered_map<std::string, struct command_stat_handler>
                 {"topkeys_json", {false, stat_topkeys_json_executor}},
                 {"subdoc_execute", {false, stat_subdoc_execute_executor}},
                 {"responses", {false, stat_responses_json_executor}},
-                {"tracing", {true, stat_tracing_executor}}};
+                {"tracing", {true, stat_tracing_executor}},
+                {"request_traces", {true, stat_request_traces_executor}}};
 
 /**
  * For a given key, try and return the handler for it
@@ -0,0 +1,163 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "request_trace_ring.h"
+
+#include <mcbp/protocol/opcode.h>
+#include <nlohmann/json.hpp>
+#include <platform/socket.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<RequestTraceRecord>::value,
+              "RequestTraceRecord is copied into the ring as raw words");
+
+std::vector<std::unique_ptr<RequestTraceRing>> request_trace_rings;
+
+template <typename Duration>
+static int32_t toMicros(Duration duration) {
+    const auto us =
+            std::chrono::duration_cast<std::chrono::microseconds>(duration)
+                    .count();
+    return int32_t(std::min<int64_t>(us, std::numeric_limits<int32_t>::max()));
+}
+
+RequestTraceRecord::RequestTraceRecord(
+        Reason reason,
+        const cb::tracing::Tracer& tracer,
+        std::chrono::steady_clock::duration elapsed,
+        uint32_t connectionId,
+        uint32_t opaque,
+        uint8_t opcode,
+        uint16_t bucketIndex)
+    : connectionId(connectionId),
+      opaque(opaque),
+      duration(uint32_t(toMicros(elapsed))),
+      bucketIndex(bucketIndex),
+      opcode(opcode),
+      reason(reason) {
+    using namespace std::chrono;
+    timestamp = duration_cast<microseconds>(
+                        (system_clock::now() - elapsed).time_since_epoch())
+                        .count();
+
+    const auto& durations = tracer.getDurations();
+    if (durations.empty()) {
+        return;
+    }
+    const auto start = durations.front().start;
+    for (const auto& span : durations) {
+        if (numSpans == MaxSpans) {
+            truncated = true;
+            break;
+        }
+        auto& entry = spans[numSpans++];
+        entry.code = span.code;
+        entry.offset = toMicros(span.start - start);
+        entry.duration = span.duration == cb::tracing::Span::Duration::max()
+                                 ? -1
+                                 : span.duration.count();
+    }
+}
+
+nlohmann::json RequestTraceRecord::to_json() const {
+    nlohmann::json ret;
+    ret["timestamp"] = timestamp;
+    ret["reason"] = reason == Reason::Slow ? "slow" : "sampled";
+    ret["connection_id"] = connectionId;
+    ret["opaque"] = ntohl(opaque);
+    try {
+        ret["opcode"] = to_string(cb::mcbp::ClientOpcode(opcode));
+    } catch (const std::exception&) {
+        ret["opcode"] = opcode;
+    }
+    ret["bucket_index"] = bucketIndex;
+    ret["duration"] = duration;
+
+    auto trace = nlohmann::json::array();
+    for (size_t ii = 0; ii < numSpans; ++ii) {
+        const auto& span = spans[ii];
+        trace.push_back({{"name", to_string(span.code)},
+                         {"offset", span.offset},
+                         {"duration", span.duration}});
+    }
+    ret["trace"] = std::move(trace);
+    if (truncated) {
+        ret["truncated"] = true;
+    }
+    return ret;
+}
+
+RequestTraceRing::RequestTraceRing(size_t capacity)
+    : capacity(capacity), slots(std::make_unique<Slot[]>(capacity)) {
+    if (capacity == 0) {
+        throw std::invalid_argument(
+                "RequestTraceRing: capacity must be non-zero");
+    }
+}
+
+void RequestTraceRing::push(const RequestTraceRecord& record) {
+    std::array<uint64_t, RecordWords> words{};
+    std::memcpy(words.data(), &record, sizeof(record));
+
+    const auto h = head.load(std::memory_order_relaxed);
+    auto& slot = slots[h % capacity];
+    const auto seq = slot.sequence.load(std::memory_order_relaxed);
+
+    // Mark the slot as being written before touching the data
+    slot.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t ii = 0; ii < RecordWords; ++ii) {
+        slot.data[ii].store(words[ii], std::memory_order_relaxed);
+    }
+    slot.sequence.store(seq + 2, std::memory_order_release);
+    head.store(h + 1, std::memory_order_release);
+}
+
+std::vector<RequestTraceRecord> RequestTraceRing::snapshot() const {
+    const auto h = head.load(std::memory_order_acquire);
+    const auto first = h > capacity ? h - capacity : 0;
+
+    std::vector<RequestTraceRecord> ret;
+    ret.reserve(h - first);
+    std::array<uint64_t, RecordWords> words;
+    for (auto ii = first; ii < h; ++ii) {
+        const auto& slot = slots[ii % capacity];
+        // Each write bumps the sequence number by two, so record ii is
+        // only intact if the slot holds exactly the sequence number of
+        // its generation (anything else is being, or has been, overwritten)
+        const auto expected = 2 * (ii / capacity + 1);
+        const auto before = slot.sequence.load(std::memory_order_acquire);
+        if (before != expected) {
+            continue;
+        }
+        for (size_t jj = 0; jj < RecordWords; ++jj) {
+            words[jj] = slot.data[jj].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+            // Overwritten while we copied it
+            continue;
+        }
+        ret.emplace_back();
+        std::memcpy(&ret.back(), words.data(), sizeof(RequestTraceRecord));
+    }
+    return ret;
+}
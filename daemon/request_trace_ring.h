@@ -0,0 +1,159 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/tracer.h>
+#include <nlohmann/json_fwd.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * A compact copy of the trace spans collected for a single request,
+ * as stored in the RequestTraceRing.
+ */
+struct RequestTraceRecord {
+    /// Why the request was recorded
+    enum class Reason : uint8_t {
+        /// The request was picked by the sampling
+        Sampled,
+        /// The request exceeded the slow threshold for its opcode
+        Slow
+    };
+
+    /// The maximum number of spans kept for a request. Any additional
+    /// spans are dropped (and truncated is set).
+    static constexpr size_t MaxSpans = 16;
+
+    struct Span {
+        cb::tracing::Code code;
+        /// Start of the span relative to the start of the request (µs)
+        int32_t offset;
+        /// Duration of the span (µs), or -1 if it was never ended
+        int32_t duration;
+    };
+
+    RequestTraceRecord() = default;
+
+    /**
+     * Build a record from the spans collected by the tracer
+     *
+     * @param reason why the request is recorded
+     * @param tracer the tracer containing the spans for the request. The
+     *               first span must be the Request span.
+     * @param elapsed the total time spent on the request
+     */
+    RequestTraceRecord(Reason reason,
+                       const cb::tracing::Tracer& tracer,
+                       std::chrono::steady_clock::duration elapsed,
+                       uint32_t connectionId,
+                       uint32_t opaque,
+                       uint8_t opcode,
+                       uint16_t bucketIndex);
+
+    nlohmann::json to_json() const;
+
+    /// Wall-clock time the request started (µs since epoch)
+    uint64_t timestamp = 0;
+    uint32_t connectionId = 0;
+    /// The opaque field from the request (in network byte order)
+    uint32_t opaque = 0;
+    /// Total duration of the request (µs)
+    uint32_t duration = 0;
+    uint16_t bucketIndex = 0;
+    uint8_t opcode = 0;
+    Reason reason = Reason::Sampled;
+    uint8_t numSpans = 0;
+    bool truncated = false;
+    std::array<Span, MaxSpans> spans;
+};
+
+/**
+ * A fixed size ring buffer of RequestTraceRecords.
+ *
+ * Each front end thread owns one ring (see request_trace_rings), and is the
+ * only writer of it so no locking is needed to add records. Readers
+ * (the stats call) may run on any thread: every slot is protected by a
+ * sequence number which is odd while the slot is being written, and the
+ * reader discards any record which was modified while it was copied.
+ */
+class RequestTraceRing {
+public:
+    static constexpr size_t DefaultCapacity = 512;
+
+    explicit RequestTraceRing(size_t capacity = DefaultCapacity);
+
+    /**
+     * Should the next request be sampled? Only to be called by the thread
+     * owning the ring.
+     *
+     * @param rate sample one out of every rate requests (0 = never)
+     */
+    bool sample(size_t rate) {
+        return rate != 0 && (++requests % rate) == 0;
+    }
+
+    /**
+     * Add a record to the ring, overwriting the oldest record if the ring
+     * is full. Only to be called by the thread owning the ring.
+     */
+    void push(const RequestTraceRecord& record);
+
+    /**
+     * Get a copy of the records currently in the ring (oldest first).
+     * May be called from any thread.
+     */
+    std::vector<RequestTraceRecord> snapshot() const;
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    /// The total number of records added to the ring
+    uint64_t getTotalRecords() const {
+        return head.load(std::memory_order_acquire);
+    }
+
+protected:
+    /// The record is stored as words of relaxed atomics so that a reader
+    /// racing with the writer is well defined (and then discarded)
+    static constexpr size_t RecordWords =
+            (sizeof(RequestTraceRecord) + sizeof(uint64_t) - 1) /
+            sizeof(uint64_t);
+
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        std::array<std::atomic<uint64_t>, RecordWords> data;
+    };
+
+    const size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    /// The number of records added (the next record goes into
+    /// slots[head % capacity])
+    std::atomic<uint64_t> head{0};
+    /// The number of requests seen by sample()
+    uint64_t requests = 0;
+};
+
+/**
+ * The request trace rings; one per front end thread (indexed by
+ * FrontEndThread::index). Created by thread_init().
+ */
+extern std::vector<std::unique_ptr<RequestTraceRing>> request_trace_rings;
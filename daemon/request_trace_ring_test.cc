@@ -0,0 +1,105 @@
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "request_trace_ring.h"
+
+#include <folly/portability/GTest.h>
+#include <mcbp/protocol/opcode.h>
+#include <nlohmann/json.hpp>
+
+using namespace std::chrono_literals;
+using cb::tracing::Code;
+
+static RequestTraceRecord makeRecord(uint32_t id) {
+    cb::tracing::Tracer tracer;
+    const auto start = std::chrono::steady_clock::now();
+    tracer.begin(Code::Request, start);
+    tracer.end(tracer.begin(Code::Parse, start), start + 2us);
+    tracer.end(tracer.begin(Code::Get, start + 5us), start + 15us);
+    tracer.end(Code::Request, start + 20us);
+    return RequestTraceRecord{RequestTraceRecord::Reason::Sampled,
+                              tracer,
+                              20us,
+                              id,
+                              0,
+                              uint8_t(cb::mcbp::ClientOpcode::Get),
+                              1};
+}
+
+TEST(RequestTraceRecordTest, Spans) {
+    const auto record = makeRecord(1);
+    EXPECT_EQ(20u, record.duration);
+    ASSERT_EQ(3, record.numSpans);
+    EXPECT_FALSE(record.truncated);
+    EXPECT_EQ(Code::Get, record.spans[2].code);
+    EXPECT_EQ(5, record.spans[2].offset);
+    EXPECT_EQ(10, record.spans[2].duration);
+
+    const auto json = record.to_json();
+    EXPECT_EQ("sampled", json["reason"].get<std::string>());
+    EXPECT_EQ("GET", json["opcode"].get<std::string>());
+    EXPECT_EQ(3u, json["trace"].size());
+    EXPECT_EQ("parse", json["trace"][1]["name"].get<std::string>());
+}
+
+TEST(RequestTraceRecordTest, Truncated) {
+    cb::tracing::Tracer tracer;
+    tracer.begin(Code::Request);
+    for (size_t ii = 0; ii < RequestTraceRecord::MaxSpans; ++ii) {
+        tracer.begin(Code::Execute);
+    }
+    RequestTraceRecord record{
+            RequestTraceRecord::Reason::Slow, tracer, 1s, 0, 0, 0, 0};
+    EXPECT_EQ(RequestTraceRecord::MaxSpans, record.numSpans);
+    EXPECT_TRUE(record.truncated);
+    // The spans were never ended
+    EXPECT_EQ(-1, record.spans[1].duration);
+}
+
+TEST(RequestTraceRingTest, Sample) {
+    RequestTraceRing ring(4);
+    EXPECT_FALSE(ring.sample(0));
+    int sampled = 0;
+    for (int ii = 0; ii < 100; ++ii) {
+        if (ring.sample(10)) {
+            ++sampled;
+        }
+    }
+    EXPECT_EQ(10, sampled);
+}
+
+TEST(RequestTraceRingTest, Wraps) {
+    RequestTraceRing ring(4);
+    EXPECT_TRUE(ring.snapshot().empty());
+
+    ring.push(makeRecord(0));
+    ring.push(makeRecord(1));
+    auto records = ring.snapshot();
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(0u, records[0].connectionId);
+    EXPECT_EQ(1u, records[1].connectionId);
+
+    // Once full the oldest records get replaced
+    for (uint32_t ii = 2; ii < 10; ++ii) {
+        ring.push(makeRecord(ii));
+    }
+    EXPECT_EQ(10u, ring.getTotalRecords());
+    records = ring.snapshot();
+    ASSERT_EQ(4u, records.size());
+    for (uint32_t ii = 0; ii < 4; ++ii) {
+        EXPECT_EQ(6 + ii, records[ii].connectionId);
+    }
+}
@@ -95,6 +95,20 @@ static void handle_always_collect_trace_info(Settings& s,
     s.setAlwaysCollectTraceInfo(obj.get<bool>());
 }
 
+static void handle_request_trace_sample_rate(Settings& s,
+                                             const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                R"("request_trace_sample_rate" must be a positive number)");
+    }
+    s.setRequestTraceSampleRate(obj.get<size_t>());
+}
+
+static void handle_request_trace_slow_ops(Settings& s,
+                                          const nlohmann::json& obj) {
+    s.setRequestTraceSlowOpsEnabled(obj.get<bool>());
+}
+
 /**
  * Handle the "rbac_file" tag in the settings
  *
@@ -182,6 +196,15 @@ static void handle_scramsha_fallback_salt(Settings& s,
     s.setScramshaFallbackSalt(salt);
 }
 
+static void handle_sasl_auth_cache_ttl(Settings& s,
+                                       const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                R"("sasl_auth_cache_ttl" must be a positive number)");
+    }
+    s.setSaslAuthCacheTtl(std::chrono::seconds(obj.get<uint32_t>()));
+}
+
 static void handle_external_auth_service(Settings& s,
                                          const nlohmann::json& obj) {
     s.setExternalAuthServiceEnabled(obj.get<bool>());
@@ -409,6 +432,15 @@ static void handle_ssl_cipher_order(Settings& s, const nlohmann::json& obj) {
     s.setSslCipherOrder(obj.get<bool>());
 }
 
+static void handle_ssl_session_tickets(Settings& s,
+                                       const nlohmann::json& obj) {
+    s.setSslSessionTickets(obj.get<bool>());
+}
+
+static void handle_ssl_ktls(Settings& s, const nlohmann::json& obj) {
+    s.setSslKtls(obj.get<bool>());
+}
+
 /**
  * Handle the "ssl_minimum_protocol" tag in the settings
  *
@@ -673,6 +705,8 @@ void Settings::reconfigure(const nlohmann::json& json) {
     std::vector<settings_config_tokens> handlers = {
             {"admin", ignore_entry},
             {"always_collect_trace_info", handle_always_collect_trace_info},
+            {"request_trace_sample_rate", handle_request_trace_sample_rate},
+            {"request_trace_slow_ops", handle_request_trace_slow_ops},
             {"rbac_file", handle_rbac_file},
             {"privilege_debug", handle_privilege_debug},
             {"audit_file", handle_audit_file},
@@ -692,6 +726,8 @@ void Settings::reconfigure(const nlohmann::json& json) {
             {"root", handle_root},
             {"ssl_cipher_list", handle_ssl_cipher_list},
             {"ssl_cipher_order", handle_ssl_cipher_order},
+            {"ssl_session_tickets", handle_ssl_session_tickets},
+            {"ssl_ktls", handle_ssl_ktls},
             {"ssl_minimum_protocol", handle_ssl_minimum_protocol},
             {"breakpad", handle_breakpad},
             {"max_packet_size", handle_max_packet_size},
@@ -710,6 +746,7 @@ void Settings::reconfigure(const nlohmann::json& json) {
             {"topkeys_enabled", handle_topkeys_enabled},
             {"tracing_enabled", handle_tracing_enabled},
             {"scramsha_fallback_salt", handle_scramsha_fallback_salt},
+            {"sasl_auth_cache_ttl", handle_sasl_auth_cache_ttl},
             {"external_auth_service", handle_external_auth_service},
             {"active_external_users_push_interval",
              handle_active_external_users_push_interval},
@@ -835,6 +872,26 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
     }
 
+    if (other.has.request_trace_sample_rate) {
+        if (other.getRequestTraceSampleRate() != getRequestTraceSampleRate()) {
+            LOG_INFO("Change request trace sample rate from 1/{} to 1/{}",
+                     getRequestTraceSampleRate(),
+                     other.getRequestTraceSampleRate());
+            setRequestTraceSampleRate(other.getRequestTraceSampleRate());
+        }
+    }
+
+    if (other.has.request_trace_slow_ops) {
+        if (other.isRequestTraceSlowOpsEnabled() !=
+            isRequestTraceSlowOpsEnabled()) {
+            LOG_INFO("{} recording of slow requests in the request trace ring",
+                     other.isRequestTraceSlowOpsEnabled() ? "Enable"
+                                                          : "Disable");
+            setRequestTraceSlowOpsEnabled(
+                    other.isRequestTraceSlowOpsEnabled());
+        }
+    }
+
     if (other.has.datatype_snappy) {
         if (other.datatype_snappy != datatype_snappy) {
             std::string curr_val_str = datatype_snappy ? "true" : "false";
@@ -943,6 +1000,24 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
     }
 
+    if (other.has.ssl_session_tickets) {
+        if (other.isSslSessionTickets() != isSslSessionTickets()) {
+            LOG_INFO(R"(Change SSL session tickets from "{}" to "{}")",
+                     isSslSessionTickets() ? "enabled" : "disabled",
+                     other.isSslSessionTickets() ? "enabled" : "disabled");
+            setSslSessionTickets(other.isSslSessionTickets());
+        }
+    }
+
+    if (other.has.ssl_ktls) {
+        if (other.isSslKtls() != isSslKtls()) {
+            LOG_INFO(R"(Change kernel TLS from "{}" to "{}")",
+                     isSslKtls() ? "enabled" : "disabled",
+                     other.isSslKtls() ? "enabled" : "disabled");
+            setSslKtls(other.isSslKtls());
+        }
+    }
+
     if (other.has.client_cert_auth) {
         const auto m = client_cert_mapper.to_string();
         const auto o = other.client_cert_mapper.to_string();
@@ -1102,6 +1177,15 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         setTracingEnabled(other.isTracingEnabled());
     }
 
+    if (other.has.sasl_auth_cache_ttl) {
+        if (other.getSaslAuthCacheTtl() != getSaslAuthCacheTtl()) {
+            LOG_INFO("Change SASL auth cache TTL from {}s to {}s",
+                     getSaslAuthCacheTtl().count(),
+                     other.getSaslAuthCacheTtl().count());
+            setSaslAuthCacheTtl(other.getSaslAuthCacheTtl());
+        }
+    }
+
     if (other.has.scramsha_fallback_salt) {
         const auto o = other.getScramshaFallbackSalt();
         const auto m = getScramshaFallbackSalt();
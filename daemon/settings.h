@@ -90,6 +90,31 @@ public:
         notify_changed("always_collect_trace_info");
     }
 
+    /// Record the trace of one out of every N requests in the request
+    /// trace ring (0 = no sampling)
+    size_t getRequestTraceSampleRate() const {
+        return request_trace_sample_rate.load(std::memory_order_consume);
+    }
+
+    void setRequestTraceSampleRate(size_t rate) {
+        request_trace_sample_rate.store(rate, std::memory_order_release);
+        has.request_trace_sample_rate = true;
+        notify_changed("request_trace_sample_rate");
+    }
+
+    /// Should requests exceeding the slow threshold for their opcode be
+    /// recorded in the request trace ring (with their spans if the request
+    /// is traced, otherwise just their duration)
+    bool isRequestTraceSlowOpsEnabled() const {
+        return request_trace_slow_ops.load(std::memory_order_consume);
+    }
+
+    void setRequestTraceSlowOpsEnabled(bool enabled) {
+        request_trace_slow_ops.store(enabled, std::memory_order_release);
+        has.request_trace_slow_ops = true;
+        notify_changed("request_trace_slow_ops");
+    }
+
     /**
      * Get the name of the file containing the RBAC data
      *
@@ -503,6 +528,28 @@ public:
 
     void setSslCipherOrder(bool ordered);
 
+    /// Should clients be issued TLS session tickets (to allow resumption)
+    bool isSslSessionTickets() const {
+        return ssl_session_tickets.load(std::memory_order_acquire);
+    }
+
+    void setSslSessionTickets(bool enable) {
+        ssl_session_tickets.store(enable, std::memory_order_release);
+        has.ssl_session_tickets = true;
+        notify_changed("ssl_session_tickets");
+    }
+
+    /// Should the symmetric crypto be offloaded to kernel TLS (if supported)
+    bool isSslKtls() const {
+        return ssl_ktls.load(std::memory_order_acquire);
+    }
+
+    void setSslKtls(bool enable) {
+        ssl_ktls.store(enable, std::memory_order_release);
+        has.ssl_ktls = true;
+        notify_changed("ssl_ktls");
+    }
+
     /// get the configured SSL protocol mask
     long getSslProtocolMask()const {
         return ssl_protocol_mask.load();
@@ -731,6 +778,17 @@ public:
         notify_changed("scramsha_fallback_salt");
     }
 
+    /// How long a successful PLAIN authentication is cached (0 = never)
+    std::chrono::seconds getSaslAuthCacheTtl() const {
+        return sasl_auth_cache_ttl.load(std::memory_order_acquire);
+    }
+
+    void setSaslAuthCacheTtl(std::chrono::seconds ttl) {
+        sasl_auth_cache_ttl.store(ttl, std::memory_order_release);
+        has.sasl_auth_cache_ttl = true;
+        notify_changed("sasl_auth_cache_ttl");
+    }
+
     std::string getScramshaFallbackSalt() const {
         return std::string{*scramsha_fallback_salt.rlock()};
     }
@@ -825,6 +883,12 @@ protected:
     /// Should the server always collect trace information for commands
     std::atomic_bool always_collect_trace_info{false};
 
+    /// Sample one out of every N requests into the request trace ring
+    std::atomic<size_t> request_trace_sample_rate{1000};
+
+    /// Record all slow requests in the request trace ring
+    std::atomic_bool request_trace_slow_ops{true};
+
     /**
      * The file containing the RBAC user data
      */
@@ -910,6 +974,12 @@ protected:
     /// if we should use the ssl cipher ordering
     std::atomic_bool ssl_cipher_order{true};
 
+    /// if we should issue TLS session tickets
+    std::atomic_bool ssl_session_tickets{true};
+
+    /// if we should try to use kernel TLS after the handshake
+    std::atomic_bool ssl_ktls{false};
+
     /**
      * The minimum ssl protocol to use (by default this is TLS1)
      */
@@ -999,6 +1069,10 @@ protected:
     /// The salt to return to users we don't know about
     folly::Synchronized<std::string> scramsha_fallback_salt;
 
+    /// The time a successful PLAIN authentication stays in the auth cache
+    std::atomic<std::chrono::seconds> sasl_auth_cache_ttl{
+            std::chrono::seconds(60)};
+
     /**
      * Note that it is not safe to add new listeners after we've spun up
      * new threads as we don't try to lock the object.
@@ -1024,6 +1098,8 @@ public:
      */
     struct {
         bool always_collect_trace_info = false;
+        bool request_trace_sample_rate = false;
+        bool request_trace_slow_ops = false;
         bool rbac_file = false;
         bool privilege_debug = false;
         bool threads = false;
@@ -1043,6 +1119,8 @@ public:
         bool max_packet_size = false;
         bool ssl_cipher_list = false;
         bool ssl_cipher_order = false;
+        bool ssl_session_tickets = false;
+        bool ssl_ktls = false;
         bool ssl_cipher_suites = false;
         bool ssl_minimum_protocol = false;
         bool client_cert_auth = false;
@@ -1058,6 +1136,7 @@ public:
         bool tracing_enabled = false;
         bool stdin_listener = false;
         bool scramsha_fallback_salt = false;
+        bool sasl_auth_cache_ttl = false;
         bool external_auth_service = false;
         bool active_external_users_push_interval = false;
         bool max_connections = false;
@@ -20,9 +20,18 @@
 #include "listening_port.h"
 #include "settings.h"
 #include <folly/Synchronized.h>
+#include <logger/logger.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 #include <openssl/ssl.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <stdexcept>
 
 long decode_ssl_protocol(const std::string& protocol) {
@@ -81,6 +90,155 @@ struct ssl_ctx_st_deleter {
 using uniqueSslCtxPtr = std::unique_ptr<ssl_ctx_st, ssl_ctx_st_deleter>;
 folly::Synchronized<std::map<std::string, uniqueSslCtxPtr>> interfaceCache;
 
+/**
+ * The keys used to protect the TLS session tickets. They are shared by all
+ * interfaces (so that a client may resume its session on any of the ports)
+ * and rotated whenever the current key is older than TicketKeyLifetime. The
+ * previous key is kept so that tickets issued right before a rotation may
+ * still be used (the client gets a new ticket). When the SSL cache is
+ * invalidated (the TLS configuration is reloaded) all the keys are replaced,
+ * so sessions established under the old configuration (which may have been
+ * verified against another CA or client certificate policy) can't resume.
+ */
+struct TicketKey {
+    std::array<unsigned char, 16> name;
+    std::array<unsigned char, 32> aesKey;
+    std::array<unsigned char, 32> hmacKey;
+    std::chrono::steady_clock::time_point created;
+};
+static const std::chrono::hours TicketKeyLifetime{1};
+/// The ticket keys in use (current first)
+static folly::Synchronized<std::deque<TicketKey>> ticketKeys;
+
+static TicketKey createTicketKey() {
+    TicketKey ret;
+    if (RAND_bytes(ret.name.data(), int(ret.name.size())) != 1 ||
+        RAND_bytes(ret.aesKey.data(), int(ret.aesKey.size())) != 1 ||
+        RAND_bytes(ret.hmacKey.data(), int(ret.hmacKey.size())) != 1) {
+        throw std::runtime_error(
+                "createTicketKey: Failed to generate random data");
+    }
+    ret.created = std::chrono::steady_clock::now();
+    return ret;
+}
+
+static void rotateTicketKeys(std::deque<TicketKey>& keys) {
+    keys.push_front(createTicketKey());
+    while (keys.size() > 2) {
+        keys.pop_back();
+    }
+}
+
+/**
+ * Callback from OpenSSL to encrypt (enc == 1) or decrypt a session ticket.
+ * See SSL_CTX_set_tlsext_ticket_key_cb(3)
+ *
+ * @return 1 if the ticket may be used, 2 if the ticket may be used but
+ *         should be renewed, 0 if no ticket should be issued (or the
+ *         ticket is unknown and a full handshake is needed)
+ */
+static int ticketKeyCallback(SSL*,
+                             unsigned char* name,
+                             unsigned char* iv,
+                             EVP_CIPHER_CTX* cipherCtx,
+                             HMAC_CTX* hmacCtx,
+                             int enc) {
+    try {
+        TicketKey key;
+        bool current = true;
+        if (enc) {
+            {
+                auto keys = ticketKeys.wlock();
+                if (keys->empty() || std::chrono::steady_clock::now() -
+                                                     keys->front().created >
+                                             TicketKeyLifetime) {
+                    rotateTicketKeys(*keys);
+                }
+                key = keys->front();
+            }
+            if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) {
+                return 0;
+            }
+            std::copy(key.name.begin(), key.name.end(), name);
+            if (EVP_EncryptInit_ex(cipherCtx,
+                                   EVP_aes_256_cbc(),
+                                   nullptr,
+                                   key.aesKey.data(),
+                                   iv) != 1) {
+                return 0;
+            }
+        } else {
+            {
+                auto keys = ticketKeys.rlock();
+                auto iter = std::find_if(
+                        keys->begin(), keys->end(), [name](const auto& k) {
+                            return std::memcmp(k.name.data(),
+                                               name,
+                                               k.name.size()) == 0;
+                        });
+                if (iter == keys->end()) {
+                    // Unknown (or expired) key; do a full handshake
+                    return 0;
+                }
+                key = *iter;
+                current = iter == keys->begin();
+            }
+            if (EVP_DecryptInit_ex(cipherCtx,
+                                   EVP_aes_256_cbc(),
+                                   nullptr,
+                                   key.aesKey.data(),
+                                   iv) != 1) {
+                return 0;
+            }
+        }
+
+        if (HMAC_Init_ex(hmacCtx,
+                         key.hmacKey.data(),
+                         int(key.hmacKey.size()),
+                         EVP_sha256(),
+                         nullptr) != 1) {
+            return 0;
+        }
+        return current ? 1 : 2;
+    } catch (const std::exception& e) {
+        LOG_WARNING("ticketKeyCallback: {}", e.what());
+        return 0;
+    }
+}
+
+/// Enable (or disable) resumption of TLS sessions through session tickets
+static void setupSessionTickets(SSL_CTX* ctx, bool enabled) {
+    // Required for resumption when we verify the client certificates
+    static const unsigned char sessionIdContext[] = "memcached";
+    SSL_CTX_set_session_id_context(
+            ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
+
+    // We don't keep a server side session cache, the state lives in the
+    // (encrypted) ticket
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    if (enabled) {
+        SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketKeyCallback);
+    } else {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+}
+
+/// Ask OpenSSL to hand the symmetric crypto to the kernel after the
+/// handshake (if OpenSSL was built with kTLS support)
+static void setupKtls(SSL_CTX* ctx) {
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#else
+    (void)ctx;
+    static std::atomic_bool warned{false};
+    if (!warned.exchange(true)) {
+        LOG_WARNING(
+                "ssl_ktls is enabled, but OpenSSL was built without kernel "
+                "TLS support");
+    }
+#endif
+}
+
 static uniqueSslCtxPtr createCacheEntry(const ListeningPort& ifc) {
     auto& settings = Settings::instance();
     uniqueSslCtxPtr ret{SSL_CTX_new(SSLv23_server_method())};
@@ -90,6 +248,10 @@ static uniqueSslCtxPtr createCacheEntry(const ListeningPort& ifc) {
     SSL_CTX_set_mode(server_ctx,
                      SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
                              SSL_MODE_ENABLE_PARTIAL_WRITE);
+    setupSessionTickets(server_ctx, settings.isSslSessionTickets());
+    if (settings.isSslKtls()) {
+        setupKtls(server_ctx);
+    }
 
     if (!SSL_CTX_use_certificate_chain_file(server_ctx, ifc.sslCert.c_str()) ||
         !SSL_CTX_use_PrivateKey_file(
@@ -157,4 +319,26 @@ uniqueSslPtr createSslStructure(const ListeningPort& ifc) {
 
 void invalidateSslCache() {
     interfaceCache.wlock()->clear();
+    // The TLS configuration changed, so no ticket issued under the old
+    // configuration may be used to resume a session
+    try {
+        auto newKey = createTicketKey();
+        auto keys = ticketKeys.wlock();
+        keys->clear();
+        keys->push_front(newKey);
+    } catch (const std::exception& e) {
+        // Without a key a new one gets created for the next ticket
+        ticketKeys.wlock()->clear();
+        LOG_WARNING("invalidateSslCache: Failed to create a ticket key: {}",
+                    e.what());
+    }
+}
+
+bool isKtlsSendEnabled(ssl_st* ssl) {
+#ifdef BIO_get_ktls_send
+    return BIO_get_ktls_send(SSL_get_wbio(ssl));
+#else
+    (void)ssl;
+    return false;
+#endif
 }
@@ -52,5 +52,13 @@ using uniqueSslPtr = std::unique_ptr<ssl_st, ssl_st_deleter>;
  */
 uniqueSslPtr createSslStructure(const ListeningPort& port);
 
-/// Invalidate the cache we've got of SSL_CTX objects in use
+/**
+ * Invalidate the cache we've got of SSL_CTX objects in use (and replace
+ * the keys used to protect TLS session tickets, so sessions established
+ * before the call can't be resumed)
+ */
 void invalidateSslCache();
+
+/// Is the kernel doing the encryption for data sent on the connection
+/// (kTLS)?
+bool isKtlsSendEnabled(ssl_st* ssl);
@@ -0,0 +1,121 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "ssl_utils.h"
+#include "listening_port.h"
+#include "settings.h"
+
+#include <folly/portability/GTest.h>
+#include <logger/logger.h>
+#include <openssl/ssl.h>
+#include <platform/dirutils.h>
+
+/**
+ * Tests for the resumption of TLS sessions through session tickets. The
+ * handshakes are done in memory between a client SSL and the SSL created
+ * for a (never opened) listening port.
+ */
+class SslSessionTicketTest : public ::testing::Test {
+public:
+    static void SetUpTestCase() {
+        cb::logger::createBlackholeLogger();
+    }
+
+protected:
+    void SetUp() override {
+        auto& settings = Settings::instance();
+        settings.setSslCipherList("HIGH");
+        settings.setSslSessionTickets(true);
+        invalidateSslCache();
+
+        // The tickets of TLS 1.2 are part of the handshake
+        clientCtx.reset(SSL_CTX_new(TLS_client_method()));
+        ASSERT_TRUE(clientCtx);
+        SSL_CTX_set_max_proto_version(clientCtx.get(), TLS1_2_VERSION);
+    }
+
+    void TearDown() override {
+        SSL_SESSION_free(session);
+        invalidateSslCache();
+    }
+
+    /**
+     * Do a handshake with the server, offering the session of the previous
+     * handshake (if any), and keep the session it ends up with.
+     *
+     * @return true if the session was resumed
+     */
+    bool handshake() {
+        auto server = createSslStructure(port);
+        std::unique_ptr<SSL, ssl_st_deleter> client{SSL_new(clientCtx.get())};
+        if (session) {
+            SSL_set_session(client.get(), session);
+        }
+
+        BIO* clientBio;
+        BIO* serverBio;
+        BIO_new_bio_pair(&clientBio, 0, &serverBio, 0);
+        SSL_set_bio(client.get(), clientBio, clientBio);
+        SSL_set_bio(server.get(), serverBio, serverBio);
+        SSL_set_connect_state(client.get());
+        SSL_set_accept_state(server.get());
+
+        bool clientDone = false;
+        bool serverDone = false;
+        for (int ii = 0; ii < 100 && !(clientDone && serverDone); ++ii) {
+            clientDone = clientDone || SSL_do_handshake(client.get()) == 1;
+            serverDone = serverDone || SSL_do_handshake(server.get()) == 1;
+        }
+        EXPECT_TRUE(clientDone && serverDone) << "Handshake failed";
+
+        SSL_SESSION_free(session);
+        session = SSL_get1_session(client.get());
+        return SSL_session_reused(client.get()) == 1;
+    }
+
+    const std::string certDir = cb::io::getcwd() + "/tests/cert/";
+    const ListeningPort port{"ssl",
+                             "127.0.0.1",
+                             11207,
+                             AF_INET,
+                             false,
+                             certDir + "testapp.pem",
+                             certDir + "testapp.cert"};
+
+    struct SslCtxDeleter {
+        void operator()(SSL_CTX* ctx) {
+            SSL_CTX_free(ctx);
+        }
+    };
+    std::unique_ptr<SSL_CTX, SslCtxDeleter> clientCtx;
+    SSL_SESSION* session = nullptr;
+};
+
+TEST_F(SslSessionTicketTest, TicketResumesSession) {
+    EXPECT_FALSE(handshake());
+    EXPECT_TRUE(handshake());
+}
+
+// A ticket issued before the TLS configuration was reloaded may not be used
+// to skip the (possibly stricter) verification of the new configuration.
+TEST_F(SslSessionTicketTest, NoResumptionAfterReload) {
+    EXPECT_FALSE(handshake());
+    invalidateSslCache();
+    EXPECT_FALSE(handshake());
+    // ... but the new session may be resumed
+    EXPECT_TRUE(handshake());
+}
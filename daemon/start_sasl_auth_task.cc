@@ -20,9 +20,11 @@
 #include "cookie.h"
 #include "external_auth_manager_thread.h"
 #include "settings.h"
+#include <cbsasl/auth_cache.h>
 #include <cbsasl/mechanism.h>
 #include <cbsasl/server.h>
 #include <logger/logger.h>
+#include <memcached/rbac.h>
 #include <nlohmann/json.hpp>
 
 StartSaslAuthTask::StartSaslAuthTask(Cookie& cookie_,
@@ -80,6 +82,19 @@ Task::Status StartSaslAuthTask::internal_auth() {
     if (response.first == cb::sasl::Error::NO_USER &&
         Settings::instance().isExternalAuthServiceEnabled() &&
         mechanism == "PLAIN") {
+        // Skip the round trip to the auth provider if the user recently
+        // authenticated with the same credentials (and we still hold the
+        // RBAC entry for the user)
+        auto& cache = cb::sasl::server::AuthCache::instance();
+        if (cb::rbac::getExternalUserTimestamp(getUsername()) &&
+            cache.lookup(cb::sasl::Domain::External,
+                         getUsername(),
+                         challenge)) {
+            successfull_external_auth();
+            return Status::Finished;
+        }
+        authCacheGeneration = cache.getGeneration();
+
         // We can't hold this lock when we're trying to enqueue the
         // request
         internal = false;
@@ -103,6 +118,13 @@ void StartSaslAuthTask::externalAuthResponse(cb::mcbp::Status status,
 
     if (status == cb::mcbp::Status::Success) {
         successfull_external_auth();
+        if (response.first == cb::sasl::Error::OK) {
+            cb::sasl::server::AuthCache::instance().insert(
+                    authCacheGeneration,
+                    cb::sasl::Domain::External,
+                    getUsername(),
+                    challenge);
+        }
     } else {
         unsuccessfull_external_auth(status, payload);
     }
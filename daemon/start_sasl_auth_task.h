@@ -53,4 +53,7 @@ protected:
 
     // Is this phase for internal or external auth
     bool internal = true;
+
+    // The generation of the auth cache when the external auth started
+    uint64_t authCacheGeneration = 0;
 };
@@ -191,6 +191,15 @@ struct stats {
 
     /** The number of times I reject a client */
     cb::RelaxedAtomic<uint64_t> rejected_conns;
+
+    /** The number of completed TLS handshakes */
+    cb::RelaxedAtomic<uint64_t> ssl_handshakes;
+
+    /** The number of TLS handshakes which resumed a previous session */
+    cb::RelaxedAtomic<uint64_t> ssl_sessions_reused;
+
+    /** The number of TLS connections where the kernel encrypts the data */
+    cb::RelaxedAtomic<uint64_t> ssl_ktls_conns;
 };
 
 class Connection;
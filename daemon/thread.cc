@@ -10,6 +10,7 @@
 #include "log_macros.h"
 #include "memcached.h"
 #include "opentracing.h"
+#include "request_trace_ring.h"
 #include "settings.h"
 #include "stats.h"
 #include "tracing.h"
@@ -426,6 +427,10 @@ void thread_init(size_t nthr,
                  struct event_base* main_base,
                  void (*dispatcher_callback)(evutil_socket_t, short, void*)) {
     scheduler_info.resize(nthr);
+    request_trace_rings.resize(nthr);
+    for (auto& ring : request_trace_rings) {
+        ring = std::make_unique<RequestTraceRing>();
+    }
 
     try {
         threads = std::vector<FrontEndThread>(nthr);
@@ -332,6 +332,38 @@ cb::EngineErrorItemPair default_engine::get(
     }
 }
 
+std::vector<cb::EngineErrorItemPair> default_engine::get_multi(
+        const std::vector<cb::EngineGetRequest>& requests) {
+    std::vector<cb::EngineErrorItemPair> results;
+    results.reserve(requests.size());
+
+    // Look up all of the keys for vbuckets we handle in one go, and
+    // remember where each result belongs
+    std::vector<std::pair<DocKey, DocStateFilter>> keys;
+    std::vector<size_t> index;
+    for (const auto& req : requests) {
+        if (handled_vbucket(this, req.vbucket)) {
+            keys.emplace_back(req.key, req.documentStateFilter);
+            index.push_back(results.size());
+            results.push_back(
+                    cb::makeEngineErrorItemPair(cb::engine_errc::no_such_key));
+        } else {
+            results.push_back(std::make_pair(
+                    cb::engine_errc::not_my_vbucket,
+                    cb::unique_item_ptr{nullptr, cb::ItemDeleter{this}}));
+        }
+    }
+
+    const auto items = item_get_multi(this, keys);
+    for (size_t ii = 0; ii < items.size(); ++ii) {
+        if (items[ii] != nullptr) {
+            results[index[ii]] = cb::makeEngineErrorItemPair(
+                    cb::engine_errc::success, items[ii], this);
+        }
+    }
+    return results;
+}
+
 cb::EngineErrorItemPair default_engine::get_if(
         gsl::not_null<const void*> cookie,
         const DocKey& key,
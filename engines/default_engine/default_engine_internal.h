@@ -122,6 +122,8 @@ struct default_engine : public EngineIface {
                                 const DocKey& key,
                                 Vbid vbucket,
                                 DocStateFilter documentStateFilter) override;
+    std::vector<cb::EngineErrorItemPair> get_multi(
+            const std::vector<cb::EngineGetRequest>& requests) override;
     cb::EngineErrorItemPair get_if(
             gsl::not_null<const void*> cookie,
             const DocKey& key,
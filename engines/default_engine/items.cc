@@ -677,6 +677,37 @@ hash_item* item_get(struct default_engine* engine,
     return do_item_get(engine, &key, state);
 }
 
+std::vector<hash_item*> item_get_multi(
+        struct default_engine* engine,
+        const std::vector<std::pair<DocKey, DocStateFilter>>& keys) {
+    std::vector<hash_item*> ret(keys.size(), nullptr);
+    // hash_key points into itself, so the keys must be created in place
+    std::vector<hash_key> hkeys(keys.size());
+    std::vector<bool> valid(keys.size());
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        valid[ii] = hash_key_create(&hkeys[ii],
+                                    keys[ii].first.data(),
+                                    keys[ii].first.size(),
+                                    engine);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(engine->items.lock);
+        for (size_t ii = 0; ii < keys.size(); ++ii) {
+            if (valid[ii]) {
+                ret[ii] = do_item_get(engine, &hkeys[ii], keys[ii].second);
+            }
+        }
+    }
+
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        if (valid[ii]) {
+            hash_key_destroy(&hkeys[ii]);
+        }
+    }
+    return ret;
+}
+
 /*
  * Decrements the reference count on an item and adds it to the freelist if
  * needed.
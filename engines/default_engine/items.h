@@ -1,5 +1,6 @@
 #pragma once
 
+#include "memcached/dockey.h"
 #include "memcached/types.h"
 #include "slabs.h"
 
@@ -7,6 +8,7 @@
 #include <atomic>
 #include <cstddef>
 #include <cstring>
+#include <vector>
 
 /*
  * You should not try to aquire any of the item locks before calling these
@@ -204,6 +206,20 @@ hash_item* item_get(struct default_engine* engine,
                     const hash_key& key,
                     const DocStateFilter state);
 
+/**
+ * Get a batch of items from the cache. The hash keys are built before
+ * the cache lock is acquired, and the lock is then held once for the
+ * whole batch rather than once per item.
+ *
+ * @param engine handle to the storage engine
+ * @param keys the keys to look up, each with the document states to return
+ * @return one entry per key; pointer to the item if it exists or NULL
+ *         otherwise
+ */
+std::vector<hash_item*> item_get_multi(
+        struct default_engine* engine,
+        const std::vector<std::pair<DocKey, DocStateFilter>>& keys);
+
 /**
  * Get an item from the cache and acquire the lock.
  *
@@ -20,6 +20,7 @@
 #include "item.h"
 #include "kvstore.h"
 #include "kvstore_config.h"
+#include "log-kvstore/log-kvstore_config.h"
 #include "vb_commit.h"
 #ifdef EP_USE_ROCKSDB
 #include "rocksdb-kvstore/rocksdb-kvstore_config.h"
@@ -33,10 +34,13 @@
 #include <platform/dirutils.h>
 #include <programs/engine_testapp/mock_server.h>
 
+#include <random>
+
 using namespace std::string_literals;
 
 enum Storage {
-    COUCHSTORE = 0
+    COUCHSTORE = 0,
+    LOGSTORE
 #ifdef EP_USE_ROCKSDB
     ,
     ROCKSDB
@@ -106,6 +110,17 @@ protected:
                     config, workload.getNumShards(), shardId);
             break;
         }
+        case LOGSTORE: {
+            state.SetLabel("LogStore");
+            config.parseConfiguration(
+                    (configStr + ";backend=logstore").c_str(),
+                    get_mock_server_api());
+            WorkLoadPolicy workload(config.getMaxNumWorkers(),
+                                    config.getMaxNumShards());
+            kvstoreConfig = std::make_unique<LogKVStoreConfig>(
+                    config, workload.getNumShards(), shardId);
+            break;
+        }
 #ifdef EP_USE_ROCKSDB
         case ROCKSDB: {
             state.SetLabel("CouchRocks");
@@ -203,11 +218,81 @@ BENCHMARK_DEFINE_F(KVStoreBench, Scan)(benchmark::State& state) {
     state.SetItemsProcessed(itemCountTotal);
 }
 
+/*
+ * Benchmark for KVStore::commit() of small batches of updates to existing
+ * keys. Reports the bytes written to disk per byte of document (key, value
+ * and metadata) as WriteAmp.
+ */
+BENCHMARK_DEFINE_F(KVStoreBench, Flush)(benchmark::State& state) {
+    const size_t batchSize = 100;
+    const std::string value(256, 'x');
+    MockWriteCallback wc;
+    Collections::VB::Manifest m;
+    int64_t seqno = numItems + 1;
+    size_t docBytes = 0;
+
+    size_t bytesBefore = 0;
+    kvstore->getStat("io_total_write_bytes", bytesBefore);
+
+    while (state.KeepRunning()) {
+        kvstore->begin(std::make_unique<TransactionContext>(vbid));
+        for (size_t i = 0; i < batchSize; i++) {
+            auto key = makeStoredDocKey("key" +
+                                        std::to_string(1 + (seqno % numItems)));
+            Item item(key,
+                      0 /*flags*/,
+                      0 /*exptime*/,
+                      value.c_str(),
+                      value.size(),
+                      PROTOCOL_BINARY_RAW_BYTES,
+                      0 /*cas*/,
+                      seqno++,
+                      vbid);
+            docBytes += key.size() + value.size();
+            kvstore->set(item, wc);
+        }
+        VB::Commit f(m);
+        ASSERT_TRUE(kvstore->commit(f));
+    }
+
+    size_t bytesAfter = 0;
+    if (kvstore->getStat("io_total_write_bytes", bytesAfter) && docBytes) {
+        state.counters["WriteAmp"] =
+                double(bytesAfter - bytesBefore) / double(docBytes);
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+
+/*
+ * Benchmark for KVStore::get() of random keys.
+ */
+BENCHMARK_DEFINE_F(KVStoreBench, Get)(benchmark::State& state) {
+    std::mt19937 generator(0);
+    std::uniform_int_distribution<int> distribution(1, numItems);
+
+    while (state.KeepRunning()) {
+        auto key = makeDiskDocKey("key" +
+                                  std::to_string(distribution(generator)));
+        auto gv = kvstore->get(key, vbid);
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
 const int NUM_ITEMS = 100000;
 
 BENCHMARK_REGISTER_F(KVStoreBench, Scan)
         ->Args({NUM_ITEMS, COUCHSTORE})
+        ->Args({NUM_ITEMS, LOGSTORE})
 #ifdef EP_USE_ROCKSDB
         ->Args({NUM_ITEMS, ROCKSDB})
 #endif
         ;
+
+BENCHMARK_REGISTER_F(KVStoreBench, Flush)
+        ->Args({NUM_ITEMS, COUCHSTORE})
+        ->Args({NUM_ITEMS, LOGSTORE});
+
+BENCHMARK_REGISTER_F(KVStoreBench, Get)
+        ->Args({NUM_ITEMS, COUCHSTORE})
+        ->Args({NUM_ITEMS, LOGSTORE});
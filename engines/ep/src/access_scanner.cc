@@ -20,6 +20,7 @@
 #include "ep_time.h"
 #include "hash_table.h"
 #include "kv_bucket.h"
+#include "mapped_access_log.h"
 #include "mutation_log.h"
 #include "stats.h"
 #include "vb_count_visitor.h"
@@ -57,12 +58,23 @@ public:
         prev = name + ".old";
         next = name + ".next";
 
-        log = std::make_unique<MutationLog>(next, conf.getAlogBlockSize());
-        log->open();
-        if (!log->isOpen()) {
-            EP_LOG_WARN("Failed to open access log: '{}'", next);
-            log.reset();
+        if (conf.getAlogFormat() == "mapped") {
+            try {
+                mappedLog = std::make_unique<MappedAccessLogWriter>(next);
+            } catch (const std::system_error& e) {
+                EP_LOG_WARN("Failed to open access log: '{}': {}",
+                            next,
+                            e.what());
+            }
         } else {
+            log = std::make_unique<MutationLog>(next, conf.getAlogBlockSize());
+            log->open();
+            if (!log->isOpen()) {
+                EP_LOG_WARN("Failed to open access log: '{}'", next);
+                log.reset();
+            }
+        }
+        if (log || mappedLog) {
             EP_LOG_INFO(
                     "Attempting to generate new access file "
                     "'{}'",
@@ -72,7 +84,7 @@ public:
 
     bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
         // Record resident, Committed HashTable items as 'accessed'.
-        if (log && v.isResident() && v.isCommitted()) {
+        if ((log || mappedLog) && v.isResident() && v.isCommitted()) {
             if (v.isExpired(startTime) || v.isDeleted()) {
                 EP_LOG_DEBUG("Skipping expired/deleted item: {}",
                              v.getBySeqno());
@@ -94,6 +106,11 @@ public:
     }
 
     void visitBucket(const VBucketPtr& vb) override {
+        if (mappedLog) {
+            visitBucketMapped(vb);
+            return;
+        }
+
         update(vb->getId());
 
         if (log == nullptr) {
@@ -111,15 +128,65 @@ public:
         }
     }
 
+    /**
+     * Visit a vBucket when generating a mapped access log; all of the
+     * vBucket's keys are collected before being written as one section.
+     */
+    void visitBucketMapped(const VBucketPtr& vb) {
+        accessed.clear();
+        if (!vBucketFilter(vb->getId())) {
+            return;
+        }
+        HashTable::Position ht_start;
+        while (ht_start != vb->ht.endPosition()) {
+            ht_start = vb->ht.pauseResumeVisit(*this, ht_start);
+            items_scanned = 0;
+        }
+        try {
+            mappedLog->addVBucket(vb->getId(), std::move(accessed));
+        } catch (const std::exception& e) {
+            EP_LOG_WARN("Failed to write access log '{}' for {}: {}",
+                        next,
+                        vb->getId(),
+                        e.what());
+            mappedLog.reset();
+        }
+        accessed.clear();
+    }
+
+    /**
+     * Commit the access log being generated.
+     * @return the number of items written, or -1 on failure
+     */
+    ssize_t commitLog() {
+        if (mappedLog) {
+            try {
+                const auto num_items = mappedLog->commit();
+                mappedLog.reset();
+                return num_items;
+            } catch (const std::exception& e) {
+                EP_LOG_WARN("Failed to commit access log '{}': {}",
+                            next,
+                            e.what());
+                mappedLog.reset();
+                return -1;
+            }
+        }
+        size_t num_items = log->itemsLogged[int(MutationLogType::New)];
+        log->commit1();
+        log->commit2();
+        log.reset();
+        return num_items;
+    }
+
     void complete() override {
 
-        if (log == nullptr) {
+        const ssize_t committed =
+                (log == nullptr && mappedLog == nullptr) ? -1 : commitLog();
+        if (committed < 0) {
             updateStateFinalizer(false);
         } else {
-            size_t num_items = log->itemsLogged[int(MutationLogType::New)];
-            log->commit1();
-            log->commit2();
-            log.reset();
+            const size_t num_items = committed;
             stats.alogRuntime.store(ep_real_time() - startTime);
             stats.alogNumItems.store(num_items);
             stats.accessScannerHisto.add(
@@ -218,6 +285,8 @@ private:
     std::vector<StoredDocKey> accessed;
 
     std::unique_ptr<MutationLog> log;
+    /// Set instead of log when alog_format is "mapped"
+    std::unique_ptr<MappedAccessLogWriter> mappedLog;
     std::atomic<bool> &stateFinalizer;
     AccessScanner &as;
 
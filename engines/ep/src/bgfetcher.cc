@@ -58,8 +58,35 @@ void BgFetcher::stop() {
     ExecutorPool::get()->cancel(taskId);
 }
 
+/// The DeferWakeup in scope on this thread, if any
+static thread_local BgFetcher::DeferWakeup* deferredWakeup = nullptr;
+
+BgFetcher::DeferWakeup::DeferWakeup() : previous(deferredWakeup) {
+    if (!previous) {
+        deferredWakeup = this;
+    }
+}
+
+BgFetcher::DeferWakeup::~DeferWakeup() {
+    if (previous) {
+        return;
+    }
+    deferredWakeup = nullptr;
+    for (auto* fetcher : fetchers) {
+        fetcher->wakeUpTaskIfSnoozed();
+    }
+}
+
 void BgFetcher::notifyBGEvent(void) {
     ++stats.numRemainingBgItems;
+    if (deferredWakeup) {
+        auto& fetchers = deferredWakeup->fetchers;
+        if (std::find(fetchers.begin(), fetchers.end(), this) ==
+            fetchers.end()) {
+            fetchers.push_back(this);
+        }
+        return;
+    }
     wakeUpTaskIfSnoozed();
 }
 
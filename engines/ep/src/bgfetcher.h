@@ -19,6 +19,7 @@
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "vbucket.h"
 
@@ -69,6 +70,30 @@ public:
         pendingVbs.insert(vbId);
     }
 
+    /**
+     * While an instance of this class is in scope, notifyBGEvent() calls
+     * made by the same thread account for the new item as usual but only
+     * wake the task once the (outermost) instance goes out of scope. A
+     * batch of lookups can then queue all of its misses before the task
+     * starts running, so that they are read by a single fetch rather than
+     * trickling into several.
+     */
+    class DeferWakeup {
+    public:
+        DeferWakeup();
+        ~DeferWakeup();
+
+        DeferWakeup(const DeferWakeup&) = delete;
+        DeferWakeup& operator=(const DeferWakeup&) = delete;
+
+    private:
+        friend class BgFetcher;
+
+        std::vector<BgFetcher*> fetchers;
+        /// The instance which was active when this one was created
+        DeferWakeup* const previous;
+    };
+
 private:
     size_t doFetch(Vbid vbId, vb_bgfetch_queue_t& items);
 
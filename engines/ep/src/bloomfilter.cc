@@ -29,10 +29,14 @@
 #define MURMURHASH_3 MurmurHash3_x86_128
 #endif
 
-BloomFilter::BloomFilter(size_t key_count, double false_positive_prob,
-                         bfilter_status_t new_status) {
+KeyFilter::KeyFilter(bfilter_status_t newStatus) : status(newStatus) {
+}
 
-    status = new_status;
+KeyFilter::~KeyFilter() = default;
+
+BloomFilter::BloomFilter(size_t key_count, double false_positive_prob,
+                         bfilter_status_t new_status)
+    : KeyFilter(new_status) {
     filterSize = estimateFilterSize(key_count, false_positive_prob);
     noOfHashes = estimateNoOfHashes(key_count);
     keyCounter = 0;
@@ -44,6 +48,10 @@ BloomFilter::~BloomFilter() {
     bitArray.clear();
 }
 
+void BloomFilter::clearKeys() {
+    bitArray.clear();
+}
+
 size_t BloomFilter::estimateFilterSize(size_t key_count,
                                        double false_positive_prob) {
     return round(-(((double)(key_count) * log(false_positive_prob))
@@ -62,7 +70,7 @@ uint64_t BloomFilter::hashDocKey(const DocKey& key, uint32_t iteration) {
     return result;
 }
 
-void BloomFilter::setStatus(bfilter_status_t to) {
+void KeyFilter::setStatus(bfilter_status_t to) {
     switch (status) {
         case BFILTER_DISABLED:
             if (to == BFILTER_ENABLED) {
@@ -72,7 +80,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_PENDING:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clearKeys();
             } else if (to == BFILTER_COMPACTING) {
                 status = to;
             }
@@ -80,7 +88,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_COMPACTING:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clearKeys();
             } else if (to == BFILTER_ENABLED) {
                 status = to;
             }
@@ -88,7 +96,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_ENABLED:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clearKeys();
             } else if (to == BFILTER_COMPACTING) {
                 status = to;
             }
@@ -96,11 +104,11 @@ void BloomFilter::setStatus(bfilter_status_t to) {
     }
 }
 
-bfilter_status_t BloomFilter::getStatus() {
+bfilter_status_t KeyFilter::getStatus() {
     return status;
 }
 
-std::string BloomFilter::getStatusString() {
+std::string KeyFilter::getStatusString() {
     switch (status) {
         case BFILTER_DISABLED:
             return "DISABLED";
@@ -29,28 +29,61 @@ enum bfilter_status_t {
 };
 
 /**
- * A bloom filter instance for a vbucket.
- * We are to maintain the vbucket-number of these instances.
+ * A filter of the keys which may exist on disk for a vbucket (but may not be
+ * resident in memory); used to avoid BG fetches of keys which surely don't
+ * exist.
  *
  * Each vbucket will hold one such object.
  */
-class BloomFilter {
+class KeyFilter {
 public:
-    BloomFilter(size_t key_count, double false_positive_prob,
-                bfilter_status_t newStatus = BFILTER_DISABLED);
-    ~BloomFilter();
+    explicit KeyFilter(bfilter_status_t newStatus);
+    virtual ~KeyFilter();
 
     void setStatus(bfilter_status_t to);
     bfilter_status_t getStatus();
     std::string getStatusString();
 
-    void addKey(const DocKey& key);
-    bool maybeKeyExists(const DocKey& key);
+    virtual void addKey(const DocKey& key) = 0;
 
-    size_t getNumOfKeysInFilter();
-    size_t getFilterSize();
+    /**
+     * Remove a key from the filter. Only keys known to have been added to
+     * this filter may be removed, otherwise the key of another document
+     * may be removed instead. Filters which can't remove keys ignore it.
+     */
+    virtual void removeKey(const DocKey& key) {
+    }
+
+    virtual bool maybeKeyExists(const DocKey& key) = 0;
+
+    virtual size_t getNumOfKeysInFilter() = 0;
+    virtual size_t getFilterSize() = 0;
 
 protected:
+    /// Drop every key of the filter (as it is disabled)
+    virtual void clearKeys() = 0;
+
+    bfilter_status_t status;
+};
+
+/**
+ * A bloom filter instance for a vbucket.
+ */
+class BloomFilter : public KeyFilter {
+public:
+    BloomFilter(size_t key_count, double false_positive_prob,
+                bfilter_status_t newStatus = BFILTER_DISABLED);
+    ~BloomFilter() override;
+
+    void addKey(const DocKey& key) override;
+    bool maybeKeyExists(const DocKey& key) override;
+
+    size_t getNumOfKeysInFilter() override;
+    size_t getFilterSize() override;
+
+protected:
+    void clearKeys() override;
+
     size_t estimateFilterSize(size_t key_count, double false_positive_prob);
     size_t estimateNoOfHashes(size_t key_count);
 
@@ -61,6 +94,5 @@ protected:
 
     size_t keyCounter;
 
-    bfilter_status_t status;
     std::vector<bool> bitArray;
 };
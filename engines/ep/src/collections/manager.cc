@@ -88,6 +88,20 @@ cb::engine_error Collections::Manager::update(KVBucket& bucket,
                         ", cannot apply:" + cb::to_string(manifest));
     }
 
+    if (current) {
+        // Release the memory-tracking slots of the dropped collections, once
+        // their items are purged, and their compression samples.
+        auto& stats = bucket.getEPEngine().getEpStats();
+        for (const auto& collection : *current) {
+            if (newManifest->findCollection(collection.first) ==
+                newManifest->end()) {
+                stats.collectionDropped(collection.first);
+                bucket.dropCompressionDictionary(collection.first);
+            }
+        }
+        stats.releaseDroppedCollectionSlots();
+    }
+
     current = std::move(newManifest);
 
     return cb::engine_error(cb::engine_errc::success,
@@ -350,6 +364,33 @@ ENGINE_ERROR_CODE Collections::Manager::doCollectionStats(
                 success = false;
             }
         }
+
+        // Memory used by each collection's items across all vBuckets
+        const auto& stats = bucket.getEPEngine().getEpStats();
+        for (const auto& entry : stats.getCollectionMemoryUsed()) {
+            try {
+                const int bsize = 512;
+                char buffer[bsize];
+                checked_snprintf(buffer,
+                                 bsize,
+                                 "collection:%s:mem_used",
+                                 entry.first.to_string().c_str());
+                add_casted_stat(buffer, entry.second, add_stat, cookie);
+            } catch (const std::exception& e) {
+                EP_LOG_WARN(
+                        "Collections::Manager::doStats failed to build stats: "
+                        "{}",
+                        e.what());
+                success = false;
+            }
+        }
+        const auto untracked = stats.getUntrackedCollectionMemoryUsed();
+        if (untracked) {
+            add_casted_stat("collections:untracked:mem_used",
+                            untracked,
+                            add_stat,
+                            cookie);
+        }
     }
 
     return success ? ENGINE_SUCCESS : ENGINE_FAILED;
@@ -24,13 +24,14 @@
 #include "systemevent.h"
 
 #include <boost/optional/optional_fwd.hpp>
+#include <folly/SharedMutex.h>
 #include <platform/non_negative_counter.h>
-#include <platform/rwlock.h>
 #include <platform/sized_buffer.h>
 
 #include <functional>
 #include <iostream>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 
 class VBucket;
@@ -73,11 +74,24 @@ namespace VB {
  * for the entire scope of the set path to ensure no other thread can interleave
  * collection create/delete and cause an inconsistency in the checkpoint
  * ordering.
+ *
+ * Every front-end key operation takes read access, so the read side must not
+ * write to any shared state. The lock is a folly::SharedMutex, whose readers
+ * register in per-core deferred slots rather than bumping one shared reader
+ * count; only a writer (a collection create/drop, which is rare) scans the
+ * slots and waits for the readers to drain - effectively an RCU grace period.
  */
 class Manifest {
 public:
     using container = ::std::unordered_map<CollectionID, ManifestEntry>;
 
+    /**
+     * The lock type guarding the manifest. Read-priority because a thread
+     * already holding a ReadHandle may take a second one and must not block
+     * behind a waiting writer.
+     */
+    using mutex_type = folly::SharedMutexReadPriority;
+
     /**
      * RAII read locking for access to the Manifest.
      */
@@ -93,7 +107,7 @@ public:
          */
         ReadHandle() = default;
 
-        ReadHandle(const Manifest* m, cb::RWLock& lock)
+        ReadHandle(const Manifest* m, mutex_type& lock)
             : readLock(lock), manifest(m) {
         }
 
@@ -255,7 +269,7 @@ public:
     protected:
         friend std::ostream& operator<<(std::ostream& os,
                                         const Manifest::ReadHandle& readHandle);
-        std::unique_lock<cb::ReaderLock> readLock;
+        std::shared_lock<mutex_type> readLock;
         const Manifest* manifest;
     };
 
@@ -287,7 +301,7 @@ public:
          *        should not be allowed, whereas a disk backfill is allowed
          */
         CachingReadHandle(const Manifest* m,
-                          cb::RWLock& lock,
+                          mutex_type& lock,
                           DocKey key,
                           bool allowSystem)
             : ReadHandle(m, lock),
@@ -464,7 +478,9 @@ public:
      */
     class StatsReadHandle : private ReadHandle {
     public:
-        StatsReadHandle(const Manifest* m, cb::RWLock& lock, CollectionID cid)
+        StatsReadHandle(const Manifest* m,
+                        mutex_type& lock,
+                        CollectionID cid)
             : ReadHandle(m, lock), itr(m->getManifestIterator(cid)) {
         }
 
@@ -498,7 +514,7 @@ public:
      */
     class WriteHandle {
     public:
-        WriteHandle(Manifest& m, cb::RWLock& lock)
+        WriteHandle(Manifest& m, mutex_type& lock)
             : writeLock(lock), manifest(m) {
         }
 
@@ -639,7 +655,7 @@ public:
         }
 
     private:
-        std::unique_lock<cb::WriterLock> writeLock;
+        std::unique_lock<mutex_type> writeLock;
         Manifest& manifest;
     };
 
@@ -1251,7 +1267,7 @@ protected:
     /**
      * shared lock to allow concurrent readers and safe updates
      */
-    mutable cb::RWLock rwlock;
+    mutable mutex_type rwlock;
 
     friend std::ostream& operator<<(std::ostream& os, const Manifest& manifest);
 
@@ -0,0 +1,122 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "compaction_throttle.h"
+
+#include <algorithm>
+#include <thread>
+
+static const std::chrono::seconds bandwidthWindow{1};
+
+CompactionThrottle::CompactionThrottle(size_t bytesPerSec)
+    : rate(bytesPerSec),
+      tokens(double(bytesPerSec)),
+      lastRefill(Clock::now()),
+      windowStart(lastRefill) {
+}
+
+CompactionThrottle& CompactionThrottle::get() {
+    static CompactionThrottle throttle;
+    return throttle;
+}
+
+void CompactionThrottle::setRate(size_t bytesPerSec) {
+    std::lock_guard<std::mutex> lh(mutex);
+    rate = bytesPerSec;
+    tokens = double(bytesPerSec);
+    lastRefill = now();
+}
+
+void CompactionThrottle::acquire(size_t bytes) {
+    const auto delay = reserve(bytes, now());
+    if (delay.count() > 0) {
+        recordDelay(delay);
+        sleepFor(delay);
+    }
+}
+
+std::chrono::microseconds CompactionThrottle::reserve(size_t bytes,
+                                                      Clock::time_point now) {
+    std::lock_guard<std::mutex> lh(mutex);
+
+    totalBytes += bytes;
+    const auto windowElapsed = now - windowStart;
+    if (windowElapsed >= bandwidthWindow) {
+        const auto secs =
+                std::chrono::duration<double>(windowElapsed).count();
+        bandwidth = size_t(windowBytes / secs);
+        windowStart = now;
+        windowBytes = 0;
+    }
+    windowBytes += bytes;
+
+    const size_t limit = rate;
+    if (limit == 0) {
+        return std::chrono::microseconds(0);
+    }
+
+    refill(now);
+    tokens -= double(bytes);
+    return getDebtTime(limit);
+}
+
+std::chrono::microseconds CompactionThrottle::getDelay(Clock::time_point now) {
+    std::lock_guard<std::mutex> lh(mutex);
+    const size_t limit = rate;
+    if (limit == 0) {
+        return std::chrono::microseconds(0);
+    }
+    refill(now);
+    return getDebtTime(limit);
+}
+
+void CompactionThrottle::recordDelay(std::chrono::microseconds delay) {
+    ++throttledCount;
+    throttledTime += delay.count();
+}
+
+void CompactionThrottle::sleepFor(std::chrono::microseconds delay) {
+    std::this_thread::sleep_for(delay);
+}
+
+size_t CompactionThrottle::getBandwidth() {
+    std::lock_guard<std::mutex> lh(mutex);
+    if (now() - windowStart > 2 * bandwidthWindow) {
+        // Nothing has been accounted for over a full window.
+        return 0;
+    }
+    return bandwidth;
+}
+
+std::chrono::microseconds CompactionThrottle::getDebtTime(size_t limit) const {
+    if (tokens >= 0) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds(
+            static_cast<int64_t>((-tokens * 1000000) / limit));
+}
+
+void CompactionThrottle::refill(Clock::time_point now) {
+    if (now <= lastRefill) {
+        return;
+    }
+    const auto elapsed =
+            std::chrono::duration<double>(now - lastRefill).count();
+    const double r = double(rate.load());
+    tokens = std::min(r, tokens + elapsed * r);
+    lastRefill = now;
+}
@@ -0,0 +1,137 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <relaxed_atomic.h>
+
+#include <chrono>
+#include <mutex>
+
+/**
+ * Token-bucket rate limiter for the disk IO performed by compaction.
+ *
+ * A single instance is shared by every compaction task in the process (see
+ * get()), so the configured rate bounds the total compaction bandwidth of
+ * the node regardless of how many vBuckets (or buckets) are compacting
+ * concurrently. Front-end reads (bgfetch) and the flusher do not go through
+ * the throttle and so keep the remaining disk bandwidth.
+ *
+ * The bucket holds at most one second's worth of tokens. IO beyond the
+ * available tokens puts the bucket into debt, and the compaction issuing it
+ * waits for the debt to be repaid (see acquire()), so a single large
+ * compaction is paced as well as the total across compactions. Compaction
+ * tasks also snooze before starting a compaction while the throttle is in
+ * debt (see getDelay()), rather than taking a writer thread only to wait.
+ */
+class CompactionThrottle {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @param bytesPerSec rate limit; zero means unlimited.
+    explicit CompactionThrottle(size_t bytesPerSec = 0);
+
+    virtual ~CompactionThrottle() = default;
+
+    /// @returns the process-wide throttle shared by all compaction tasks.
+    static CompactionThrottle& get();
+
+    /**
+     * Change the rate limit. Zero disables throttling; any outstanding debt
+     * is discarded so waiters are not held to the old rate.
+     */
+    void setRate(size_t bytesPerSec);
+
+    size_t getRate() const {
+        return rate;
+    }
+
+    /**
+     * Take `bytes` worth of tokens for compaction IO about to be issued, and
+     * wait (blocking the calling thread) until any resulting debt has been
+     * repaid. The wait is recorded in the throttled count / time stats.
+     */
+    void acquire(size_t bytes);
+
+    /**
+     * Take `bytes` worth of tokens at time `now`. Exposed for testing.
+     *
+     * @returns how long compaction should wait for the resulting debt (if
+     *          any) to be repaid.
+     */
+    std::chrono::microseconds reserve(size_t bytes, Clock::time_point now);
+
+    /**
+     * @returns how long compaction should wait at time `now` before issuing
+     *          more IO; zero unless the throttle is in debt.
+     */
+    std::chrono::microseconds getDelay(Clock::time_point now);
+
+    /// Record that compaction was delayed (slept or snoozed) for `delay`.
+    void recordDelay(std::chrono::microseconds delay);
+
+    /// Total bytes accounted through the throttle.
+    size_t getTotalBytes() const {
+        return totalBytes;
+    }
+
+    /// Number of times compaction was delayed.
+    size_t getThrottledCount() const {
+        return throttledCount;
+    }
+
+    /// Total time compactions have been delayed, in microseconds.
+    size_t getThrottledTime() const {
+        return throttledTime;
+    }
+
+    /**
+     * @returns compaction bandwidth (bytes/s) measured over the most recently
+     * completed one second window, or zero if compaction has been idle for
+     * longer than that.
+     */
+    size_t getBandwidth();
+
+protected:
+    /// @returns the current time; virtual for testing.
+    virtual Clock::time_point now() const {
+        return Clock::now();
+    }
+
+    /// Block the calling thread for `delay`; virtual for testing.
+    virtual void sleepFor(std::chrono::microseconds delay);
+
+private:
+    void refill(Clock::time_point now);
+
+    /// @returns the time for the current debt to be repaid at `limit`.
+    std::chrono::microseconds getDebtTime(size_t limit) const;
+
+    std::mutex mutex;
+    cb::RelaxedAtomic<size_t> rate;
+    /// Available tokens (bytes); negative when in debt.
+    double tokens{0};
+    Clock::time_point lastRefill;
+
+    /// Start and byte count of the current bandwidth measurement window.
+    Clock::time_point windowStart;
+    size_t windowBytes{0};
+
+    cb::RelaxedAtomic<size_t> totalBytes{0};
+    cb::RelaxedAtomic<size_t> throttledCount{0};
+    cb::RelaxedAtomic<size_t> throttledTime{0};
+    size_t bandwidth{0};
+};
@@ -0,0 +1,382 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "compression_dictionary.h"
+
+#include "blob.h"
+#include "bucket_logger.h"
+#include "objectregistry.h"
+
+#include <stdexcept>
+
+#ifdef EP_USE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+
+/// Compression level used for all dictionaries (the Zstandard default)
+static const int compressionLevel = 3;
+
+/**
+ * The dictionaries in existence, by id, so a dictionary compressed value can
+ * be decompressed without knowing which bucket or collection it belongs to.
+ * A dictionary removes itself on destruction, which waits for any reader
+ * (decompression) using it to complete.
+ */
+static folly::Synchronized<
+        std::unordered_map<uint32_t, const CompressionDictionary*>>
+        registry;
+
+/*
+ * The compression contexts are expensive to create, so each thread keeps one
+ * of each. They are shared by all buckets, so their memory isn't accounted
+ * to any bucket.
+ */
+struct CCtxDeleter {
+    void operator()(ZSTD_CCtx* ctx) {
+        NonBucketAllocationGuard guard;
+        ZSTD_freeCCtx(ctx);
+    }
+};
+
+struct DCtxDeleter {
+    void operator()(ZSTD_DCtx* ctx) {
+        NonBucketAllocationGuard guard;
+        ZSTD_freeDCtx(ctx);
+    }
+};
+
+static ZSTD_CCtx* getCCtx() {
+    thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> ctx;
+    if (!ctx) {
+        NonBucketAllocationGuard guard;
+        ctx.reset(ZSTD_createCCtx());
+    }
+    return ctx.get();
+}
+
+static ZSTD_DCtx* getDCtx() {
+    thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> ctx;
+    if (!ctx) {
+        NonBucketAllocationGuard guard;
+        ctx.reset(ZSTD_createDCtx());
+    }
+    return ctx.get();
+}
+
+bool CompressionDictionary::isSupported() {
+    return true;
+}
+
+std::shared_ptr<const CompressionDictionary> CompressionDictionary::train(
+        cb::const_char_buffer samples,
+        const std::vector<size_t>& sampleSizes,
+        size_t maxSize) {
+    std::vector<char> content(maxSize);
+    const auto size = ZDICT_trainFromBuffer(content.data(),
+                                            content.size(),
+                                            samples.data(),
+                                            sampleSizes.data(),
+                                            unsigned(sampleSizes.size()));
+    if (ZDICT_isError(size)) {
+        EP_LOG_INFO(
+                "CompressionDictionary::train: Failed to train a dictionary "
+                "from {} samples: {}",
+                sampleSizes.size(),
+                ZDICT_getErrorName(size));
+        return {};
+    }
+
+    const auto id = ZDICT_getDictID(content.data(), size);
+    std::shared_ptr<const CompressionDictionary> ret(new CompressionDictionary(
+            id,
+            size,
+            ZSTD_createCDict(content.data(), size, compressionLevel),
+            ZSTD_createDDict(content.data(), size)));
+    if (!ret->cdict || !ret->ddict) {
+        throw std::bad_alloc();
+    }
+
+    {
+        NonBucketAllocationGuard guard;
+        if (!registry.wlock()->emplace(id, ret.get()).second) {
+            // Another dictionary (from another bucket) has the same id,
+            // which can't be told apart when decompressing. Don't use it.
+            EP_LOG_WARN(
+                    "CompressionDictionary::train: Discarding dictionary "
+                    "with duplicate id {}",
+                    id);
+            return {};
+        }
+    }
+    return ret;
+}
+
+std::unique_ptr<Blob> CompressionDictionary::decompress(
+        cb::const_char_buffer input) {
+    const auto size = getDecompressedSize(input);
+    const auto id = ZSTD_getDictID_fromFrame(input.data(), input.size());
+    std::unique_ptr<Blob> ret(Blob::New(size));
+
+    auto locked = registry.rlock();
+    const auto it = locked->find(id);
+    if (it == locked->end()) {
+        throw std::runtime_error(
+                "CompressionDictionary::decompress: Unknown dictionary " +
+                std::to_string(id));
+    }
+    const auto rv = ZSTD_decompress_usingDDict(getDCtx(),
+                                               const_cast<char*>(ret->getData()),
+                                               size,
+                                               input.data(),
+                                               input.size(),
+                                               it->second->ddict);
+    if (ZSTD_isError(rv) || rv != size) {
+        throw std::runtime_error(
+                "CompressionDictionary::decompress: Failed to decompress "
+                "value: " +
+                std::string(ZSTD_isError(rv) ? ZSTD_getErrorName(rv)
+                                             : "size mismatch"));
+    }
+    return ret;
+}
+
+size_t CompressionDictionary::getDecompressedSize(cb::const_char_buffer input) {
+    const auto size = ZSTD_getFrameContentSize(input.data(), input.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+        throw std::runtime_error(
+                "CompressionDictionary::getDecompressedSize: Invalid value");
+    }
+    return size_t(size);
+}
+
+CompressionDictionary::~CompressionDictionary() {
+    {
+        NonBucketAllocationGuard guard;
+        auto locked = registry.wlock();
+        const auto it = locked->find(id);
+        if (it != locked->end() && it->second == this) {
+            locked->erase(it);
+        }
+    }
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+}
+
+bool CompressionDictionary::compress(cb::const_char_buffer input,
+                                     std::string& output) const {
+    output.resize(ZSTD_compressBound(input.size()));
+    const auto size = ZSTD_compress_usingCDict(getCCtx(),
+                                               &output[0],
+                                               output.size(),
+                                               input.data(),
+                                               input.size(),
+                                               cdict);
+    if (ZSTD_isError(size)) {
+        return false;
+    }
+    output.resize(size);
+    return true;
+}
+
+#else
+
+bool CompressionDictionary::isSupported() {
+    return false;
+}
+
+std::shared_ptr<const CompressionDictionary> CompressionDictionary::train(
+        cb::const_char_buffer, const std::vector<size_t>&, size_t) {
+    return {};
+}
+
+std::unique_ptr<Blob> CompressionDictionary::decompress(
+        cb::const_char_buffer) {
+    throw std::logic_error(
+            "CompressionDictionary::decompress: Built without Zstandard");
+}
+
+size_t CompressionDictionary::getDecompressedSize(cb::const_char_buffer) {
+    throw std::logic_error(
+            "CompressionDictionary::getDecompressedSize: Built without "
+            "Zstandard");
+}
+
+CompressionDictionary::~CompressionDictionary() = default;
+
+bool CompressionDictionary::compress(cb::const_char_buffer,
+                                     std::string&) const {
+    return false;
+}
+
+#endif
+
+CompressionDictionary::CompressionDictionary(uint32_t id,
+                                             size_t size,
+                                             ZSTD_CDict_s* cdict,
+                                             ZSTD_DDict_s* ddict)
+    : id(id), size(size), cdict(cdict), ddict(ddict) {
+}
+
+CollectionDictionaries::CollectionDictionaries(size_t dictionarySize,
+                                               size_t sampleSize,
+                                               size_t maxSampleMemory)
+    : dictionarySize(dictionarySize),
+      sampleSize(sampleSize),
+      maxSampleMemory(maxSampleMemory) {
+}
+
+CollectionDictionaries::Lookup CollectionDictionaries::lookup(
+        CollectionID cid, cb::const_char_buffer value) {
+    auto locked = state.wlock();
+    if (locked->dropped.count(cid)) {
+        // A document of a dropped collection, yet to be erased.
+        return {nullptr, false};
+    }
+
+    auto it = locked->collections.find(cid);
+    if (it == locked->collections.end()) {
+        if (locked->sampleMemory >= maxSampleMemory) {
+            // Wait for the samples of other collections to be trained from
+            // before sampling this one.
+            return {nullptr, true};
+        }
+        it = locked->collections.emplace(cid, Collection{}).first;
+    }
+
+    auto& collection = it->second;
+    if (collection.dictionary || collection.failed) {
+        return {collection.dictionary, false};
+    }
+    if (!collection.training && collection.samples.size() < sampleSize &&
+        locked->sampleMemory < maxSampleMemory && value.size() != 0) {
+        collection.samples.append(value.data(), value.size());
+        collection.sampleSizes.push_back(value.size());
+        locked->sampleMemory += value.size();
+    }
+    return {nullptr, true};
+}
+
+void CollectionDictionaries::dropCollection(CollectionID cid) {
+    auto locked = state.wlock();
+    std::shared_ptr<const CompressionDictionary> dictionary;
+    auto it = locked->collections.find(cid);
+    if (it != locked->collections.end()) {
+        // The samples being trained from (if any) are accounted by train()
+        locked->sampleMemory -= it->second.samples.size();
+        dictionary = std::move(it->second.dictionary);
+        locked->collections.erase(it);
+    }
+    locked->dropped.emplace(cid, std::move(dictionary));
+}
+
+bool CollectionDictionaries::passCompleted(
+        const std::unordered_set<CollectionID>& visitedCollections) {
+    auto locked = state.wlock();
+
+    // A dropped collection none of whose documents were found by the pass
+    // has been erased, so its dictionary is no longer needed.
+    for (auto it = locked->dropped.begin(); it != locked->dropped.end();) {
+        if (visitedCollections.count(it->first)) {
+            ++it;
+        } else {
+            it = locked->dropped.erase(it);
+        }
+    }
+
+    if (locked->trainingScheduled) {
+        return false;
+    }
+    for (const auto& entry : locked->collections) {
+        const auto& collection = entry.second;
+        if (!collection.dictionary && !collection.failed &&
+            !collection.training) {
+            locked->trainingScheduled = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t CollectionDictionaries::train() {
+    // Take the samples to train with, so the dictionaries can be trained
+    // without blocking lookup().
+    std::vector<std::pair<CollectionID, Collection>> toTrain;
+    {
+        auto locked = state.wlock();
+        locked->trainingScheduled = false;
+        for (auto& entry : locked->collections) {
+            auto& collection = entry.second;
+            if (!collection.dictionary && !collection.failed &&
+                !collection.training) {
+                Collection samples;
+                samples.samples = std::move(collection.samples);
+                samples.sampleSizes = std::move(collection.sampleSizes);
+                collection.samples = {};
+                collection.sampleSizes = {};
+                collection.training = true;
+                toTrain.emplace_back(entry.first, std::move(samples));
+            }
+        }
+    }
+
+    size_t trained = 0;
+    for (auto& entry : toTrain) {
+        auto& samples = entry.second;
+        auto dictionary = CompressionDictionary::train(
+                {samples.samples.data(), samples.samples.size()},
+                samples.sampleSizes,
+                dictionarySize);
+
+        auto locked = state.wlock();
+        locked->sampleMemory -= samples.samples.size();
+        auto it = locked->collections.find(entry.first);
+        if (it == locked->collections.end()) {
+            // Dropped while training
+            continue;
+        }
+        auto& current = it->second;
+        current.training = false;
+        if (dictionary) {
+            EP_LOG_INFO(
+                    "CollectionDictionaries::train: Trained dictionary {} "
+                    "({} bytes) for collection {} from {} samples",
+                    dictionary->getId(),
+                    dictionary->getSize(),
+                    entry.first.to_string(),
+                    samples.sampleSizes.size());
+            current.dictionary = std::move(dictionary);
+            ++trained;
+        } else {
+            current.failed = true;
+        }
+    }
+    return trained;
+}
+
+size_t CollectionDictionaries::getNumDictionaries() const {
+    size_t ret = 0;
+    auto locked = state.rlock();
+    for (const auto& entry : locked->collections) {
+        if (entry.second.dictionary) {
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+size_t CollectionDictionaries::getSampleMemory() const {
+    return state.rlock()->sampleMemory;
+}
@@ -0,0 +1,208 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <memcached/dockey.h>
+#include <platform/sized_buffer.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Blob;
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+/**
+ * A Zstandard dictionary trained from sample documents, used by the
+ * ItemCompressor to compress values which are too small to compress well on
+ * their own (the dictionary holds the content common to the documents, such
+ * as the JSON field names of a shared schema).
+ *
+ * The id of the dictionary is recorded in every value compressed with it, so
+ * the dictionary can be found again when the value is decompressed; every
+ * dictionary is registered by its id for its lifetime.
+ *
+ * Only available if ep-engine is built with Zstandard (EP_USE_ZSTD).
+ */
+class CompressionDictionary {
+public:
+    /// @return true if dictionary compression is available in this build
+    static bool isSupported();
+
+    /**
+     * Train a dictionary from the given samples.
+     *
+     * @param samples the sample documents, concatenated
+     * @param sampleSizes the size of each sample
+     * @param maxSize the maximum size of the dictionary
+     * @return the dictionary, or null if none could be trained (for example
+     *         if there were too few samples)
+     */
+    static std::shared_ptr<const CompressionDictionary> train(
+            cb::const_char_buffer samples,
+            const std::vector<size_t>& sampleSizes,
+            size_t maxSize);
+
+    /**
+     * Decompress a value compressed with any existing dictionary.
+     *
+     * @throws std::runtime_error if the dictionary doesn't exist or the
+     *         value isn't valid
+     */
+    static std::unique_ptr<Blob> decompress(cb::const_char_buffer input);
+
+    /**
+     * @return the size of the given compressed value once decompressed
+     * @throws std::runtime_error if the value isn't valid
+     */
+    static size_t getDecompressedSize(cb::const_char_buffer input);
+
+    ~CompressionDictionary();
+
+    /**
+     * Compress a value with this dictionary.
+     *
+     * @return false if the value couldn't be compressed
+     */
+    bool compress(cb::const_char_buffer input, std::string& output) const;
+
+    uint32_t getId() const {
+        return id;
+    }
+
+    /// @return the size of the dictionary content
+    size_t getSize() const {
+        return size;
+    }
+
+private:
+    CompressionDictionary(uint32_t id,
+                          size_t size,
+                          ZSTD_CDict_s* cdict,
+                          ZSTD_DDict_s* ddict);
+
+    const uint32_t id;
+    const size_t size;
+    ZSTD_CDict_s* const cdict;
+    ZSTD_DDict_s* const ddict;
+};
+
+/**
+ * The compression dictionaries of a bucket, one per collection.
+ *
+ * A collection starts off collecting sample documents (from the documents
+ * visited by the ItemCompressor). Once the ItemCompressor completes a pass
+ * over the bucket a dictionary is trained from the samples (by a
+ * CompressionDictionaryTrainerTask); if that fails (for example the
+ * collection is too small) the collection is marked as having no
+ * dictionary, and its documents are compressed with Snappy.
+ *
+ * The samples of all collections are bounded by maxSampleMemory; while it
+ * is reached, collections without samples wait for the others to be trained.
+ *
+ * The dictionary of a dropped collection is kept until a pass no longer
+ * finds any of its documents, as they may still be read until erased.
+ */
+class CollectionDictionaries {
+public:
+    /**
+     * @param dictionarySize the maximum size of a dictionary
+     * @param sampleSize the total size of the samples to collect for a
+     *        collection
+     * @param maxSampleMemory the total size of the samples to hold for all
+     *        collections
+     */
+    CollectionDictionaries(size_t dictionarySize,
+                           size_t sampleSize,
+                           size_t maxSampleMemory);
+
+    struct Lookup {
+        /// The dictionary of the collection, null if it doesn't have one
+        std::shared_ptr<const CompressionDictionary> dictionary;
+        /// True until the dictionary of the collection has been trained;
+        /// the document should be left as is until then.
+        bool training = false;
+    };
+
+    /**
+     * Find the dictionary to compress a document of the given collection
+     * with. While the collection is collecting samples the document is taken
+     * as one.
+     */
+    Lookup lookup(CollectionID cid, cb::const_char_buffer value);
+
+    /// Forget the samples and dictionary of a dropped collection.
+    void dropCollection(CollectionID cid);
+
+    /**
+     * Called when the ItemCompressor completes a pass over the bucket.
+     *
+     * @param visitedCollections the collections of the documents visited by
+     *        the pass
+     * @return true if a CompressionDictionaryTrainerTask should be scheduled
+     *         to train the dictionaries of the collections sampled
+     */
+    bool passCompleted(
+            const std::unordered_set<CollectionID>& visitedCollections);
+
+    /**
+     * Train the dictionaries of the collections collecting samples.
+     *
+     * @return the number of dictionaries trained
+     */
+    size_t train();
+
+    /// @return the number of dictionaries trained
+    size_t getNumDictionaries() const;
+
+    /// @return the total size of the samples held. Exposed for testing.
+    size_t getSampleMemory() const;
+
+private:
+    struct Collection {
+        std::shared_ptr<const CompressionDictionary> dictionary;
+        /// Set if training failed, so no dictionary will be used
+        bool failed = false;
+        /// Set while the samples are being trained from
+        bool training = false;
+        std::string samples;
+        std::vector<size_t> sampleSizes;
+    };
+
+    struct State {
+        std::unordered_map<CollectionID, Collection> collections;
+        /// The dropped collections whose documents may still be in memory,
+        /// with their dictionary (if any)
+        std::unordered_map<CollectionID,
+                           std::shared_ptr<const CompressionDictionary>>
+                dropped;
+        /// The total size of the samples of all collections (including
+        /// those being trained from)
+        size_t sampleMemory = 0;
+        bool trainingScheduled = false;
+    };
+
+    const size_t dictionarySize;
+    const size_t sampleSize;
+    const size_t maxSampleMemory;
+
+    folly::Synchronized<State> state;
+};
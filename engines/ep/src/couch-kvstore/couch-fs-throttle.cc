@@ -0,0 +1,158 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-throttle.h"
+#include "compaction_throttle.h"
+#include "kvstore.h"
+#include "kvstore_config.h"
+
+#include <fcntl.h>
+
+std::unique_ptr<FileOpsInterface> getCouchstoreThrottleOps(
+        FileOpsInterface& base_ops,
+        CompactionThrottle& throttle,
+        const KVStoreConfig& config) {
+    return std::make_unique<ThrottleOps>(base_ops, throttle, config);
+}
+
+void ThrottleOps::acquire(size_t bytes) {
+    throttle.acquire(bytes);
+}
+
+couch_file_handle ThrottleOps::constructor(couchstore_error_info_t* errinfo) {
+    FileOpsInterface* orig_ops = &wrapped_ops;
+    auto* tf = new ThrottleFile(orig_ops, orig_ops->constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(tf);
+}
+
+couchstore_error_t ThrottleOps::open(couchstore_error_info_t* errinfo,
+                                     couch_file_handle* h,
+                                     const char* path,
+                                     int flags) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(*h);
+    tf->readahead = false;
+    auto err = tf->orig_ops->open(errinfo, &tf->orig_handle, path, flags);
+    if (err != COUCHSTORE_SUCCESS) {
+        return err;
+    }
+
+    if ((flags & O_ACCMODE) == O_RDONLY &&
+        config.getCouchstoreCompactionReadahead()) {
+        // Advice is only a hint; failing to apply it is not an error.
+        couchstore_error_info_t ignored;
+        if (tf->orig_ops->advise(&ignored,
+                                 tf->orig_handle,
+                                 0,
+                                 0,
+                                 COUCHSTORE_FILE_ADVICE_SEQUENTIAL) ==
+            COUCHSTORE_SUCCESS) {
+            tf->readahead = true;
+        }
+    }
+    return err;
+}
+
+couchstore_error_t ThrottleOps::close(couchstore_error_info_t* errinfo,
+                                      couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    if (tf->readahead) {
+        // The source file is about to be replaced by the compacted one; drop
+        // its pages so they do not displace the bgfetch working set.
+        couchstore_error_info_t ignored;
+        tf->orig_ops->advise(&ignored,
+                             tf->orig_handle,
+                             0,
+                             0,
+                             COUCHSTORE_FILE_ADVICE_DONTNEED);
+        tf->readahead = false;
+    }
+    return tf->orig_ops->close(errinfo, tf->orig_handle);
+}
+
+couchstore_error_t ThrottleOps::set_periodic_sync(couch_file_handle h,
+                                                  uint64_t period_bytes) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->set_periodic_sync(tf->orig_handle, period_bytes);
+}
+
+couchstore_error_t ThrottleOps::set_tracing_enabled(couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->set_tracing_enabled(tf->orig_handle);
+}
+
+couchstore_error_t ThrottleOps::set_write_validation_enabled(
+        couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->set_write_validation_enabled(tf->orig_handle);
+}
+
+couchstore_error_t ThrottleOps::set_mprotect_enabled(couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->set_mprotect_enabled(tf->orig_handle);
+}
+
+ssize_t ThrottleOps::pread(couchstore_error_info_t* errinfo,
+                           couch_file_handle h,
+                           void* buf,
+                           size_t sz,
+                           cs_off_t off) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    acquire(sz);
+    return tf->orig_ops->pread(errinfo, tf->orig_handle, buf, sz, off);
+}
+
+ssize_t ThrottleOps::pwrite(couchstore_error_info_t* errinfo,
+                            couch_file_handle h,
+                            const void* buf,
+                            size_t sz,
+                            cs_off_t off) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    acquire(sz);
+    return tf->orig_ops->pwrite(errinfo, tf->orig_handle, buf, sz, off);
+}
+
+cs_off_t ThrottleOps::goto_eof(couchstore_error_info_t* errinfo,
+                               couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->goto_eof(errinfo, tf->orig_handle);
+}
+
+couchstore_error_t ThrottleOps::sync(couchstore_error_info_t* errinfo,
+                                     couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->sync(errinfo, tf->orig_handle);
+}
+
+couchstore_error_t ThrottleOps::advise(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h,
+                                       cs_off_t offs,
+                                       cs_off_t len,
+                                       couchstore_file_advice_t adv) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->advise(errinfo, tf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* ThrottleOps::get_stats(couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    return tf->orig_ops->get_stats(tf->orig_handle);
+}
+
+void ThrottleOps::destructor(couch_file_handle h) {
+    auto* tf = reinterpret_cast<ThrottleFile*>(h);
+    tf->orig_ops->destructor(tf->orig_handle);
+    delete tf;
+}
@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <libcouchstore/couch_db.h>
+
+class CompactionThrottle;
+class KVStoreConfig;
+
+/**
+ * Returns an instance of ThrottleOps which rate limits the IO of the given
+ * base FileOps implementation through `throttle`.
+ */
+std::unique_ptr<FileOpsInterface> getCouchstoreThrottleOps(
+        FileOpsInterface& base_ops,
+        CompactionThrottle& throttle,
+        const KVStoreConfig& config);
+
+/**
+ * FileOpsInterface implementation used by compaction which takes tokens
+ * from a shared CompactionThrottle before every pread() / pwrite(), waiting
+ * while the throttle is in debt so compaction IO is paced to its rate.
+ *
+ * When couchstore_compaction_readahead is enabled, files opened read-only
+ * (the compaction source) are advised as sequential so the kernel reads
+ * ahead aggressively, and their pages are dropped from the page cache when
+ * closed so that compaction does not evict the working set of bgfetches.
+ */
+class ThrottleOps : public FileOpsInterface {
+public:
+    ThrottleOps(FileOpsInterface& ops,
+                CompactionThrottle& _throttle,
+                const KVStoreConfig& _config)
+        : wrapped_ops(ops), throttle(_throttle), config(_config) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    couchstore_error_t set_tracing_enabled(couch_file_handle handle) override;
+    couchstore_error_t set_write_validation_enabled(
+            couch_file_handle handle) override;
+    couchstore_error_t set_mprotect_enabled(couch_file_handle handle) override;
+
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    void acquire(size_t bytes);
+
+    FileOpsInterface& wrapped_ops;
+    CompactionThrottle& throttle;
+    const KVStoreConfig& config;
+
+    struct ThrottleFile {
+        ThrottleFile(FileOpsInterface* _orig_ops,
+                     couch_file_handle _orig_handle)
+            : orig_ops(_orig_ops), orig_handle(_orig_handle) {
+        }
+
+        FileOpsInterface* orig_ops;
+        couch_file_handle orig_handle;
+        /// True if the file was opened read-only and advised as sequential.
+        bool readahead = false;
+    };
+};
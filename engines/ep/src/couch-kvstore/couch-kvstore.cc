@@ -20,6 +20,7 @@
 #include "collections/collection_persisted_stats.h"
 #include "collections/kvstore_generated.h"
 #include "common.h"
+#include "compaction_throttle.h"
 #include "diskdockey.h"
 #include "ep_time.h"
 #include "item.h"
@@ -331,6 +332,10 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config,
     statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, base_ops);
     statCollectingFileOpsCompaction = getCouchstoreStatsOps(
         st.fsStatsCompaction, base_ops);
+    throttledFileOpsCompaction =
+            getCouchstoreThrottleOps(*statCollectingFileOpsCompaction,
+                                     CompactionThrottle::get(),
+                                     configuration);
 
     // init db file map with default revision number, 1
     numDbFiles = configuration.getMaxVBuckets();
@@ -1063,7 +1068,7 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     }
     couchstore_compact_hook       hook = time_purge_hook;
     couchstore_docinfo_hook dhook = docinfo_hook;
-    FileOpsInterface         *def_iops = statCollectingFileOpsCompaction.get();
+    FileOpsInterface         *def_iops = throttledFileOpsCompaction.get();
     DbHolder compactdb(*this);
     DbHolder targetDb(*this);
     couchstore_error_t         errCode = COUCHSTORE_SUCCESS;
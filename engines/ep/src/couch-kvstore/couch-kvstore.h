@@ -19,6 +19,7 @@
 #include "atomicqueue.h"
 #include "configuration.h"
 #include "couch-kvstore/couch-fs-stats.h"
+#include "couch-kvstore/couch-fs-throttle.h"
 #include "couch-kvstore/couch-kvstore-metadata.h"
 #include "kvstore.h"
 #include "kvstore_priv.h"
@@ -805,6 +806,13 @@ protected:
      */
     std::unique_ptr<FileOpsInterface> statCollectingFileOpsCompaction;
 
+    /**
+     * FileOpsInterface implementation used by compaction; rate limits
+     * statCollectingFileOpsCompaction through the process-wide
+     * CompactionThrottle.
+     */
+    std::unique_ptr<FileOpsInterface> throttledFileOpsCompaction;
+
     /* deleted docs in each file, indexed by vBucket. RelaxedAtomic
        to allow stats access witout lock */
     std::vector<cb::RelaxedAtomic<size_t>> cachedDeleteCount;
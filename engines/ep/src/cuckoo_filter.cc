@@ -0,0 +1,346 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "cuckoo_filter.h"
+
+#include "murmurhash3.h"
+
+#include <memcached/dockey.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if __x86_64__ || __ppc64__
+#define MURMURHASH_3 MurmurHash3_x64_128
+#else
+#define MURMURHASH_3 MurmurHash3_x86_128
+#endif
+
+/// Identifies a serialised CuckooFilter ("CKFL")
+static const uint32_t serialMagic = 0x434b464c;
+static const uint32_t serialVersion = 1;
+
+/// Filled to this load factor, a cuckoo filter with 4 slots per bucket can
+/// still place most keys without too many relocations.
+static const double targetLoadFactor = 0.95;
+
+static size_t nextPowerOfTwo(size_t value) {
+    size_t ret = 1;
+    while (ret < value) {
+        ret <<= 1;
+    }
+    return ret;
+}
+
+template <typename T>
+static void appendValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool readValue(const std::string& in, size_t& offset, T& value) {
+    if (in.size() - offset < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, in.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+}
+
+CuckooFilter::Table::Table(size_t numBuckets)
+    : slots(numBuckets * SlotsPerBucket, 0) {
+}
+
+size_t CuckooFilter::Table::altIndex(size_t index, uint16_t fingerprint) const {
+    // XOR with the hash of the fingerprint, so the alternative bucket can be
+    // found from either bucket without the key.
+    const uint32_t fingerprintHash = uint32_t(fingerprint) * 0x5bd1e995;
+    return (index ^ fingerprintHash) & (getNumBuckets() - 1);
+}
+
+bool CuckooFilter::Table::insertInBucket(size_t index, uint16_t fingerprint) {
+    auto* bucket = slots.data() + index * SlotsPerBucket;
+    for (size_t ii = 0; ii < SlotsPerBucket; ++ii) {
+        if (bucket[ii] == 0) {
+            bucket[ii] = fingerprint;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::Table::removeFromBucket(size_t index, uint16_t fingerprint) {
+    auto* bucket = slots.data() + index * SlotsPerBucket;
+    for (size_t ii = 0; ii < SlotsPerBucket; ++ii) {
+        if (bucket[ii] == fingerprint) {
+            bucket[ii] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::Table::bucketContains(size_t index,
+                                         uint16_t fingerprint) const {
+    const auto* bucket = slots.data() + index * SlotsPerBucket;
+    return std::find(bucket, bucket + SlotsPerBucket, fingerprint) !=
+           bucket + SlotsPerBucket;
+}
+
+CuckooFilter::CuckooFilter(size_t key_count, bfilter_status_t newStatus)
+    : KeyFilter(newStatus),
+      initialBuckets(std::max(
+              nextPowerOfTwo(size_t(std::ceil(
+                      key_count / (SlotsPerBucket * targetLoadFactor)))),
+              size_t(16))) {
+    tables.emplace_back(initialBuckets);
+}
+
+CuckooFilter::~CuckooFilter() = default;
+
+void CuckooFilter::clearKeys() {
+    tables.clear();
+    keyCounter = 0;
+}
+
+uint64_t CuckooFilter::hashDocKey(const DocKey& key) {
+    uint64_t result[2] = {0, 0};
+    auto hashable = key.getIdAndKey();
+    MURMURHASH_3(hashable.second.data(),
+                 hashable.second.size(),
+                 uint32_t(hashable.first),
+                 result);
+    return result[0];
+}
+
+uint16_t CuckooFilter::getFingerprint(uint64_t hash) {
+    // 0 marks an empty slot
+    const auto fingerprint = uint16_t(hash >> 48);
+    return fingerprint ? fingerprint : 1;
+}
+
+void CuckooFilter::insert(Table& table, uint64_t hash) {
+    auto fingerprint = getFingerprint(hash);
+    auto index = hash & (table.getNumBuckets() - 1);
+    if (table.insertInBucket(index, fingerprint)) {
+        return;
+    }
+    index = table.altIndex(index, fingerprint);
+    if (table.insertInBucket(index, fingerprint)) {
+        return;
+    }
+
+    // Both buckets are full; relocate fingerprints to their other bucket
+    // until one finds an empty slot.
+    for (size_t kick = 0; kick < MaxKicks; ++kick) {
+        const auto slot = index * SlotsPerBucket +
+                          (kickGenerator() % SlotsPerBucket);
+        std::swap(fingerprint, table.slots[slot]);
+        index = table.altIndex(index, fingerprint);
+        if (table.insertInBucket(index, fingerprint)) {
+            return;
+        }
+    }
+
+    // Keep the homeless fingerprint aside; the table is now full.
+    table.victimUsed = true;
+    table.victimIndex = index;
+    table.victimFingerprint = fingerprint;
+}
+
+bool CuckooFilter::contains(const Table& table, uint64_t hash) const {
+    const auto fingerprint = getFingerprint(hash);
+    const auto index = hash & (table.getNumBuckets() - 1);
+    const auto alt = table.altIndex(index, fingerprint);
+    if (table.bucketContains(index, fingerprint) ||
+        table.bucketContains(alt, fingerprint)) {
+        return true;
+    }
+    return table.victimUsed && table.victimFingerprint == fingerprint &&
+           (table.victimIndex == index || table.victimIndex == alt);
+}
+
+bool CuckooFilter::remove(Table& table, uint64_t hash) {
+    const auto fingerprint = getFingerprint(hash);
+    const auto index = hash & (table.getNumBuckets() - 1);
+    const auto alt = table.altIndex(index, fingerprint);
+    if (!table.removeFromBucket(index, fingerprint) &&
+        !table.removeFromBucket(alt, fingerprint)) {
+        if (table.victimUsed && table.victimFingerprint == fingerprint &&
+            (table.victimIndex == index || table.victimIndex == alt)) {
+            table.victimUsed = false;
+            return true;
+        }
+        return false;
+    }
+
+    // A slot was freed; try to give the victim (if any) a place again.
+    if (table.victimUsed) {
+        const auto victimAlt =
+                table.altIndex(table.victimIndex, table.victimFingerprint);
+        if (table.insertInBucket(table.victimIndex, table.victimFingerprint) ||
+            table.insertInBucket(victimAlt, table.victimFingerprint)) {
+            table.victimUsed = false;
+        }
+    }
+    return true;
+}
+
+void CuckooFilter::addKey(const DocKey& key) {
+    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        if (tables.empty()) {
+            tables.emplace_back(initialBuckets);
+        } else if (tables.back().victimUsed) {
+            tables.emplace_back(tables.back().getNumBuckets() * 2);
+        }
+        insert(tables.back(), hashDocKey(key));
+        keyCounter++;
+    }
+}
+
+void CuckooFilter::removeKey(const DocKey& key) {
+    if (status == BFILTER_ENABLED) {
+        const auto hash = hashDocKey(key);
+        // Newest (largest) table first: keys which collide with this key in
+        // a table also collide in every smaller one, so if the fingerprint
+        // of another key is removed instead, that key is still covered by
+        // the copy of this key in a smaller table.
+        for (auto it = tables.rbegin(); it != tables.rend(); ++it) {
+            if (remove(*it, hash)) {
+                keyCounter--;
+                return;
+            }
+        }
+    }
+}
+
+bool CuckooFilter::maybeKeyExists(const DocKey& key) {
+    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        const auto hash = hashDocKey(key);
+        return std::any_of(
+                tables.begin(), tables.end(), [this, hash](const Table& t) {
+                    return contains(t, hash);
+                });
+    }
+    // The key may exist.
+    return true;
+}
+
+size_t CuckooFilter::getNumOfKeysInFilter() {
+    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        return keyCounter;
+    } else {
+        return 0;
+    }
+}
+
+size_t CuckooFilter::getFilterSize() {
+    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+        size_t ret = 0;
+        for (const auto& table : tables) {
+            ret += table.slots.size() * sizeof(uint16_t) * 8;
+        }
+        return ret;
+    } else {
+        return 0;
+    }
+}
+
+size_t CuckooFilter::getNumTables() const {
+    return tables.size();
+}
+
+std::string CuckooFilter::serialize(uint64_t highSeqno) const {
+    std::string ret;
+    appendValue(ret, serialMagic);
+    appendValue(ret, serialVersion);
+    appendValue(ret, highSeqno);
+    appendValue(ret, uint64_t(initialBuckets));
+    appendValue(ret, uint64_t(keyCounter));
+    appendValue(ret, uint64_t(tables.size()));
+    for (const auto& table : tables) {
+        appendValue(ret, uint64_t(table.getNumBuckets()));
+        appendValue(ret, uint8_t(table.victimUsed));
+        appendValue(ret, uint64_t(table.victimIndex));
+        appendValue(ret, table.victimFingerprint);
+        ret.append(reinterpret_cast<const char*>(table.slots.data()),
+                   table.slots.size() * sizeof(uint16_t));
+    }
+    return ret;
+}
+
+std::unique_ptr<CuckooFilter> CuckooFilter::deserialize(const std::string& data,
+                                                        uint64_t highSeqno) {
+    size_t offset = 0;
+    uint32_t magic;
+    uint32_t version;
+    uint64_t savedSeqno;
+    uint64_t savedInitialBuckets;
+    uint64_t keyCounter;
+    uint64_t numTables;
+    if (!readValue(data, offset, magic) || magic != serialMagic ||
+        !readValue(data, offset, version) || version != serialVersion ||
+        !readValue(data, offset, savedSeqno) || savedSeqno != highSeqno ||
+        !readValue(data, offset, savedInitialBuckets) ||
+        !readValue(data, offset, keyCounter) ||
+        !readValue(data, offset, numTables)) {
+        return {};
+    }
+
+    if (savedInitialBuckets == 0 ||
+        (savedInitialBuckets & (savedInitialBuckets - 1)) != 0) {
+        return {};
+    }
+
+    auto ret = std::make_unique<CuckooFilter>(0, BFILTER_ENABLED);
+    ret->initialBuckets = savedInitialBuckets;
+    ret->keyCounter = keyCounter;
+    ret->tables.clear();
+    for (uint64_t ii = 0; ii < numTables; ++ii) {
+        uint64_t numBuckets;
+        uint8_t victimUsed;
+        uint64_t victimIndex;
+        uint16_t victimFingerprint;
+        if (!readValue(data, offset, numBuckets) ||
+            !readValue(data, offset, victimUsed) ||
+            !readValue(data, offset, victimIndex) ||
+            !readValue(data, offset, victimFingerprint)) {
+            return {};
+        }
+        // Reject sizes which aren't a power of two, or larger than the data
+        // (checked before computing the size in bytes, which could overflow)
+        const size_t bucketBytes = SlotsPerBucket * sizeof(uint16_t);
+        if (numBuckets == 0 || (numBuckets & (numBuckets - 1)) != 0 ||
+            victimIndex >= numBuckets ||
+            numBuckets > (data.size() - offset) / bucketBytes) {
+            return {};
+        }
+        const auto bytes = numBuckets * bucketBytes;
+        Table table(numBuckets);
+        std::memcpy(table.slots.data(), data.data() + offset, bytes);
+        offset += bytes;
+        table.victimUsed = victimUsed != 0;
+        table.victimIndex = victimIndex;
+        table.victimFingerprint = victimFingerprint;
+        ret->tables.push_back(std::move(table));
+    }
+    if (offset != data.size()) {
+        return {};
+    }
+    return ret;
+}
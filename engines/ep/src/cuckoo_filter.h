@@ -0,0 +1,142 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "bloomfilter.h"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * A cuckoo filter instance for a vbucket.
+ *
+ * Unlike a BloomFilter, keys can be removed from a cuckoo filter, so its
+ * false positive rate doesn't keep rising as keys are brought back into
+ * memory between compactions. Each key is stored as a 16-bit fingerprint in
+ * one of two candidate buckets of SlotsPerBucket slots, which gives a false
+ * positive rate of about 0.01% per table.
+ *
+ * The filter grows online: once a table is full (a fingerprint couldn't be
+ * placed after MaxKicks relocations) keys are added to a new table twice
+ * its size, and lookups check every table.
+ *
+ * The filter may hold the same key more than once (keys are added every
+ * time they are evicted); each removeKey() removes one copy of the key.
+ */
+class CuckooFilter : public KeyFilter {
+public:
+    /// The number of fingerprints per bucket
+    static const size_t SlotsPerBucket = 4;
+
+    /// The maximum number of fingerprints relocated to add a key
+    static const size_t MaxKicks = 500;
+
+    CuckooFilter(size_t key_count,
+                 bfilter_status_t newStatus = BFILTER_DISABLED);
+
+    CuckooFilter(const CuckooFilter& other) = default;
+
+    ~CuckooFilter() override;
+
+    void addKey(const DocKey& key) override;
+
+    /// Keys are only removed while the filter is enabled; while compacting
+    /// the filter may not hold every key yet.
+    void removeKey(const DocKey& key) override;
+
+    bool maybeKeyExists(const DocKey& key) override;
+
+    size_t getNumOfKeysInFilter() override;
+
+    /// @return the size of the filter in bits
+    size_t getFilterSize() override;
+
+    /// @return the number of tables of the filter
+    size_t getNumTables() const;
+
+    /**
+     * Serialise the filter, so that it can be restored by the next warmup.
+     *
+     * @param highSeqno the seqno up to which the filter is valid
+     */
+    std::string serialize(uint64_t highSeqno) const;
+
+    /**
+     * Restore a filter saved by serialize(); the new filter is enabled.
+     *
+     * @param highSeqno the seqno the filter must have been saved at
+     * @return the filter, or null if the data isn't a valid filter saved at
+     *         highSeqno
+     */
+    static std::unique_ptr<CuckooFilter> deserialize(const std::string& data,
+                                                     uint64_t highSeqno);
+
+protected:
+    void clearKeys() override;
+
+    struct Table {
+        explicit Table(size_t numBuckets);
+
+        size_t getNumBuckets() const {
+            return slots.size() / SlotsPerBucket;
+        }
+
+        /// @return the index of the other candidate bucket of a fingerprint
+        size_t altIndex(size_t index, uint16_t fingerprint) const;
+
+        /// Place a fingerprint in an empty slot of the bucket (if any)
+        bool insertInBucket(size_t index, uint16_t fingerprint);
+
+        /// Remove a fingerprint from the bucket (if present)
+        bool removeFromBucket(size_t index, uint16_t fingerprint);
+
+        bool bucketContains(size_t index, uint16_t fingerprint) const;
+
+        /// The fingerprints, SlotsPerBucket per bucket; 0 is an empty slot
+        std::vector<uint16_t> slots;
+
+        /// A fingerprint which couldn't be placed in the table; once set the
+        /// table is full.
+        bool victimUsed = false;
+        size_t victimIndex = 0;
+        uint16_t victimFingerprint = 0;
+    };
+
+    /// @return the hash of the key; its top 16 bits are the fingerprint
+    uint64_t hashDocKey(const DocKey& key);
+
+    static uint16_t getFingerprint(uint64_t hash);
+
+    /// Add a fingerprint to the table, relocating others as necessary
+    void insert(Table& table, uint64_t hash);
+
+    bool contains(const Table& table, uint64_t hash) const;
+
+    bool remove(Table& table, uint64_t hash);
+
+    /// The number of buckets of the first table
+    size_t initialBuckets;
+
+    size_t keyCounter = 0;
+
+    std::vector<Table> tables;
+
+    /// Chooses which fingerprint to relocate when a bucket is full
+    std::minstd_rand kickGenerator;
+};
@@ -19,8 +19,10 @@
 
 #include "checkpoint.h"
 #include "checkpoint_manager.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/producer.h"
 #include "dcp/response.h"
+#include "ep_engine.h"
 #include "ep_time.h"
 #include "kv_bucket.h"
 #include "statwriter.h"
@@ -134,6 +136,10 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
         endStream(END_STREAM_OK);
         itemsReady.store(true);
         // lock is released on leaving the scope
+    } else {
+        // The other streams of the vBucket may all have been notified
+        // already; make sure we hear about the next mutation
+        engine->getDcpConnMap().requestVBNotification(vb_);
     }
 }
 
@@ -173,6 +179,17 @@ std::unique_ptr<DcpResponse> ActiveStream::next(
     }
 
     itemsReady.store(response ? true : false);
+    if (!response) {
+        // Ask to be notified about the next mutation on the vBucket, then
+        // look at the checkpoint once more: a mutation queued after we
+        // looked (but before we asked) found the vBucket already notified,
+        // and so didn't wake us. The checkpoint processor wakes us once it
+        // has fetched any such mutation.
+        engine->getDcpConnMap().requestVBNotification(vb_);
+        if ((isInMemory() || isTakeoverSend()) && readyQ.empty()) {
+            nextCheckpointItem();
+        }
+    }
     return response;
 }
 
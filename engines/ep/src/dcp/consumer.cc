@@ -149,7 +149,8 @@ private:
 DcpConsumer::DcpConsumer(EventuallyPersistentEngine& engine,
                          const void* cookie,
                          const std::string& name,
-                         const std::string& consumerName_)
+                         const std::string& consumerName_,
+                         cb::ProcessClockSource& clock)
     : ConnHandler(engine, cookie, name),
       lastMessageTime(ep_current_time()),
       engine(engine),
@@ -163,7 +164,7 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine& engine,
       consumerName(consumerName_),
       producerIsVersion5orHigher(false),
       processorTaskRunning(false),
-      flowControl(engine, this),
+      flowControl(engine, this, clock),
       processBufferedMessagesYieldThreshold(
               engine.getConfiguration()
                       .getDcpConsumerProcessBufferedMessagesYieldLimit()),
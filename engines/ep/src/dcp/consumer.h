@@ -68,11 +68,13 @@ public:
      * @param consumerName (Optional) consumer_name; if non-empty used by the
      *        consumer to identify itself to the producer (for Sync
      *        Replication).
+     * @param clock Clock used for flow control measurements.
      */
     DcpConsumer(EventuallyPersistentEngine& e,
                 const void* cookie,
                 const std::string& name,
-                const std::string& consumerName);
+                const std::string& consumerName,
+                cb::ProcessClockSource& clock = cb::defaultProcessClockSource());
 
     virtual ~DcpConsumer();
 
@@ -499,6 +501,7 @@ protected:
             if (bytes == 0) {
                 throw std::invalid_argument("UpdateFlowControl given 0 bytes");
             }
+            consumer.flowControl.incrReceivedBytes(bytes);
         }
 
         ~UpdateFlowControl() {
@@ -45,7 +45,8 @@ private:
 
 DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     : ConnMap(e),
-      aggrDcpConsumerBufferSize(0) {
+      aggrDcpConsumerBufferSize(0),
+      vbNotified(e.getConfiguration().getMaxVbuckets()) {
     backfills.numActiveSnoozing = 0;
     updateMaxActiveSnoozingBackfills(engine.getEpStats().getMaxDataSize());
     minCompressionRatioForProducer.store(
@@ -449,6 +450,15 @@ void DcpConnMap::removeVBConnections(DcpProducer& prod) {
 void DcpConnMap::notifyVBConnections(Vbid vbid,
                                      uint64_t bySeqno,
                                      SyncWriteOperation syncWrite) {
+    auto& notified = *vbNotified[vbid.get()];
+    // Set the flag before looking at the streams; a stream which runs out
+    // of data while we walk the list clears it again so the next mutation
+    // notifies it
+    if (notified.load() || notified.exchange(true)) {
+        // Every stream already knows it has data to send
+        return;
+    }
+
     size_t lock_num = vbid.get() % vbConnLockNum;
     std::lock_guard<std::mutex> lh(vbConnLocks[lock_num]);
 
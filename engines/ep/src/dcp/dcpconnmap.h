@@ -23,6 +23,7 @@
 #include <memcached/engine.h>
 #include <platform/sized_buffer.h>
 
+#include <folly/CachelinePadded.h>
 #include <folly/SharedMutex.h>
 #include <atomic>
 #include <list>
@@ -65,10 +66,34 @@ public:
                              const std::string& name,
                              const std::string& consumerName = {});
 
+    /**
+     * Notify the producers streaming the given vBucket that a new seqno is
+     * available.
+     *
+     * Called for every front-end mutation, so the fan-out is coalesced:
+     * once all the streams of the vBucket have been told there is data
+     * to send the following calls return immediately (after a single
+     * atomic load) until one of the streams runs out of data and calls
+     * requestVBNotification().
+     */
     void notifyVBConnections(Vbid vbid,
                              uint64_t bySeqno,
                              SyncWriteOperation syncWrite);
 
+    /**
+     * Request that the next notifyVBConnections() for the vBucket fans
+     * out to the producers again. To be called by a stream which has
+     * nothing more to send (or which ignored the last notification).
+     */
+    void requestVBNotification(Vbid vbid) {
+        auto& notified = *vbNotified[vbid.get()];
+        // Avoid dirtying the cache line (read by all front-end threads
+        // writing to the vBucket) if someone already requested it
+        if (notified.load()) {
+            notified.exchange(false);
+        }
+    }
+
     /**
      * Send a SeqnoAck message over the PassiveStream for the given VBucket.
      *
@@ -239,5 +264,13 @@ protected:
     /* Total memory used by all DCP consumer buffers */
     std::atomic<size_t> aggrDcpConsumerBufferSize;
 
+    /**
+     * Per vBucket flag set when all the streams of the vBucket have been
+     * notified (and cleared by requestVBNotification()). See
+     * notifyVBConnections(). Each flag has a cache line of its own, so
+     * writes to one vBucket don't slow down the front-end threads of others.
+     */
+    std::vector<folly::CachelinePadded<std::atomic<bool>>> vbNotified;
+
     class DcpConfigChangeListener;
 };
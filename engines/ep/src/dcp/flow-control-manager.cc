@@ -34,6 +34,9 @@ size_t DcpFlowControlManager::newConsumerConn(DcpConsumer *) {
 
 void DcpFlowControlManager::handleDisconnect(DcpConsumer *) {}
 
+void DcpFlowControlManager::handleBufferAck(DcpConsumer*, size_t) {
+}
+
 bool DcpFlowControlManager::isEnabled() const
 {
     return false;
@@ -223,3 +226,105 @@ void DcpFlowControlManagerAggressive::resizeBuffers_UNLOCKED(size_t bufferSize)
         iter.second->setFlowControlBufSize(bufferSize);
     }
 }
+
+DcpFlowControlManagerAdaptive::DcpFlowControlManagerAdaptive(
+        EventuallyPersistentEngine& engine)
+    : DcpFlowControlManager(engine), aggrBufferSize(0) {
+}
+
+DcpFlowControlManagerAdaptive::~DcpFlowControlManagerAdaptive() {}
+
+size_t DcpFlowControlManagerAdaptive::newConsumerConn(
+        DcpConsumer* consumerConn) {
+    if (consumerConn == nullptr) {
+        throw std::invalid_argument(
+                "DcpFlowControlManagerAdaptive::newConsumerConn: resp is NULL");
+    }
+
+    /* Nothing has been measured yet, start at the minimum size and let the
+     observed throughput grow the buffer */
+    size_t bufferSize = engine_.getConfiguration().getDcpConnBufferSize();
+
+    std::lock_guard<std::mutex> lh(dcpConsumersMapMutex);
+    dcpConsumersMap[consumerConn->getCookie()] = bufferSize;
+    aggrBufferSize += bufferSize;
+    EP_LOG_DEBUG("{} Conn flow control buffer is {}",
+                 consumerConn->logHeader(),
+                 bufferSize);
+    return bufferSize;
+}
+
+void DcpFlowControlManagerAdaptive::handleDisconnect(
+        DcpConsumer* consumerConn) {
+    std::lock_guard<std::mutex> lh(dcpConsumersMapMutex);
+    auto iter = dcpConsumersMap.find(consumerConn->getCookie());
+    if (iter != dcpConsumersMap.end()) {
+        aggrBufferSize -= iter->second;
+        dcpConsumersMap.erase(iter);
+    }
+}
+
+void DcpFlowControlManagerAdaptive::handleBufferAck(DcpConsumer* consumerConn,
+                                                    size_t bdpBytes) {
+    Configuration& config = engine_.getConfiguration();
+    size_t bufferSize = getTargetBufferSize(
+            bdpBytes, config.getDcpConnBufferSizeAdaptiveHeadroomPerc());
+
+    /* Make sure that the flow control buffer size is within a max and min
+     range */
+    setBufSizeWithinBounds(consumerConn, bufferSize);
+
+    std::unique_lock<std::mutex> lh(dcpConsumersMapMutex);
+    auto iter = dcpConsumersMap.find(consumerConn->getCookie());
+    if (iter == dcpConsumersMap.end()) {
+        return;
+    }
+    const size_t currentSize = iter->second;
+
+    /* Only resize when the target differs by more than 1/8th of the current
+     size; every resize costs a control message to the producer */
+    const size_t delta = bufferSize > currentSize ? bufferSize - currentSize
+                                                  : currentSize - bufferSize;
+    if (delta <= currentSize / 8) {
+        return;
+    }
+
+    /* Growing must not take the aggr memory used for flow control buffers
+     across all consumers above the threshold */
+    if (bufferSize > currentSize) {
+        const double threshold =
+                static_cast<double>(
+                        config.getDcpConnBufferSizeAggrMemThreshold()) /
+                100;
+        const size_t aggrLimit =
+                threshold * engine_.getEpStats().getMaxDataSize();
+        const size_t others = aggrBufferSize - currentSize;
+        if (others + bufferSize > aggrLimit) {
+            if (others + currentSize >= aggrLimit) {
+                return;
+            }
+            bufferSize = aggrLimit - others;
+        }
+    }
+
+    aggrBufferSize = aggrBufferSize - currentSize + bufferSize;
+    iter->second = bufferSize;
+    lh.unlock();
+
+    EP_LOG_DEBUG("{} Conn flow control buffer resized from {} to {} (bdp:{})",
+                 consumerConn->logHeader(),
+                 currentSize,
+                 bufferSize,
+                 bdpBytes);
+    consumerConn->setFlowControlBufSize(bufferSize);
+}
+
+bool DcpFlowControlManagerAdaptive::isEnabled() const {
+    return true;
+}
+
+size_t DcpFlowControlManagerAdaptive::getTargetBufferSize(size_t bdpBytes,
+                                                          size_t headroomPerc) {
+    return static_cast<size_t>(static_cast<double>(bdpBytes) * headroomPerc /
+                               100);
+}
@@ -48,6 +48,15 @@ public:
     /* To be called when a consumer connection is deleted */
     virtual void handleDisconnect(DcpConsumer *);
 
+    /**
+     * To be called every time a consumer connection sends a buffer ack to
+     * its producer, with the latest measurement of the connection's
+     * bandwidth-delay product (bytes drained per second multiplied by the
+     * buffer-ack latency). Policies which size the buffer from observed
+     * throughput may resize the connection's buffer here.
+     */
+    virtual void handleBufferAck(DcpConsumer*, size_t bdpBytes);
+
     /* Will indicate if flow control is enabled */
     virtual bool isEnabled(void) const;
 
@@ -130,3 +139,46 @@ private:
     /* Fraction of memQuota for all dcp consumer connection buffers */
     std::atomic<double> dcpConnBufferSizeAggrFrac;
 };
+
+/**
+ * In this policy the flow control buffer size of each connection is derived
+ * from the throughput observed on that connection rather than from the bucket
+ * memory quota. Every time a connection sends a buffer ack it reports its
+ * measured bandwidth-delay product (drain rate * buffer-ack latency); the
+ * buffer is sized to a configurable multiple of that product (the headroom
+ * allows the buffer to grow while it is the bottleneck), within the min
+ * (dcp_conn_buffer_size) and max (dcp_conn_buffer_size_max) values.
+ * Connections start with the min size, and the aggregate size of all buffers
+ * is capped at dcp_conn_buffer_size_aggr_mem_threshold percent of the bucket
+ * memory quota. Slow consumers therefore keep small buffers while fast ones
+ * get enough buffer to keep the pipeline full.
+ */
+class DcpFlowControlManagerAdaptive : public DcpFlowControlManager {
+public:
+    DcpFlowControlManagerAdaptive(EventuallyPersistentEngine& engine);
+
+    ~DcpFlowControlManagerAdaptive();
+
+    size_t newConsumerConn(DcpConsumer* consumerConn);
+
+    void handleDisconnect(DcpConsumer* consumerConn);
+
+    void handleBufferAck(DcpConsumer* consumerConn, size_t bdpBytes);
+
+    bool isEnabled(void) const;
+
+    /**
+     * Calculate the buffer size the adaptive policy targets for a
+     * connection with the given bandwidth-delay product (before applying
+     * the min/max bounds).
+     */
+    static size_t getTargetBufferSize(size_t bdpBytes, size_t headroomPerc);
+
+private:
+    /* Mutex to ensure dcpConsumersMap and aggrBufferSize are thread safe */
+    std::mutex dcpConsumersMapMutex;
+    /* Flow control buffer size of every DCP Consumer using this policy */
+    std::map<const void*, size_t> dcpConsumersMap;
+    /* Total memory used by all DCP consumer buffers */
+    size_t aggrBufferSize;
+};
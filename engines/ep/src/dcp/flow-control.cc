@@ -23,14 +23,18 @@
 #include "ep_time.h"
 #include "objectregistry.h"
 
-FlowControl::FlowControl(EventuallyPersistentEngine &engine,
-                         DcpConsumer* consumer) :
+FlowControl::FlowControl(EventuallyPersistentEngine& engine,
+                         DcpConsumer* consumer,
+                         cb::ProcessClockSource& clock) :
     consumerConn(consumer),
     engine_(engine),
+    clock(clock),
     pendingControl(true),
     lastBufferAck(ep_current_time()),
     ackedBytes(0),
-    freedBytes(0)
+    freedBytes(0),
+    lastBufferAckTime(clock.now()),
+    ackSentTime(lastBufferAckTime.load())
 {
     enabled = engine.getDcpFlowControlManager().isEnabled();
     if (enabled) {
@@ -63,24 +67,12 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
         } else if (isBufferSufficientlyDrained_UNLOCKED(ackable_bytes)) {
             lh.unlock();
             /* Send a buffer ack when at least 20% of the buffer is drained */
-            uint64_t opaque = consumerConn->incrOpaqueCounter();
-            ret = producers->buffer_acknowledgement(
-                    opaque, Vbid(0), ackable_bytes);
-            lastBufferAck = ep_current_time();
-            ackedBytes.fetch_add(ackable_bytes);
-            freedBytes.fetch_sub(ackable_bytes);
-            return ret;
+            return sendBufferAck(producers, ackable_bytes);
         } else if (ackable_bytes > 0 &&
                    (ep_current_time() - lastBufferAck) > 5) {
             lh.unlock();
             /* Ack at least every 5 seconds */
-            uint64_t opaque = consumerConn->incrOpaqueCounter();
-            ret = producers->buffer_acknowledgement(
-                    opaque, Vbid(0), ackable_bytes);
-            lastBufferAck = ep_current_time();
-            ackedBytes.fetch_add(ackable_bytes);
-            freedBytes.fetch_sub(ackable_bytes);
-            return ret;
+            return sendBufferAck(producers, ackable_bytes);
         } else {
             lh.unlock();
         }
@@ -88,6 +80,63 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
     return ENGINE_FAILED;
 }
 
+ENGINE_ERROR_CODE FlowControl::sendBufferAck(
+        struct dcp_message_producers* producers, uint32_t ackable_bytes) {
+    // If the producer has filled the buffer it can't send anything more
+    // until it receives this ack, so the next message received measures the
+    // round trip of the ack.
+    const bool producerStalled =
+            receivedBytes.load() - ackedBytes.load() >= bufferSize;
+    const auto now = clock.now();
+    if (producerStalled) {
+        ackSentTime = now;
+        ackLatencyPending = true;
+    }
+
+    uint64_t opaque = consumerConn->incrOpaqueCounter();
+    ENGINE_ERROR_CODE ret =
+            producers->buffer_acknowledgement(opaque, Vbid(0), ackable_bytes);
+    lastBufferAck = ep_current_time();
+    ackedBytes.fetch_add(ackable_bytes);
+    freedBytes.fetch_sub(ackable_bytes);
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - lastBufferAckTime.exchange(now));
+    if (elapsed.count() > 0) {
+        drainRate = ewma(drainRate,
+                         (uint64_t(ackable_bytes) * 1000000) / elapsed.count());
+    }
+
+    engine_.getDcpFlowControlManager().handleBufferAck(
+            consumerConn, getBandwidthDelayProduct());
+    return ret;
+}
+
+uint64_t FlowControl::ewma(uint64_t average, uint64_t sample) {
+    if (average == 0) {
+        return sample;
+    }
+    // Weight new samples by 1/4 to smooth out bursts
+    return (average * 3 + sample) / 4;
+}
+
+uint64_t FlowControl::getBandwidthDelayProduct() const {
+    return (drainRate * ackLatencyUs) / 1000000;
+}
+
+void FlowControl::incrReceivedBytes(uint32_t bytes) {
+    receivedBytes.fetch_add(bytes);
+    if (ackLatencyPending.load(std::memory_order_relaxed)) {
+        bool expected = true;
+        if (ackLatencyPending.compare_exchange_strong(expected, false)) {
+            const auto latency =
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                            clock.now() - ackSentTime.load());
+            ackLatencyUs = ewma(ackLatencyUs, latency.count());
+        }
+    }
+}
+
 void FlowControl::incrFreedBytes(uint32_t bytes)
 {
     freedBytes.fetch_add(bytes);
@@ -120,4 +169,8 @@ void FlowControl::addStats(const AddStatFn& add_stat, const void* c) {
     consumerConn->addStat("total_acked_bytes", ackedBytes, add_stat, c);
     consumerConn->addStat("max_buffer_bytes", bufferSize, add_stat, c);
     consumerConn->addStat("unacked_bytes", freedBytes, add_stat, c);
+    consumerConn->addStat("drain_rate_bytes", drainRate, add_stat, c);
+    consumerConn->addStat("ack_latency_us", ackLatencyUs, add_stat, c);
+    consumerConn->addStat(
+            "bandwidth_delay_product", getBandwidthDelayProduct(), add_stat, c);
 }
@@ -19,8 +19,11 @@
 #include "atomic.h"
 #include "memcached/engine.h"
 
+#include <platform/processclock.h>
 #include <relaxed_atomic.h>
 
+#include <chrono>
+
 class DcpConsumer;
 class EventuallyPersistentEngine;
 
@@ -33,12 +36,25 @@ class EventuallyPersistentEngine;
  */
 class FlowControl {
 public:
-    FlowControl(EventuallyPersistentEngine &engine, DcpConsumer* consumer);
+    /**
+     * @param clock Source of the time used to measure the drain rate and
+     *        ack latency (tests may supply their own).
+     */
+    FlowControl(EventuallyPersistentEngine& engine,
+                DcpConsumer* consumer,
+                cb::ProcessClockSource& clock = cb::defaultProcessClockSource());
 
     ~FlowControl();
 
     ENGINE_ERROR_CODE handleFlowCtl(struct dcp_message_producers* producers);
 
+    /**
+     * Account for a message received from the producer; the first message
+     * received after an ack which unblocked the producer completes an ack
+     * latency sample.
+     */
+    void incrReceivedBytes(uint32_t bytes);
+
     void incrFreedBytes(uint32_t bytes);
 
     uint32_t getFlowControlBufSize(void);
@@ -53,17 +69,49 @@ public:
         return freedBytes.load();
     }
 
+    /// @returns the smoothed rate (bytes/s) at which the buffer is drained
+    uint64_t getDrainRate() const {
+        return drainRate;
+    }
+
+    /**
+     * @returns the smoothed round trip time from sending a buffer ack to a
+     *          stalled producer to receiving its next message
+     */
+    std::chrono::microseconds getAckLatency() const {
+        return std::chrono::microseconds(ackLatencyUs.load());
+    }
+
+    /// @returns the measured bandwidth-delay product of the connection
+    uint64_t getBandwidthDelayProduct() const;
+
 private:
     void setBufSizeWithinBounds(size_t &bufSize);
 
     bool isBufferSufficientlyDrained_UNLOCKED(uint32_t ackable_bytes);
 
+    /**
+     * Send a buffer ack for the given number of bytes and update the drain
+     * rate measurement.
+     */
+    ENGINE_ERROR_CODE sendBufferAck(struct dcp_message_producers* producers,
+                                    uint32_t ackable_bytes);
+
+    /**
+     * Fold a new sample into an exponentially weighted moving average;
+     * the first sample initialises the average.
+     */
+    static uint64_t ewma(uint64_t average, uint64_t sample);
+
     /* Associated consumer connection handler */
     DcpConsumer* consumerConn;
 
     /* Reference to ep engine instance */
     EventuallyPersistentEngine &engine_;
 
+    /* Clock for the drain rate and ack latency measurements */
+    cb::ProcessClockSource& clock;
+
     /* Indicates if flow control is enabled for this connection */
     bool enabled;
 
@@ -85,4 +133,25 @@ private:
 
     /* Bytes processed from the flow control buffer */
     std::atomic<uint64_t> freedBytes;
+
+    /* Total bytes received from the producer */
+    std::atomic<uint64_t> receivedBytes{0};
+
+    /* When the last buffer ack was sent, used to measure the drain rate */
+    std::atomic<std::chrono::steady_clock::time_point> lastBufferAckTime;
+
+    /* When the last buffer ack to a stalled producer was sent */
+    std::atomic<std::chrono::steady_clock::time_point> ackSentTime;
+
+    /* Set when a buffer ack has been sent to a stalled producer and no
+       message has been received since; used to measure ack latency */
+    std::atomic<bool> ackLatencyPending{false};
+
+    /* Smoothed rate, in bytes per second, at which the consumer drains the
+       flow control buffer */
+    cb::RelaxedAtomic<uint64_t> drainRate{0};
+
+    /* Smoothed time, in microseconds, between sending a buffer ack to a
+       stalled producer and receiving its next message */
+    cb::RelaxedAtomic<uint64_t> ackLatencyUs{0};
 };
@@ -244,3 +244,7 @@ ENGINE_ERROR_CODE DcpMsgProducersBorderGuard::abort(uint32_t opaque,
     NonBucketAllocationGuard guard;
     return guarded.abort(opaque, vbucket, key, prepared_seqno, abort_seqno);
 }
+bool DcpMsgProducersBorderGuard::want_more_messages() {
+    NonBucketAllocationGuard guard;
+    return guarded.want_more_messages();
+}
@@ -152,6 +152,8 @@ public:
                             uint64_t prepared_seqno,
                             uint64_t abort_seqno) override;
 
+    bool want_more_messages() override;
+
 private:
     /// The DCP message producers we are guarding.
     dcp_message_producers& guarded;
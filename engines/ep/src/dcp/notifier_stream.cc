@@ -18,6 +18,7 @@
 #include "notifier_stream.h"
 
 #include "bucket_logger.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/producer.h"
 #include "dcp/response.h"
 #include "ep_engine.h"
@@ -56,6 +57,8 @@ NotifierStream::NotifierStream(EventuallyPersistentEngine* e,
                 opaque_, END_STREAM_OK, vb_, cb::mcbp::DcpStreamId{}));
         transitionState(StreamState::Dead);
         itemsReady.store(true);
+    } else {
+        e->getDcpConnMap().requestVBNotification(vb_);
     }
     p->getLogger().log(spdlog::level::level_enum::info,
                        "({}) stream created with start seqno {} and "
@@ -1417,6 +1417,8 @@ void DcpProducer::notifySeqnoAvailable(Vbid vbucket,
         // and we do not support SyncWrites or SyncReplication. It wouldn't send
         // anything anyway and we'd run a bunch of tasks on NonIO threads, front
         // end worker threads and potentially AuxIO threads.
+        // We still want to hear about the next (non-prepare) mutation.
+        engine_.getDcpConnMap().requestVBNotification(vbucket);
         return;
     }
 
@@ -1430,6 +1432,12 @@ void DcpProducer::notifySeqnoAvailable(Vbid vbucket,
             }
         }
     }
+
+    if (notifyOnly) {
+        // Notifier streams wait for the seqno to pass their start seqno
+        // rather than for data to send, so keep asking for notifications
+        engine_.getDcpConnMap().requestVBNotification(vbucket);
+    }
 }
 
 void DcpProducer::closeStreamDueToVbStateChange(
@@ -36,7 +36,10 @@ DefragmenterTask::DefragmenterTask(EventuallyPersistentEngine* e,
 
 bool DefragmenterTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "DefragmenterTask");
-    if (engine->getConfiguration().isDefragmenterEnabled()) {
+    // When the fused scan is enabled the HashTableMaintenanceTask
+    // defragments as part of its pass.
+    if (engine->getConfiguration().isDefragmenterEnabled() &&
+        !engine->getConfiguration().isHashTableFusedScan()) {
         ServerAllocatorIface* alloc_hooks = engine->getServerApi()->alloc_hooks;
         // Get our pause/resume visitor. If we didn't finish the previous pass,
         // then resume from where we last were, otherwise create a new visitor
@@ -49,19 +49,20 @@ bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
     // value must be at least non-zero (also covers Items with null Blobs)
     // and no larger than the biggest size class the allocator
     // supports, so it can be successfully reallocated to a run with other
-    // objects of the same size.
-    if (value_len > 0 && value_len <= max_size_class) {
+    // objects of the same size. Inline values have no Blob to reallocate.
+    if (value_len > 0 && value_len <= max_size_class &&
+        !v.hasInlineValue()) {
         // If sufficiently old and if it looks like nothing else holds a
         // reference to the blob reallocate, otherwise increment it's age.
         // It may be possible to add a reference to the blob without holding
         // any locks, therefore the check is somewhat of an estimate which
         // should be good enough.
-        if (v.getValue()->getAge() >= age_threshold &&
-            v.getValue().refCount() < 2) {
+        const auto& blob = v.getValueBlob();
+        if (blob->getAge() >= age_threshold && blob.refCount() < 2) {
             v.reallocate();
             defrag_count++;
         } else {
-            v.getValue()->incrementAge();
+            blob->incrementAge();
         }
     }
 
@@ -275,7 +275,10 @@ void ActiveDurabilityMonitor::addSyncWrite(const void* cookie,
         throwException<std::logic_error>(__func__, "Impossible");
     }
 
-    state.wlock()->addSyncWrite(cookie, std::move(item));
+    const auto expiry = state.wlock()->addSyncWrite(cookie, std::move(item));
+    if (expiry) {
+        vb.scheduleDurabilityTimeout(*expiry);
+    }
 }
 
 ENGINE_ERROR_CODE ActiveDurabilityMonitor::seqnoAckReceived(
@@ -1305,8 +1308,9 @@ void ActiveDurabilityMonitor::State::cleanUpTrackedWritesPostTopologyChange(
     }
 }
 
-void ActiveDurabilityMonitor::State::addSyncWrite(const void* cookie,
-                                                  queued_item item) {
+boost::optional<std::chrono::steady_clock::time_point>
+ActiveDurabilityMonitor::State::addSyncWrite(const void* cookie,
+                                             queued_item item) {
     Expects(firstChain.get());
     const auto seqno = item->getBySeqno();
     trackedWrites.emplace_back(cookie,
@@ -1316,6 +1320,7 @@ void ActiveDurabilityMonitor::State::addSyncWrite(const void* cookie,
                                secondChain.get());
     lastTrackedSeqno = seqno;
     totalAccepted++;
+    return trackedWrites.back().getExpiryTime();
 }
 
 void ActiveDurabilityMonitor::State::removeExpired(
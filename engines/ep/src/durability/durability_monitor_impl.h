@@ -192,6 +192,12 @@ public:
      */
     bool isExpired(std::chrono::steady_clock::time_point asOf) const;
 
+    /// @return the expiry-time of this SyncWrite, none if it never expires
+    boost::optional<std::chrono::steady_clock::time_point> getExpiryTime()
+            const {
+        return expiryTime;
+    }
+
     /**
      * Reset the ack-state for this SyncWrite and set it up for the new
      * given topology. In general, checkDurabilityPossibleAndResetTopology
@@ -434,8 +440,10 @@ struct ActiveDurabilityMonitor::State {
      *
      * @param cookie Connection to notify on completion
      * @param item The prepare
+     * @return the expiry-time of the new SyncWrite, none if it never expires
      */
-    void addSyncWrite(const void* cookie, queued_item item);
+    boost::optional<std::chrono::steady_clock::time_point> addSyncWrite(
+            const void* cookie, queued_item item);
 
     /**
      * Returns the next position for a node iterator.
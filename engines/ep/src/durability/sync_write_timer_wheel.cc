@@ -0,0 +1,178 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "sync_write_timer_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+constexpr std::chrono::milliseconds SyncWriteTimerWheel::TickDuration;
+
+SyncWriteTimerWheel::SyncWriteTimerWheel(Clock::time_point start)
+    : start(start) {
+    for (size_t level = 0; level < Levels; ++level) {
+        levels[level].resize(getNumSlots(level));
+    }
+}
+
+bool SyncWriteTimerWheel::add(Vbid vbid, Clock::time_point expiry) {
+    // Anything already expired is returned by the next advance()
+    const auto tick = std::max(toTick(expiry), currentTick);
+    const auto level = getLevel(tick);
+    auto& slot = getSlot(level, tick);
+    if (!slot.empty() && slot.back().tick == tick && slot.back().vbid == vbid) {
+        // The vBucket is already due at this tick (common when it has a
+        // high rate of SyncWrites), no need for another entry.
+        return false;
+    }
+    slot.push_back({tick, vbid});
+    ++numEntries;
+    if (level == 0) {
+        ++numLevel0Entries;
+    }
+    if (tick < earliestTick) {
+        earliestTick = tick;
+        return true;
+    }
+    return false;
+}
+
+std::vector<Vbid> SyncWriteTimerWheel::advance(Clock::time_point now) {
+    std::vector<Vbid> expired;
+    // An entry for tick t expires once the whole tick has passed
+    const auto nowTick = toTick(now);
+    const auto mask = getNumSlots(0) - 1;
+    while (currentTick < nowTick) {
+        if (numEntries == 0) {
+            // Nothing to expire (or cascade), skip straight to now
+            currentTick = nowTick;
+            break;
+        }
+
+        if (numLevel0Entries == 0) {
+            // Nothing due in the rest of this turn, skip to the next one
+            currentTick = std::min(nowTick, (currentTick | mask) + 1);
+        } else {
+            auto& slot = levels[0][currentTick & mask];
+            for (const auto& entry : slot) {
+                expired.push_back(entry.vbid);
+            }
+            numEntries -= slot.size();
+            numLevel0Entries -= slot.size();
+            slot.clear();
+            ++currentTick;
+        }
+
+        if ((currentTick & mask) == 0) {
+            // Starting a new turn of level 0; bring down the entries of this
+            // turn from the higher level(s).
+            for (size_t level = 1; level < Levels; ++level) {
+                cascade(level);
+                if (((currentTick >> getShift(level)) &
+                     (getNumSlots(level) - 1)) != 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    earliestTick = findEarliestTick();
+
+    std::sort(expired.begin(), expired.end());
+    expired.erase(std::unique(expired.begin(), expired.end()), expired.end());
+    return expired;
+}
+
+SyncWriteTimerWheel::Clock::time_point SyncWriteTimerWheel::getNextDueTime()
+        const {
+    if (numEntries == 0) {
+        return Clock::time_point::max();
+    }
+    // Due once the whole tick has passed
+    return start + (earliestTick + 1) * TickDuration;
+}
+
+uint64_t SyncWriteTimerWheel::findEarliestTick() const {
+    auto earliest = std::numeric_limits<uint64_t>::max();
+    // The slots of each level cover consecutive ranges of ticks following
+    // the slot of the current tick, so the earliest entry of a level is in
+    // the first non-empty slot from there. (The current slot of the higher
+    // levels has already been cascaded, anything in it is a full turn away.)
+    // The exception is the last level, where parked entries may be in an
+    // earlier slot than entries expiring before them - check all of it.
+    for (size_t level = 0; level < Levels; ++level) {
+        const auto& slots = levels[level];
+        const auto mask = getNumSlots(level) - 1;
+        const auto current = (currentTick >> getShift(level)) & mask;
+        const size_t first = level == 0 ? 0 : 1;
+        for (size_t ii = first; ii < first + slots.size(); ++ii) {
+            const auto& slot = slots[(current + ii) & mask];
+            for (const auto& entry : slot) {
+                earliest = std::min(earliest, entry.tick);
+            }
+            if (!slot.empty() && level != Levels - 1) {
+                break;
+            }
+        }
+    }
+    return earliest;
+}
+
+uint64_t SyncWriteTimerWheel::toTick(Clock::time_point time) const {
+    if (time <= start) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time - start)
+                   .count() /
+           TickDuration.count();
+}
+
+size_t SyncWriteTimerWheel::getLevel(uint64_t tick) const {
+    const auto delta = tick - currentTick;
+    for (size_t level = 0; level < Levels - 1; ++level) {
+        if (delta < (uint64_t(1) << getShift(level + 1))) {
+            return level;
+        }
+    }
+    return Levels - 1;
+}
+
+SyncWriteTimerWheel::Slot& SyncWriteTimerWheel::getSlot(size_t level,
+                                                        uint64_t tick) {
+    const auto range = uint64_t(1) << getShift(level + 1);
+    if (tick - currentTick >= range) {
+        // Beyond the wheel; park it in the furthest slot of the last level,
+        // it will be placed again when that slot cascades.
+        tick = currentTick + range - (uint64_t(1) << getShift(level));
+    }
+    const auto mask = getNumSlots(level) - 1;
+    return levels[level][(tick >> getShift(level)) & mask];
+}
+
+void SyncWriteTimerWheel::cascade(size_t level) {
+    const auto mask = getNumSlots(level) - 1;
+    auto& slot = levels[level][(currentTick >> getShift(level)) & mask];
+    Slot entries;
+    entries.swap(slot);
+    for (const auto& entry : entries) {
+        const auto newLevel = getLevel(entry.tick);
+        getSlot(newLevel, entry.tick).push_back(entry);
+        if (newLevel == 0) {
+            ++numLevel0Entries;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/vbucket.h>
+
+#include <array>
+#include <chrono>
+#include <limits>
+#include <vector>
+
+/**
+ * A hierarchical timer wheel of SyncWrite expiry times, used by the
+ * DurabilityTimeoutTask to find the vBuckets which have SyncWrites to
+ * time out without visiting every vBucket.
+ *
+ * Time is divided into ticks of one millisecond. Level 0 has a slot for
+ * each of the next 256 ticks; every following level has 64 slots, each
+ * covering a full turn of the level below. An expiry is added to the lowest
+ * level covering it, and the entries of a higher level slot are cascaded
+ * down once time reaches that slot. Adding is therefore O(1), and advancing
+ * only touches the entries which expire (or cascade), skipping the turns of
+ * level 0 without any entry.
+ *
+ * Expiries more than ~18 hours away (longer than any durability timeout)
+ * are kept in the last slot of the highest level until they come in range.
+ *
+ * Not thread-safe; the owner must serialise access.
+ */
+class SyncWriteTimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// The resolution of the wheel
+    static constexpr std::chrono::milliseconds TickDuration{1};
+
+    explicit SyncWriteTimerWheel(Clock::time_point start = Clock::now());
+
+    /**
+     * Add the expiry time of a SyncWrite on the given vBucket.
+     *
+     * @return true if this is now the earliest entry in the wheel (the time
+     *         returned by getNextDueTime() moved earlier)
+     */
+    bool add(Vbid vbid, Clock::time_point expiry);
+
+    /**
+     * Advance the wheel up to the given time, removing the entries which
+     * expired before it.
+     *
+     * @return the vBuckets with at least one expired entry (each vBucket
+     *         listed once)
+     */
+    std::vector<Vbid> advance(Clock::time_point now);
+
+    /**
+     * @return the time at which advance() will next return an entry, or
+     *         Clock::time_point::max() if the wheel is empty
+     */
+    Clock::time_point getNextDueTime() const;
+
+    /// @return the number of entries in the wheel
+    size_t size() const {
+        return numEntries;
+    }
+
+private:
+    struct Entry {
+        uint64_t tick;
+        Vbid vbid;
+    };
+    using Slot = std::vector<Entry>;
+
+    static constexpr size_t Levels = 4;
+    /// log2 of the number of slots in level 0 and in the other levels
+    static constexpr size_t Level0Bits = 8;
+    static constexpr size_t LevelBits = 6;
+
+    /// @return log2 of the number of ticks covered by a slot of the level
+    static constexpr size_t getShift(size_t level) {
+        return level == 0 ? 0 : Level0Bits + (level - 1) * LevelBits;
+    }
+
+    static constexpr size_t getNumSlots(size_t level) {
+        return level == 0 ? (size_t(1) << Level0Bits)
+                          : (size_t(1) << LevelBits);
+    }
+
+    /// @return the tick (rounded down) of the given time
+    uint64_t toTick(Clock::time_point time) const;
+
+    /// @return the tick of the earliest entry (max if the wheel is empty)
+    uint64_t findEarliestTick() const;
+
+    /// @return the level an entry for the given tick belongs to
+    size_t getLevel(uint64_t tick) const;
+
+    /// @return the slot of the given level covering the given tick
+    Slot& getSlot(size_t level, uint64_t tick);
+
+    /// Move the entries of a slot of the given level down the wheel
+    void cascade(size_t level);
+
+    /// The time of tick 0
+    const Clock::time_point start;
+
+    /// The next tick to expire; all entries for earlier ticks have been
+    /// returned by advance(), and the higher level slots covering it have
+    /// been cascaded.
+    uint64_t currentTick = 0;
+
+    size_t numEntries = 0;
+
+    /// The number of entries in level 0, used to skip empty turns
+    size_t numLevel0Entries = 0;
+
+    /// The tick of the earliest entry (max if the wheel is empty)
+    uint64_t earliestTick = std::numeric_limits<uint64_t>::max();
+
+    std::array<std::vector<Slot>, Levels> levels;
+};
@@ -17,62 +17,59 @@
 
 #include "durability_timeout_task.h"
 #include "ep_engine.h"
-#include "kv_bucket.h"
+#include "executorpool.h"
+#include "vbucket.h"
 
 #include <phosphor/phosphor.h>
 
-class DurabilityTimeoutTask::ConfigChangeListener
-    : public ValueChangedListener {
-public:
-    ConfigChangeListener(DurabilityTimeoutTask& timeoutTask)
-        : timeoutTask(timeoutTask) {
-    }
-
-    void sizeValueChanged(const std::string& key, size_t value) override {
-        if (key == "durability_timeout_task_interval") {
-            timeoutTask.setSleepTime(std::chrono::milliseconds(value));
-        }
-    }
-
-private:
-    DurabilityTimeoutTask& timeoutTask;
-};
+#include <climits>
 
-DurabilityTimeoutTask::DurabilityTimeoutTask(EventuallyPersistentEngine& engine,
-                                             std::chrono::milliseconds interval)
+DurabilityTimeoutTask::DurabilityTimeoutTask(EventuallyPersistentEngine& engine)
     : GlobalTask(&engine,
                  TaskId::DurabilityTimeoutTask,
-                 0 /*initial sleep-time in seconds*/,
-                 false /*completeBeforeShutdown*/),
-      sleepTime(interval) {
-    engine.getConfiguration().addValueChangedListener(
-            "durability_timeout_task_interval",
-            std::make_unique<ConfigChangeListener>(*this));
+                 INT_MAX /*sleep until the first SyncWrite is added*/,
+                 false /*completeBeforeShutdown*/) {
 }
 
 bool DurabilityTimeoutTask::run() {
     TRACE_EVENT0("ep-engine/task", "DurabilityTimeoutTask");
 
-    // @todo: A meaningful value will be the P99.99
-    const auto maxExpectedDurationForVisitorTask =
-            std::chrono::milliseconds(100);
+    if (engine->getEpStats().isShutdown) {
+        return false;
+    }
 
-    auto& kvBucket = *engine->getKVBucket();
-    kvBucket.visitAsync(std::make_unique<DurabilityTimeoutVisitor>(),
-                        "DurabilityTimeoutVisitor",
-                        TaskId::DurabilityTimeoutVisitor,
-                        maxExpectedDurationForVisitorTask);
+    const auto now = std::chrono::steady_clock::now();
+    const auto expired = wheel.lock()->advance(now);
 
-    // Note: Default unit for std::duration is seconds, so the following gives
-    // the seconds-representation (as double) of the given millis (sleepTime)
-    snooze(std::chrono::duration_cast<std::chrono::duration<double>>(
-                   sleepTime.load())
-                   .count());
+    // Note: The wheel is not locked while the vBuckets are processed, so
+    // front-end threads adding SyncWrites are never blocked by this.
+    for (const auto vbid : expired) {
+        auto vb = engine->getVBucket(vbid);
+        if (vb) {
+            vb->processDurabilityTimeout(now);
+        }
+    }
 
-    // Schedule again if not shutting down
-    return !engine->getEpStats().isShutdown;
+    // Sleep until the next SyncWrite is due. Note this is done with the
+    // wheel locked so it cannot override the wake-up requested by a
+    // concurrent addSyncWriteTimeout().
+    auto locked = wheel.lock();
+    const auto due = locked->getNextDueTime();
+    if (due == SyncWriteTimerWheel::Clock::time_point::max()) {
+        snooze(INT_MAX);
+    } else {
+        snooze(std::chrono::duration<double>(
+                       due - std::chrono::steady_clock::now())
+                       .count());
+    }
+    return true;
 }
 
-void DurabilityTimeoutVisitor::visitBucket(const VBucketPtr& vb) {
-    vb->processDurabilityTimeout(startTime);
+void DurabilityTimeoutTask::addSyncWriteTimeout(
+        Vbid vbid, std::chrono::steady_clock::time_point expiry) {
+    if (wheel.lock()->add(vbid, expiry)) {
+        // The task is sleeping until a later time (if at all); run it now so
+        // it snoozes until the new earliest expiry.
+        ExecutorPool::get()->wake(getId());
+    }
 }
@@ -16,22 +16,28 @@
  */
 #pragma once
 
+#include "durability/sync_write_timer_wheel.h"
 #include "globaltask.h"
-#include "vb_visitors.h"
-#include <platform/atomic_duration.h>
+
+#include <folly/Synchronized.h>
+#include <memcached/vbucket.h>
+
+#include <mutex>
 
 /*
  * Enforces the Durability Timeout for the SyncWrites tracked in this KVBucket.
+ *
+ * The expiry time of every SyncWrite with a timeout is registered in a timer
+ * wheel when the SyncWrite is added (see addSyncWriteTimeout()). The task
+ * sleeps until the earliest expiry, and then only processes the vBuckets which
+ * have SyncWrites due - there is no periodic sweep of all the vBuckets.
  */
 class DurabilityTimeoutTask : public GlobalTask {
 public:
-    class ConfigChangeListener;
-
     /**
      * @param engine The engine that will be visited
      */
-    DurabilityTimeoutTask(EventuallyPersistentEngine& engine,
-                          std::chrono::milliseconds interval);
+    explicit DurabilityTimeoutTask(EventuallyPersistentEngine& engine);
 
     bool run() override;
 
@@ -40,35 +46,21 @@ public:
     }
 
     std::chrono::microseconds maxExpectedDuration() override {
-        // This tasks just spawns a new VBCBAdaptor, which is the actual tasks
-        // that executes the DurabilityTimeoutVisitor. So, keeping the value
-        // relatively high as there is no too much value in logging this timing.
-        return std::chrono::seconds(1);
+        // Only the vBuckets with expired SyncWrites are processed, which
+        // should normally be very few.
+        return std::chrono::milliseconds(100);
     }
 
-    void setSleepTime(std::chrono::milliseconds value) {
-        sleepTime = value;
-    }
-
-private:
-    // Note: this is the actual minimum interval between subsequent runs.
-    // The VBCBAdaptor (which is the actual task that executes this Visitor)
-    // has its internal sleep-time which is used for a different purpose,
-    // details in VBCBAdaptor.
-    cb::AtomicDuration<std::memory_order::memory_order_seq_cst> sleepTime;
-};
-
-/**
- * DurabilityTimeoutVisitor visits a VBucket for enforcing the Durability
- * Timeout for the SyncWrites tracked by VBucket.
- */
-class DurabilityTimeoutVisitor : public CappedDurationVBucketVisitor {
-public:
-    DurabilityTimeoutVisitor() : startTime(std::chrono::steady_clock::now()) {
-    }
-
-    void visitBucket(const VBucketPtr& vb) override;
+    /**
+     * Register the expiry time of a SyncWrite, waking the task earlier if
+     * this is now the first SyncWrite to expire.
+     *
+     * @param vbid The vBucket tracking the SyncWrite
+     * @param expiry The expiry-time of the SyncWrite
+     */
+    void addSyncWriteTimeout(Vbid vbid,
+                             std::chrono::steady_clock::time_point expiry);
 
 private:
-    const std::chrono::steady_clock::time_point startTime;
+    folly::Synchronized<SyncWriteTimerWheel, std::mutex> wheel;
 };
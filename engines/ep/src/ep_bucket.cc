@@ -21,6 +21,7 @@
 #include "bucket_logger.h"
 #include "checkpoint_manager.h"
 #include "collections/manager.h"
+#include "compaction_throttle.h"
 #include "dcp/dcpconnmap.h"
 #include "ep_engine.h"
 #include "ep_time.h"
@@ -39,12 +40,18 @@
 #include "vbucket_state.h"
 #include "warmup.h"
 
+#include <platform/dirutils.h>
 #include <platform/timeutils.h>
 #include <utilities/hdrhistogram.h>
 #include <utilities/logtags.h>
 
 #include <gsl.h>
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
 /**
  * Callback class used by EpStore, for adding relevant keys
  * to bloomfilter during compaction.
@@ -224,6 +231,8 @@ public:
             bucket.setAccessScannerSleeptime(value, false);
         } else if (key == "alog_task_time") {
             bucket.resetAccessScannerStartTime();
+        } else if (key == "compaction_max_bytes_per_sec") {
+            CompactionThrottle::get().setRate(value);
         } else {
             EP_LOG_WARN("Failed to change value for unknown variable, {}", key);
         }
@@ -272,6 +281,15 @@ EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
            "retain_erroneous_tombstones",
            std::make_unique<ValueChangedListener>(*this));
 
+    // The compaction throttle is shared by all buckets; only override the
+    // current rate if this bucket was explicitly configured with one.
+    if (config.getCompactionMaxBytesPerSec() != 0) {
+        CompactionThrottle::get().setRate(config.getCompactionMaxBytesPerSec());
+    }
+    config.addValueChangedListener(
+            "compaction_max_bytes_per_sec",
+            std::make_unique<ValueChangedListener>(*this));
+
     initializeWarmupTask();
 }
 
@@ -300,9 +318,89 @@ std::vector<ExTask> EPBucket::deinitialize() {
     stopFlusher();
     stopBgFetcher();
     stopWarmup();
+    if (!stats.forceShutdown) {
+        saveFilters();
+    }
     return KVBucket::deinitialize();
 }
 
+void EPBucket::saveFilters() {
+    auto& config = engine.getConfiguration();
+    if (!config.isBfilterEnabled() || config.getBfilterType() != "cuckoo") {
+        return;
+    }
+
+    for (auto vbid : vbMap.getBuckets()) {
+        auto vb = getVBucket(vbid);
+        if (!vb) {
+            continue;
+        }
+        const auto data = vb->snapshotFilter();
+        if (data.empty()) {
+            continue;
+        }
+
+        const auto fname = getFilterFileName(vbid);
+        const auto next_fname = fname + ".new";
+        bool rv;
+        {
+            std::ofstream file(next_fname,
+                               std::ios::out | std::ios::binary |
+                                       std::ios::trunc);
+            file.write(data.data(), data.size());
+            file.close();
+            rv = bool(file);
+        }
+        if (!rv || rename(next_fname.c_str(), fname.c_str()) != 0) {
+            EP_LOG_WARN("EPBucket::saveFilters: Failed to save the filter of "
+                        "{} to '{}': {}",
+                        vbid,
+                        fname,
+                        strerror(errno));
+            remove(next_fname.c_str());
+        }
+    }
+}
+
+void EPBucket::restoreFilter(VBucket& vb, int64_t highSeqno) {
+    auto& config = engine.getConfiguration();
+    const auto fname = getFilterFileName(vb.getId());
+    if (!cb::io::isFile(fname)) {
+        return;
+    }
+
+    if (config.isBfilterEnabled() && config.getBfilterType() == "cuckoo") {
+        std::ifstream file(fname, std::ios::in | std::ios::binary);
+        std::string data{std::istreambuf_iterator<char>(file),
+                         std::istreambuf_iterator<char>()};
+        if (vb.restoreFilter(data, highSeqno)) {
+            EP_LOG_INFO(
+                    "EPBucket::restoreFilter: Restored the filter of {} "
+                    "with {} keys",
+                    vb.getId(),
+                    vb.getNumOfKeysInFilter());
+        } else {
+            EP_LOG_WARN(
+                    "EPBucket::restoreFilter: Ignoring the filter of {} in "
+                    "'{}', which isn't valid at seqno:{}",
+                    vb.getId(),
+                    fname,
+                    highSeqno);
+        }
+    }
+
+    if (remove(fname.c_str()) != 0) {
+        EP_LOG_WARN("EPBucket::restoreFilter: Failed to remove '{}': {}",
+                    fname,
+                    strerror(errno));
+    }
+}
+
+std::string EPBucket::getFilterFileName(Vbid vbid) const {
+    return engine.getConfiguration().getDbname() + "/" +
+           std::to_string(vbid.get()) + ".cuckoo_filter";
+}
+
 /**
  * @returns true if the item `candidate` can be de-duplicated (skipped) because
  * `lastFlushed` already supercedes it.
@@ -866,14 +964,24 @@ ENGINE_ERROR_CODE EPBucket::scheduleCompaction(Vbid vbid,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
+    // Read outside of compactionLock; this may need to open the file.
+    const auto fragmentation = getFragmentation(c.db_file_id);
+
     LockHolder lh(compactionLock);
     ExTask task = std::make_shared<CompactTask>(
             *this, c, vb->getPurgeSeqno(), cookie);
-    compactionTasks.push_back(std::make_pair(c.db_file_id, task));
+    const bool sameVBucketPending =
+            std::any_of(compactionTasks.begin(),
+                        compactionTasks.end(),
+                        [&c](const CompTaskEntry& entry) {
+                            return entry.vbid == c.db_file_id;
+                        });
+    compactionTasks.emplace_back(c.db_file_id, task, fragmentation);
     if (compactionTasks.size() > 1) {
         if ((stats.diskQueueSize > compactionWriteQueueCap &&
              compactionTasks.size() > (vbMap.getNumShards() / 2)) ||
-            engine.getWorkLoadPolicy().getWorkLoadPattern() == READ_HEAVY) {
+            engine.getWorkLoadPolicy().getWorkLoadPattern() == READ_HEAVY ||
+            sameVBucketPending) {
             // Snooze a new compaction task.
             // We will wake it up when one of the existing compaction tasks is
             // done.
@@ -884,10 +992,11 @@ ENGINE_ERROR_CODE EPBucket::scheduleCompaction(Vbid vbid,
     ExecutorPool::get()->schedule(task);
 
     EP_LOG_DEBUG(
-            "Scheduled compaction task {} on {},"
+            "Scheduled compaction task {} on {}, fragmentation = {}%, "
             "purge_before_ts = {}, purge_before_seq = {}, dropdeletes = {}",
             uint64_t(task->getId()),
             c.db_file_id,
+            fragmentation,
             c.purge_before_ts,
             c.purge_before_seq,
             c.drop_deletes);
@@ -897,12 +1006,46 @@ ENGINE_ERROR_CODE EPBucket::scheduleCompaction(Vbid vbid,
 
 ENGINE_ERROR_CODE EPBucket::cancelCompaction(Vbid vbid) {
     LockHolder lh(compactionLock);
-    for (const auto& task : compactionTasks) {
-        task.second->cancel();
+    for (const auto& entry : compactionTasks) {
+        entry.task->cancel();
     }
     return ENGINE_SUCCESS;
 }
 
+bool EPBucket::beginCompaction(Vbid vbid, size_t taskId) {
+    LockHolder lh(compactionLock);
+    auto own = compactionTasks.end();
+    for (auto it = compactionTasks.begin(); it != compactionTasks.end();
+         ++it) {
+        if (it->task->getId() == taskId) {
+            own = it;
+        } else if (it->vbid == vbid && it->running) {
+            return false;
+        }
+    }
+    if (own != compactionTasks.end()) {
+        own->running = true;
+    }
+    return true;
+}
+
+size_t EPBucket::getFragmentation(Vbid vbid) {
+    DBFileInfo info;
+    try {
+        info = getRWUnderlying(vbid)->getDbFileInfo(vbid);
+    } catch (const std::exception& e) {
+        EP_LOG_DEBUG("EPBucket::getFragmentation: {} failed to read file info "
+                     "- {}",
+                     vbid,
+                     e.what());
+        return 0;
+    }
+    if (info.fileSize == 0 || info.spaceUsed >= info.fileSize) {
+        return 0;
+    }
+    return ((info.fileSize - info.spaceUsed) * 100) / info.fileSize;
+}
+
 
 void EPBucket::flushOneDelOrSet(const queued_item& qi, VBucketPtr& vb) {
     if (!vb) {
@@ -1036,7 +1179,8 @@ void EPBucket::compactInternal(const CompactionConfig& config,
 
 bool EPBucket::doCompact(const CompactionConfig& config,
                          uint64_t purgeSeqno,
-                         const void* cookie) {
+                         const void* cookie,
+                         size_t taskId) {
     ENGINE_ERROR_CODE err = ENGINE_SUCCESS;
     StorageProperties storeProp = getStorageProperties();
     bool concWriteCompact = storeProp.hasConcWriteCompact();
@@ -1070,7 +1214,7 @@ bool EPBucket::doCompact(const CompactionConfig& config,
         compactInternal(config, purgeSeqno);
     }
 
-    updateCompactionTasks(vbid);
+    updateCompactionTasks(vbid, taskId);
 
     if (cookie) {
         engine.notifyIOComplete(cookie, err);
@@ -1079,25 +1223,42 @@ bool EPBucket::doCompact(const CompactionConfig& config,
     return false;
 }
 
-void EPBucket::updateCompactionTasks(Vbid db_file_id) {
+void EPBucket::updateCompactionTasks(Vbid db_file_id, size_t taskId) {
     LockHolder lh(compactionLock);
-    bool erased = false, woke = false;
-    std::list<CompTaskEntry>::iterator it = compactionTasks.begin();
-    while (it != compactionTasks.end()) {
-        if ((*it).first == db_file_id) {
-            it = compactionTasks.erase(it);
-            erased = true;
-        } else {
-            ExTask& task = (*it).second;
-            if (task->getState() == TASK_SNOOZED) {
-                ExecutorPool::get()->wake(task->getId());
-                woke = true;
-            }
-            ++it;
+    auto done = std::find_if(compactionTasks.begin(),
+                             compactionTasks.end(),
+                             [taskId](const CompTaskEntry& entry) {
+                                 return entry.task->getId() == taskId;
+                             });
+    if (done != compactionTasks.end()) {
+        compactionTasks.erase(done);
+    }
+
+    // Hand the freed slot to the snoozed task which should run next,
+    // skipping any whose vBucket is still being compacted by another task.
+    std::unordered_set<Vbid> busy;
+    for (const auto& entry : compactionTasks) {
+        if (entry.running) {
+            busy.insert(entry.vbid);
+        }
+    }
+    auto next = compactionTasks.end();
+    for (auto it = compactionTasks.begin(); it != compactionTasks.end();
+         ++it) {
+        if (it->task->getState() != TASK_SNOOZED || busy.count(it->vbid)) {
+            continue;
         }
-        if (erased && woke) {
+        if (it->vbid == db_file_id) {
+            next = it;
             break;
         }
+        if (next == compactionTasks.end() ||
+            it->fragmentation > next->fragmentation) {
+            next = it;
+        }
+    }
+    if (next != compactionTasks.end()) {
+        ExecutorPool::get()->wake(next->task->getId());
     }
 }
 
@@ -77,24 +77,47 @@ public:
     /// Stops the background fetcher for each shard.
     void stopBgFetcher();
 
+    /**
+     * Restore the cuckoo filter of a vBucket saved by the last (clean)
+     * shutdown, if any. The saved filter is removed, so it can't be used
+     * by a later warmup once the vBucket has moved on.
+     *
+     * @param highSeqno the persisted high seqno of the vBucket
+     */
+    void restoreFilter(VBucket& vb, int64_t highSeqno);
+
     ENGINE_ERROR_CODE scheduleCompaction(Vbid vbid,
                                          const CompactionConfig& c,
                                          const void* ck) override;
 
     ENGINE_ERROR_CODE cancelCompaction(Vbid vbid) override;
 
+    /**
+     * Claim the right to compact the given vBucket for the given compaction
+     * task. At most one compaction of a vBucket runs at a time; a task which
+     * fails to claim it should snooze until woken by the completion of the
+     * running one.
+     *
+     * @param vbid vBucket to compact
+     * @param taskId id of the compaction task which wants to compact it
+     * @return true if the caller may go ahead and compact
+     */
+    bool beginCompaction(Vbid vbid, size_t taskId);
+
     /**
      * Compaction of a database file
      *
      * @param ctx Context for compaction hooks
      * @param ck cookie used to notify connection of operation completion
+     * @param taskId id of the compaction task running the compaction
      *
      * return true if the compaction needs to be rescheduled and false
      *             otherwise
      */
     bool doCompact(const CompactionConfig& config,
                    uint64_t purgeSeq,
-                   const void* cookie);
+                   const void* cookie,
+                   size_t taskId);
 
     std::pair<uint64_t, bool> getLastPersistedCheckpointId(Vbid vb) override;
 
@@ -208,14 +231,26 @@ protected:
     void compactInternal(const CompactionConfig& config, uint64_t purgeSeqno);
 
     /**
-     * Remove completed compaction tasks or wake snoozed tasks
+     * Remove the completed compaction task and wake the snoozed task which
+     * should run next: one waiting for the same vBucket if there is one,
+     * otherwise the one for the most fragmented vBucket.
      *
      * @param db_file_id vbucket id for couchstore
+     * @param taskId id of the completed compaction task
      */
-    void updateCompactionTasks(Vbid db_file_id);
+    void updateCompactionTasks(Vbid db_file_id, size_t taskId);
+
+    /// @return percentage of the vBucket's file which is stale data.
+    size_t getFragmentation(Vbid vbid);
 
     void stopWarmup();
 
+    /// Save the cuckoo filter of every vBucket, for the next warmup
+    void saveFilters();
+
+    /// @return the name of the file the filter of a vBucket is saved in
+    std::string getFilterFileName(Vbid vbid) const;
+
     /// function which is passed down to compactor for dropping keys
     void dropKey(Vbid vbid, const DiskDocKey& key, int64_t bySeqno);
 
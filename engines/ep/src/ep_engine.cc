@@ -24,6 +24,8 @@
 #include "checkpoint_manager.h"
 #include "collections/manager.h"
 #include "common.h"
+#include "compaction_throttle.h"
+#include "compression_dictionary.h"
 #include "connmap.h"
 #include "dcp/consumer.h"
 #include "dcp/dcpconnmap.h"
@@ -32,15 +34,18 @@
 #include "dcp/producer.h"
 #include "ep_bucket.h"
 #include "ep_engine_public.h"
+#include "ep_metrics.h"
 #include "ep_vb.h"
 #include "ephemeral_bucket.h"
 #include "executorpool.h"
 #include "ext_meta_parser.h"
+#include "hot_key_cache.h"
 #include "failover-table.h"
 #include "flusher.h"
 #include "hash_table_stat_visitor.h"
 #include "htresizer.h"
 #include "memory_tracker.h"
+#include "objectregistry.h"
 #include "replicationthrottle.h"
 #include "server_document_iface_border_guard.h"
 #include "stats-info.h"
@@ -86,6 +91,9 @@
 
 using cb::tracing::Code;
 
+/// The maximum number of DCP messages added by a single step() call
+static const size_t maxDcpMessagesPerStep = 64;
+
 static size_t percentOf(size_t val, double percent) {
     return static_cast<size_t>(static_cast<double>(val) * percent);
 }
@@ -267,10 +275,13 @@ void EventuallyPersistentEngine::release(gsl::not_null<item*> itm) {
     acquireEngine(this)->itemRelease(itm);
 }
 
-cb::EngineErrorItemPair EventuallyPersistentEngine::get(
-        gsl::not_null<const void*> cookie,
-        const DocKey& key,
-        Vbid vbucket,
+/**
+ * Get the options to use for a front-end get with the given document state
+ * filter.
+ *
+ * @return the options, or boost::none if the filter isn't supported
+ */
+static boost::optional<get_options_t> getOptionsForFilter(
         DocStateFilter documentStateFilter) {
     get_options_t options = static_cast<get_options_t>(QUEUE_BG_FETCH |
                                                        HONOR_STATES |
@@ -288,20 +299,37 @@ cb::EngineErrorItemPair EventuallyPersistentEngine::get(
         // way of requesting just deleted documents, and luckily for
         // us no part of our code is using this yet. Return an error
         // if anyone start using it
-        return std::make_pair(
-                cb::engine_errc::not_supported,
-                cb::unique_item_ptr{nullptr, cb::ItemDeleter{this}});
+        return boost::none;
     case DocStateFilter::AliveOrDeleted:
         options = static_cast<get_options_t>(options | GET_DELETED_VALUE);
         break;
     }
+    return options;
+}
+
+cb::EngineErrorItemPair EventuallyPersistentEngine::get(
+        gsl::not_null<const void*> cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        DocStateFilter documentStateFilter) {
+    const auto options = getOptionsForFilter(documentStateFilter);
+    if (!options) {
+        return std::make_pair(
+                cb::engine_errc::not_supported,
+                cb::unique_item_ptr{nullptr, cb::ItemDeleter{this}});
+    }
 
     item* itm = nullptr;
     ENGINE_ERROR_CODE ret =
-            acquireEngine(this)->get(cookie, &itm, key, vbucket, options);
+            acquireEngine(this)->get(cookie, &itm, key, vbucket, *options);
     return cb::makeEngineErrorItemPair(cb::engine_errc(ret), itm, this);
 }
 
+std::vector<cb::EngineErrorItemPair> EventuallyPersistentEngine::get_multi(
+        const std::vector<cb::EngineGetRequest>& requests) {
+    return acquireEngine(this)->getMultiInner(requests);
+}
+
 cb::EngineErrorItemPair EventuallyPersistentEngine::get_if(
         gsl::not_null<const void*> cookie,
         const DocKey& key,
@@ -421,6 +449,18 @@ void EventuallyPersistentEngine::reset_stats(
     acquireEngine(this)->resetStats();
 }
 
+cb::engine_errc EventuallyPersistentEngine::get_metrics(
+        gsl::not_null<const void*> cookie, cb::metrics::Collector& collector) {
+    // The collector is owned (and freed) by the front end, so don't account
+    // the memory it allocates against this bucket.
+    {
+        NonBucketAllocationGuard guard;
+        collector.reserve(collector.size() + ep_metrics::count);
+    }
+    acquireEngine(this)->doEngineMetrics(collector);
+    return cb::engine_errc::success;
+}
+
 cb::mcbp::Status EventuallyPersistentEngine::setReplicationParam(
         const std::string& key, const std::string& val, std::string& msg) {
     auto rv = cb::mcbp::Status::Success;
@@ -606,6 +646,13 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setBfilterKeyCount(std::stoull(val));
         } else if (key == "pager_active_vb_pcnt") {
             getConfiguration().setPagerActiveVbPcnt(std::stoull(val));
+        } else if (key == "pager_eviction_strategy") {
+            getConfiguration().setPagerEvictionStrategy(val);
+        } else if (key == "pager_sampled_eviction_perc") {
+            getConfiguration().setPagerSampledEvictionPerc(std::stoull(val));
+        } else if (key == "pager_sampled_eviction_sample_size") {
+            getConfiguration().setPagerSampledEvictionSampleSize(
+                    std::stoull(val));
         } else if (key == "pager_sleep_time_ms") {
             getConfiguration().setPagerSleepTimeMs(std::stoull(val));
         } else if (key == "item_eviction_age_percentage") {
@@ -645,6 +692,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setBfilterEnabled(cb_stob(val));
         } else if (key == "bfilter_residency_threshold") {
             getConfiguration().setBfilterResidencyThreshold(std::stof(val));
+        } else if (key == "hash_table_fused_scan") {
+            getConfiguration().setHashTableFusedScan(cb_stob(val));
         } else if (key == "defragmenter_enabled") {
             getConfiguration().setDefragmenterEnabled(cb_stob(val));
         } else if (key == "defragmenter_interval") {
@@ -658,6 +707,14 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setItemCompressorInterval(v);
         } else if (key == "item_compressor_chunk_duration") {
             getConfiguration().setItemCompressorChunkDuration(std::stoull(val));
+        } else if (key == "item_compressor_algorithm") {
+            if (val == "zstd_dictionary" &&
+                !CompressionDictionary::isSupported()) {
+                throw std::logic_error(
+                        "item_compressor_algorithm: zstd_dictionary is not "
+                        "supported by this build");
+            }
+            getConfiguration().setItemCompressorAlgorithm(val);
         } else if (key == "defragmenter_age_threshold") {
             getConfiguration().setDefragmenterAgeThreshold(std::stoull(val));
         } else if (key == "defragmenter_chunk_duration") {
@@ -669,6 +726,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             runDefragmenterTask();
         } else if (key == "compaction_write_queue_cap") {
             getConfiguration().setCompactionWriteQueueCap(std::stoull(val));
+        } else if (key == "compaction_max_bytes_per_sec") {
+            getConfiguration().setCompactionMaxBytesPerSec(std::stoull(val));
         } else if (key == "chk_expel_enabled") {
             getConfiguration().setChkExpelEnabled(cb_stob(val));
         } else if (key == "dcp_min_compression_ratio") {
@@ -694,11 +753,18 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
         } else if (key == "ephemeral_metadata_purge_stale_chunk_duration") {
             getConfiguration().setEphemeralMetadataPurgeStaleChunkDuration(
                     std::stoull(val));
+        } else if (key == "ephemeral_metadata_purge_stale_threshold") {
+            getConfiguration().setEphemeralMetadataPurgeStaleThreshold(
+                    std::stoull(val));
         } else if (key == "fsync_after_every_n_bytes_written") {
             getConfiguration().setFsyncAfterEveryNBytesWritten(
                     std::stoull(val));
         } else if (key == "xattr_enabled") {
             getConfiguration().setXattrEnabled(cb_stob(val));
+        } else if (key == "hot_key_cache_enabled") {
+            getConfiguration().setHotKeyCacheEnabled(cb_stob(val));
+        } else if (key == "ht_optimistic_reads") {
+            getConfiguration().setHtOptimisticReads(cb_stob(val));
         } else if (key == "compression_mode") {
             getConfiguration().setCompressionMode(val);
         } else if (key == "min_compression_ratio") {
@@ -720,6 +786,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setCouchstoreWriteValidation(cb_stob(val));
         } else if (key == "couchstore_mprotect") {
             getConfiguration().setCouchstoreMprotect(cb_stob(val));
+        } else if (key == "couchstore_compaction_readahead") {
+            getConfiguration().setCouchstoreCompactionReadahead(cb_stob(val));
         } else if (key == "allow_del_with_meta_prune_user_data") {
             getConfiguration().setAllowDelWithMetaPruneUserData(cb_stob(val));
         } else {
@@ -1282,7 +1350,17 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::step(
     ConnHandler* conn = engine->getConnHandler(cookie);
     if (conn) {
         DcpMsgProducersBorderGuard guardedProducers(*producers);
-        return conn->step(&guardedProducers);
+        // Add as many messages as the connection wants (up to a limit so
+        // we don't starve the other connections served by the front-end
+        // thread) to avoid the overhead of calling into the engine (and
+        // looking up the connection) for every message
+        ENGINE_ERROR_CODE ret;
+        size_t count = 0;
+        do {
+            ret = conn->step(&guardedProducers);
+        } while (ret == ENGINE_SUCCESS && ++count < maxDcpMessagesPerStep &&
+                 guardedProducers.want_more_messages());
+        return ret;
     }
     return ENGINE_DISCONNECT;
 }
@@ -2096,6 +2174,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
     } else if (!flowCtlPolicy.compare("aggressive")) {
         dcpFlowControlManager_ =
                 std::make_unique<DcpFlowControlManagerAggressive>(*this);
+    } else if (!flowCtlPolicy.compare("adaptive")) {
+        dcpFlowControlManager_ =
+                std::make_unique<DcpFlowControlManagerAdaptive>(*this);
     } else {
         /* Flow control is not enabled */
         dcpFlowControlManager_ = std::make_unique<DcpFlowControlManager>(*this);
@@ -2302,6 +2383,67 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::get(const void* cookie,
     return ret;
 }
 
+std::vector<cb::EngineErrorItemPair>
+EventuallyPersistentEngine::getMultiInner(
+        const std::vector<cb::EngineGetRequest>& requests) {
+    std::vector<cb::EngineErrorItemPair> results;
+    results.reserve(requests.size());
+
+    // The lookups to pass down to the bucket, and the index of the
+    // request each of them belongs to
+    std::vector<GetMultiRequest> lookups;
+    std::vector<size_t> index;
+    lookups.reserve(requests.size());
+    index.reserve(requests.size());
+    for (const auto& req : requests) {
+        const auto options = getOptionsForFilter(req.documentStateFilter);
+        results.emplace_back(
+                options ? cb::engine_errc::success
+                        : cb::engine_errc::not_supported,
+                cb::unique_item_ptr{nullptr, cb::ItemDeleter{this}});
+        if (options) {
+            index.push_back(results.size() - 1);
+            lookups.push_back({req.cookie, req.key, req.vbucket, *options});
+        }
+    }
+
+    if (lookups.empty()) {
+        return results;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto values = kvBucket->getMulti(lookups);
+    const auto stop = std::chrono::steady_clock::now();
+
+    // Record each lookup with its share of the batch so that get_cmd
+    // still holds one sample per get; and, as for get(), give each
+    // command a Get span (covering the whole batch).
+    const auto elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    stats.getCmdHisto.add(elapsed / lookups.size(), lookups.size());
+    for (const auto& lookup : lookups) {
+        TracerStopwatch tracer(lookup.cookie, cb::tracing::Code::Get);
+        tracer.start(start);
+        tracer.stop(stop);
+    }
+
+    for (size_t ii = 0; ii < values.size(); ++ii) {
+        auto& result = results[index[ii]];
+        ENGINE_ERROR_CODE ret = values[ii].getStatus();
+        if (ret == ENGINE_SUCCESS) {
+            result.second.reset(values[ii].item.release());
+            ++stats.numOpsGet;
+        } else if (ret == ENGINE_KEY_ENOENT || ret == ENGINE_NOT_MY_VBUCKET) {
+            if (isDegradedMode()) {
+                ret = ENGINE_TMPFAIL;
+            }
+        }
+        result.first = cb::engine_errc(ret);
+    }
+
+    return results;
+}
+
 cb::EngineErrorItemPair EventuallyPersistentEngine::getAndTouchInner(
         const void* cookie, const DocKey& key, Vbid vbucket, uint32_t exptime) {
     auto* handle = reinterpret_cast<EngineIface*>(this);
@@ -2668,6 +2810,21 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                         VBucket::getCheckpointFlushTimeout().count(),
                         add_stat,
                         cookie);
+
+        // Node-wide compaction IO throttle (shared by all buckets).
+        auto& throttle = CompactionThrottle::get();
+        add_casted_stat("ep_compaction_bandwidth",
+                        throttle.getBandwidth(),
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_compaction_throttled_count",
+                        throttle.getThrottledCount(),
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_compaction_throttled_time",
+                        throttle.getThrottledTime(),
+                        add_stat,
+                        cookie);
     }
     add_casted_stat("ep_vbucket_del",
                     epstats.vbucketDeletions, add_stat, cookie);
@@ -2738,6 +2895,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     add_stat, cookie);
     add_casted_stat("ep_num_pager_runs", epstats.pagerRuns,
                     add_stat, cookie);
+    add_casted_stat("ep_num_pager_sampled_rounds",
+                    epstats.pagerSampledRounds,
+                    add_stat,
+                    cookie);
     add_casted_stat("ep_num_expiry_pager_runs", epstats.expiryPagerRuns,
                     add_stat, cookie);
     add_casted_stat("ep_num_freq_decayer_runs",
@@ -2921,6 +3082,15 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     add_stat,
                     cookie);
 
+    add_casted_stat("ep_hot_key_cache_hits",
+                    kvBucket->getHotKeyCache().getNumHits(),
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_hot_key_cache_snapshots",
+                    kvBucket->getHotKeyCache().getNumSnapshots(),
+                    add_stat,
+                    cookie);
+
     add_casted_stat("ep_cursor_dropping_lower_threshold",
                     epstats.cursorDroppingLThreshold, add_stat, cookie);
     add_casted_stat("ep_cursor_dropping_upper_threshold",
@@ -3122,6 +3292,53 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
     return ENGINE_SUCCESS;
 }
 
+void EventuallyPersistentEngine::doEngineMetrics(
+        cb::metrics::Collector& collector) {
+    // Visiting the vBuckets allocates bucket memory, the rest of the
+    // metrics are read directly from EPStats.
+    kvBucket->getAggregatedVBucketMetrics(collector);
+
+    NonBucketAllocationGuard guard;
+    using namespace ep_metrics;
+    EPStats& epstats = getEpStats();
+
+    collector.addGauge(mem_used, stats.getPreciseTotalMemoryUsed());
+    collector.addGauge(ep_kv_size, stats.getCurrentSize());
+    collector.addGauge(ep_overhead, stats.getMemOverhead());
+    collector.addGauge(ep_max_size, stats.getMaxDataSize());
+    collector.addGauge(ep_mem_low_wat, stats.mem_low_wat);
+    collector.addGauge(ep_mem_high_wat, stats.mem_high_wat);
+    collector.addCounter(ep_oom_errors, stats.oom_errors);
+    collector.addCounter(ep_tmp_oom_errors, stats.tmp_oom_errors);
+
+    collector.addGauge(ep_queue_size, epstats.diskQueueSize);
+    collector.addGauge(ep_flusher_todo, epstats.flusher_todo);
+    collector.addCounter(ep_total_persisted, epstats.totalPersisted);
+    collector.addCounter(ep_commit_num, epstats.flusherCommits);
+    collector.addCounter(ep_item_commit_failed, epstats.commitFailed);
+    collector.addGauge(ep_storage_age, epstats.dirtyAge);
+
+    collector.addCounter(ep_bg_fetched, epstats.bg_fetched);
+    collector.addCounter(ep_bg_meta_fetched, epstats.bg_meta_fetched);
+    collector.addGauge(ep_bg_remaining_jobs, epstats.numRemainingBgJobs);
+    collector.addGauge(ep_pending_ops, epstats.pendingOps);
+    collector.addCounter(ep_num_not_my_vbuckets, epstats.numNotMyVBuckets);
+    collector.addCounter(ep_num_value_ejects, epstats.numValueEjects);
+    collector.addCounter(ep_expired_access, epstats.expired_access);
+    collector.addCounter(ep_expired_compactor, epstats.expired_compactor);
+    collector.addCounter(ep_expired_pager, epstats.expired_pager);
+    collector.addCounter(ep_num_ops_get_meta, epstats.numOpsGetMeta);
+    collector.addCounter(ep_num_ops_set_meta, epstats.numOpsSetMeta);
+    collector.addCounter(ep_num_ops_del_meta, epstats.numOpsDelMeta);
+
+    collector.addHistogram(get_cmd, epstats.getCmdHisto);
+    collector.addHistogram(store_cmd, epstats.storeCmdHisto);
+    collector.addHistogram(arith_cmd, epstats.arithCmdHisto);
+    collector.addHistogram(bg_load, epstats.bgLoadHisto);
+    collector.addHistogram(pending_ops, epstats.pendingOpsHisto);
+    collector.addHistogram(storage_age, epstats.dirtyAgeHisto);
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::doMemoryStats(
         const void* cookie, const AddStatFn& add_stat) {
     add_casted_stat("mem_used_estimate",
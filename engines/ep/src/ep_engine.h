@@ -129,6 +129,9 @@ public:
                                 const DocKey& key,
                                 Vbid vbucket,
                                 DocStateFilter documentStateFilter) override;
+    std::vector<cb::EngineErrorItemPair> get_multi(
+            const std::vector<cb::EngineGetRequest>& requests) override;
+
     cb::EngineErrorItemPair get_if(
             gsl::not_null<const void*> cookie,
             const DocKey& key,
@@ -184,6 +187,9 @@ public:
 
     void reset_stats(gsl::not_null<const void*> cookie) override;
 
+    cb::engine_errc get_metrics(gsl::not_null<const void*> cookie,
+                                cb::metrics::Collector& collector) override;
+
     ENGINE_ERROR_CODE unknown_command(const void* cookie,
                                       const cb::mcbp::Request& request,
                                       const AddResponseFn& response) override;
@@ -431,6 +437,13 @@ public:
                           Vbid vbucket,
                           get_options_t options);
 
+    /**
+     * Look up a batch of items with a single call into the bucket (see
+     * KVBucketIface::getMulti).
+     */
+    std::vector<cb::EngineErrorItemPair> getMultiInner(
+            const std::vector<cb::EngineGetRequest>& requests);
+
     /**
      * Fetch an item only if the specified filter predicate returns true.
      *
@@ -848,6 +861,7 @@ protected:
                                     const AddStatFn& add_stat);
     ENGINE_ERROR_CODE doMemoryStats(const void* cookie,
                                     const AddStatFn& add_stat);
+    void doEngineMetrics(cb::metrics::Collector& collector);
     ENGINE_ERROR_CODE doVBucketStats(const void* cookie,
                                      const AddStatFn& add_stat,
                                      const char* stat_key,
@@ -0,0 +1,30 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "ep_metrics.h"
+
+namespace ep_metrics {
+#define X(id, type, name, help) \
+    const cb::metrics::Definition name{id, cb::metrics::Type::type, #name, help};
+#include "ep_metrics.def"
+#undef X
+
+#define X(id, type, name, help) +1
+const size_t count = 0
+#include "ep_metrics.def"
+        ;
+#undef X
+} // namespace ep_metrics
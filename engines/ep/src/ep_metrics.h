@@ -0,0 +1,32 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/metrics.h>
+
+/**
+ * The definitions of the metrics ep-engine provides through
+ * EngineIface::get_metrics(), one per entry in ep_metrics.def.
+ */
+namespace ep_metrics {
+#define X(id, type, name, help) extern const cb::metrics::Definition name;
+#include "ep_metrics.def"
+#undef X
+
+/// The number of metrics defined
+extern const size_t count;
+} // namespace ep_metrics
@@ -141,7 +141,9 @@ enum get_options_t {
     HIDE_LOCKED_CAS = 0x0020, // whether locked items should have their CAS
     // hidden (return -1).
     GET_DELETED_VALUE = 0x0040, // whether to retrieve value of a deleted item
-    ALLOW_META_ONLY = 0x0080 // Allow only the meta to be returned for an item
+    ALLOW_META_ONLY = 0x0080, // Allow only the meta to be returned for an item
+    OPTIMISTIC_READ = 0x0100 // whether the item may be read without locking
+    // its hash bucket (see HashTable::findForReadOptimistic)
 };
 
 /// Used to identify if QUEUE_BG_FETCH option is set
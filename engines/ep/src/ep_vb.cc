@@ -69,7 +69,8 @@ EPVBucket::EPVBucket(Vbid i,
               lastSnapEnd,
               std::move(table),
               flusherCb,
-              std::make_unique<StoredValueFactory>(st),
+              std::make_unique<StoredValueFactory>(
+                      st, config.getMaxInlineValueSize()),
               std::move(newSeqnoCb),
               syncWriteResolvedCb,
               syncWriteCb,
@@ -117,6 +118,7 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
                 if (v && v->isTempInitialItem()) {
                     ht.unlocked_restoreMeta(
                             res.lock.getHTLock(), *fetchedValue, *v);
+                    removeRestoredKeyFromFilter(*fetchedValue);
                 }
             } else if (status == ENGINE_KEY_ENOENT) {
                 if (v && v->isTempInitialItem()) {
@@ -159,8 +161,12 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
 
             if (restore) {
                 if (status == ENGINE_SUCCESS) {
+                    const bool wasTemp = v->isTempInitialItem();
                     ht.unlocked_restoreValue(
                             res.lock.getHTLock(), *fetchedValue, *v);
+                    if (wasTemp) {
+                        removeRestoredKeyFromFilter(*fetchedValue);
+                    }
                     if (!v->isResident()) {
                         throw std::logic_error(
                                 "VBucket::completeBGFetchForSingleItem: "
@@ -409,6 +415,17 @@ void EPVBucket::completeStatsVKey(const DocKey& key, const GetValue& gcb) {
     }
 }
 
+void EPVBucket::removeRestoredKeyFromFilter(const Item& fetched) {
+    // Under full eviction a key which isn't in the HashTable but exists on
+    // disk was added to the filter when it was evicted (or its deletion
+    // persisted). Now the key is back in memory it no longer needs to be in
+    // the filter, until it is evicted again. A deleted item stays in the
+    // filter, as its temp item may be removed without re-adding the key.
+    if (eviction == EvictionPolicy::Full && !fetched.isDeleted()) {
+        removeFromFilter(fetched.getKey());
+    }
+}
+
 bool EPVBucket::areDeletedItemsAlwaysResident() const {
     // Persistent buckets do not keep all deleted items resident in memory.
     // (They may be *temporarily* resident while a request is in flight asking
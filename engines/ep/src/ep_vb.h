@@ -298,6 +298,12 @@ private:
                        const std::chrono::steady_clock::time_point start,
                        const std::chrono::steady_clock::time_point stop);
 
+    /**
+     * Remove the key of an item restored into the HashTable by a background
+     * fetch (for a key which wasn't in the HashTable) from the filter.
+     */
+    void removeRestoredKeyFromFilter(const Item& fetched);
+
     GetValue getInternalNonResident(const DocKey& key,
                                     const void* cookie,
                                     EventuallyPersistentEngine& engine,
@@ -102,10 +102,14 @@ EphemeralBucket::EphemeralBucket(EventuallyPersistentEngine& theEngine)
              that we are going to use like NRU, FIFO etc. */
     eviction_policy = EvictionPolicy::Value;
 
-    // Create tombstone purger task; it will later be scheduled as necessary
-    // in initialize().
-    tombstonePurgerTask =
-            std::make_shared<EphTombstoneHTCleaner>(&engine, *this);
+    // Create tombstone purger tasks; they will later be scheduled as
+    // necessary in initialize().
+    const auto numPurgerTasks =
+            engine.getConfiguration().getEphemeralMetadataPurgeTasks();
+    for (size_t ii = 0; ii < numPurgerTasks; ++ii) {
+        tombstonePurgerTasks.push_back(std::make_shared<EphTombstoneHTCleaner>(
+                &engine, *this, ii, numPurgerTasks));
+    }
 
     replicationThrottle = std::make_unique<ReplicationThrottleEphe>(
             engine.getConfiguration(), stats);
@@ -160,10 +164,12 @@ void EphemeralBucket::attemptToFreeMemory() {
         wakeUpExpiryPager();
     }
 
-    // Additionally, wake up the tombstone purger to scan for and remove any
+    // Additionally, wake up the tombstone purgers to scan for and remove any
     // tombstones in the HashTable / sequence list.
-    if (tombstonePurgerTask->getState() == TASK_SNOOZED) {
-        ExecutorPool::get()->wake(tombstonePurgerTask->getId());
+    for (auto& task : tombstonePurgerTasks) {
+        if (task->getState() == TASK_SNOOZED) {
+            ExecutorPool::get()->wake(task->getId());
+        }
     }
 }
 
@@ -242,12 +248,16 @@ RollbackResult EphemeralBucket::doRollback(Vbid vbid, uint64_t rollbackSeqno) {
 }
 
 void EphemeralBucket::enableTombstonePurgerTask() {
-    ExecutorPool::get()->cancel(tombstonePurgerTask->getId());
-    ExecutorPool::get()->schedule(tombstonePurgerTask);
+    for (auto& task : tombstonePurgerTasks) {
+        ExecutorPool::get()->cancel(task->getId());
+        ExecutorPool::get()->schedule(task);
+    }
 }
 
 void EphemeralBucket::disableTombstonePurgerTask() {
-    ExecutorPool::get()->cancel(tombstonePurgerTask->getId());
+    for (auto& task : tombstonePurgerTasks) {
+        ExecutorPool::get()->cancel(task->getId());
+    }
 }
 
 void EphemeralBucket::reconfigureForEphemeral(Configuration& config) {
@@ -324,6 +334,24 @@ void EphemeralBucket::appendAggregatedVBucketStats(VBucketCountVisitor& active,
     ARP_STAT("seqlist_stale_metadata_bytes", seqlistStaleMetadataBytes);
 
 #undef ARP_STAT
+
+    // How far behind the tombstone purger is; the worst of its partitions.
+    const auto now = std::chrono::steady_clock::now();
+    std::chrono::milliseconds htCleanerLag{0};
+    std::chrono::milliseconds staleItemDeleterLag{0};
+    for (const auto& task : tombstonePurgerTasks) {
+        htCleanerLag = std::max(htCleanerLag, task->getPassLag(now));
+        staleItemDeleterLag =
+                std::max(staleItemDeleterLag, task->getStaleItemDeleterLag(now));
+    }
+    add_casted_stat("ep_ephemeral_ht_cleaner_lag_ms",
+                    htCleanerLag.count(),
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_ephemeral_stale_item_deleter_lag_ms",
+                    staleItemDeleterLag.count(),
+                    add_stat,
+                    cookie);
 }
 
 EphemeralBucket::NotifyHighPriorityReqTask::NotifyHighPriorityReqTask(
@@ -19,6 +19,7 @@
 #include "kv_bucket.h"
 
 /* Forward declarations */
+class EphTombstoneHTCleaner;
 class RollbackResult;
 
 /**
@@ -149,8 +150,9 @@ protected:
 
     // Protected member variables /////////////////////////////////////////////
 
-    /// Task responsible for purging in-memory tombstones.
-    ExTask tombstonePurgerTask;
+    /// Tasks responsible for purging in-memory tombstones, one per partition
+    /// of the vBuckets (see ephemeral_metadata_purge_tasks).
+    std::vector<std::shared_ptr<EphTombstoneHTCleaner>> tombstonePurgerTasks;
 
 private:
     /**
@@ -29,7 +29,10 @@
 #include <climits>
 
 EphemeralVBucket::HTTombstonePurger::HTTombstonePurger(rel_time_t purgeAge)
-    : now(ep_current_time()), purgeAge(purgeAge), numPurgedItems(0) {
+    : now(ep_current_time()),
+      purgeAge(purgeAge),
+      numPurgedItems(0),
+      numPurgedBytes(0) {
 }
 
 void EphemeralVBucket::HTTombstonePurger::setDeadline(
@@ -56,6 +59,9 @@ bool EphemeralVBucket::HTTombstonePurger::visit(
         // to being owned by the sequence list. Remove by pointer (not by key)
         // so that we do not remove any committed/prepared StoredValues for
         // which there may be two with the same key.
+        // Read the size first: once marked stale the OSV may be freed by the
+        // StaleItemDeleter at any time.
+        const auto purgedBytes = osv->size();
         auto ownedSV = vbucket->ht.unlocked_release(hbl, osv);
         {
             std::lock_guard<std::mutex> listWriteLg(
@@ -66,6 +72,7 @@ bool EphemeralVBucket::HTTombstonePurger::visit(
         }
         ++vbucket->htDeletedPurgeCount;
         ++numPurgedItems;
+        numPurgedBytes += purgedBytes;
     }
     ++numVisitedItems;
 
@@ -77,20 +84,71 @@ bool EphemeralVBucket::HTTombstonePurger::visit(
 void EphemeralVBucket::HTTombstonePurger::clearStats() {
     numVisitedItems = 0;
     numPurgedItems = 0;
+    numPurgedBytes = 0;
+}
+
+/**
+ * Passes on to the wrapped visitor only the vBuckets of one purge partition
+ * (those whose vbid modulo the number of partitions is the partition).
+ */
+class PartitionedVBVisitor : public PauseResumeVBVisitor {
+public:
+    PartitionedVBVisitor(PauseResumeVBVisitor& visitor,
+                         size_t partition,
+                         size_t numPartitions)
+        : visitor(visitor), partition(partition), numPartitions(numPartitions) {
+    }
+
+    bool visit(VBucket& vb) override {
+        if (vb.getId().get() % numPartitions != partition) {
+            return true;
+        }
+        return visitor.visit(vb);
+    }
+
+private:
+    PauseResumeVBVisitor& visitor;
+    const size_t partition;
+    const size_t numPartitions;
+};
+
+/// @return the time elapsed since the given start, zero if not started.
+static std::chrono::milliseconds getElapsed(
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point now) {
+    if (start == std::chrono::steady_clock::time_point() || now < start) {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+}
+
+/// @return the description of a task, qualified by its partition if the
+///         vBuckets are split into more than one.
+static std::string describePartition(std::string description,
+                                     size_t partition,
+                                     size_t numPartitions) {
+    if (numPartitions > 1) {
+        description += " (partition " + std::to_string(partition) + ")";
+    }
+    return description;
 }
 
 EphTombstoneHTCleaner::EphTombstoneHTCleaner(EventuallyPersistentEngine* e,
-                                             EphemeralBucket& bucket)
+                                             EphemeralBucket& bucket,
+                                             size_t partition,
+                                             size_t numPartitions)
     : GlobalTask(e,
                  TaskId::EphTombstoneHTCleaner,
                  e->getConfiguration().getEphemeralMetadataPurgeInterval(),
                  false),
       bucket(bucket),
       bucketPosition(bucket.endPosition()),
-      staleItemDeleterTask(
-              std::make_shared<EphTombstoneStaleItemDeleter>(e, bucket)) {
-    staleItemDeleterTaskId =
-            ExecutorPool::get()->schedule(staleItemDeleterTask);
+      partition(partition),
+      numPartitions(numPartitions),
+      passStart(std::chrono::steady_clock::time_point()),
+      staleItemDeleterTask(std::make_shared<EphTombstoneStaleItemDeleter>(
+              e, bucket, partition, numPartitions)) {
+    ExecutorPool::get()->schedule(staleItemDeleterTask);
 }
 
 bool EphTombstoneHTCleaner::run() {
@@ -102,6 +160,7 @@ bool EphTombstoneHTCleaner::run() {
                 std::make_unique<EphemeralVBucket::HTTombstonePurger>(
                         getDeletedPurgeAge()));
         bucketPosition = bucket.startPosition();
+        passStart = std::chrono::steady_clock::now();
 
         EP_LOG_DEBUG("{} starting with purge age:{}s",
                      getDescription(),
@@ -115,7 +174,8 @@ bool EphTombstoneHTCleaner::run() {
 
     // (re)start visiting.
     auto start = std::chrono::steady_clock::now();
-    bucketPosition = bucket.pauseResumeVisit(*prAdapter, bucketPosition);
+    PartitionedVBVisitor partitionVisitor(*prAdapter, partition, numPartitions);
+    bucketPosition = bucket.pauseResumeVisit(partitionVisitor, bucketPosition);
     auto end = std::chrono::steady_clock::now();
 
     // Check if the visitor completed a full pass.
@@ -124,7 +184,18 @@ bool EphTombstoneHTCleaner::run() {
     auto duration_ms =
             std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
 
+    bytesMarkedStale += visitor.getBytesMarkedStale();
+
     if (!completed) {
+        // Don't wait for the end of the pass to delete the stale items if
+        // enough have been marked stale already.
+        const auto threshold = engine->getConfiguration()
+                                       .getEphemeralMetadataPurgeStaleThreshold();
+        if (threshold > 0 && bytesMarkedStale >= threshold) {
+            bytesMarkedStale = 0;
+            staleItemDeleterTask->wakeup();
+        }
+
         // Schedule to run again asap - note this still yields to the scheduler
         // if there are any higher priority tasks which want to run.
         return true;
@@ -142,13 +213,16 @@ bool EphTombstoneHTCleaner::run() {
             uint64_t(visitor.getNumItemsMarkedStale()),
             uint64_t(getSleepTime()));
 
+    passStart = std::chrono::steady_clock::time_point();
+    bytesMarkedStale = 0;
     snooze(getSleepTime());
-    ExecutorPool::get()->wake(staleItemDeleterTaskId);
+    staleItemDeleterTask->wakeup();
     return true;
 }
 
 std::string EphTombstoneHTCleaner::getDescription() {
-    return "Eph tombstone hashtable cleaner";
+    return describePartition(
+            "Eph tombstone hashtable cleaner", partition, numPartitions);
 }
 
 std::chrono::microseconds EphTombstoneHTCleaner::maxExpectedDuration() {
@@ -174,6 +248,16 @@ size_t EphTombstoneHTCleaner::getDeletedPurgeAge() const {
     return engine->getConfiguration().getEphemeralMetadataPurgeAge();
 }
 
+std::chrono::milliseconds EphTombstoneHTCleaner::getPassLag(
+        std::chrono::steady_clock::time_point now) const {
+    return getElapsed(passStart, now);
+}
+
+std::chrono::milliseconds EphTombstoneHTCleaner::getStaleItemDeleterLag(
+        std::chrono::steady_clock::time_point now) const {
+    return staleItemDeleterTask->getLag(now);
+}
+
 EphemeralVBucket::HTTombstonePurger&
 EphTombstoneHTCleaner::getPurgerVisitor() {
     return dynamic_cast<EphemeralVBucket::HTTombstonePurger&>(
@@ -210,6 +294,11 @@ public:
                                     numVisitedItems++);
                     return !(shouldContinueVisiting);
                 });
+        if (shouldContinueVisiting) {
+            // Done with this vBucket for this pass (a paused vBucket is
+            // visited again when resumed, so is only counted then).
+            remainingStaleBytes += vbucket->seqList->getStaleValueBytes();
+        }
         return shouldContinueVisiting;
     }
 
@@ -217,6 +306,12 @@ public:
         return numItemsDeleted;
     }
 
+    /// Size (in bytes) of the stale items left in the vBuckets visited in
+    /// this pass, once they had been visited.
+    size_t getRemainingStaleBytes() const {
+        return remainingStaleBytes;
+    }
+
     void setDeadline(std::chrono::steady_clock::time_point deadline) {
         progressTracker.setDeadline(deadline);
     }
@@ -240,14 +335,24 @@ protected:
     /// Count of how many items have been visited.
     size_t numVisitedItems = 0;
 
+    /// Size of the stale items left in the visited vBuckets (for the whole
+    /// pass, not cleared by clearStats()).
+    size_t remainingStaleBytes = 0;
+
     /// Indicates if the VB visitor should continue visiting other vbuckets in
     /// the current run
     bool shouldContinueVisiting = true;
 };
 
 EphTombstoneStaleItemDeleter::EphTombstoneStaleItemDeleter(
-        EventuallyPersistentEngine* e, EphemeralBucket& bucket)
+        EventuallyPersistentEngine* e,
+        EphemeralBucket& bucket,
+        size_t partition,
+        size_t numPartitions)
     : GlobalTask(e, TaskId::EphTombstoneStaleItemDeleter, INT_MAX, false),
+      partition(partition),
+      numPartitions(numPartitions),
+      pendingSince(std::chrono::steady_clock::time_point()),
       bucket(bucket),
       bucketPosition(bucket.endPosition()) {
 }
@@ -270,8 +375,9 @@ bool EphTombstoneStaleItemDeleter::run() {
     staleItemDeleteVbVisitor->clearStats();
 
     auto start = std::chrono::steady_clock::now();
-    bucketPosition =
-            bucket.pauseResumeVisit(*staleItemDeleteVbVisitor, bucketPosition);
+    PartitionedVBVisitor partitionVisitor(
+            *staleItemDeleteVbVisitor, partition, numPartitions);
+    bucketPosition = bucket.pauseResumeVisit(partitionVisitor, bucketPosition);
     auto end = std::chrono::steady_clock::now();
 
     // Check if the visitor completed a full pass.
@@ -292,14 +398,40 @@ bool EphTombstoneStaleItemDeleter::run() {
                  staleItemDeleteVbVisitor->getNumItemsDeleted(),
                  duration_ms.count());
 
+    // If the stale items left (because they are still in a range read, or
+    // were marked stale by updates while we were running) exceed the
+    // threshold, run again shortly rather than waiting for the HTCleaner.
+    const auto threshold =
+            engine->getConfiguration().getEphemeralMetadataPurgeStaleThreshold();
+    if (threshold > 0 &&
+        staleItemDeleteVbVisitor->getRemainingStaleBytes() >= threshold) {
+        snooze(1);
+        return true;
+    }
+
     // Completed a full pass, sleep forever - rely on the HTCleaner task to
     // wake us.
+    pendingSince = std::chrono::steady_clock::time_point();
     snooze(INT_MAX);
     return true;
 }
 
 std::string EphTombstoneStaleItemDeleter::getDescription() {
-    return "Eph tombstone stale item deleter";
+    return describePartition(
+            "Eph tombstone stale item deleter", partition, numPartitions);
+}
+
+void EphTombstoneStaleItemDeleter::wakeup() {
+    // Only record when the first of the pending stale items was signalled.
+    auto notPending = std::chrono::steady_clock::time_point();
+    pendingSince.compare_exchange_strong(notPending,
+                                         std::chrono::steady_clock::now());
+    ExecutorPool::get()->wake(getId());
+}
+
+std::chrono::milliseconds EphTombstoneStaleItemDeleter::getLag(
+        std::chrono::steady_clock::time_point now) const {
+    return getElapsed(pendingSince, now);
 }
 
 std::chrono::microseconds EphTombstoneStaleItemDeleter::maxExpectedDuration() {
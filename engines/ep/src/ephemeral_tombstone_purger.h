@@ -60,6 +60,16 @@
  * existing item. As such, EphTombstoneStaleItemDeleter task deletes stale
  * items created in both situations, and isn't strictly limited to purging
  * tombstones.
+ *
+ * The vBuckets of the bucket can be split into a number of partitions
+ * (ephemeral_metadata_purge_tasks, by vbid modulo the number of partitions),
+ * each purged by its own pair of tasks, so that buckets with a high delete
+ * rate can purge on more than one NonIO thread.
+ *
+ * The StaleItemDeleter of a partition normally runs once its HTCleaner has
+ * completed a pass; if ephemeral_metadata_purge_stale_threshold is set it is
+ * also woken as soon as that many bytes have been marked stale, and keeps
+ * running while the stale items of its partition still exceed the threshold.
  */
 #pragma once
 
@@ -68,6 +78,9 @@
 #include "progress_tracker.h"
 #include "vb_visitors.h"
 
+#include <atomic>
+#include <chrono>
+
 class EphemeralBucket;
 class EphTombstoneStaleItemDeleter;
 
@@ -102,6 +115,11 @@ public:
         return numPurgedItems;
     }
 
+    /// Return the size (in bytes) of the items purged from the HashTable.
+    size_t getBytesMarkedStale() const {
+        return numPurgedBytes;
+    }
+
     void clearStats();
 
 protected:
@@ -124,6 +142,9 @@ protected:
 
     /// Count of how many items have been purged.
     size_t numPurgedItems;
+
+    /// Size (in bytes) of the items which have been purged.
+    size_t numPurgedBytes;
 };
 
 /**
@@ -132,8 +153,14 @@ protected:
  */
 class EphTombstoneHTCleaner : public GlobalTask {
 public:
+    /**
+     * @param partition the partition of vBuckets purged by this task
+     * @param numPartitions the number of partitions the vBuckets are split in
+     */
     EphTombstoneHTCleaner(EventuallyPersistentEngine* e,
-                          EphemeralBucket& bucket);
+                          EphemeralBucket& bucket,
+                          size_t partition = 0,
+                          size_t numPartitions = 1);
 
     bool run() override;
 
@@ -141,6 +168,25 @@ public:
 
     std::chrono::microseconds maxExpectedDuration() override;
 
+    /**
+     * @return how long the current pass of this task has been running for
+     *         (zero if it isn't part way through a pass).
+     */
+    std::chrono::milliseconds getPassLag(
+            std::chrono::steady_clock::time_point now) const;
+
+    /**
+     * @return how long the stale items of this task's partition have been
+     *         waiting for the StaleItemDeleter (zero if none are).
+     */
+    std::chrono::milliseconds getStaleItemDeleterLag(
+            std::chrono::steady_clock::time_point now) const;
+
+    /// @return the paired StaleItemDeleter task. Exposed for testing.
+    EphTombstoneStaleItemDeleter& getStaleItemDeleterTask() {
+        return *staleItemDeleterTask;
+    }
+
 private:
     /// How long should each chunk of HT cleaning run for?
     std::chrono::milliseconds getChunkDuration() const;
@@ -167,11 +213,20 @@ private:
      */
     std::unique_ptr<PauseResumeVBAdapter> prAdapter;
 
+    /// The partition of vBuckets purged by this task.
+    const size_t partition;
+
+    /// The number of partitions the vBuckets are split in.
+    const size_t numPartitions;
+
+    /// When the current pass started; default (epoch) if not in a pass.
+    std::atomic<std::chrono::steady_clock::time_point> passStart;
+
+    /// Bytes marked stale since the StaleItemDeleter was last woken.
+    size_t bytesMarkedStale = 0;
+
     /// Second paired task which deletes stale items from the sequenceList.
     std::shared_ptr<EphTombstoneStaleItemDeleter> staleItemDeleterTask;
-
-    /// TaskId for StaleItemDeleter registered with executorpool.
-    size_t staleItemDeleterTaskId;
 };
 
 /**
@@ -183,7 +238,9 @@ private:
 class EphTombstoneStaleItemDeleter : public GlobalTask {
 public:
     EphTombstoneStaleItemDeleter(EventuallyPersistentEngine* e,
-                                 EphemeralBucket& bucket);
+                                 EphemeralBucket& bucket,
+                                 size_t partition = 0,
+                                 size_t numPartitions = 1);
 
     bool run() override;
 
@@ -191,10 +248,27 @@ public:
 
     std::chrono::microseconds maxExpectedDuration() override;
 
+    /// Wake the task, to delete the items which have been marked stale.
+    void wakeup();
+
+    /// @see EphTombstoneHTCleaner::getStaleItemDeleterLag
+    std::chrono::milliseconds getLag(
+            std::chrono::steady_clock::time_point now) const;
+
 private:
     /// How long should each chunk of stale item deleter run for?
     std::chrono::milliseconds getChunkDuration() const;
 
+    /// The partition of vBuckets purged by this task.
+    const size_t partition;
+
+    /// The number of partitions the vBuckets are split in.
+    const size_t numPartitions;
+
+    /// When the task was first woken (and not since completed a pass) to
+    /// delete stale items; default (epoch) if there are none waiting.
+    std::atomic<std::chrono::steady_clock::time_point> pendingSince;
+
     /// The bucket we are associated with.
     EphemeralBucket& bucket;
 
@@ -138,7 +138,7 @@ bool EphemeralVBucket::eligibleToPageOut(const HashTable::HashBucketLock& lh,
     if (getState() != vbucket_state_active) {
         return false;
     }
-    if (v.isDeleted() && !v.getValue()) {
+    if (v.isDeleted() && !v.hasValue()) {
         // If the item has already been deleted (and doesn't have a value
         // associated with it) then there's no further deletion possible,
         // until the deletion marker (tombstone) is later purged at the
@@ -28,7 +28,9 @@
 
 #include <logtags.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <cstring>
+#include <random>
 
 static const ssize_t prime_size_table[] = {
     3, 7, 13, 23, 47, 97, 193, 383, 769, 1531, 3079, 6143, 12289, 24571, 49157,
@@ -178,7 +180,7 @@ void HashTable::clear(bool deactivate) {
                     "non-active object");
         }
     }
-    MultiLockHolder mlh(mutexes);
+    MultiLockHolder<BucketMutex> mlh(mutexes);
     clear_UNLOCKED(deactivate);
 }
 
@@ -195,6 +197,10 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
             auto v = std::move(values[i]);
             clearedMemSize += v->size();
             clearedValSize += v->valuelen();
+            const auto cid = v->getKey().getCollectionID();
+            if (!cid.isSystem()) {
+                stats.collectionMemoryChanged(cid, -int64_t(v->size()));
+            }
             values[i] = std::move(v->getNext());
         }
     }
@@ -269,7 +275,7 @@ void HashTable::resize(size_t newSize) {
     TRACE_EVENT2(
             "HashTable", "resize", "size", size.load(), "newSize", newSize);
 
-    MultiLockHolder mlh(mutexes);
+    MultiLockHolder<BucketMutex> mlh(mutexes);
     if (visitors.load() > 0) {
         // Do not allow a resize while any visitors are actually
         // processing.  The next attempt will have to pick it up.  New
@@ -315,11 +321,17 @@ HashTable::FindInnerResult HashTable::findInner(const DocKey& key) {
                 "non-active object");
     }
     HashBucketLock hbl = getLockedBucket(key);
+    auto found = findInBucket(hbl.getBucketNum(), key);
+    return {std::move(hbl), found.first, found.second};
+}
+
+std::pair<StoredValue*, StoredValue*> HashTable::findInBucket(
+        int bucketNum, const DocKey& key) {
     // Scan through all elements in the hash bucket chain looking for Committed
     // and Pending items with the same key.
     StoredValue* foundCmt = nullptr;
     StoredValue* foundPend = nullptr;
-    for (StoredValue* v = values[hbl.getBucketNum()].get().get(); v;
+    for (StoredValue* v = values[bucketNum].get().get(); v;
          v = v->getNext().get().get()) {
         if (v->hasKey(key)) {
             if (v->isPending() || v->isCompleted()) {
@@ -331,8 +343,7 @@ HashTable::FindInnerResult HashTable::findInner(const DocKey& key) {
             }
         }
     }
-
-    return {std::move(hbl), foundCmt, foundPend};
+    return {foundCmt, foundPend};
 }
 
 std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
@@ -441,7 +452,8 @@ HashTable::Statistics::StoredValueProperties::StoredValueProperties(
     isResident = sv->isResident();
     isDeleted = sv->isDeleted();
     isTempItem = sv->isTempItem();
-    isSystemItem = sv->getKey().getCollectionID().isSystem();
+    collection = sv->getKey().getCollectionID();
+    isSystemItem = collection.isSystem();
     isPreparedSyncWrite = sv->isPending() || sv->isCompleted();
 }
 
@@ -461,6 +473,12 @@ void HashTable::Statistics::epilogue(StoredValueProperties pre,
     if (pre.size != post.size) {
         cacheSize.fetch_add(post.size - pre.size);
         memSize.fetch_add(post.size - pre.size);
+        // System events are not attributed to any collection.
+        const auto& props = post.isValid ? post : pre;
+        if (!props.isSystemItem) {
+            epStats.collectionMemoryChanged(props.collection,
+                                            post.size - pre.size);
+        }
     }
     if (pre.metaDataSize != post.metaDataSize) {
         metaDataMemory.fetch_add(post.metaDataSize - pre.metaDataSize);
@@ -667,6 +685,69 @@ HashTable::FindROResult HashTable::findForRead(
     return {sv, std::move(result.lock)};
 }
 
+HashTable::FindOptimisticResult HashTable::findForReadOptimistic(
+        const DocKey& key, WantsDeleted wantsDeleted) {
+    if (!isActive()) {
+        throw std::logic_error(
+                "HashTable::findForReadOptimistic: Cannot call on a "
+                "non-active object");
+    }
+    const int hash = key.hash();
+    const int bucket = getBucketForHash(hash);
+    auto& mutex = mutexes[mutexForBucket(bucket)];
+    if (!mutex.tryBeginRead()) {
+        return {nullptr, {}};
+    }
+    OptimisticReadLock lock(mutex);
+    if (bucket != getBucketForHash(hash)) {
+        // Resized before we started reading; the key is now in another
+        // bucket.
+        return {nullptr, {}};
+    }
+
+    // As findForRead() - a pending SV which is MaybeVisible blocks reading.
+    auto found = findInBucket(bucket, key);
+    if (found.second && found.second->isPreparedMaybeVisible()) {
+        return {found.second, std::move(lock)};
+    }
+    auto* sv = found.first;
+    if (sv && sv->isDeleted() && wantsDeleted == WantsDeleted::No) {
+        sv = nullptr;
+    }
+    return {sv, std::move(lock)};
+}
+
+void HashTable::trackOptimisticRead(const DocKey& key,
+                                    FindOptimisticResult& result) {
+    auto* sv = const_cast<StoredValue*>(result.storedValue);
+    result.storedValue = nullptr;
+    if (!result.lock.owns_lock() || !sv || sv->isDeleted() ||
+        !sv->isCommitted()) {
+        result.lock.unlock();
+        return;
+    }
+
+    // The NRU bits are atomic, so can be updated by concurrent readers.
+    sv->referenced();
+
+    // The frequency counter isn't (it is in the tag of the value pointer), so
+    // any increment is made once the read has ended, under the lock.
+    const auto counter = sv->getFreqCounterValue();
+    const auto newCounter = generateFreqValue(counter);
+    result.lock.unlock();
+    if (newCounter == counter) {
+        return;
+    }
+
+    auto res = findInner(key);
+    if (res.committedSV && res.committedSV->getFreqCounterValue() == counter) {
+        res.committedSV->setFreqCounterValue(newCounter);
+        if (newCounter == std::numeric_limits<uint8_t>::max()) {
+            frequencyCounterSaturated();
+        }
+    }
+}
+
 HashTable::FindResult HashTable::findForWrite(const DocKey& key,
                                               WantsDeleted wantsDeleted) {
     auto result = findInner(key);
@@ -902,7 +983,7 @@ void HashTable::dump() const {
 }
 
 nlohmann::json HashTable::dumpStoredValuesAsJson() const {
-    MultiLockHolder mlh(mutexes);
+    MultiLockHolder<BucketMutex> mlh(mutexes);
     auto obj = nlohmann::json::array();
     for (const auto& chain : values) {
         if (chain) {
@@ -927,6 +1008,15 @@ void HashTable::storeCompressedBuffer(cb::const_char_buffer buf,
     valueStats.epilogue(preProps, &v);
 }
 
+void HashTable::storeDictionaryCompressedBuffer(cb::const_char_buffer buf,
+                                                StoredValue& v) {
+    const auto preProps = valueStats.prologue(&v);
+
+    v.storeDictionaryCompressedBuffer(buf);
+
+    valueStats.epilogue(preProps, &v);
+}
+
 void HashTable::visit(HashTableVisitor& visitor) {
     HashTable::Position ht_pos;
     while (ht_pos != endPosition()) {
@@ -942,7 +1032,7 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
     // Acquire one (any) of the mutexes before incrementing {visitors}, this
     // prevents any race between this visitor and the HashTable resizer.
     // See comments in pauseResumeVisit() for further details.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    std::unique_lock<BucketMutex> lh(mutexes[0]);
     VisitorTracker vt(&visitors);
     lh.unlock();
 
@@ -950,7 +1040,7 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
         for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
             // (re)acquire mutex on each HashBucket, to minimise any impact
             // on front-end threads.
-            LockHolder lh(mutexes[l]);
+            std::lock_guard<BucketMutex> lh(mutexes[l]);
 
             size_t depth = 0;
             StoredValue* p = values[i].get().get();
@@ -978,6 +1068,49 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
     }
 }
 
+size_t HashTable::visitSample(HashTableVisitor& visitor,
+                              size_t maxItems,
+                              uint64_t seed) {
+    if ((valueStats.getNumItems() + valueStats.getNumTempItems()) == 0 ||
+        !isActive() || maxItems == 0) {
+        return 0;
+    }
+
+    // As per pauseResumeVisit(); register as a visitor so the table cannot be
+    // resized (and the bucket indices picked below invalidated) meanwhile.
+    std::unique_lock<BucketMutex> lh(mutexes[0]);
+    VisitorTracker vt(&visitors);
+    lh.unlock();
+
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<size_t> dist(0, size - 1);
+
+    // Bound the number of buckets probed so a sparsely populated table
+    // cannot keep us here for long.
+    const size_t maxProbes = std::max(maxItems * 4, size_t(64));
+    size_t visited = 0;
+    bool paused = false;
+    for (size_t probe = 0;
+         isActive() && !paused && visited < maxItems && probe < maxProbes;
+         ++probe) {
+        const size_t hash_bucket = dist(gen);
+        visitor.setUpHashBucketVisit();
+        {
+            HashBucketLock lh(hash_bucket,
+                              mutexes[mutexForBucket(hash_bucket)]);
+            StoredValue* v = values[hash_bucket].get().get();
+            while (!paused && v) {
+                StoredValue* tmp = v->getNext().get().get();
+                paused = !visitor.visit(lh, *v);
+                ++visited;
+                v = tmp;
+            }
+        }
+        visitor.tearDownHashBucketVisit();
+    }
+    return visited;
+}
+
 HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
                                                 Position& start_pos) {
     if ((valueStats.getNumItems() + valueStats.getNumTempItems()) == 0 ||
@@ -999,7 +1132,7 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
     // inside the inner for() loop. To prevent this race, we explicitly acquire
     // (any) mutex, increment {visitors} and then release the mutex. This
     //avoids the race as if visitors >0 then Resizer will not attempt to resize.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    std::unique_lock<BucketMutex> lh(mutexes[0]);
     VisitorTracker vt(&visitors);
     lh.unlock();
 
@@ -1118,7 +1251,7 @@ std::unique_ptr<Item> HashTable::getRandomKeyFromSlot(int slot) {
 }
 
 bool HashTable::unlocked_restoreValue(
-        const std::unique_lock<std::mutex>& htLock,
+        const std::unique_lock<BucketMutex>& htLock,
         const Item& itm,
         StoredValue& v) {
     if (!htLock || !isActive() || v.isResident()) {
@@ -1134,9 +1267,10 @@ bool HashTable::unlocked_restoreValue(
     return true;
 }
 
-void HashTable::unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
-                                     const Item& itm,
-                                     StoredValue& v) {
+void HashTable::unlocked_restoreMeta(
+        const std::unique_lock<BucketMutex>& htLock,
+        const Item& itm,
+        StoredValue& v) {
     if (!htLock) {
         throw std::invalid_argument(
                 "HashTable::unlocked_restoreMeta: htLock "
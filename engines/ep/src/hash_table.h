@@ -24,7 +24,10 @@
 #include <platform/non_negative_counter.h>
 
 #include <array>
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <thread>
 
 class AbstractStoredValueFactory;
 class HashTableVisitor;
@@ -246,6 +249,8 @@ public:
             bool isTempItem = false;
             bool isSystemItem = false;
             bool isPreparedSyncWrite = false;
+            // Collection of the item; only meaningful if isValid.
+            CollectionID collection = CollectionID::Default;
         };
 
         /**
@@ -378,6 +383,61 @@ public:
         EPStats& epStats;
     };
 
+    /**
+     * The mutex guarding a set of hash buckets (see mutexForBucket()).
+     *
+     * Besides being locked for exclusive access (by HashBucketLock), it
+     * allows optimistic readers (see findForReadOptimistic()) to read the
+     * buckets without locking the mutex, and without blocking each other.
+     * A reader registers itself in a count of readers and only proceeds if
+     * the mutex isn't locked; whoever locks the mutex marks it as locked and
+     * then waits for the readers already registered to finish. Hence the
+     * StoredValues of the buckets can't be modified or freed while a reader
+     * reads them.
+     */
+    class BucketMutex {
+    public:
+        void lock() {
+            mutex.lock();
+            // Sequentially consistent, so either a reader registering now
+            // sees the mutex is locked, or we see the reader.
+            locked.store(true);
+            while (readers.load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+
+        void unlock() {
+            locked.store(false, std::memory_order_release);
+            mutex.unlock();
+        }
+
+        /**
+         * Register an optimistic reader.
+         *
+         * @return true if the reader may read the buckets until it calls
+         *         endRead(); false if the mutex is locked (and the reader
+         *         isn't registered).
+         */
+        bool tryBeginRead() {
+            readers.fetch_add(1);
+            if (locked.load()) {
+                readers.fetch_sub(1, std::memory_order_release);
+                return false;
+            }
+            return true;
+        }
+
+        void endRead() {
+            readers.fetch_sub(1, std::memory_order_release);
+        }
+
+    private:
+        std::mutex mutex;
+        std::atomic<bool> locked{false};
+        std::atomic<uint32_t> readers{0};
+    };
+
     /**
      * Represents a locked hash bucket that provides RAII semantics for the lock
      *
@@ -389,7 +449,7 @@ public:
         HashBucketLock()
             : bucketNum(-1) {}
 
-        HashBucketLock(int bucketNum, std::mutex& mutex)
+        HashBucketLock(int bucketNum, BucketMutex& mutex)
             : bucketNum(bucketNum), htLock(mutex) {
         }
 
@@ -411,17 +471,63 @@ public:
             return bucketNum;
         }
 
-        const std::unique_lock<std::mutex>& getHTLock() const {
+        const std::unique_lock<BucketMutex>& getHTLock() const {
             return htLock;
         }
 
-        std::unique_lock<std::mutex>& getHTLock() {
+        std::unique_lock<BucketMutex>& getHTLock() {
             return htLock;
         }
 
     private:
         int bucketNum;
-        std::unique_lock<std::mutex> htLock;
+        std::unique_lock<BucketMutex> htLock;
+    };
+
+    /**
+     * An optimistic read of a hash bucket (see findForReadOptimistic()),
+     * with RAII semantics: the StoredValues of the bucket may be read (but
+     * not modified) while it owns the read.
+     */
+    class OptimisticReadLock {
+    public:
+        OptimisticReadLock() = default;
+
+        explicit OptimisticReadLock(BucketMutex& mutex) : mutex(&mutex) {
+        }
+
+        OptimisticReadLock(OptimisticReadLock&& other) : mutex(other.mutex) {
+            other.mutex = nullptr;
+        }
+
+        OptimisticReadLock& operator=(OptimisticReadLock&& other) {
+            unlock();
+            mutex = other.mutex;
+            other.mutex = nullptr;
+            return *this;
+        }
+
+        // Cannot copy OptimisticReadLock.
+        OptimisticReadLock(const OptimisticReadLock& other) = delete;
+        OptimisticReadLock& operator=(const OptimisticReadLock& other) = delete;
+
+        ~OptimisticReadLock() {
+            unlock();
+        }
+
+        bool owns_lock() const {
+            return mutex != nullptr;
+        }
+
+        void unlock() {
+            if (mutex) {
+                mutex->endRead();
+                mutex = nullptr;
+            }
+        }
+
+    private:
+        BucketMutex* mutex = nullptr;
     };
 
     /**
@@ -442,7 +548,7 @@ public:
     size_t memorySize() {
         return sizeof(HashTable)
             + (size * sizeof(StoredValue*))
-            + (mutexes.size() * sizeof(std::mutex));
+            + (mutexes.size() * sizeof(BucketMutex));
     }
 
     /**
@@ -633,6 +739,51 @@ public:
             WantsDeleted wantsDeleted = WantsDeleted::No,
             ForGetReplicaOp fetchRequestedForReplicaItem = ForGetReplicaOp::No);
 
+    /**
+     * Result of the findForReadOptimistic() method.
+     */
+    struct FindOptimisticResult {
+        /// If find successful then pointer to found StoredValue; else nullptr.
+        const StoredValue* storedValue;
+        /**
+         * The optimistic read of the key's hash bucket. If it doesn't own
+         * the read (because the bucket was locked) nothing was looked up,
+         * and the caller should use findForRead() instead.
+         */
+        OptimisticReadLock lock;
+    };
+
+    /**
+     * Find an item with the specified key for read-only access, without
+     * locking its hash bucket (so concurrent readers of the bucket don't
+     * serialise on its lock).
+     *
+     * Finds the same StoredValue as findForRead(key, TrackReference::No,
+     * wantsDeleted); the StoredValue may only be read (not modified) while
+     * the returned lock is held, as other readers may read it concurrently.
+     * Use trackOptimisticRead() to track the reference of the read.
+     *
+     * @param key The key of the item to find
+     * @param wantsDeleted whether a deleted value needs to be returned
+     * @return A FindOptimisticResult consisting of:
+     *         - a pointer to a StoredValue -- NULL if not found
+     *         - the optimistic read of the key's hash bucket, which does not
+     *           own the read if the bucket was locked.
+     */
+    FindOptimisticResult findForReadOptimistic(
+            const DocKey& key, WantsDeleted wantsDeleted = WantsDeleted::No);
+
+    /**
+     * Track the reference to the StoredValue found by
+     * findForReadOptimistic() (as findForRead() does for
+     * TrackReference::Yes), ending the optimistic read.
+     *
+     * @param key The key which was found
+     * @param result The result of findForReadOptimistic(); its lock is
+     *        released.
+     */
+    void trackOptimisticRead(const DocKey& key, FindOptimisticResult& result);
+
     /**
      * Result of the findFor...() methods which return a non-const result.
      */
@@ -953,6 +1104,17 @@ public:
      */
     void storeCompressedBuffer(cb::const_char_buffer buf, StoredValue& v);
 
+    /**
+     * Store the given buffer compressed with a CompressionDictionary as a
+     * value in the given StoredValue
+     *
+     * @param buf buffer holding compressed data
+     * @param v   StoredValue in which compressed data has
+     *            to be stored
+     */
+    void storeDictionaryCompressedBuffer(cb::const_char_buffer buf,
+                                         StoredValue& v);
+
     /**
      * Result of an Update operation.
      */
@@ -1112,6 +1274,22 @@ public:
      */
     void visitDepth(HashTableDepthVisitor &visitor);
 
+    /**
+     * Visit a random sample of the items in this hashtable. Hash buckets
+     * are picked uniformly at random and every item in a picked bucket is
+     * visited, so each item is equally likely to be sampled. Visiting stops
+     * once at least maxItems items have been visited, the visitor pauses,
+     * or a bounded number of (possibly empty) buckets have been probed.
+     *
+     * @param visitor The visitor object to use.
+     * @param maxItems The number of items to sample.
+     * @param seed Seed for picking the hash buckets to visit.
+     * @return The number of items visited.
+     */
+    size_t visitSample(HashTableVisitor& visitor,
+                       size_t maxItems,
+                       uint64_t seed);
+
     /**
      * Visit the items in this hashtable, starting the iteration from the
      * given startPosition and allowing the visit to be paused at any point.
@@ -1189,7 +1367,7 @@ public:
      *
      * @return true if restored; else false
      */
-    bool unlocked_restoreValue(const std::unique_lock<std::mutex>& htLock,
+    bool unlocked_restoreValue(const std::unique_lock<BucketMutex>& htLock,
                                const Item& itm,
                                StoredValue& v);
 
@@ -1202,7 +1380,7 @@ public:
      * @param itm the Item whose metadata is being restored
      * @param v corresponding StoredValue
      */
-    void unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
+    void unlocked_restoreMeta(const std::unique_lock<BucketMutex>& htLock,
                               const Item& itm,
                               StoredValue& v);
 
@@ -1330,6 +1508,16 @@ private:
         StoredValue* pendingSV;
     };
 
+    /**
+     * Find the committed/pending item(s) with the given key in the chain of
+     * the given hash bucket, which the caller must have locked (or be
+     * reading optimistically).
+     *
+     * @return the Committed and Pending StoredValues (nullptr if not found)
+     */
+    std::pair<StoredValue*, StoredValue*> findInBucket(int bucketNum,
+                                                       const DocKey& key);
+
     /**
      * Find the committed/pending item(s) with the given key.
      *
@@ -1357,7 +1545,7 @@ private:
     std::atomic<size_t> size;
     table_type values;
     // Mutable so that we can make dumpStoredValuesAsJson const
-    mutable std::vector<std::mutex> mutexes;
+    mutable std::vector<BucketMutex> mutexes;
     EPStats&             stats;
     std::unique_ptr<AbstractStoredValueFactory> valFact;
     std::atomic<size_t>       visitors;
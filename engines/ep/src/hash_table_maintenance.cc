@@ -0,0 +1,362 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "hash_table_maintenance.h"
+
+#include "bucket_logger.h"
+#include "defragmenter.h"
+#include "defragmenter_visitor.h"
+#include "ep_engine.h"
+#include "executorpool.h"
+#include "item_compressor_visitor.h"
+#include "item_freq_decayer_visitor.h"
+#include "kv_bucket.h"
+#include "stored-value.h"
+#include "vb_visitors.h"
+#include <memcached/server_allocator_iface.h>
+#include <phosphor/phosphor.h>
+
+#include <algorithm>
+
+static std::string to_string(HashTableMaintenanceTask::ActionType type) {
+    switch (type) {
+    case HashTableMaintenanceTask::ActionType::Decay:
+        return "decay";
+    case HashTableMaintenanceTask::ActionType::Compress:
+        return "compress";
+    case HashTableMaintenanceTask::ActionType::Defragment:
+        return "defragment";
+    }
+    return "invalid";
+}
+
+HashTableMaintenanceTask::HashTableMaintenanceTask(
+        EventuallyPersistentEngine* e, EPStats& stats_, bool defragment)
+    : GlobalTask(e, TaskId::HashTableMaintenanceTask, 0, false),
+      stats(stats_),
+      compressor(std::make_unique<ItemCompressorVisitor>()),
+      decayAction(ActionType::Decay, engine->getKVBucket()->startPosition()),
+      compressAction(ActionType::Compress,
+                     engine->getKVBucket()->startPosition()),
+      defragmentAction(ActionType::Defragment,
+                       engine->getKVBucket()->startPosition()),
+      prAdapter(std::make_unique<PauseResumeVBAdapter>(
+              std::make_unique<FusedHTVisitor>())) {
+    if (defragment) {
+        defragmenter = std::make_unique<DefragmentVisitor>(
+                DefragmenterTask::getMaxValueSize(
+                        engine->getServerApi()->alloc_hooks));
+    }
+}
+
+HashTableMaintenanceTask::~HashTableMaintenanceTask() = default;
+
+bool HashTableMaintenanceTask::run() {
+    TRACE_EVENT0("ep-engine/task", "HashTableMaintenanceTask");
+    if (engine->getConfiguration().isHashTableFusedScan()) {
+        auto due = getDueActions(std::chrono::steady_clock::now());
+        while (!due.empty()) {
+            // Visit the due actions which have reached the same position as
+            // the first one together, leaving the others for the next chunk.
+            std::vector<Action*> actions;
+            std::vector<Action*> others;
+            for (auto* action : due) {
+                if (action->samePosition(*due.front())) {
+                    actions.push_back(action);
+                } else {
+                    others.push_back(action);
+                }
+            }
+            runChunk(actions);
+            due = std::move(others);
+        }
+    }
+
+    snooze(getSleepTime());
+    if (engine->getEpStats().isShutdown) {
+        return false;
+    }
+    return true;
+}
+
+std::vector<HashTableMaintenanceTask::Action*>
+HashTableMaintenanceTask::getDueActions(
+        std::chrono::steady_clock::time_point now) {
+    auto& config = engine->getConfiguration();
+    std::vector<Action*> due;
+    if (decayRequested && now >= decayAction.nextChunk) {
+        due.push_back(&decayAction);
+    }
+    if (engine->getCompressionMode() == BucketCompressionMode::Active &&
+        now >= compressAction.nextChunk) {
+        due.push_back(&compressAction);
+    }
+    // Must be the last action as it may reallocate the StoredValue
+    if (defragmenter && config.isDefragmenterEnabled() &&
+        now >= defragmentAction.nextChunk) {
+        due.push_back(&defragmentAction);
+    }
+    return due;
+}
+
+void HashTableMaintenanceTask::runChunk(const std::vector<Action*>& actions) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<VBucketAwareHTVisitor*> visitors;
+    bool defragment = false;
+    for (auto* action : actions) {
+        prepare(*action, start);
+        visitors.push_back(&getVisitor(action->type));
+        defragment |= action->type == ActionType::Defragment;
+    }
+    dynamic_cast<FusedHTVisitor&>(prAdapter->getHTVisitor())
+            .setActions(std::move(visitors));
+
+    // Resume from where the actions paused.
+    auto& leader = *actions.front();
+    prAdapter->setResumePosition(leader.resumeVBucket, leader.htPosition);
+
+    // Disable thread-caching when defragmenting (we don't want any of the
+    // new Blobs in tcache).
+    ServerAllocatorIface* alloc_hooks = engine->getServerApi()->alloc_hooks;
+    bool old_tcache = false;
+    if (defragment) {
+        old_tcache = alloc_hooks->enable_thread_cache(false);
+    }
+
+    const auto position = engine->getKVBucket()->pauseResumeVisit(
+            *prAdapter, leader.epstorePosition);
+    const auto end = std::chrono::steady_clock::now();
+
+    if (defragment) {
+        alloc_hooks->enable_thread_cache(old_tcache);
+        alloc_hooks->release_free_memory();
+    }
+
+    // Check if the visitor completed a full pass.
+    const bool completed = (position == engine->getKVBucket()->endPosition());
+
+    std::string visited;
+    for (auto* action : actions) {
+        if (completed) {
+            // Start the next pass from the beginning
+            action->epstorePosition = engine->getKVBucket()->startPosition();
+            action->resumeVBucket = Vbid(0);
+            action->htPosition = HashTable::Position();
+        } else {
+            action->epstorePosition = position;
+            action->resumeVBucket = prAdapter->getResumeVBucket();
+            action->htPosition = prAdapter->getHashtablePosition();
+        }
+        finish(*action, end, completed);
+        visited += std::string(visited.empty() ? "" : ",") +
+                   to_string(action->type);
+    }
+
+    EP_LOG_DEBUG(
+            "{} for bucket '{}' {} (actions:{}). Took {} us. mem_used={}",
+            getDescription(),
+            engine->getName(),
+            completed ? "finished" : "paused",
+            visited,
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+                    .count(),
+            stats.getEstimatedTotalMemoryUsed());
+}
+
+void HashTableMaintenanceTask::prepare(
+        Action& action, std::chrono::steady_clock::time_point start) {
+    auto& config = engine->getConfiguration();
+    const auto deadline = start + getChunkDuration(action.type);
+    switch (action.type) {
+    case ActionType::Decay:
+        if (!decayer) {
+            decayer = std::make_unique<ItemFreqDecayerVisitor>(
+                    config.getItemFreqDecayerPercent());
+        }
+        decayer->setDeadline(deadline);
+        decayer->clearStats();
+        return;
+    case ActionType::Compress:
+        compressor->setDeadline(deadline);
+        compressor->clearStats();
+        compressor->setCompressionMode(engine->getCompressionMode());
+        compressor->setMinCompressionRatio(engine->getMinCompressionRatio());
+        compressor->setDictionaries(
+                engine->getKVBucket()->getCompressionDictionaries());
+        return;
+    case ActionType::Defragment:
+        defragmenter->setDeadline(deadline);
+        defragmenter->setBlobAgeThreshold(
+                config.getDefragmenterAgeThreshold());
+        // Only defragment StoredValues of persistent buckets (see
+        // DefragmenterTask::run)
+        if (config.getBucketType() == "persistent") {
+            defragmenter->setStoredValueAgeThreshold(
+                    config.getDefragmenterStoredValueAgeThreshold());
+        }
+        defragmenter->clearStats();
+        return;
+    }
+    throw std::logic_error("HashTableMaintenanceTask::prepare: invalid type " +
+                           std::to_string(int(action.type)));
+}
+
+void HashTableMaintenanceTask::finish(Action& action,
+                                      std::chrono::steady_clock::time_point end,
+                                      bool completed) {
+    auto& config = engine->getConfiguration();
+    switch (action.type) {
+    case ActionType::Decay:
+        ++stats.freqDecayerRuns;
+        // Like the ItemFreqDecayerTask, carry on until the pass is complete
+        action.nextChunk = end;
+        if (completed) {
+            // The percentage is read again for the next pass
+            decayer.reset();
+            decayRequested = false;
+        }
+        return;
+    case ActionType::Compress:
+        stats.compressorNumCompressed.fetch_add(
+                compressor->getCompressedCount());
+        stats.compressorNumVisited.fetch_add(compressor->getVisitedCount());
+        action.nextChunk = end + std::chrono::milliseconds(
+                                         config.getItemCompressorInterval());
+        // Train the dictionaries of the collections sampled during the pass
+        if (completed) {
+            auto visitedCollections = compressor->takeVisitedCollections();
+            if (engine->getKVBucket()->getCompressionDictionaries()) {
+                engine->getKVBucket()->itemCompressorPassCompleted(
+                        visitedCollections);
+            }
+        }
+        return;
+    case ActionType::Defragment:
+        stats.defragNumMoved.fetch_add(defragmenter->getDefragCount());
+        stats.defragStoredValueNumMoved.fetch_add(
+                defragmenter->getStoredValueDefragCount());
+        stats.defragNumVisited.fetch_add(defragmenter->getVisitedCount());
+        action.nextChunk =
+                end + std::chrono::duration_cast<
+                              std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(
+                                      config.getDefragmenterInterval()));
+        return;
+    }
+    throw std::logic_error("HashTableMaintenanceTask::finish: invalid type " +
+                           std::to_string(int(action.type)));
+}
+
+VBucketAwareHTVisitor& HashTableMaintenanceTask::getVisitor(ActionType type) {
+    switch (type) {
+    case ActionType::Decay:
+        return *decayer;
+    case ActionType::Compress:
+        return *compressor;
+    case ActionType::Defragment:
+        return *defragmenter;
+    }
+    throw std::logic_error(
+            "HashTableMaintenanceTask::getVisitor: invalid type " +
+            std::to_string(int(type)));
+}
+
+void HashTableMaintenanceTask::stop() {
+    if (uid) {
+        ExecutorPool::get()->cancel(uid);
+    }
+}
+
+void HashTableMaintenanceTask::wakeupDecayer() {
+    bool expected = false;
+    if (decayRequested.compare_exchange_strong(expected, true)) {
+        ExecutorPool::get()->wake(getId());
+    }
+}
+
+bool HashTableMaintenanceTask::isPassInProgress(ActionType type) const {
+    const Action start(type, engine->getKVBucket()->startPosition());
+    switch (type) {
+    case ActionType::Decay:
+        return !decayAction.samePosition(start);
+    case ActionType::Compress:
+        return !compressAction.samePosition(start);
+    case ActionType::Defragment:
+        return !defragmentAction.samePosition(start);
+    }
+    throw std::logic_error(
+            "HashTableMaintenanceTask::isPassInProgress: invalid type " +
+            std::to_string(int(type)));
+}
+
+std::string HashTableMaintenanceTask::getDescription() {
+    return "HashTable maintenance";
+}
+
+std::chrono::microseconds HashTableMaintenanceTask::maxExpectedDuration() {
+    // Each chunk is constrained by the shortest chunk duration of the
+    // actions included; apply the same headroom as the individual tasks.
+    return std::max({getChunkDuration(ActionType::Decay),
+                     getChunkDuration(ActionType::Compress),
+                     getChunkDuration(ActionType::Defragment)}) *
+           10;
+}
+
+double HashTableMaintenanceTask::getSleepTime() const {
+    auto& config = engine->getConfiguration();
+    // Wake up often enough to notice the fused scan (or compression) being
+    // enabled
+    double sleepTime = config.getItemCompressorInterval() * 0.001;
+    if (!config.isHashTableFusedScan()) {
+        return sleepTime;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto untilDue = [now](std::chrono::steady_clock::time_point next) {
+        return std::max(0.0,
+                        std::chrono::duration<double>(next - now).count());
+    };
+    if (decayRequested) {
+        sleepTime = std::min(sleepTime, untilDue(decayAction.nextChunk));
+    }
+    if (engine->getCompressionMode() == BucketCompressionMode::Active) {
+        sleepTime = std::min(sleepTime, untilDue(compressAction.nextChunk));
+    }
+    if (defragmenter && config.isDefragmenterEnabled()) {
+        sleepTime = std::min(sleepTime, untilDue(defragmentAction.nextChunk));
+    }
+    return sleepTime;
+}
+
+std::chrono::milliseconds HashTableMaintenanceTask::getChunkDuration(
+        ActionType type) const {
+    auto& config = engine->getConfiguration();
+    switch (type) {
+    case ActionType::Decay:
+        return std::chrono::milliseconds(
+                config.getItemFreqDecayerChunkDuration());
+    case ActionType::Compress:
+        return std::chrono::milliseconds(
+                config.getItemCompressorChunkDuration());
+    case ActionType::Defragment:
+        return std::chrono::milliseconds(
+                config.getDefragmenterChunkDuration());
+    }
+    throw std::logic_error(
+            "HashTableMaintenanceTask::getChunkDuration: invalid type " +
+            std::to_string(int(type)));
+}
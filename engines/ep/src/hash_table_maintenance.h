@@ -0,0 +1,167 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "globaltask.h"
+#include "hash_table.h"
+#include "kv_bucket_iface.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+class DefragmentVisitor;
+class EPStats;
+class ItemCompressorVisitor;
+class ItemFreqDecayerVisitor;
+class PauseResumeVBAdapter;
+class VBucketAwareHTVisitor;
+
+/**
+ * Task running the per-item HashTable maintenance (frequency counter decay,
+ * item compression and defragmentation) as a single pass over the
+ * HashTables.
+ *
+ * The ItemFreqDecayerTask, the ItemCompressorTask and the DefragmenterTask
+ * each walk every HashTable on their own schedule, and on large buckets
+ * every walk means pulling all of the StoredValues through the CPU caches
+ * again. When hash_table_fused_scan is enabled those tasks leave the work
+ * to this task, which visits the StoredValues once (see FusedHTVisitor) for
+ * all of the actions due.
+ *
+ * Each action keeps its own schedule, budget and resume position: every
+ * time the task runs it includes the actions which are due (the decayer
+ * when woken, the others when item_compressor_interval /
+ * defragmenter_interval has expired). Due actions which have reached the
+ * same position - typically because they started their pass together -
+ * share a visit, which pauses once any of them reaches its chunk duration;
+ * the others are visited separately. Every action therefore sees every
+ * item once per pass, whatever the schedules.
+ */
+class HashTableMaintenanceTask : public GlobalTask {
+public:
+    /// The maintenance actions, in the order they are applied to an item
+    enum class ActionType { Decay, Compress, Defragment };
+
+    /**
+     * @param e the engine
+     * @param stats_ the stats to update
+     * @param defragment true if the pass should defragment (only supported
+     *                   if the memory allocator supports it)
+     */
+    HashTableMaintenanceTask(EventuallyPersistentEngine* e,
+                             EPStats& stats_,
+                             bool defragment);
+
+    ~HashTableMaintenanceTask() override;
+
+    bool run();
+
+    void stop();
+
+    std::string getDescription();
+
+    std::chrono::microseconds maxExpectedDuration();
+
+    /**
+     * Request a pass decaying the frequency counters of the items; used
+     * instead of waking the ItemFreqDecayerTask when the fused scan is
+     * enabled.
+     */
+    void wakeupDecayer();
+
+    /**
+     * @return true if the action has started a pass over the HashTables which
+     *         it hasn't finished yet. Exposed for testing.
+     */
+    bool isPassInProgress(ActionType type) const;
+
+protected:
+    /// Upper limit on how long a chunk including the action can run for
+    virtual std::chrono::milliseconds getChunkDuration(ActionType type) const;
+
+private:
+    /// The schedule and resume position of one of the actions
+    struct Action {
+        Action(ActionType type, KVBucketIface::Position start)
+            : type(type), epstorePosition(start) {
+        }
+
+        /// @return true if the action will resume from the same place
+        bool samePosition(const Action& other) const {
+            return epstorePosition == other.epstorePosition &&
+                   resumeVBucket == other.resumeVBucket &&
+                   htPosition == other.htPosition;
+        }
+
+        const ActionType type;
+
+        /// When the action should next be included
+        std::chrono::steady_clock::time_point nextChunk;
+
+        /// How far through the epStore the action's pass has got
+        KVBucketIface::Position epstorePosition;
+
+        /// The vBucket and HashTable position the pass paused at
+        Vbid resumeVBucket = Vbid(0);
+        HashTable::Position htPosition;
+    };
+
+    /// @return the actions which are enabled and due at the given time
+    std::vector<Action*> getDueActions(
+            std::chrono::steady_clock::time_point now);
+
+    /// Run one chunk of the pass of the actions, which must be at the same
+    /// position
+    void runChunk(const std::vector<Action*>& actions);
+
+    /// Prepare the visitor of the action for a chunk
+    void prepare(Action& action, std::chrono::steady_clock::time_point start);
+
+    /// Update the stats and schedule of the action after a chunk
+    void finish(Action& action,
+                std::chrono::steady_clock::time_point end,
+                bool completed);
+
+    VBucketAwareHTVisitor& getVisitor(ActionType type);
+
+    /// Duration (in seconds) to sleep until the next action is due
+    double getSleepTime() const;
+
+    /// Reference to EP stats, used to check on mem_used.
+    EPStats& stats;
+
+    /// The visitors (nullptr if the action isn't supported)
+    std::unique_ptr<ItemFreqDecayerVisitor> decayer;
+    std::unique_ptr<ItemCompressorVisitor> compressor;
+    std::unique_ptr<DefragmentVisitor> defragmenter;
+
+    Action decayAction;
+    Action compressAction;
+    Action defragmentAction;
+
+    /// Set when a decay pass has been requested and not yet completed
+    std::atomic<bool> decayRequested{false};
+
+    /**
+     * Visitor adapter (wrapping a FusedHTVisitor) which supports pausing &
+     * resuming; repositioned to the position of the actions visited by each
+     * chunk.
+     */
+    std::unique_ptr<PauseResumeVBAdapter> prAdapter;
+};
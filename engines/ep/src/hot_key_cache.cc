@@ -0,0 +1,229 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "hot_key_cache.h"
+
+#include "item.h"
+
+#include <folly/concurrency/CacheLocality.h>
+#include <platform/sysinfo.h>
+
+#include <algorithm>
+
+/// @return true if the given StoredDocKey and DocKey are the same key
+static bool isSameKey(const StoredDocKey& stored, const DocKey& key) {
+    if (key.getEncoding() == DocKeyEncodesCollectionId::Yes) {
+        return stored.size() == key.size() &&
+               std::equal(key.data(), key.data() + key.size(), stored.data());
+    }
+    // A key without a collection-ID is in the DefaultCollection
+    return stored.size() == key.size() + 1 &&
+           stored.data()[0] == DefaultCollectionLeb128Encoded &&
+           std::equal(key.data(), key.data() + key.size(), stored.data() + 1);
+}
+
+HotKeyCache::HotKeyCache(size_t maxKeys, size_t threshold, size_t numShards)
+    : maxKeys(maxKeys),
+      threshold(std::max(threshold, size_t(1))),
+      shards(numShards ? numShards : cb::get_cpu_count()) {
+}
+
+HotKeyCache::~HotKeyCache() = default;
+
+HotKeyCache::Lookup HotKeyCache::get(Vbid vbid,
+                                     const DocKey& key,
+                                     uint64_t revision,
+                                     time_t now) {
+    return getShard().get(
+            vbid, key, key.hash(), revision, now, maxKeys, threshold);
+}
+
+void HotKeyCache::publish(Vbid vbid, const Item& item, uint64_t revision) {
+    if (maxKeys == 0) {
+        return;
+    }
+    getShard().publish(vbid, item, item.getKey().hash(), revision, maxKeys);
+}
+
+void HotKeyCache::clear() {
+    for (auto& shard : shards) {
+        shard->clear();
+    }
+}
+
+size_t HotKeyCache::getNumHits() const {
+    size_t ret = 0;
+    for (const auto& shard : shards) {
+        ret += shard->getNumHits();
+    }
+    return ret;
+}
+
+size_t HotKeyCache::getNumSnapshots() const {
+    size_t ret = 0;
+    for (const auto& shard : shards) {
+        ret += shard->getNumSnapshots();
+    }
+    return ret;
+}
+
+HotKeyCache::Shard& HotKeyCache::getShard() {
+    auto stripe =
+            folly::AccessSpreader<std::atomic>::cachedCurrent(shards.size());
+    return *shards[stripe];
+}
+
+HotKeyCache::Lookup HotKeyCache::Shard::get(Vbid vbid,
+                                            const DocKey& key,
+                                            uint32_t hash,
+                                            uint64_t revision,
+                                            time_t now,
+                                            size_t maxKeys,
+                                            size_t threshold) {
+    std::lock_guard<std::mutex> lh(mutex);
+
+    Lookup ret;
+    for (auto it = snapshots.begin(); it != snapshots.end(); ++it) {
+        if (it->vbid != vbid || it->hash != hash ||
+            !isSameKey(it->item->getKey(), key)) {
+            continue;
+        }
+        const auto exptime = it->item->getExptime();
+        if (it->revision == revision && (exptime == 0 || exptime > now)) {
+            ret.item = std::make_unique<Item>(*it->item);
+            ++hits;
+        } else {
+            // Stale; it will be published again by the next read.
+            snapshots.erase(it);
+        }
+        break;
+    }
+
+    if (++reads % SampleInterval == 0) {
+        const auto count = sample(vbid, key, hash);
+        if (++samples % DecayInterval == 0) {
+            decay(threshold);
+        }
+        ret.publish = !ret.item && maxKeys > 0 && count >= threshold;
+    } else if (!ret.item && maxKeys > 0) {
+        // Not sampled; still publish if the key is known to be hot.
+        for (const auto& candidate : candidates) {
+            if (candidate.vbid == vbid && candidate.hash == hash &&
+                isSameKey(candidate.key, key)) {
+                ret.publish = candidate.count >= threshold;
+                break;
+            }
+        }
+    }
+    return ret;
+}
+
+void HotKeyCache::Shard::publish(Vbid vbid,
+                                 const Item& item,
+                                 uint32_t hash,
+                                 uint64_t revision,
+                                 size_t maxKeys) {
+    // Take a copy of the value, so the reference count of the snapshot's
+    // Blob is only touched by this core.
+    auto copy = std::make_unique<Item>(item);
+    if (copy->getValue()) {
+        copy->replaceValue(Blob::Copy(*copy->getValue()));
+    }
+
+    std::lock_guard<std::mutex> lh(mutex);
+    for (auto& snapshot : snapshots) {
+        if (snapshot.vbid == vbid && snapshot.hash == hash &&
+            snapshot.item->getKey() == item.getKey()) {
+            snapshot.revision = revision;
+            snapshot.item = std::move(copy);
+            return;
+        }
+    }
+    if (snapshots.size() < maxKeys) {
+        snapshots.push_back({vbid, hash, revision, std::move(copy)});
+        return;
+    }
+    nextVictim = nextVictim % snapshots.size();
+    snapshots[nextVictim++] = {vbid, hash, revision, std::move(copy)};
+}
+
+void HotKeyCache::Shard::clear() {
+    std::lock_guard<std::mutex> lh(mutex);
+    candidates.clear();
+    snapshots.clear();
+}
+
+size_t HotKeyCache::Shard::getNumHits() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return hits;
+}
+
+size_t HotKeyCache::Shard::getNumSnapshots() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return snapshots.size();
+}
+
+size_t HotKeyCache::Shard::sample(Vbid vbid, const DocKey& key, uint32_t hash) {
+    // Track a few more candidates than there are snapshots, so keys about
+    // to become hot aren't pushed out by the long tail of other keys.
+    const size_t maxCandidates = 16;
+
+    for (auto& candidate : candidates) {
+        if (candidate.vbid == vbid && candidate.hash == hash &&
+            isSameKey(candidate.key, key)) {
+            return ++candidate.count;
+        }
+    }
+    if (candidates.size() < maxCandidates) {
+        candidates.push_back({vbid, hash, StoredDocKey(key), 1});
+        return 1;
+    }
+
+    // Space-Saving: the new key replaces the least counted candidate, and
+    // inherits its count.
+    auto victim = std::min_element(candidates.begin(),
+                                   candidates.end(),
+                                   [](const Candidate& a, const Candidate& b) {
+                                       return a.count < b.count;
+                                   });
+    *victim = {vbid, hash, StoredDocKey(key), victim->count + 1};
+    return victim->count;
+}
+
+void HotKeyCache::Shard::decay(size_t threshold) {
+    for (auto& candidate : candidates) {
+        candidate.count /= 2;
+    }
+
+    // Forget the snapshots of the keys which are no longer hot.
+    snapshots.erase(
+            std::remove_if(
+                    snapshots.begin(),
+                    snapshots.end(),
+                    [this, threshold](const Snapshot& snapshot) {
+                        return std::none_of(
+                                candidates.begin(),
+                                candidates.end(),
+                                [&snapshot, threshold](const Candidate& c) {
+                                    return c.vbid == snapshot.vbid &&
+                                           c.hash == snapshot.hash &&
+                                           c.key == snapshot.item->getKey() &&
+                                           c.count * 2 >= threshold;
+                                });
+                    }),
+            snapshots.end());
+}
@@ -0,0 +1,162 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "storeddockey.h"
+
+#include <folly/CachelinePadded.h>
+#include <memcached/dockey.h>
+#include <memcached/vbucket.h>
+
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Item;
+
+/**
+ * A cache of read-only snapshots of the hottest keys of a bucket, so that
+ * reads of a very hot key (for example a configuration document read by
+ * every client) don't all serialise on the HashTable lock and StoredValue
+ * of that key.
+ *
+ * The cache is split into one shard per core (as TopKeys), each with its own
+ * copy of the snapshots; a front-end thread only uses the shard of the core
+ * it runs on. Each shard detects its hot keys by sampling the reads it sees
+ * (every SampleInterval-th read is counted, using the Space-Saving algorithm
+ * over a small table of candidates, with counts halved every DecayInterval
+ * samples). Once a key is hot, the next read which misses the cache
+ * publishes its result as the snapshot of the key.
+ *
+ * A snapshot is only valid as long as the key hasn't changed. The caller
+ * supplies a revision of the key (see VBucket::getHotKeyRevision()), read
+ * before the key is read from the HashTable, which is stored with the
+ * snapshot and compared when it is looked up.
+ */
+class HotKeyCache {
+public:
+    /// Every SampleInterval-th read of a shard is counted
+    static const size_t SampleInterval = 8;
+
+    /// The counts of a shard are halved every DecayInterval samples
+    static const size_t DecayInterval = 1024;
+
+    /**
+     * @param maxKeys the maximum number of keys with a snapshot (per shard)
+     * @param threshold the number of samples (within a decay interval) for
+     *        a key to be hot
+     * @param numShards the number of shards, 0 for one per core
+     */
+    HotKeyCache(size_t maxKeys, size_t threshold, size_t numShards = 0);
+
+    ~HotKeyCache();
+
+    struct Lookup {
+        /// A copy of the snapshot of the key, null if there isn't a valid one
+        std::unique_ptr<Item> item;
+        /// True if the key is hot but has no valid snapshot; the result of
+        /// reading it should be published.
+        bool publish = false;
+    };
+
+    /**
+     * Look up the snapshot of the given key, and count the read.
+     *
+     * @param revision the current revision of the key
+     * @param now the current time, to skip a snapshot which has expired
+     */
+    Lookup get(Vbid vbid, const DocKey& key, uint64_t revision, time_t now);
+
+    /**
+     * Publish the snapshot of a hot key.
+     *
+     * @param item the key as read from the HashTable
+     * @param revision the revision of the key read before reading the item
+     */
+    void publish(Vbid vbid, const Item& item, uint64_t revision);
+
+    /// Remove every snapshot and candidate
+    void clear();
+
+    /// @return the number of reads served from a snapshot
+    size_t getNumHits() const;
+
+    /// @return the number of snapshots currently held (in all shards)
+    size_t getNumSnapshots() const;
+
+private:
+    struct Candidate {
+        Vbid vbid;
+        uint32_t hash;
+        StoredDocKey key;
+        size_t count;
+    };
+
+    struct Snapshot {
+        Vbid vbid;
+        uint32_t hash;
+        uint64_t revision;
+        std::unique_ptr<Item> item;
+    };
+
+    class Shard {
+    public:
+        Lookup get(Vbid vbid,
+                   const DocKey& key,
+                   uint32_t hash,
+                   uint64_t revision,
+                   time_t now,
+                   size_t maxKeys,
+                   size_t threshold);
+
+        void publish(Vbid vbid,
+                     const Item& item,
+                     uint32_t hash,
+                     uint64_t revision,
+                     size_t maxKeys);
+
+        void clear();
+
+        size_t getNumHits() const;
+
+        size_t getNumSnapshots() const;
+
+    private:
+        /// @return the count of the key after sampling the read
+        size_t sample(Vbid vbid, const DocKey& key, uint32_t hash);
+
+        /// Halve all counts, forgetting the snapshots of keys no longer hot
+        void decay(size_t threshold);
+
+        mutable std::mutex mutex;
+        std::vector<Candidate> candidates;
+        std::vector<Snapshot> snapshots;
+        /// The snapshot to replace next when full
+        size_t nextVictim = 0;
+        size_t reads = 0;
+        size_t samples = 0;
+        size_t hits = 0;
+    };
+
+    Shard& getShard();
+
+    const size_t maxKeys;
+    const size_t threshold;
+
+    std::vector<folly::CachelinePadded<Shard>> shards;
+};
@@ -33,7 +33,10 @@ ItemCompressorTask::ItemCompressorTask(EventuallyPersistentEngine* e,
 
 bool ItemCompressorTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "ItemCompressorTask");
-    if (engine->getCompressionMode() == BucketCompressionMode::Active) {
+    // When the fused scan is enabled the HashTableMaintenanceTask
+    // compresses as part of its pass.
+    if (engine->getCompressionMode() == BucketCompressionMode::Active &&
+        !engine->getConfiguration().isHashTableFusedScan()) {
         // Get our pause/resume visitor. If we didn't finish the previous pass,
         // then resume from where we last were, otherwise create a new visitor
         // starting from the beginning.
@@ -68,6 +71,8 @@ bool ItemCompressorTask::run(void) {
         visitor.clearStats();
         visitor.setCompressionMode(engine->getCompressionMode());
         visitor.setMinCompressionRatio(engine->getMinCompressionRatio());
+        visitor.setDictionaries(
+                engine->getKVBucket()->getCompressionDictionaries());
 
         // Do it - set off the visitor.
         epstore_position = engine->getKVBucket()->pauseResumeVisit(
@@ -103,8 +108,13 @@ bool ItemCompressorTask::run(void) {
             EP_LOG_DEBUG("{}", ss.str());
         }
 
-        // Delete(reset) visitor if it finished.
+        // Delete(reset) visitor if it finished, and train the dictionaries
+        // of the collections sampled during the pass.
         if (completed) {
+            if (engine->getKVBucket()->getCompressionDictionaries()) {
+                engine->getKVBucket()->itemCompressorPassCompleted(
+                        visitor.takeVisitedCollections());
+            }
             prAdapter.reset();
         }
     }
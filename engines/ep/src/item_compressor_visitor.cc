@@ -16,6 +16,9 @@
  */
 
 #include "item_compressor_visitor.h"
+#include "compression_dictionary.h"
+
+#include <memcached/protocol_binary.h>
 #include <platform/compress.h>
 
 // ItemCompressorVisitor implementation //////////////////////////////
@@ -24,7 +27,8 @@ ItemCompressorVisitor::ItemCompressorVisitor()
     : compressed_count(0),
       visited_count(0),
       currentVb(nullptr),
-      currentMinCompressionRatio(0.0) {
+      currentMinCompressionRatio(0.0),
+      dictionaries(nullptr) {
 }
 
 ItemCompressorVisitor::~ItemCompressorVisitor() {
@@ -37,12 +41,16 @@ void ItemCompressorVisitor::setDeadline(
 
 bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
                                   StoredValue& v) {
+    if (dictionaries) {
+        visitedCollections.insert(v.getKey().getCollectionID());
+    }
 
     // Check if the item can be compressed
-    if (compressMode == BucketCompressionMode::Active && v.isCompressible()) {
+    if (compressMode == BucketCompressionMode::Active && v.isCompressible() &&
+        !compressWithDictionary(v)) {
         cb::compression::Buffer deflated;
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
-                                     {v.getValue()->getData(), v.valuelen()},
+                                     v.getValueBuffer(),
                                      deflated)) {
             auto comp_ratio = static_cast<float>(v.valuelen()) /
                               static_cast<float>(deflated.size());
@@ -68,6 +76,43 @@ bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
     return progressTracker.shouldContinueVisiting(visited_count);
 }
 
+bool ItemCompressorVisitor::compressWithDictionary(StoredValue& v) {
+    // Documents of ephemeral buckets may be read by range reads without the
+    // HashBucketLock, so they are left to Snappy; as are documents with
+    // XATTRs, which are inspected in place when the document is deleted.
+    if (!dictionaries || v.isOrdered() ||
+        mcbp::datatype::is_xattr(v.getDatatype())) {
+        return false;
+    }
+
+    const auto value = v.getValueBuffer();
+    auto lookup = dictionaries->lookup(v.getKey().getCollectionID(), value);
+    if (lookup.training) {
+        // Leave the document until its collection has a dictionary.
+        return true;
+    }
+    if (!lookup.dictionary) {
+        return false;
+    }
+
+    std::string compressed;
+    if (!lookup.dictionary->compress(value, compressed)) {
+        // Don't try again on every pass
+        v.setUncompressible();
+        return true;
+    }
+    auto comp_ratio = static_cast<float>(v.valuelen()) /
+                      static_cast<float>(compressed.size());
+    if (comp_ratio >= currentMinCompressionRatio) {
+        currentVb->ht.storeDictionaryCompressedBuffer(
+                {compressed.data(), compressed.size()}, v);
+        compressed_count++;
+    } else {
+        v.setUncompressible();
+    }
+    return true;
+}
+
 void ItemCompressorVisitor::clearStats() {
     compressed_count = 0;
     visited_count = 0;
@@ -93,3 +138,15 @@ void ItemCompressorVisitor::setCurrentVBucket(VBucket& vb) {
 void ItemCompressorVisitor::setMinCompressionRatio(float minCompressionRatio) {
     currentMinCompressionRatio = minCompressionRatio;
 }
+
+void ItemCompressorVisitor::setDictionaries(
+        CollectionDictionaries* dictionaries) {
+    this->dictionaries = dictionaries;
+}
+
+std::unordered_set<CollectionID>
+ItemCompressorVisitor::takeVisitedCollections() {
+    std::unordered_set<CollectionID> ret;
+    ret.swap(visitedCollections);
+    return ret;
+}
@@ -22,6 +22,10 @@
 #include "vb_visitors.h"
 #include "vbucket.h"
 
+#include <unordered_set>
+
+class CollectionDictionaries;
+
 /**
  * Item Compressor visitor - visit all objects in a VBucket and compress
  * the values
@@ -41,6 +45,14 @@ public:
     // Set the minimum compression ratio
     void setMinCompressionRatio(float minCompressionRatio);
 
+    // Set the dictionaries to compress documents with (instead of Snappy),
+    // or null to use Snappy.
+    void setDictionaries(CollectionDictionaries* dictionaries);
+
+    // Returns the collections of the documents visited with dictionaries
+    // since last called (i.e. during the pass).
+    std::unordered_set<CollectionID> takeVisitedCollections();
+
     // Implementation of HashTableVisitor interface:
     virtual bool visit(const HashTable::HashBucketLock& lh,
                        StoredValue& v) override;
@@ -57,6 +69,14 @@ public:
     void setCurrentVBucket(VBucket& vb) override;
 
 private:
+    /**
+     * Compress the given document with the dictionary of its collection.
+     *
+     * @return true if the document has been dealt with, false if it should
+     *         be compressed with Snappy instead.
+     */
+    bool compressWithDictionary(StoredValue& v);
+
     /* Runtime state */
 
     // Estimates how far we have got, and when we should pause.
@@ -76,4 +96,10 @@ private:
 
     // The current minimum compression ratio supported by the bucket
     float currentMinCompressionRatio;
+
+    // The dictionaries to compress documents with, null if Snappy is used
+    CollectionDictionaries* dictionaries;
+
+    // The collections of the documents visited with dictionaries
+    std::unordered_set<CollectionID> visitedCollections;
 };
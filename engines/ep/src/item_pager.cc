@@ -38,6 +38,7 @@
 #include <limits>
 #include <list>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include <phosphor/phosphor.h>
@@ -62,6 +63,35 @@ ItemPager::ItemPager(EventuallyPersistentEngine& e, EPStats& st)
                     : ACTIVE_AND_PENDING_ONLY;
 }
 
+/**
+ * @return for each collection using more than its fair share (an equal
+ *         split of the memory used by all collections' items) the ratio of
+ *         its memory to that share.
+ */
+static std::unordered_map<CollectionID, double> getCollectionPressure(
+        const EPStats& stats) {
+    std::unordered_map<CollectionID, double> pressure;
+    const auto memUsed = stats.getCollectionMemoryUsed();
+    size_t total = 0;
+    size_t numCollections = 0;
+    for (const auto& entry : memUsed) {
+        if (entry.second > 0) {
+            total += entry.second;
+            ++numCollections;
+        }
+    }
+    if (numCollections < 2) {
+        return pressure;
+    }
+    const double fairShare = double(total) / numCollections;
+    for (const auto& entry : memUsed) {
+        if (entry.second > fairShare) {
+            pressure[entry.first] = entry.second / fairShare;
+        }
+    }
+    return pressure;
+}
+
 bool ItemPager::run(void) {
     TRACE_EVENT0("ep-engine/task", "ItemPager");
 
@@ -77,6 +107,9 @@ bool ItemPager::run(void) {
     // Clear the notification flag before starting the task's actions
     notified.store(false);
 
+    // Dropped collections may have been purged since the last run
+    stats.releaseDroppedCollectionSlots();
+
     KVBucket* kvBucket = engine.getKVBucket();
     double current = static_cast<double>(stats.getEstimatedTotalMemoryUsed());
     double upper = static_cast<double>(stats.mem_high_wat);
@@ -145,6 +178,30 @@ bool ItemPager::run(void) {
                 cfg.getItemEvictionAgePercentage(),
                 cfg.getItemEvictionFreqCounterAgeThreshold());
 
+        // Direct eviction at the vBuckets and collections using the most
+        // memory, rather than evicting evenly from every tenant.
+        size_t itemMemory = 0;
+        size_t vbMemory = 0;
+        size_t numVBuckets = 0;
+        for (auto vbid : filter.getVBSet()) {
+            auto vb = kvBucket->getVBucket(vbid);
+            if (vb) {
+                itemMemory += vb->ht.getItemMemory();
+                vbMemory += vb->getMemoryUsed();
+                ++numVBuckets;
+            }
+        }
+        pv->setMemoryAttribution(numVBuckets ? vbMemory / numVBuckets : 0,
+                                 getCollectionPressure(stats));
+
+        if (cfg.getPagerEvictionStrategy() == "sampled") {
+            pv->enableSampledEviction(
+                    cfg.getPagerSampledEvictionSampleSize(),
+                    cfg.getPagerSampledEvictionPerc(),
+                    static_cast<size_t>(current - lower),
+                    itemMemory);
+        }
+
         // p99.99 is ~200ms
         const auto maxExpectedDurationForVisitorTask =
                 std::chrono::milliseconds(200);
@@ -18,9 +18,11 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -31,10 +33,12 @@
 #include <utilities/logtags.h>
 
 #include "access_scanner.h"
+#include "bgfetcher.h"
 #include "bucket_logger.h"
 #include "checkpoint_manager.h"
 #include "checkpoint_remover.h"
 #include "collections/manager.h"
+#include "compression_dictionary.h"
 #include "conflict_resolution.h"
 #include "connmap.h"
 #include "dcp/dcpconnmap.h"
@@ -42,11 +46,14 @@
 #include "durability/durability_completion_task.h"
 #include "durability_timeout_task.h"
 #include "ep_engine.h"
+#include "ep_metrics.h"
 #include "ep_time.h"
 #include "executorpool.h"
 #include "ext_meta_parser.h"
 #include "failover-table.h"
 #include "flusher.h"
+#include "hash_table_maintenance.h"
+#include "hot_key_cache.h"
 #include "htresizer.h"
 #include "item.h"
 #include "item_compressor.h"
@@ -56,6 +63,7 @@
 #include "kvstore.h"
 #include "locks.h"
 #include "mutation_log.h"
+#include "objectregistry.h"
 #include "replicationthrottle.h"
 #include "rollback_result.h"
 #include "statwriter.h"
@@ -168,6 +176,10 @@ public:
             }
         } else if (key.compare("xattr_enabled") == 0) {
             store.setXattrEnabled(value);
+        } else if (key.compare("hot_key_cache_enabled") == 0) {
+            store.setHotKeyCacheEnabled(value);
+        } else if (key.compare("ht_optimistic_reads") == 0) {
+            store.setHtOptimisticReads(value);
         }
     }
 
@@ -277,6 +289,12 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
       vbMap(theEngine.getConfiguration(), *this),
       defragmenterTask(NULL),
       itemCompressorTask(nullptr),
+      hashTableMaintenanceTask(nullptr),
+      compressionDictionaries(std::make_unique<CollectionDictionaries>(
+              engine.getConfiguration().getItemCompressorDictionarySize(),
+              engine.getConfiguration().getItemCompressorDictionarySampleSize(),
+              engine.getConfiguration()
+                      .getItemCompressorDictionaryTotalSampleSize())),
       itemFreqDecayerTask(nullptr),
       vb_mutexes(engine.getConfiguration().getMaxVbuckets()),
       backfillMemoryThreshold(0.95),
@@ -284,6 +302,11 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
       lastTransTimePerItem(0),
       collectionsManager(std::make_unique<Collections::Manager>()),
       xattrEnabled(true),
+      hotKeyCache(std::make_unique<HotKeyCache>(
+              engine.getConfiguration().getHotKeyCacheSize(),
+              engine.getConfiguration().getHotKeyCacheThreshold())),
+      hotKeyCacheEnabled(false),
+      htOptimisticReads(false),
       maxTtl(engine.getConfiguration().getMaxTtl()) {
     cachedResidentRatio.activeRatio.store(0);
     cachedResidentRatio.replicaRatio.store(0);
@@ -401,6 +424,16 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
 
     xattrEnabled = config.isXattrEnabled();
 
+    config.addValueChangedListener(
+            "hot_key_cache_enabled",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+    hotKeyCacheEnabled = config.isHotKeyCacheEnabled();
+
+    config.addValueChangedListener(
+            "ht_optimistic_reads",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+    htOptimisticReads = config.isHtOptimisticReads();
+
     // Always create the item pager; but initially disable, leaving scheduling
     // up to the specific KVBucket subclasses.
     itemPagerTask = std::make_shared<ItemPager>(engine, stats);
@@ -424,10 +457,7 @@ bool KVBucket::initialize() {
             &engine, stats, checkpointRemoverInterval);
     ExecutorPool::get()->schedule(chkTask);
 
-    durabilityTimeoutTask = std::make_shared<DurabilityTimeoutTask>(
-            engine,
-            std::chrono::milliseconds(
-                    config.getDurabilityTimeoutTaskInterval()));
+    durabilityTimeoutTask = std::make_shared<DurabilityTimeoutTask>(engine);
     ExecutorPool::get()->schedule(durabilityTimeoutTask);
 
     durabilityCompletionTask =
@@ -448,6 +478,20 @@ bool KVBucket::initialize() {
 
     enableItemCompressor();
 
+    /*
+     * Runs the frequency decayer, the item compressor and the defragmenter
+     * as a single pass over the HashTables instead of their own tasks when
+     * hash_table_fused_scan is enabled.
+     */
+#if HAVE_JEMALLOC
+    const bool defragment = true;
+#else
+    const bool defragment = false;
+#endif
+    hashTableMaintenanceTask = std::make_shared<HashTableMaintenanceTask>(
+            &engine, stats, defragment);
+    ExecutorPool::get()->schedule(hashTableMaintenanceTask);
+
     /*
      * Creates the ItemFreqDecayer task which is used to ensure that the
      * frequency counters of items stored in the hash table do not all
@@ -474,6 +518,8 @@ KVBucket::~KVBucket() {
     defragmenterTask.reset();
     EP_LOG_INFO("Deleting itemCompressorTask");
     itemCompressorTask.reset();
+    EP_LOG_INFO("Deleting hashTableMaintenanceTask");
+    hashTableMaintenanceTask.reset();
     EP_LOG_INFO("Deleting itemFreqDecayerTask");
     itemFreqDecayerTask.reset();
     EP_LOG_INFO("Deleted KvBucket.");
@@ -960,6 +1006,10 @@ ENGINE_ERROR_CODE KVBucket::createVBucket_UNLOCKED(
 
     newvb->setFreqSaturatedCallback(
             [this] { this->wakeItemFreqDecayerTask(); });
+    newvb->setSyncWriteTimeoutCallback(
+            [this](Vbid vbid, std::chrono::steady_clock::time_point expiry) {
+                this->scheduleDurabilityTimeout(vbid, expiry);
+            });
 
     Configuration& config = engine.getConfiguration();
     if (config.isBfilterEnabled()) {
@@ -1141,8 +1191,11 @@ void KVBucket::snapshotStats() {
     getOneRWUnderlying()->snapshotStats(snap.smap);
 }
 
-void KVBucket::getAggregatedVBucketStats(const void* cookie,
-                                         const AddStatFn& add_stat) {
+void KVBucket::visitVBucketCounts(
+        std::function<void(VBucketCountVisitor&,
+                           VBucketCountVisitor&,
+                           VBucketCountVisitor&,
+                           VBucketCountVisitor&)> callback) {
     // Create visitors for each of the four vBucket states, and collect
     // stats for each.
     auto active = makeVBCountVisitor(vbucket_state_active);
@@ -1163,9 +1216,55 @@ void KVBucket::getAggregatedVBucketStats(const void* cookie,
                                                         replica->getNumItems() +
                                                         pending->getNumItems());
 
-    // And finally actually return the stats using the AddStatFn callback.
-    appendAggregatedVBucketStats(
-            *active, *replica, *pending, *dead, cookie, add_stat);
+    callback(*active, *replica, *pending, *dead);
+}
+
+void KVBucket::getAggregatedVBucketStats(const void* cookie,
+                                         const AddStatFn& add_stat) {
+    visitVBucketCounts([this, cookie, &add_stat](VBucketCountVisitor& active,
+                                                 VBucketCountVisitor& replica,
+                                                 VBucketCountVisitor& pending,
+                                                 VBucketCountVisitor& dead) {
+        // And finally actually return the stats using the AddStatFn
+        // callback.
+        appendAggregatedVBucketStats(
+                active, replica, pending, dead, cookie, add_stat);
+    });
+}
+
+void KVBucket::getAggregatedVBucketMetrics(cb::metrics::Collector& collector) {
+    visitVBucketCounts([&collector](VBucketCountVisitor& active,
+                                    VBucketCountVisitor& replica,
+                                    VBucketCountVisitor& pending,
+                                    VBucketCountVisitor& dead) {
+        // The collector belongs to the front end
+        NonBucketAllocationGuard guard;
+        using namespace ep_metrics;
+        collector.addGauge(curr_items, active.getNumItems());
+        collector.addGauge(curr_items_tot,
+                           active.getNumItems() + replica.getNumItems() +
+                                   pending.getNumItems());
+        collector.addGauge(curr_temp_items, active.getNumTempItems());
+        collector.addGauge(vb_active_num, active.getVBucketNumber());
+        collector.addGauge(vb_replica_num, replica.getVBucketNumber());
+        collector.addGauge(vb_pending_num, pending.getVBucketNumber());
+        collector.addGauge(vb_dead_num, dead.getVBucketNumber());
+        collector.addGauge(vb_replica_curr_items, replica.getNumItems());
+        collector.addGauge(vb_active_num_non_resident,
+                           active.getNonResident());
+        collector.addGauge(vb_active_perc_mem_resident,
+                           active.getMemResidentPer());
+        collector.addGauge(vb_replica_perc_mem_resident,
+                           replica.getMemResidentPer());
+        collector.addCounter(vb_active_ops_create, active.getOpsCreate());
+        collector.addCounter(vb_active_ops_update, active.getOpsUpdate());
+        collector.addCounter(vb_active_ops_delete, active.getOpsDelete());
+        collector.addCounter(vb_active_ops_get, active.getOpsGet());
+        collector.addCounter(vb_active_expired, active.getExpired());
+        collector.addCounter(vb_active_eject, active.getEjects());
+        collector.addGauge(vb_active_queue_size, active.getQueueSize());
+        collector.addGauge(vb_replica_queue_size, replica.getQueueSize());
+    });
 }
 
 std::unique_ptr<VBucketCountVisitor> KVBucket::makeVBCountVisitor(
@@ -1439,15 +1538,70 @@ GetValue KVBucket::getInternal(const DocKey& key,
         return GetValue(nullptr, ENGINE_NOT_MY_VBUCKET);
     }
 
+    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    return getInternalLocked(*vb, key, cookie, getReplicaItem, options);
+}
+
+std::vector<GetValue> KVBucket::getMulti(
+        const std::vector<GetMultiRequest>& requests) {
+    std::vector<GetValue> results(requests.size());
+
+    // Visit the requests grouped by vbucket, keeping the original order
+    // of lookups for the same key
+    std::vector<size_t> order(requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+            order.begin(), order.end(), [&requests](size_t a, size_t b) {
+                return requests[a].vbucket < requests[b].vbucket;
+            });
+
+    // Don't let the reader task start before all misses are queued
+    BgFetcher::DeferWakeup deferWakeup;
+
+    auto first = order.begin();
+    while (first != order.end()) {
+        const auto vbid = requests[*first].vbucket;
+        const auto last = std::find_if(first, order.end(), [&](size_t ii) {
+            return requests[ii].vbucket != vbid;
+        });
+
+        VBucketPtr vb = getVBucket(vbid);
+        if (!vb) {
+            for (auto it = first; it != last; ++it) {
+                ++stats.numNotMyVBuckets;
+                results[*it] = GetValue(nullptr, ENGINE_NOT_MY_VBUCKET);
+            }
+            first = last;
+            continue;
+        }
+
+        // Each key is still looked up (and its hash bucket locked) on its
+        // own; only the vbucket lookup and state lock are shared.
+        folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+        for (auto it = first; it != last; ++it) {
+            const auto& req = requests[*it];
+            results[*it] = getInternalLocked(
+                    *vb, req.key, req.cookie, ForGetReplicaOp::No, req.options);
+        }
+        first = last;
+    }
+
+    return results;
+}
+
+GetValue KVBucket::getInternalLocked(VBucket& vb,
+                                     const DocKey& key,
+                                     const void* cookie,
+                                     const ForGetReplicaOp getReplicaItem,
+                                     get_options_t options) {
     const bool honorStates = (options & HONOR_STATES);
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
     if (honorStates) {
         vbucket_state_t disallowedState =
                 (getReplicaItem == ForGetReplicaOp::Yes)
                         ? vbucket_state_active
                         : vbucket_state_replica;
-        vbucket_state_t vbState = vb->getState();
+        vbucket_state_t vbState = vb.getState();
         if (vbState == vbucket_state_dead) {
             ++stats.numNotMyVBuckets;
             return GetValue(nullptr, ENGINE_NOT_MY_VBUCKET);
@@ -1464,9 +1618,9 @@ GetValue KVBucket::getInternal(const DocKey& key,
                 ++stats.numNotMyVBuckets;
                 return GetValue(nullptr, ENGINE_NOT_MY_VBUCKET);
             }
-            if (vb->addPendingOp(cookie)) {
+            if (vb.addPendingOp(cookie)) {
                 if (options & TRACK_STATISTICS) {
-                    vb->opsGet++;
+                    vb.opsGet++;
                 }
                 return GetValue(nullptr, ENGINE_EWOULDBLOCK);
             }
@@ -1474,7 +1628,7 @@ GetValue KVBucket::getInternal(const DocKey& key,
     }
 
     { // hold collections read handle for duration of get
-        auto cHandle = vb->lockCollections(key);
+        auto cHandle = vb.lockCollections(key);
         if (!cHandle.valid()) {
             engine.setErrorJsonExtras(
                     cookie,
@@ -1483,12 +1637,43 @@ GetValue KVBucket::getInternal(const DocKey& key,
             return GetValue(nullptr, ENGINE_UNKNOWN_COLLECTION);
         }
 
-        return vb->getInternal(cookie,
-                               engine,
-                               options,
-                               VBucket::GetKeyOnly::No,
-                               cHandle,
-                               getReplicaItem);
+        // Serve the read from the snapshot of the key if it is hot; the
+        // revision must be read before the key is read from the HashTable.
+        HotKeyCache::Lookup hotKey;
+        uint64_t hotKeyRevision = 0;
+        if (hotKeyCacheEnabled && getReplicaItem == ForGetReplicaOp::No &&
+            vb.getState() == vbucket_state_active) {
+            hotKeyRevision = vb.getHotKeyRevision(key);
+            hotKey = hotKeyCache->get(
+                    vb.getId(), key, hotKeyRevision, ep_real_time());
+            if (hotKey.item &&
+                !cHandle.isLogicallyDeleted(hotKey.item->getBySeqno())) {
+                if (options & TRACK_STATISTICS) {
+                    vb.opsGet++;
+                }
+                const auto seqno = hotKey.item->getBySeqno();
+                return GetValue(std::move(hotKey.item), ENGINE_SUCCESS, seqno);
+            }
+        }
+
+        if (htOptimisticReads && getReplicaItem == ForGetReplicaOp::No) {
+            options = static_cast<get_options_t>(options | OPTIMISTIC_READ);
+        }
+        auto gv = vb.getInternal(cookie,
+                                 engine,
+                                 options,
+                                 VBucket::GetKeyOnly::No,
+                                 cHandle,
+                                 getReplicaItem);
+
+        // Only publish an alive, unlocked item (a locked item can only be
+        // told apart by its hidden CAS).
+        if (hotKey.publish && gv.getStatus() == ENGINE_SUCCESS && gv.item &&
+            !gv.item->isDeleted() && (options & HIDE_LOCKED_CAS) &&
+            gv.item->getCas() != static_cast<uint64_t>(-1)) {
+            hotKeyCache->publish(vb.getId(), *gv.item, hotKeyRevision);
+        }
+        return gv;
     }
 }
 
@@ -1852,10 +2037,19 @@ std::string KVBucket::validateKey(const DocKey& key,
             return "item_deleted";
         }
 
+        // A dictionary compressed value has to be decompressed to compare
+        // it with the value on disk.
+        value_t decompressed;
+        auto value = v->getValueBuffer();
+        if (v->isDictionaryCompressed()) {
+            decompressed = v->getValue();
+            value = {decompressed->getData(), decompressed->valueSize()};
+        }
+
         if (diskItem.getFlags() != v->getFlags()) {
             return "flags_mismatch";
         } else if (v->isResident() && memcmp(diskItem.getData(),
-                                             v->getValue()->getData(),
+                                             value.data(),
                                              diskItem.getNBytes())) {
             return "data_mismatch";
         } else {
@@ -2116,10 +2310,23 @@ void KVBucket::disableItemPager() {
 }
 
 void KVBucket::wakeItemFreqDecayerTask() {
+    // When the fused scan is enabled the HashTableMaintenanceTask decays
+    // the frequency counters as part of its pass.
+    if (engine.getConfiguration().isHashTableFusedScan()) {
+        auto& t = dynamic_cast<HashTableMaintenanceTask&>(
+                *hashTableMaintenanceTask);
+        t.wakeupDecayer();
+        return;
+    }
     auto& t = dynamic_cast<ItemFreqDecayerTask&>(*itemFreqDecayerTask);
     t.wakeup();
 }
 
+void KVBucket::scheduleDurabilityTimeout(
+        Vbid vbid, std::chrono::steady_clock::time_point expiry) {
+    durabilityTimeoutTask->addSyncWriteTimeout(vbid, expiry);
+}
+
 void KVBucket::enableAccessScannerTask() {
     LockHolder lh(accessScanner.mutex);
     if (!accessScanner.enabled) {
@@ -2205,6 +2412,33 @@ void KVBucket::enableItemCompressor() {
     ExecutorPool::get()->schedule(itemCompressorTask);
 }
 
+CollectionDictionaries* KVBucket::getCompressionDictionaries() {
+    if (CompressionDictionary::isSupported() &&
+        engine.getConfiguration().getItemCompressorAlgorithm() ==
+                "zstd_dictionary") {
+        return compressionDictionaries.get();
+    }
+    return nullptr;
+}
+
+void KVBucket::itemCompressorPassCompleted(
+        const std::unordered_set<CollectionID>& visitedCollections) {
+    // Training takes a while, so is left to its own task rather than
+    // holding up the compressor (and the other tasks of its thread).
+    if (compressionDictionaries->passCompleted(visitedCollections)) {
+        ExecutorPool::get()->schedule(
+                std::make_shared<CompressionDictionaryTrainerTask>(&engine));
+    }
+}
+
+size_t KVBucket::trainCompressionDictionaries() {
+    return compressionDictionaries->train();
+}
+
+void KVBucket::dropCompressionDictionary(CollectionID cid) {
+    compressionDictionaries->dropCollection(cid);
+}
+
 void KVBucket::setAllBloomFilters(bool to) {
     for (auto vbid : vbMap.getBuckets()) {
         VBucketPtr vb = vbMap.getBucket(vbid);
@@ -2592,6 +2826,14 @@ void KVBucket::setXattrEnabled(bool value) {
     xattrEnabled = value;
 }
 
+void KVBucket::setHotKeyCacheEnabled(bool value) {
+    hotKeyCacheEnabled = value;
+    if (!value) {
+        // Release the memory of the snapshots
+        hotKeyCache->clear();
+    }
+}
+
 std::chrono::seconds KVBucket::getMaxTtl() const {
     return std::chrono::seconds{maxTtl.load()};
 }
@@ -26,8 +26,13 @@
 
 #include <cstdlib>
 #include <deque>
+#include <functional>
+#include <unordered_set>
 
+class CollectionDictionaries;
 class DurabilityCompletionTask;
+class DurabilityTimeoutTask;
+class HotKeyCache;
 class ReplicationThrottle;
 class VBucketCountVisitor;
 namespace Collections {
@@ -92,7 +97,23 @@ private:
 const uint16_t EP_PRIMARY_SHARD = 0;
 class KVShard;
 
-typedef std::pair<Vbid, ExTask> CompTaskEntry;
+/**
+ * A scheduled compaction task, as tracked by the bucket to limit how many
+ * compactions run concurrently.
+ */
+struct CompTaskEntry {
+    CompTaskEntry(Vbid vbid, ExTask task, size_t fragmentation)
+        : vbid(vbid), task(std::move(task)), fragmentation(fragmentation) {
+    }
+
+    Vbid vbid;
+    ExTask task;
+    /// Percentage of the vBucket's file which was stale when scheduled;
+    /// snoozed tasks are woken most fragmented first.
+    size_t fragmentation;
+    /// True once the task has started compacting its vBucket.
+    bool running = false;
+};
 
 /**
  * KVBucket is the base class for concrete Key/Value bucket implementations
@@ -127,6 +148,9 @@ public:
         return getInternal(key, vbucket, cookie, ForGetReplicaOp::No, options);
     }
 
+    std::vector<GetValue> getMulti(
+            const std::vector<GetMultiRequest>& requests) override;
+
     GetValue getRandomKey() override;
 
     GetValue getReplica(const DocKey& key,
@@ -196,6 +220,9 @@ public:
     void getAggregatedVBucketStats(const void* cookie,
                                    const AddStatFn& add_stat) override;
 
+    void getAggregatedVBucketMetrics(
+            cb::metrics::Collector& collector) override;
+
     void completeBGFetchMulti(Vbid vbId,
                               std::vector<bgfetched_item_t>& fetchedItems,
                               std::chrono::steady_clock::time_point start) override;
@@ -494,6 +521,13 @@ public:
     /// Wake up the ItemFreqDecayer Task, scheduling it for immediate run.
     void wakeItemFreqDecayerTask();
 
+    /**
+     * Register the expiry time of a SyncWrite with the DurabilityTimeoutTask,
+     * so it runs for the given vBucket once the SyncWrite times out.
+     */
+    void scheduleDurabilityTimeout(Vbid vbid,
+                                   std::chrono::steady_clock::time_point expiry);
+
     void enableAccessScannerTask() override;
     void disableAccessScannerTask() override;
     void setAccessScannerSleeptime(size_t val, bool useStartTime) override;
@@ -505,6 +539,29 @@ public:
 
     void enableItemCompressor();
 
+    /**
+     * @return the dictionaries the ItemCompressor should compress documents
+     *         with, or null if documents should be compressed with Snappy
+     *         (item_compressor_algorithm).
+     */
+    CollectionDictionaries* getCompressionDictionaries();
+
+    /**
+     * Called when the ItemCompressor completes a pass with dictionaries;
+     * schedules the training of the dictionaries of the collections sampled.
+     *
+     * @param visitedCollections the collections of the documents visited
+     */
+    void itemCompressorPassCompleted(
+            const std::unordered_set<CollectionID>& visitedCollections);
+
+    /// Train the compression dictionaries of the collections sampled.
+    size_t trainCompressionDictionaries();
+
+    /// Forget the compression dictionary (and samples) of a dropped
+    /// collection.
+    void dropCompressionDictionary(CollectionID cid);
+
     void setAllBloomFilters(bool to) override;
 
     float getBfiltersResidencyThreshold() override {
@@ -664,6 +721,16 @@ public:
 
     void setXattrEnabled(bool value);
 
+    HotKeyCache& getHotKeyCache() {
+        return *hotKeyCache;
+    }
+
+    void setHotKeyCacheEnabled(bool value);
+
+    void setHtOptimisticReads(bool value) {
+        htOptimisticReads = value;
+    }
+
     /**
      * Returns the replication throttle instance
      *
@@ -686,6 +753,16 @@ protected:
                          ForGetReplicaOp getReplicaItem,
                          get_options_t options) override;
 
+    /**
+     * The part of getInternal() which runs once the vbucket has been
+     * found and its state lock acquired (by the caller).
+     */
+    GetValue getInternalLocked(VBucket& vb,
+                               const DocKey& key,
+                               const void* cookie,
+                               ForGetReplicaOp getReplicaItem,
+                               get_options_t options);
+
     bool resetVBucket_UNLOCKED(LockedVBucketPtr& vb,
                                std::unique_lock<std::mutex>& vbset);
 
@@ -719,6 +796,18 @@ protected:
     virtual std::unique_ptr<VBucketCountVisitor> makeVBCountVisitor(
             vbucket_state_t state);
 
+    /**
+     * Count the items in all vBuckets per vBucket state (updating the cached
+     * resident ratios and the replication throttle as a side effect), and
+     * invoke the callback with the visitors for the active, replica, pending
+     * and dead vBuckets.
+     */
+    void visitVBucketCounts(
+            std::function<void(VBucketCountVisitor& active,
+                               VBucketCountVisitor& replica,
+                               VBucketCountVisitor& pending,
+                               VBucketCountVisitor& dead)> callback);
+
     /**
      * Helper method used by getAggregatedVBucketStats to output aggregated
      * bucket stats.
@@ -760,6 +849,10 @@ protected:
     float                           bfilterResidencyThreshold;
     ExTask                          defragmenterTask;
     ExTask itemCompressorTask;
+    ExTask hashTableMaintenanceTask;
+    // The per-collection dictionaries used by the ItemCompressor when
+    // item_compressor_algorithm is zstd_dictionary.
+    std::unique_ptr<CollectionDictionaries> compressionDictionaries;
     // The itemFreqDecayerTask is used to decay the frequency count of items
     // stored in the hash table.  This is required to ensure that all the
     // frequency counts do not become saturated.
@@ -769,7 +862,7 @@ protected:
 
     // Responsible for enforcing the Durability Timeout for the SyncWrites
     // tracked in this KVBucket.
-    ExTask durabilityTimeoutTask;
+    std::shared_ptr<DurabilityTimeoutTask> durabilityTimeoutTask;
 
     /// Responsible for completing (commiting or aborting SyncWrites which have
     /// completed in this KVBucket.
@@ -822,6 +915,13 @@ protected:
      */
     cb::RelaxedAtomic<bool> xattrEnabled;
 
+    /// Snapshots of the hottest keys, used if hotKeyCacheEnabled
+    std::unique_ptr<HotKeyCache> hotKeyCache;
+    cb::RelaxedAtomic<bool> hotKeyCacheEnabled;
+
+    /// Should GETs read the HashTable optimistically (ht_optimistic_reads)?
+    cb::RelaxedAtomic<bool> htOptimisticReads;
+
     /* Contains info about throttling the replication */
     std::unique_ptr<ReplicationThrottle> replicationThrottle;
 
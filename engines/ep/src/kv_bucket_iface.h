@@ -43,9 +43,22 @@ class Warmup;
 namespace Collections {
 class Manager;
 }
+namespace cb {
+namespace metrics {
+class Collector;
+}
+} // namespace cb
 
 using bgfetched_item_t = std::pair<DiskDocKey, const VBucketBGFetchItem*>;
 
+/// A single lookup in a batch passed to KVBucketIface::getMulti()
+struct GetMultiRequest {
+    const void* cookie;
+    DocKey key;
+    Vbid vbucket;
+    get_options_t options;
+};
+
 /**
  * This is the abstract base class that manages the bucket behavior in
  * ep-engine.
@@ -141,6 +154,20 @@ public:
                          const void* cookie,
                          get_options_t options) = 0;
 
+    /**
+     * Retrieve a batch of values.
+     *
+     * Equivalent to calling get() for each request, but the lookups are
+     * grouped by vbucket so that each vbucket is looked up and
+     * state-locked once, and any background fetches required are issued
+     * as a single batch. Each key still takes its hash bucket lock.
+     *
+     * @param requests the lookups to perform
+     * @return the result of each lookup, in the same order as requests
+     */
+    virtual std::vector<GetValue> getMulti(
+            const std::vector<GetMultiRequest>& requests) = 0;
+
     /**
      * Retrieve a value randomly from the store.
      *
@@ -352,6 +379,13 @@ public:
     virtual void getAggregatedVBucketStats(const void* cookie,
                                            const AddStatFn& add_stat) = 0;
 
+    /**
+     * Add the summarized vBucket metrics for this bucket (the subset of
+     * getAggregatedVBucketStats() listed in ep_metrics.def) to the collector.
+     */
+    virtual void getAggregatedVBucketMetrics(
+            cb::metrics::Collector& collector) = 0;
+
     /**
      * Get file statistics
      *
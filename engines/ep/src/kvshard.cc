@@ -24,6 +24,7 @@
 #include "flusher.h"
 #include "kvshard.h"
 #include "kvstore.h"
+#include "log-kvstore/log-kvstore_config.h"
 #ifdef EP_USE_MAGMA
 #include "magma-kvstore/magma-kvstore_config.h"
 #endif
@@ -45,6 +46,10 @@ KVShard::KVShard(id_type numShards, id_type id, Configuration& config)
         auto stores = KVStoreFactory::create(*kvConfig);
         rwStore = std::move(stores.rw);
         roStore = std::move(stores.ro);
+    } else if (backend == "logstore") {
+        kvConfig = std::make_unique<LogKVStoreConfig>(config, numShards, id);
+        auto stores = KVStoreFactory::create(*kvConfig);
+        rwStore = std::move(stores.rw);
     }
 #ifdef EP_USE_MAGMA
     else if (backend == "magma") {
@@ -23,6 +23,8 @@
 #include "common.h"
 #include "couch-kvstore/couch-kvstore.h"
 #include "item.h"
+#include "log-kvstore/log-kvstore.h"
+#include "log-kvstore/log-kvstore_config.h"
 #include "vbucket_state.h"
 #ifdef EP_USE_MAGMA
 #include "magma-kvstore/magma-kvstore.h"
@@ -143,6 +145,10 @@ KVStoreRWRO KVStoreFactory::create(KVStoreConfig& config) {
         auto rw = std::make_unique<CouchKVStore>(config);
         auto ro = rw->makeReadOnlyStore();
         return {rw.release(), ro.release()};
+    } else if (backend == "logstore") {
+        auto rw = std::make_unique<LogKVStore>(
+                dynamic_cast<LogKVStoreConfig&>(config));
+        return {rw.release(), nullptr};
     }
 #ifdef EP_USE_MAGMA
     else if (backend == "magma") {
@@ -42,6 +42,9 @@ public:
         if (key == "couchstore_mprotect") {
             config.setCouchstoreMprotectEnabled(value);
         }
+        if (key == "couchstore_compaction_readahead") {
+            config.setCouchstoreCompactionReadahead(value);
+        }
     }
 
 private:
@@ -72,6 +75,10 @@ KVStoreConfig::KVStoreConfig(Configuration& config,
     config.addValueChangedListener(
             "couchstore_mprotect",
             std::make_unique<ConfigChangeListener>(*this));
+    setCouchstoreCompactionReadahead(config.isCouchstoreCompactionReadahead());
+    config.addValueChangedListener(
+            "couchstore_compaction_readahead",
+            std::make_unique<ConfigChangeListener>(*this));
 }
 
 KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
@@ -88,7 +95,8 @@ KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
       buffered(true),
       couchstoreTracingEnabled(false),
       couchstoreWriteValidationEnabled(false),
-      couchstoreMprotectEnabled(false) {
+      couchstoreMprotectEnabled(false),
+      couchstoreCompactionReadahead(false) {
 }
 
 KVStoreConfig::~KVStoreConfig() = default;
@@ -121,6 +121,14 @@ public:
         return couchstoreMprotectEnabled;
     }
 
+    void setCouchstoreCompactionReadahead(bool value) {
+        couchstoreCompactionReadahead = value;
+    }
+
+    bool getCouchstoreCompactionReadahead() const {
+        return couchstoreCompactionReadahead;
+    }
+
 private:
     class ConfigChangeListener;
 
@@ -148,4 +156,6 @@ private:
     std::atomic_bool couchstoreWriteValidationEnabled;
     /* enbale mprotect of couchstore internal io buffer */
     std::atomic_bool couchstoreMprotectEnabled;
+    /* advise sequential readahead of the compaction source file */
+    std::atomic_bool couchstoreCompactionReadahead;
 };
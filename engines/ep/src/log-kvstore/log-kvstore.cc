@@ -0,0 +1,3298 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "log-kvstore.h"
+#include "bucket_logger.h"
+#include "ep_time.h"
+#include "item.h"
+#include "kvstore_priv.h"
+#include "log-kvstore_config.h"
+#include "objectregistry.h"
+#include "statwriter.h"
+#include "vb_commit.h"
+#include "vbucket_state.h"
+
+extern "C" {
+#include "crc32.h"
+}
+
+#include <boost/optional.hpp>
+#include <folly/portability/Fcntl.h>
+#include <folly/portability/SysStat.h>
+#include <folly/portability/Unistd.h>
+#include <gsl/gsl>
+#include <mcbp/protocol/request.h>
+#include <nlohmann/json.hpp>
+#include <platform/dirutils.h>
+#include <platform/n_byte_integer.h>
+#include <utilities/logtags.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <shared_mutex>
+#include <system_error>
+#include <unordered_map>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+namespace logkv {
+
+/// Alignment (and granularity) of O_DIRECT writes
+static const size_t BlockSize = 4096;
+
+/// Size of the reads issued when replaying or compacting a segment
+static const size_t ReadChunkSize = 1024 * 1024;
+
+/// Upper bound on the size of a single record; anything larger is corrupt
+static const uint32_t MaxRecordSize = 64 * 1024 * 1024;
+
+/// Number of commit points kept in memory per vBucket for rollback
+static const size_t MaxCommitPoints = 1024;
+
+enum class RecordType : uint8_t {
+    /// A document; body is MetaData followed by the value
+    Document = 1,
+    /// A local (metadata) document; body is the value
+    Local = 2,
+    /// End of a batch; body is a CommitPayload
+    Commit = 3,
+};
+
+namespace RecordFlags {
+/// Local document tombstone
+static const uint8_t Deleted = 0x1;
+/// Commit record written by compaction (not a rollback point)
+static const uint8_t Compaction = 0x2;
+} // namespace RecordFlags
+
+#pragma pack(1)
+struct RecordHeader {
+    /// crc32 of the record, from the field following crc to the end
+    uint32_t crc;
+    /// Length of the whole record, including this header
+    uint32_t length;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t keyLen;
+    uint64_t lsn;
+};
+
+struct CommitPayload {
+    int64_t highSeqno;
+    /// Oldest LSN which can still be rolled back to (see VBLog)
+    uint64_t rollbackFloor;
+};
+
+struct RollbackMarker {
+    uint64_t first;
+    uint64_t last;
+    uint32_t crc;
+};
+
+// MetaData is used to serialize and de-serialize the metadata of a Document
+// record. The layout follows magmakv::MetaData without the fields which are
+// implied by the log (version and vbid).
+class MetaData {
+public:
+    // The Operation this represents - maps to queue_op types:
+    enum class Operation {
+        // A standard mutation (or deletion). Present in the 'normal'
+        // (committed) namespace.
+        Mutation,
+
+        // A prepared SyncWrite. `durability_level` field indicates the level
+        // Present in the DurabilityPrepare namespace.
+        PreparedSyncWrite,
+
+        // A committed SyncWrite.
+        // Present in the 'normal' (committed) namespace.
+        CommittedSyncWrite,
+
+        // An aborted SyncWrite.
+        // Present in the DurabilityPrepare namespace.
+        Abort,
+    };
+
+    MetaData() = default;
+
+    explicit MetaData(const Item& it)
+        : bySeqno(it.getBySeqno()),
+          cas(it.getCas()),
+          revSeqno(it.getRevSeqno()),
+          exptime(it.getExptime()),
+          flags(it.getFlags()),
+          valueSize(it.getNBytes()),
+          datatype(it.getDataType()),
+          prepareSeqno(it.getPrepareSeqno()) {
+        if (it.isDeleted()) {
+            deleted = 1;
+            deleteSource = static_cast<uint8_t>(it.deletionSource());
+        } else {
+            deleted = 0;
+            deleteSource = 0;
+        }
+        operation = static_cast<uint8_t>(toOperation(it.getOperation()));
+        durabilityLevel =
+                static_cast<uint8_t>(it.getDurabilityReqs().getLevel());
+    }
+
+    Operation getOperation() const {
+        return static_cast<Operation>(operation);
+    }
+
+    cb::durability::Level getDurabilityLevel() const {
+        return static_cast<cb::durability::Level>(durabilityLevel);
+    }
+
+    int64_t bySeqno;
+    uint64_t cas;
+    uint64_t revSeqno;
+    uint32_t exptime;
+    uint32_t flags;
+    uint32_t valueSize;
+    uint8_t datatype;
+    uint8_t deleted : 1;
+    uint8_t deleteSource : 1;
+    uint8_t operation : 2;
+    uint8_t durabilityLevel : 2;
+    cb::uint48_t prepareSeqno;
+
+private:
+    static Operation toOperation(queue_op op) {
+        switch (op) {
+        case queue_op::mutation:
+        case queue_op::system_event:
+            return Operation::Mutation;
+        case queue_op::pending_sync_write:
+            return Operation::PreparedSyncWrite;
+        case queue_op::commit_sync_write:
+            return Operation::CommittedSyncWrite;
+        case queue_op::abort_sync_write:
+            return Operation::Abort;
+        case queue_op::flush:
+        case queue_op::empty:
+        case queue_op::checkpoint_start:
+        case queue_op::checkpoint_end:
+        case queue_op::set_vbucket_state:
+            break;
+        }
+        throw std::invalid_argument(
+                "logkv::MetaData::toOperation: Unsupported op " +
+                std::to_string(static_cast<uint8_t>(op)));
+    }
+};
+#pragma pack()
+
+static_assert(sizeof(RecordHeader) == 20,
+              "logkv::RecordHeader is not the expected size.");
+static_assert(sizeof(CommitPayload) == 16,
+              "logkv::CommitPayload is not the expected size.");
+static_assert(sizeof(MetaData) == 44,
+              "logkv::MetaData is not the expected size.");
+
+/// A deletion, as opposed to a prepared SyncDelete (which is a live document)
+static bool isTombstone(const MetaData& meta) {
+    return meta.deleted &&
+           meta.getOperation() != MetaData::Operation::PreparedSyncWrite;
+}
+
+/// Append a record to the buffer, returning its offset within the buffer.
+static size_t appendRecord(std::vector<uint8_t>& buffer,
+                           RecordType type,
+                           uint8_t flags,
+                           uint64_t lsn,
+                           cb::const_char_buffer key,
+                           cb::const_char_buffer body,
+                           cb::const_char_buffer value = {}) {
+    RecordHeader header;
+    header.length = gsl::narrow<uint32_t>(sizeof(RecordHeader) + key.size() +
+                                          body.size() + value.size());
+    header.type = static_cast<uint8_t>(type);
+    header.flags = flags;
+    header.keyLen = gsl::narrow<uint16_t>(key.size());
+    header.lsn = lsn;
+    header.crc = 0;
+
+    const size_t offset = buffer.size();
+    buffer.resize(offset + header.length);
+    auto* record = buffer.data() + offset;
+    auto* p = record + sizeof(RecordHeader);
+    for (const auto& part : {key, body, value}) {
+        if (part.size()) {
+            std::memcpy(p, part.data(), part.size());
+            p += part.size();
+        }
+    }
+    std::memcpy(record, &header, sizeof(RecordHeader));
+    header.crc = crc32buf(record + sizeof(header.crc),
+                          header.length - sizeof(header.crc));
+    std::memcpy(record, &header.crc, sizeof(header.crc));
+    return offset;
+}
+
+/// A record inside a buffer which has passed its CRC check.
+struct Record {
+    RecordHeader header;
+    const uint8_t* data;
+
+    cb::const_char_buffer key() const {
+        return {reinterpret_cast<const char*>(data) + sizeof(RecordHeader),
+                header.keyLen};
+    }
+
+    cb::const_char_buffer body() const {
+        return {reinterpret_cast<const char*>(data) + sizeof(RecordHeader) +
+                        header.keyLen,
+                header.length - sizeof(RecordHeader) - header.keyLen};
+    }
+
+    /// Decode a Document record; @return false if malformed
+    bool decodeDocument(MetaData& meta, cb::const_char_buffer& value) const {
+        const auto b = body();
+        if (b.size() < sizeof(MetaData)) {
+            return false;
+        }
+        std::memcpy(&meta, b.data(), sizeof(MetaData));
+        if (meta.valueSize != b.size() - sizeof(MetaData)) {
+            return false;
+        }
+        value = {b.data() + sizeof(MetaData), meta.valueSize};
+        return true;
+    }
+
+    /// Decode a Commit record; @return false if malformed
+    bool decodeCommit(CommitPayload& payload) const {
+        const auto b = body();
+        if (b.size() != sizeof(CommitPayload)) {
+            return false;
+        }
+        std::memcpy(&payload, b.data(), sizeof(CommitPayload));
+        return true;
+    }
+};
+
+/**
+ * Validate the record at the start of the buffer.
+ * @return false if the buffer does not start with a complete, intact record
+ */
+static bool parseRecord(const uint8_t* data, size_t available, Record& record) {
+    if (available < sizeof(RecordHeader)) {
+        return false;
+    }
+    std::memcpy(&record.header, data, sizeof(RecordHeader));
+    const auto& header = record.header;
+    if (header.length < sizeof(RecordHeader) + header.keyLen ||
+        header.length > MaxRecordSize || header.length > available) {
+        return false;
+    }
+    // crc32buf takes a non-const pointer but does not modify the buffer
+    if (crc32buf(const_cast<uint8_t*>(data) + sizeof(header.crc),
+                 header.length - sizeof(header.crc)) != header.crc) {
+        return false;
+    }
+    record.data = data;
+    return true;
+}
+
+static void pwriteFully(int fd,
+                        const uint8_t* buf,
+                        size_t nbytes,
+                        uint64_t offset) {
+    while (nbytes > 0) {
+        auto written = pwrite(fd, buf, nbytes, offset);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(
+                    errno, std::system_category(), "pwrite failed");
+        }
+        buf += written;
+        nbytes -= written;
+        offset += written;
+    }
+}
+
+static void closeFd(int& fd) {
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+/// Make the creation of files in the directory durable.
+static void syncDirectory(const std::string& dir) {
+#ifndef WIN32
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd != -1) {
+        fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+/// A heap buffer whose data() is aligned to BlockSize, as O_DIRECT requires.
+class AlignedBuffer {
+public:
+    uint8_t* data() {
+        return aligned;
+    }
+
+    void reserve(size_t size) {
+        if (size > capacity) {
+            storage.resize(size + BlockSize);
+            auto address = reinterpret_cast<uintptr_t>(storage.data());
+            aligned = reinterpret_cast<uint8_t*>(
+                    (address + BlockSize - 1) & ~uintptr_t(BlockSize - 1));
+            capacity = size;
+        }
+    }
+
+    void release() {
+        storage = {};
+        aligned = nullptr;
+        capacity = 0;
+    }
+
+private:
+    std::vector<uint8_t> storage;
+    uint8_t* aligned{nullptr};
+    size_t capacity{0};
+};
+
+/**
+ * One segment file of a vBucket log. Records are only ever appended (at
+ * `size`, the end of the valid data) by a single writer; reads may be issued
+ * concurrently from any thread.
+ */
+class LogSegment {
+public:
+    /**
+     * @param create create a new (empty) file, opened for appends; otherwise
+     *        open an existing, sealed one
+     * @throws std::system_error if the file cannot be opened
+     */
+    LogSegment(std::string path, uint32_t id, bool create, bool directIo)
+        : path(std::move(path)), id(id) {
+        if (create) {
+            const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_BINARY;
+#ifdef O_DIRECT
+            if (directIo) {
+                writeFd = ::open(this->path.c_str(), flags | O_DIRECT, 0666);
+                direct = writeFd != -1;
+            }
+#else
+            (void)directIo;
+#endif
+            if (writeFd == -1) {
+                writeFd = ::open(this->path.c_str(), flags, 0666);
+            }
+            if (writeFd == -1) {
+                throw std::system_error(errno,
+                                        std::system_category(),
+                                        "LogSegment: failed to create " +
+                                                this->path);
+            }
+        } else {
+            sealed = true;
+        }
+
+        readFd = ::open(this->path.c_str(), O_RDONLY | O_BINARY);
+        if (readFd == -1) {
+            const auto error = errno;
+            closeFd(writeFd);
+            throw std::system_error(error,
+                                    std::system_category(),
+                                    "LogSegment: failed to open " + this->path);
+        }
+    }
+
+    ~LogSegment() {
+        closeFd(writeFd);
+        closeFd(readFd);
+    }
+
+    LogSegment(const LogSegment&) = delete;
+    LogSegment& operator=(const LogSegment&) = delete;
+
+    /**
+     * Append the data at the end of the segment.
+     * @return the number of bytes physically written (O_DIRECT writes
+     *         rewrite the partial tail block and are padded to BlockSize)
+     */
+    size_t append(const uint8_t* data, size_t length, FileStats& stats) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t offset = size;
+        size_t written = length;
+        if (direct) {
+            try {
+                written = appendDirect(data, length, offset);
+            } catch (const std::system_error& e) {
+                if (e.code().value() != EINVAL) {
+                    throw;
+                }
+                // The filesystem rejected the aligned write; carry on
+                // through the page cache.
+                reopenBuffered();
+                pwriteFully(writeFd, data, length, offset);
+            }
+        } else {
+            pwriteFully(writeFd, data, length, offset);
+        }
+        size = offset + length;
+
+        stats.writeTimeHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start));
+        stats.writeSizeHisto.add(written);
+        stats.totalBytesWritten += written;
+        return written;
+    }
+
+    void sync(FileStats& stats) {
+        const auto start = std::chrono::steady_clock::now();
+        int ret;
+#ifdef __linux__
+        while ((ret = fdatasync(writeFd)) == -1 && errno == EINTR) {
+        }
+#else
+        while ((ret = fsync(writeFd)) == -1 && errno == EINTR) {
+        }
+#endif
+        if (ret == -1) {
+            throw std::system_error(errno,
+                                    std::system_category(),
+                                    "LogSegment::sync: failed for " + path);
+        }
+        stats.syncTimeHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start));
+    }
+
+    /// @return the number of bytes read (less than length at end of file)
+    size_t read(uint64_t offset,
+                uint8_t* buf,
+                size_t length,
+                FileStats& stats) const {
+        const auto start = std::chrono::steady_clock::now();
+        size_t done = 0;
+        while (done < length) {
+            auto ret = pread(readFd, buf + done, length - done, offset + done);
+            if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno,
+                                        std::system_category(),
+                                        "LogSegment::read: failed for " + path);
+            }
+            if (ret == 0) {
+                break;
+            }
+            done += ret;
+        }
+        stats.readTimeHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start));
+        stats.readSizeHisto.add(done);
+        stats.totalBytesRead += done;
+        return done;
+    }
+
+    uint64_t getFileSize() const {
+        struct stat st;
+        if (fstat(readFd, &st) != 0) {
+            throw std::system_error(errno,
+                                    std::system_category(),
+                                    "LogSegment::getFileSize: failed for " +
+                                            path);
+        }
+        return st.st_size;
+    }
+
+    /// Discard anything written after offset (used after a failed append).
+    void truncate(uint64_t offset) {
+        if (ftruncate(writeFd, offset) != 0) {
+            throw std::system_error(errno,
+                                    std::system_category(),
+                                    "LogSegment::truncate: failed for " + path);
+        }
+    }
+
+    /// Stop appending to the segment; it is read-only from now on.
+    void seal() {
+        closeFd(writeFd);
+        staging.release();
+        tail.clear();
+        sealed = true;
+    }
+
+    void unlink() {
+        if (std::remove(path.c_str()) != 0 && errno != ENOENT) {
+            throw std::system_error(errno,
+                                    std::system_category(),
+                                    "LogSegment::unlink: failed for " + path);
+        }
+    }
+
+    const std::string path;
+    const uint32_t id;
+
+    /// End of the valid (committed) data
+    std::atomic<uint64_t> size{0};
+    /// Bytes of records which have been superseded
+    std::atomic<uint64_t> garbage{0};
+    /// No more appends; the segment may be compacted
+    std::atomic<bool> sealed{false};
+
+private:
+    size_t appendDirect(const uint8_t* data, size_t length, uint64_t offset) {
+        // The partial block at the end of the file is kept in memory and
+        // written again in front of the new data.
+        const uint64_t alignedOffset = offset & ~uint64_t(BlockSize - 1);
+        const size_t used = tail.size() + length;
+        const size_t total = (used + BlockSize - 1) & ~(BlockSize - 1);
+        staging.reserve(total);
+        auto* buf = staging.data();
+        if (!tail.empty()) {
+            std::memcpy(buf, tail.data(), tail.size());
+        }
+        std::memcpy(buf + tail.size(), data, length);
+        std::memset(buf + used, 0, total - used);
+        pwriteFully(writeFd, buf, total, alignedOffset);
+
+        const size_t partial = used % BlockSize;
+        tail.assign(buf + used - partial, buf + used);
+        return total;
+    }
+
+    void reopenBuffered() {
+        closeFd(writeFd);
+        writeFd = ::open(path.c_str(), O_WRONLY | O_BINARY);
+        if (writeFd == -1) {
+            throw std::system_error(errno,
+                                    std::system_category(),
+                                    "LogSegment: failed to reopen " + path);
+        }
+        direct = false;
+        staging.release();
+        tail.clear();
+    }
+
+    int readFd{-1};
+    int writeFd{-1};
+    bool direct{false};
+    AlignedBuffer staging;
+    std::vector<uint8_t> tail;
+};
+
+/**
+ * Sequentially reads the intact records of a segment, stopping at the first
+ * one which is incomplete or fails its CRC check.
+ */
+class SegmentReader {
+public:
+    SegmentReader(const LogSegment& segment, FileStats& stats, uint64_t limit)
+        : segment(segment), stats(stats), limit(limit) {
+    }
+
+    bool next() {
+        pos += consumed;
+        consumed = 0;
+        if (!fill(sizeof(RecordHeader))) {
+            return false;
+        }
+        RecordHeader header;
+        std::memcpy(&header, buffer.data() + pos, sizeof(RecordHeader));
+        if (header.length < sizeof(RecordHeader) ||
+            header.length > MaxRecordSize || !fill(header.length)) {
+            return false;
+        }
+        if (!parseRecord(buffer.data() + pos, end - pos, current)) {
+            return false;
+        }
+        consumed = header.length;
+        return true;
+    }
+
+    const Record& getRecord() const {
+        return current;
+    }
+
+    /// @return the offset in the segment of the current record
+    uint64_t getOffset() const {
+        return bufferStart + pos;
+    }
+
+private:
+    /// Make sure `needed` bytes from pos are in the buffer
+    bool fill(size_t needed) {
+        if (end - pos >= needed) {
+            return true;
+        }
+        if (pos > 0) {
+            std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+            bufferStart += pos;
+            end -= pos;
+            pos = 0;
+        }
+        if (buffer.size() < std::max(needed, ReadChunkSize)) {
+            buffer.resize(std::max(needed, ReadChunkSize));
+        }
+        while (end < needed) {
+            const uint64_t fileOffset = bufferStart + end;
+            if (fileOffset >= limit) {
+                return false;
+            }
+            const size_t want = std::min<uint64_t>(buffer.size() - end,
+                                                   limit - fileOffset);
+            const auto got =
+                    segment.read(fileOffset, buffer.data() + end, want, stats);
+            if (got == 0) {
+                return false;
+            }
+            end += got;
+        }
+        return true;
+    }
+
+    const LogSegment& segment;
+    FileStats& stats;
+    const uint64_t limit;
+    std::vector<uint8_t> buffer;
+    uint64_t bufferStart{0};
+    size_t pos{0};
+    size_t end{0};
+    size_t consumed{0};
+    Record current;
+};
+
+/// Location of the latest version of a document
+struct IndexEntry {
+    uint64_t lsn;
+    int64_t bySeqno;
+    uint64_t offset;
+    uint32_t segment;
+    uint32_t length;
+    bool deleted;
+};
+
+/// Location and (cached) value of the latest version of a local document
+struct LocalEntry {
+    uint64_t lsn;
+    uint64_t offset;
+    uint32_t segment;
+    uint32_t length;
+    bool deleted;
+    std::string value;
+};
+
+struct Location {
+    std::shared_ptr<LogSegment> segment;
+    uint64_t offset;
+    uint32_t length;
+};
+
+struct CommitPoint {
+    uint64_t lsn;
+    int64_t highSeqno;
+};
+
+/// A range of LSNs whose records must be ignored (rolled back)
+struct LsnRange {
+    bool contains(uint64_t lsn) const {
+        return lsn >= first && lsn <= last;
+    }
+
+    uint64_t first{1};
+    uint64_t last{0};
+};
+
+/**
+ * The serialised form of one write to a vBucket log: a sequence of records
+ * terminated by a Commit record, plus what is needed to apply the batch to
+ * the index once it is on disk.
+ */
+class LogBatch {
+public:
+    struct Entry {
+        std::string key;
+        size_t offset;
+        uint32_t length;
+        uint64_t lsn;
+        int64_t bySeqno;
+        bool deleted;
+        std::string value;
+    };
+
+    explicit LogBatch(std::atomic<uint64_t>& nextLsn) : nextLsn(nextLsn) {
+    }
+
+    void addDocument(std::string key,
+                     const MetaData& meta,
+                     cb::const_char_buffer value) {
+        const auto lsn = nextLsn++;
+        const auto offset = appendRecord(
+                buffer,
+                RecordType::Document,
+                0,
+                lsn,
+                {key.data(), key.size()},
+                {reinterpret_cast<const char*>(&meta), sizeof(MetaData)},
+                value);
+        const auto length = gsl::narrow<uint32_t>(buffer.size() - offset);
+        documents.push_back(Entry{std::move(key),
+                                  offset,
+                                  length,
+                                  lsn,
+                                  meta.bySeqno,
+                                  meta.deleted != 0,
+                                  {}});
+    }
+
+    void addLocal(std::string key, std::string value, bool deleted = false) {
+        const auto lsn = nextLsn++;
+        const auto offset =
+                appendRecord(buffer,
+                             RecordType::Local,
+                             deleted ? RecordFlags::Deleted : 0,
+                             lsn,
+                             {key.data(), key.size()},
+                             {value.data(), value.size()});
+        const auto length = gsl::narrow<uint32_t>(buffer.size() - offset);
+        locals.push_back(Entry{std::move(key),
+                               offset,
+                               length,
+                               lsn,
+                               0,
+                               deleted,
+                               std::move(value)});
+    }
+
+    void setVBState(const vbucket_state& state);
+
+    void addCommit(int64_t highSeqno, uint64_t rollbackFloor) {
+        commitLsn = nextLsn++;
+        CommitPayload payload{highSeqno, rollbackFloor};
+        appendRecord(buffer,
+                     RecordType::Commit,
+                     commitFlags,
+                     commitLsn,
+                     {},
+                     {reinterpret_cast<const char*>(&payload),
+                      sizeof(payload)});
+    }
+
+    std::vector<uint8_t> buffer;
+    std::vector<Entry> documents;
+    std::vector<Entry> locals;
+    boost::optional<vbucket_state> vbstate;
+    uint64_t commitLsn{0};
+    uint8_t commitFlags{0};
+
+private:
+    std::atomic<uint64_t>& nextLsn;
+};
+
+// Keys of local documents
+static const std::string vbstateKey = "_vbstate";
+static const std::string manifestKey = "_collections/manifest";
+static const std::string openCollectionsKey = "_collections/open";
+static const std::string openScopesKey = "_scopes/open";
+static const std::string droppedCollectionsKey = "_collections/dropped";
+
+void LogBatch::setVBState(const vbucket_state& state) {
+    nlohmann::json j = state;
+    addLocal(vbstateKey, j.dump());
+    vbstate = state;
+}
+
+/**
+ * The log of one vBucket: its segments and the in-memory index over them.
+ *
+ * Records carry a log sequence number (LSN) which increases with every
+ * record written; when the same key appears more than once (in any segment)
+ * the record with the highest LSN is the current one. This is what allows
+ * compaction to copy records into new segments in any order.
+ *
+ * Rollback: the vBucket can be rolled back to any retained commit point,
+ * which is done by replaying the log ignoring records above the commit's
+ * LSN. Compaction discards superseded versions, so every time it drops a
+ * record it raises rollbackFloor to the LSN of the record which superseded
+ * it (or to the current LSN when purging); commit points below the floor
+ * can no longer be reconstructed. Superseded local documents are kept
+ * instead while a commit point made before they were replaced is retained,
+ * so compacting away old vbstates doesn't by itself prevent rollback.
+ *
+ * Locking: compactionMutex -> writeMutex -> indexMutex.
+ */
+class VBLog {
+public:
+    using KeyIndex = std::map<std::string, IndexEntry>;
+
+    VBLog(Vbid vbid, uint64_t revision) : vbid(vbid), revision(revision) {
+    }
+
+    /// Make entry the current version of key if it is newer.
+    void applyDocument(const std::string& key, const IndexEntry& entry) {
+        auto it = keys.find(key);
+        if (it != keys.end()) {
+            if (it->second.lsn >= entry.lsn) {
+                addGarbage(entry.segment, entry.length);
+                return;
+            }
+            addGarbage(it->second.segment, it->second.length);
+            unlinkDocument(it);
+            it->second = entry;
+        } else {
+            it = keys.emplace(key, entry).first;
+        }
+        if (entry.deleted) {
+            ++deletedCount;
+        } else {
+            ++itemCount;
+        }
+        bySeqno[entry.bySeqno] = it;
+    }
+
+    void applyLocal(const std::string& key, LocalEntry entry) {
+        auto it = localDocs.find(key);
+        if (it != localDocs.end()) {
+            if (it->second.lsn >= entry.lsn) {
+                addGarbage(entry.segment, entry.length);
+                return;
+            }
+            addGarbage(it->second.segment, it->second.length);
+            it->second = std::move(entry);
+        } else {
+            localDocs.emplace(key, std::move(entry));
+        }
+    }
+
+    /// Drop the document from the index (it has been purged).
+    void removeDocument(KeyIndex::iterator it) {
+        unlinkDocument(it);
+        keys.erase(it);
+    }
+
+    void addCommitPoint(uint64_t lsn, int64_t highSeqno) {
+        commitPoints.push_back({lsn, highSeqno});
+        if (commitPoints.size() > MaxCommitPoints) {
+            // Keep recent history dense: thin out the older half.
+            std::deque<CommitPoint> thinned;
+            const auto half = commitPoints.size() / 2;
+            for (size_t ii = 0; ii < commitPoints.size(); ++ii) {
+                if (ii >= half || ii % 2 == 0) {
+                    thinned.push_back(commitPoints[ii]);
+                }
+            }
+            commitPoints.swap(thinned);
+        }
+    }
+
+    void clearIndex() {
+        keys.clear();
+        bySeqno.clear();
+        localDocs.clear();
+        commitPoints.clear();
+        rollbackFloor = 0;
+        itemCount = 0;
+        deletedCount = 0;
+        persisted = vbucket_state{};
+    }
+
+    /// @return false if the key has no document (deleted or not)
+    bool find(const std::string& key, Location& location) {
+        std::shared_lock<std::shared_timed_mutex> lock(indexMutex);
+        auto it = keys.find(key);
+        if (it == keys.end()) {
+            return false;
+        }
+        location = {segments.at(it->second.segment),
+                    it->second.offset,
+                    it->second.length};
+        return true;
+    }
+
+    DBFileInfo getFileInfo() {
+        std::shared_lock<std::shared_timed_mutex> lock(indexMutex);
+        DBFileInfo info;
+        for (const auto& segment : segments) {
+            info.fileSize += segment.second->size;
+            info.spaceUsed += segment.second->size - segment.second->garbage;
+        }
+        return info;
+    }
+
+    const Vbid vbid;
+    const uint64_t revision;
+
+    // Everything below up to writeMutex is guarded by indexMutex
+    std::shared_timed_mutex indexMutex;
+    KeyIndex keys;
+    std::map<int64_t, KeyIndex::iterator> bySeqno;
+    std::map<std::string, LocalEntry> localDocs;
+    std::map<uint32_t, std::shared_ptr<LogSegment>> segments;
+    std::deque<CommitPoint> commitPoints;
+    uint64_t rollbackFloor{0};
+    size_t itemCount{0};
+    size_t deletedCount{0};
+    /// The vbucket_state which is on disk (the cached one may be ahead)
+    vbucket_state persisted;
+
+    /// Serialises appends; also guards `active`
+    std::mutex writeMutex;
+    std::shared_ptr<LogSegment> active;
+
+    /// Held for the duration of a compaction or rollback
+    std::mutex compactionMutex;
+
+    std::atomic<uint64_t> nextLsn{1};
+    std::atomic<uint32_t> nextSegmentId{0};
+    /// Set when the vBucket is deleted; writers and compactors give up
+    std::atomic<bool> dropped{false};
+
+private:
+    void unlinkDocument(KeyIndex::iterator it) {
+        if (it->second.deleted) {
+            --deletedCount;
+        } else {
+            --itemCount;
+        }
+        auto seq = bySeqno.find(it->second.bySeqno);
+        if (seq != bySeqno.end() && seq->second == it) {
+            bySeqno.erase(seq);
+        }
+    }
+
+    void addGarbage(uint32_t segment, uint32_t length) {
+        auto it = segments.find(segment);
+        if (it != segments.end()) {
+            it->second->garbage += length;
+        }
+    }
+};
+
+/**
+ * Writes the records kept by a compaction into new segments, rolling over
+ * to a new segment at the configured segment size.
+ */
+class CompactionWriter {
+public:
+    CompactionWriter(std::function<std::shared_ptr<LogSegment>()> newSegment,
+                     size_t segmentSize,
+                     FileStats& stats)
+        : newSegment(std::move(newSegment)),
+          segmentSize(segmentSize),
+          stats(stats) {
+    }
+
+    Location add(const Record& record) {
+        if (!current) {
+            current = newSegment();
+            segments.push_back(current);
+        }
+        Location location{
+                current, current->size + buffer.size(), record.header.length};
+        buffer.insert(buffer.end(),
+                      record.data,
+                      record.data + record.header.length);
+        if (buffer.size() >= ReadChunkSize) {
+            flush();
+        }
+        if (current->size + buffer.size() >= segmentSize) {
+            finishSegment();
+        }
+        return location;
+    }
+
+    void finish() {
+        if (current) {
+            finishSegment();
+        }
+    }
+
+    /// Floor recorded in the Commit record ending each segment
+    uint64_t rollbackFloor{0};
+    std::vector<std::shared_ptr<LogSegment>> segments;
+
+private:
+    void flush() {
+        if (!buffer.empty()) {
+            current->append(buffer.data(), buffer.size(), stats);
+            buffer.clear();
+        }
+    }
+
+    void finishSegment() {
+        CommitPayload payload{0, rollbackFloor};
+        appendRecord(buffer,
+                     RecordType::Commit,
+                     RecordFlags::Compaction,
+                     0,
+                     {},
+                     {reinterpret_cast<const char*>(&payload),
+                      sizeof(payload)});
+        flush();
+        current->sync(stats);
+        current->seal();
+        current.reset();
+    }
+
+    std::function<std::shared_ptr<LogSegment>()> newSegment;
+    const size_t segmentSize;
+    FileStats& stats;
+    std::shared_ptr<LogSegment> current;
+    std::vector<uint8_t> buffer;
+};
+
+static bool parseSegmentName(const std::string& name,
+                             uint16_t& vbid,
+                             uint64_t& revision,
+                             uint32_t& segment) {
+    // <vbid>.<revision>.<segment>.log
+    std::vector<uint64_t> parts;
+    size_t start = 0;
+    for (int ii = 0; ii < 3; ++ii) {
+        const auto dot = name.find('.', start);
+        if (dot == std::string::npos || dot == start) {
+            return false;
+        }
+        const auto part = name.substr(start, dot - start);
+        if (part.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        parts.push_back(std::stoull(part));
+        start = dot + 1;
+    }
+    if (name.substr(start) != "log" ||
+        parts[0] > std::numeric_limits<uint16_t>::max() ||
+        parts[2] > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+    vbid = gsl::narrow<uint16_t>(parts[0]);
+    revision = parts[1];
+    segment = gsl::narrow<uint32_t>(parts[2]);
+    return true;
+}
+
+static void writeRollbackMarker(const std::string& path,
+                                const LsnRange& range) {
+    RollbackMarker marker{range.first, range.last, 0};
+    marker.crc = crc32buf(reinterpret_cast<uint8_t*>(&marker),
+                          offsetof(RollbackMarker, crc));
+    int fd = ::open(
+            path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (fd == -1) {
+        throw std::system_error(errno,
+                                std::system_category(),
+                                "writeRollbackMarker: failed to create " +
+                                        path);
+    }
+    try {
+        pwriteFully(fd, reinterpret_cast<uint8_t*>(&marker), sizeof(marker), 0);
+        if (fsync(fd) != 0) {
+            throw std::system_error(errno,
+                                    std::system_category(),
+                                    "writeRollbackMarker: fsync failed");
+        }
+    } catch (const std::system_error&) {
+        closeFd(fd);
+        std::remove(path.c_str());
+        throw;
+    }
+    closeFd(fd);
+}
+
+/// @return false if there is no (valid) rollback marker at path
+static bool readRollbackMarker(const std::string& path, LsnRange& range) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_BINARY);
+    if (fd == -1) {
+        return false;
+    }
+    RollbackMarker marker;
+    const bool valid =
+            pread(fd, &marker, sizeof(marker), 0) == sizeof(marker) &&
+            crc32buf(reinterpret_cast<uint8_t*>(&marker),
+                     offsetof(RollbackMarker, crc)) == marker.crc;
+    closeFd(fd);
+    if (valid) {
+        range.first = marker.first;
+        range.last = marker.last;
+    }
+    return valid;
+}
+
+} // namespace logkv
+
+using namespace logkv;
+
+static std::string toKeyString(const DiskDocKey& key) {
+    return {reinterpret_cast<const char*>(key.data()), key.size()};
+}
+
+static std::unique_ptr<Item> makeItem(Vbid vb,
+                                      cb::const_char_buffer keyBuf,
+                                      const MetaData& meta,
+                                      cb::const_char_buffer value,
+                                      GetMetaOnly getMetaOnly) {
+    const DiskDocKey key{keyBuf.data(), keyBuf.size()};
+    const bool includeValue = getMetaOnly == GetMetaOnly::No && meta.valueSize;
+
+    auto item = std::make_unique<Item>(key.getDocKey(),
+                                       meta.flags,
+                                       meta.exptime,
+                                       includeValue ? value.data() : nullptr,
+                                       includeValue ? meta.valueSize : 0,
+                                       meta.datatype,
+                                       meta.cas,
+                                       meta.bySeqno,
+                                       vb,
+                                       meta.revSeqno);
+
+    if (meta.deleted) {
+        item->setDeleted(static_cast<DeleteSource>(meta.deleteSource));
+    }
+
+    switch (meta.getOperation()) {
+    case MetaData::Operation::Mutation:
+        // Item already defaults to Mutation - nothing else to do.
+        return item;
+    case MetaData::Operation::PreparedSyncWrite:
+        // From disk we return a zero (infinite) timeout; as this could
+        // refer to an already-committed SyncWrite and hence timeout
+        // must be ignored.
+        item->setPendingSyncWrite({meta.getDurabilityLevel(),
+                                   cb::durability::Timeout::Infinity()});
+        return item;
+    case MetaData::Operation::CommittedSyncWrite:
+        item->setCommittedviaPrepareSyncWrite();
+        item->setPrepareSeqno(meta.prepareSeqno);
+        return item;
+    case MetaData::Operation::Abort:
+        item->setAbortSyncWrite();
+        item->setPrepareSeqno(meta.prepareSeqno);
+        return item;
+    }
+
+    throw std::logic_error("LogKVStore makeItem: unexpected operation:" +
+                           std::to_string(meta.operation));
+}
+
+/**
+ * Class representing a document to be persisted in the log.
+ */
+class LogRequest : public IORequest {
+public:
+    LogRequest(const Item& item, MutationRequestCallback callback)
+        : IORequest(std::move(callback), DiskDocKey{item}),
+          docMeta(item),
+          docBody(item.getValue()) {
+    }
+
+    const MetaData& getDocMeta() const {
+        return docMeta;
+    }
+
+    std::string getKeyString() const {
+        return toKeyString(key);
+    }
+
+    size_t getKeyLen() const {
+        return key.size();
+    }
+
+    cb::const_char_buffer getValue() const {
+        if (!docBody) {
+            return {};
+        }
+        return {docBody->getData(), docBody->valueSize()};
+    }
+
+    size_t getBodySize() const {
+        return docBody ? docBody->valueSize() : 0;
+    }
+
+    void markOldItemExists() {
+        itemOldExists = true;
+    }
+
+    bool oldItemExists() const {
+        return itemOldExists;
+    }
+
+    void markOldItemIsDelete() {
+        itemOldIsDelete = true;
+    }
+
+    bool oldItemIsDelete() const {
+        return itemOldIsDelete;
+    }
+
+private:
+    MetaData docMeta;
+    value_t docBody;
+    bool itemOldExists{false};
+    bool itemOldIsDelete{false};
+};
+
+/**
+ * Scan over a point-in-time copy of the by-seqno index. The segments are
+ * held so that compaction can't remove them while the scan is running.
+ */
+class LogScanContext : public ScanContext {
+public:
+    struct Entry {
+        int64_t bySeqno;
+        uint64_t offset;
+        uint32_t segment;
+        uint32_t length;
+    };
+
+    LogScanContext(std::shared_ptr<StatusCallback<GetValue>> cb,
+                   std::shared_ptr<StatusCallback<CacheLookup>> cl,
+                   Vbid vbid,
+                   size_t id,
+                   int64_t start,
+                   int64_t end,
+                   uint64_t purgeSeqno,
+                   DocumentFilter _docFilter,
+                   ValueFilter _valFilter,
+                   uint64_t _documentCount,
+                   const vbucket_state& vbucketState,
+                   const KVStoreConfig& _config,
+                   const std::vector<Collections::KVStore::DroppedCollection>&
+                           droppedCollections,
+                   std::vector<Entry> entries,
+                   std::map<uint32_t, std::shared_ptr<LogSegment>> segments)
+        : ScanContext(cb,
+                      cl,
+                      vbid,
+                      id,
+                      start,
+                      end,
+                      purgeSeqno,
+                      _docFilter,
+                      _valFilter,
+                      _documentCount,
+                      vbucketState,
+                      _config,
+                      droppedCollections),
+          entries(std::move(entries)),
+          segments(std::move(segments)) {
+    }
+
+    const std::vector<Entry> entries;
+    const std::map<uint32_t, std::shared_ptr<LogSegment>> segments;
+};
+
+LogKVStore::LogKVStore(LogKVStoreConfig& config)
+    : KVStore(config),
+      logConfig(config),
+      dbPath(config.getDBName() + "/logstore." +
+             std::to_string(config.getShardId())),
+      vbLogs(config.getMaxVBuckets()),
+      vbRevisions(config.getMaxVBuckets()),
+      pendingReqs(std::make_unique<PendingRequestQueue>()),
+      in_transaction(false),
+      scanCounter(0),
+      logger(config.getLogger()) {
+    cachedVBStates.resize(config.getMaxVBuckets());
+    createDataDir(dbPath);
+    openVBLogs();
+
+    auto engine = ObjectRegistry::getCurrentEngine();
+    compactorThread = std::thread([this, engine]() {
+        ObjectRegistry::onSwitchThread(engine, false);
+        runBackgroundCompactor();
+        ObjectRegistry::onSwitchThread(nullptr);
+    });
+}
+
+LogKVStore::~LogKVStore() {
+    {
+        std::lock_guard<std::mutex> lh(compactorMutex);
+        compactorShutdown = true;
+    }
+    compactorCv.notify_one();
+    compactorThread.join();
+}
+
+std::string LogKVStore::getSegmentPath(Vbid vbid,
+                                       uint64_t revision,
+                                       uint32_t segment) const {
+    return dbPath + "/" + std::to_string(vbid.get()) + "." +
+           std::to_string(revision) + "." + std::to_string(segment) + ".log";
+}
+
+std::string LogKVStore::getRollbackMarkerPath(Vbid vbid,
+                                              uint64_t revision) const {
+    return dbPath + "/" + std::to_string(vbid.get()) + "." +
+           std::to_string(revision) + ".rollback";
+}
+
+void LogKVStore::removeSegmentFiles(Vbid vbid, uint64_t revision) {
+    const auto prefix = dbPath + "/" + std::to_string(vbid.get()) + "." +
+                        std::to_string(revision) + ".";
+    for (const auto& file : cb::io::findFilesWithPrefix(prefix)) {
+        if (std::remove(file.c_str()) != 0) {
+            logger.warn("LogKVStore::removeSegmentFiles: remove error:{}, {}",
+                        errno,
+                        file);
+        }
+    }
+}
+
+std::shared_ptr<VBLog> LogKVStore::getVBLog(Vbid vbid) {
+    std::lock_guard<std::mutex> lock(vbLogsMutex);
+    return vbLogs[vbid.get()];
+}
+
+std::shared_ptr<VBLog> LogKVStore::getOrCreateVBLog(Vbid vbid) {
+    std::lock_guard<std::mutex> lock(vbLogsMutex);
+    auto& log = vbLogs[vbid.get()];
+    if (!log) {
+        log = std::make_shared<VBLog>(vbid, vbRevisions[vbid.get()]);
+    }
+    return log;
+}
+
+void LogKVStore::dropVBLog(VBLog& log) {
+    log.dropped = true;
+    std::lock_guard<std::mutex> compactionLock(log.compactionMutex);
+    std::lock_guard<std::mutex> writeLock(log.writeMutex);
+    if (log.active) {
+        log.active->seal();
+        log.active.reset();
+    }
+}
+
+std::shared_ptr<LogSegment> LogKVStore::createSegment(VBLog& log) {
+    const auto id = log.nextSegmentId++;
+    auto segment = std::make_shared<LogSegment>(
+            getSegmentPath(log.vbid, log.revision, id),
+            id,
+            true,
+            logConfig.getDirectIo());
+    syncDirectory(dbPath);
+    return segment;
+}
+
+void LogKVStore::openVBLogs() {
+    // vbid -> revision -> (segment id, path)
+    std::map<uint16_t,
+             std::map<uint64_t, std::vector<std::pair<uint32_t, std::string>>>>
+            found;
+    for (const auto& path : cb::io::findFilesContaining(dbPath, ".log")) {
+        uint16_t vb;
+        uint64_t revision;
+        uint32_t segment;
+        if (!parseSegmentName(cb::io::basename(path), vb, revision, segment) ||
+            vb >= vbLogs.size()) {
+            logger.warn("LogKVStore::openVBLogs: ignoring unexpected file {}",
+                        path);
+            continue;
+        }
+        found[vb][revision].emplace_back(segment, path);
+    }
+
+    for (auto& vbEntry : found) {
+        const Vbid vbid(vbEntry.first);
+        auto& revisions = vbEntry.second;
+
+        // Older revisions belong to deleted vBuckets whose files were not
+        // removed before shutdown.
+        const auto revision = revisions.rbegin()->first;
+        for (const auto& old : revisions) {
+            if (old.first != revision) {
+                removeSegmentFiles(vbid, old.first);
+            }
+        }
+
+        auto log = std::make_shared<VBLog>(vbid, revision);
+        uint32_t maxSegment = 0;
+        for (const auto& file : revisions.rbegin()->second) {
+            log->segments[file.first] = std::make_shared<LogSegment>(
+                    file.second, file.first, false, false);
+            maxSegment = std::max(maxSegment, file.first);
+        }
+        log->nextSegmentId = maxSegment + 1;
+
+        LsnRange discard;
+        const auto markerPath = getRollbackMarkerPath(vbid, revision);
+        const bool rollbackPending = readRollbackMarker(markerPath, discard);
+
+        replay(*log, discard);
+
+        // Segments without a single complete batch hold nothing
+        for (auto it = log->segments.begin(); it != log->segments.end();) {
+            if (it->second->size == 0) {
+                it->second->unlink();
+                it = log->segments.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (rollbackPending) {
+            // Finish the interrupted rollback by rewriting the segments
+            // without the rolled back records.
+            std::vector<std::shared_ptr<LogSegment>> segments;
+            for (const auto& segment : log->segments) {
+                segments.push_back(segment.second);
+            }
+            std::lock_guard<std::mutex> compactionLock(log->compactionMutex);
+            if (compactSegments(*log, segments, nullptr)) {
+                std::remove(markerPath.c_str());
+            }
+        }
+
+        vbRevisions[vbid.get()] = revision;
+        if (readVBState(*log)) {
+            ++st.numLoadedVb;
+        } else {
+            logger.warn("LogKVStore::openVBLogs: {} has no vbstate", vbid);
+        }
+        vbLogs[vbid.get()] = std::move(log);
+    }
+}
+
+void LogKVStore::replay(VBLog& log, const LsnRange& discard) {
+    log.clearIndex();
+
+    uint64_t maxLsn = 0;
+    std::vector<CommitPoint> commitPoints;
+    // Bytes of Commit records per segment; not counted as garbage
+    std::unordered_map<uint32_t, uint64_t> overhead;
+
+    for (auto& entry : log.segments) {
+        auto& segment = *entry.second;
+        SegmentReader reader(segment, st.fsStats, segment.getFileSize());
+        // Records of the batch being read; applied once its Commit record
+        // has been read.
+        std::vector<std::pair<Record, uint64_t>> pending;
+        std::vector<std::vector<uint8_t>> pendingData;
+        uint64_t validEnd = 0;
+
+        while (reader.next()) {
+            const auto& record = reader.getRecord();
+            const auto& header = record.header;
+            maxLsn = std::max(maxLsn, header.lsn);
+
+            if (header.type != static_cast<uint8_t>(RecordType::Commit)) {
+                // The reader's buffer is reused, so keep a copy
+                pendingData.emplace_back(record.data,
+                                         record.data + header.length);
+                Record copy{header, pendingData.back().data()};
+                pending.emplace_back(copy, reader.getOffset());
+                continue;
+            }
+
+            CommitPayload payload;
+            if (!record.decodeCommit(payload)) {
+                break;
+            }
+            validEnd = reader.getOffset() + header.length;
+            overhead[segment.id] += header.length;
+
+            for (const auto& p : pending) {
+                const auto& rec = p.first;
+                if (discard.contains(rec.header.lsn)) {
+                    continue;
+                }
+                const auto key = rec.key();
+                if (rec.header.type ==
+                    static_cast<uint8_t>(RecordType::Document)) {
+                    MetaData meta;
+                    cb::const_char_buffer value;
+                    if (!rec.decodeDocument(meta, value)) {
+                        continue;
+                    }
+                    log.applyDocument({key.data(), key.size()},
+                                      IndexEntry{rec.header.lsn,
+                                                 meta.bySeqno,
+                                                 p.second,
+                                                 segment.id,
+                                                 rec.header.length,
+                                                 meta.deleted != 0});
+                } else if (rec.header.type ==
+                           static_cast<uint8_t>(RecordType::Local)) {
+                    const auto body = rec.body();
+                    log.applyLocal(
+                            {key.data(), key.size()},
+                            LocalEntry{rec.header.lsn,
+                                       p.second,
+                                       segment.id,
+                                       rec.header.length,
+                                       (rec.header.flags &
+                                        RecordFlags::Deleted) != 0,
+                                       {body.data(), body.size()}});
+                }
+            }
+            pending.clear();
+            pendingData.clear();
+
+            if (!discard.contains(header.lsn)) {
+                log.rollbackFloor =
+                        std::max(log.rollbackFloor, payload.rollbackFloor);
+                if (!(header.flags & RecordFlags::Compaction)) {
+                    commitPoints.push_back({header.lsn, payload.highSeqno});
+                }
+            }
+        }
+        // Anything after the last Commit record is a torn write
+        segment.size = validEnd;
+    }
+
+    std::sort(commitPoints.begin(),
+              commitPoints.end(),
+              [](const CommitPoint& a, const CommitPoint& b) {
+                  return a.lsn < b.lsn;
+              });
+    for (const auto& point : commitPoints) {
+        log.addCommitPoint(point.lsn, point.highSeqno);
+    }
+    log.nextLsn = std::max(log.nextLsn.load(), maxLsn + 1);
+
+    // Everything in a segment which isn't live (or a Commit record) is
+    // garbage.
+    std::unordered_map<uint32_t, uint64_t> live = overhead;
+    for (const auto& key : log.keys) {
+        live[key.second.segment] += key.second.length;
+    }
+    for (const auto& local : log.localDocs) {
+        live[local.second.segment] += local.second.length;
+    }
+    for (auto& segment : log.segments) {
+        const auto size = segment.second->size.load();
+        segment.second->garbage = size - std::min(size, live[segment.first]);
+    }
+}
+
+bool LogKVStore::readVBState(VBLog& log) {
+    std::string value;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(log.indexMutex);
+        auto it = log.localDocs.find(vbstateKey);
+        if (it == log.localDocs.end() || it->second.deleted) {
+            return false;
+        }
+        value = it->second.value;
+    }
+
+    vbucket_state state;
+    try {
+        state = nlohmann::json::parse(value).get<vbucket_state>();
+    } catch (const std::exception& e) {
+        logger.warn(
+                "LogKVStore::readVBState: {} failed to parse the vbstate json "
+                "doc: {}. Reason: {}",
+                log.vbid,
+                value,
+                e.what());
+        return false;
+    }
+
+    {
+        std::lock_guard<std::shared_timed_mutex> lock(log.indexMutex);
+        log.persisted = state;
+    }
+    cachedVBStates[log.vbid.get()] = std::make_unique<vbucket_state>(state);
+    return true;
+}
+
+std::string LogKVStore::readLocalDoc(VBLog& log, const std::string& key) {
+    std::shared_lock<std::shared_timed_mutex> lock(log.indexMutex);
+    auto it = log.localDocs.find(key);
+    if (it == log.localDocs.end() || it->second.deleted) {
+        return {};
+    }
+    return it->second.value;
+}
+
+bool LogKVStore::begin(std::unique_ptr<TransactionContext> txCtx) {
+    in_transaction = true;
+    transactionCtx = std::move(txCtx);
+    return in_transaction;
+}
+
+bool LogKVStore::commit(VB::Commit& commitData) {
+    // This behaviour is to replicate the one in Couchstore.
+    // If `commit` is called when not in transaction, just return true.
+    if (!in_transaction) {
+        logger.warn("LogKVStore::commit called not in transaction");
+        return true;
+    }
+
+    if (pendingReqs->empty()) {
+        in_transaction = false;
+        return true;
+    }
+
+    kvstats_ctx kvctx(commitData);
+    const auto vbid = transactionCtx->vbid;
+    auto log = getOrCreateVBLog(vbid);
+
+    const bool success = saveDocs(*log, commitData, kvctx, *pendingReqs);
+    if (!success) {
+        logger.warn("LogKVStore::commit: saveDocs failed for {}", vbid);
+    }
+
+    commitCallback(success, *pendingReqs);
+
+    // This behaviour is to replicate the one in Couchstore.
+    // Set `in_transanction = false` only if `commit` is successful.
+    if (success) {
+        in_transaction = false;
+        transactionCtx.reset();
+    }
+
+    pendingReqs->clear();
+    return success;
+}
+
+bool LogKVStore::saveDocs(VBLog& log,
+                          VB::Commit& commitData,
+                          kvstats_ctx& kvctx,
+                          PendingRequestQueue& commitBatch) {
+    std::lock_guard<std::mutex> writeLock(log.writeMutex);
+    if (log.dropped) {
+        logger.warn("LogKVStore::saveDocs: {} has been deleted", log.vbid);
+        return false;
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    LogBatch batch(log.nextLsn);
+    int64_t lastSeqno = 0;
+
+    // Count of logical bytes written (key + meta + value), used to
+    // calculate Write Amplification.
+    size_t docsLogicalBytes = 0;
+
+    // Keys written earlier in this batch (and whether they were deletes)
+    std::unordered_map<std::string, bool> batchKeys;
+
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(log.indexMutex);
+        for (auto& req : commitBatch) {
+            auto key = req.getKeyString();
+            const auto& meta = req.getDocMeta();
+            lastSeqno = std::max(lastSeqno, meta.bySeqno);
+
+            bool found = false;
+            bool tombstone = false;
+            auto inBatch = batchKeys.find(key);
+            if (inBatch != batchKeys.end()) {
+                found = true;
+                tombstone = inBatch->second;
+            } else {
+                auto it = log.keys.find(key);
+                if (it != log.keys.end()) {
+                    found = true;
+                    tombstone = it->second.deleted;
+                }
+            }
+            batchKeys[key] = meta.deleted != 0;
+
+            const auto& diskDocKey = req.getKey();
+            auto docKey = diskDocKey.getDocKey();
+
+            if (found) {
+                req.markOldItemExists();
+                if (tombstone) {
+                    req.markOldItemIsDelete();
+                    // Old item is a delete and new is an insert.
+                    if (!req.isDelete()) {
+                        if (diskDocKey.isCommitted()) {
+                            commitData.collections.incrementDiskCount(docKey);
+                        } else {
+                            kvctx.onDiskPrepareDelta++;
+                        }
+                    }
+                } else if (req.isDelete()) {
+                    // Old item is insert and new is delete.
+                    if (diskDocKey.isCommitted()) {
+                        commitData.collections.decrementDiskCount(docKey);
+                    } else {
+                        kvctx.onDiskPrepareDelta--;
+                    }
+                }
+            } else {
+                // Old item doesn't exist and new is an insert.
+                if (!req.isDelete()) {
+                    if (diskDocKey.isCommitted()) {
+                        commitData.collections.incrementDiskCount(docKey);
+                    } else {
+                        kvctx.onDiskPrepareDelta++;
+                    }
+                }
+            }
+
+            kvctx.keyStats[diskDocKey] =
+                    req.oldItemExists() && !req.oldItemIsDelete();
+
+            commitData.collections.setPersistedHighSeqno(
+                    docKey, meta.bySeqno, int(req.isDelete()));
+
+            docsLogicalBytes +=
+                    key.size() + sizeof(MetaData) + req.getBodySize();
+            batch.addDocument(std::move(key), meta, req.getValue());
+        }
+    }
+
+    commitData.collections.saveCollectionStats(
+            [this, &batch](CollectionID cid,
+                           const Collections::VB::PersistedStats& stats) {
+                batch.addLocal(getCollectionsStatsKey(cid),
+                               stats.getLebEncodedStats());
+            });
+
+    auto* state = getVBucketState(log.vbid);
+    boost::optional<vbucket_state> newState;
+    if (state) {
+        newState = *state;
+        newState->highSeqno = lastSeqno;
+        newState->onDiskPrepares += kvctx.onDiskPrepareDelta;
+        batch.setVBState(*newState);
+    }
+
+    if (collectionsMeta.needsCommit) {
+        updateCollectionsMeta(log, batch, commitData.collections);
+    }
+
+    const auto writeBegin = std::chrono::steady_clock::now();
+    size_t bytesWritten = 0;
+    const bool success = writeBatch(log, batch, lastSeqno, bytesWritten);
+    const auto end = std::chrono::steady_clock::now();
+    st.commitHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            end - writeBegin));
+    st.saveDocsHisto.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(end - begin));
+
+    if (!success) {
+        return false;
+    }
+
+    if (newState) {
+        state->highSeqno = newState->highSeqno;
+        state->onDiskPrepares = newState->onDiskPrepares;
+    }
+
+    st.batchSize.add(commitBatch.size());
+    // Record the write amplification of this commit - i.e. for each byte
+    // of user data (key+value+meta) how many bytes were written.
+    if (docsLogicalBytes) {
+        st.flusherWriteAmplificationHisto.addValue((bytesWritten * 10) /
+                                                   docsLogicalBytes);
+    }
+    return true;
+}
+
+void LogKVStore::commitCallback(bool success,
+                                PendingRequestQueue& commitBatch) {
+    for (const auto& req : commitBatch) {
+        const size_t mutationSize =
+                req.getKeyLen() + sizeof(MetaData) + req.getBodySize();
+        ++st.io_num_write;
+        st.io_document_write_bytes += mutationSize;
+
+        const bool existed = req.oldItemExists() && !req.oldItemIsDelete();
+        if (req.isDelete()) {
+            auto status = MutationStatus::Failed;
+            if (success) {
+                status = existed ? MutationStatus::Success
+                                 : MutationStatus::DocNotFound;
+                st.delTimeHisto.add(req.getDelta());
+            } else {
+                ++st.numDelFailure;
+            }
+            req.getDelCallback()(*transactionCtx, status);
+        } else {
+            auto setState = MutationSetResultState::Failed;
+            if (success) {
+                setState = existed ? MutationSetResultState::Update
+                                   : MutationSetResultState::Insert;
+                st.writeTimeHisto.add(req.getDelta());
+                st.writeSizeHisto.add(mutationSize);
+            } else {
+                ++st.numSetFailure;
+            }
+            req.getSetCallback()(*transactionCtx, setState);
+        }
+    }
+}
+
+std::shared_ptr<LogSegment> LogKVStore::getActiveSegment(VBLog& log) {
+    if (!log.active) {
+        auto segment = createSegment(log);
+        {
+            std::lock_guard<std::shared_timed_mutex> lock(log.indexMutex);
+            log.segments[segment->id] = segment;
+        }
+        log.active = std::move(segment);
+    }
+    return log.active;
+}
+
+void LogKVStore::sealActiveSegment(VBLog& log) {
+    if (log.active) {
+        log.active->seal();
+        log.active.reset();
+    }
+}
+
+bool LogKVStore::writeBatch(VBLog& log,
+                            LogBatch& batch,
+                            int64_t highSeqno,
+                            size_t& bytesWritten) {
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(log.indexMutex);
+        batch.addCommit(highSeqno, log.rollbackFloor);
+    }
+
+    std::shared_ptr<LogSegment> segment;
+    uint64_t offset = 0;
+    try {
+        segment = getActiveSegment(log);
+        offset = segment->size;
+        bytesWritten = segment->append(
+                batch.buffer.data(), batch.buffer.size(), st.fsStats);
+        segment->sync(st.fsStats);
+    } catch (const std::system_error& e) {
+        logger.warn("LogKVStore::writeBatch: {} write failed: {}",
+                    log.vbid,
+                    e.what());
+        if (segment) {
+            // Don't leave a partial batch in front of the next one
+            try {
+                segment->truncate(offset);
+            } catch (const std::system_error&) {
+            }
+            segment->size = offset;
+            sealActiveSegment(log);
+        }
+        return false;
+    }
+
+    {
+        std::lock_guard<std::shared_timed_mutex> lock(log.indexMutex);
+        for (const auto& doc : batch.documents) {
+            log.applyDocument(doc.key,
+                              IndexEntry{doc.lsn,
+                                         doc.bySeqno,
+                                         offset + doc.offset,
+                                         segment->id,
+                                         doc.length,
+                                         doc.deleted});
+        }
+        for (auto& local : batch.locals) {
+            log.applyLocal(local.key,
+                           LocalEntry{local.lsn,
+                                      offset + local.offset,
+                                      segment->id,
+                                      local.length,
+                                      local.deleted,
+                                      std::move(local.value)});
+        }
+        if (!(batch.commitFlags & RecordFlags::Compaction)) {
+            log.addCommitPoint(batch.commitLsn, highSeqno);
+        }
+        if (batch.vbstate) {
+            log.persisted = *batch.vbstate;
+        }
+    }
+
+    if (segment->size >= logConfig.getSegmentSize()) {
+        sealActiveSegment(log);
+        {
+            std::lock_guard<std::mutex> lh(compactorMutex);
+            compactorWakeup = true;
+        }
+        compactorCv.notify_one();
+    }
+    return true;
+}
+
+void LogKVStore::rollback() {
+    if (in_transaction) {
+        in_transaction = false;
+        transactionCtx.reset();
+    }
+}
+
+StorageProperties LogKVStore::getStorageProperties() {
+    StorageProperties rv(StorageProperties::EfficientVBDump::Yes,
+                         StorageProperties::EfficientVBDeletion::Yes,
+                         StorageProperties::PersistedDeletion::No,
+                         StorageProperties::EfficientGet::Yes,
+                         StorageProperties::ConcurrentWriteCompact::Yes);
+    return rv;
+}
+
+// Note: This routine is only called during warmup. The caller
+// can not make changes to the vbstate or it would cause race conditions.
+std::vector<vbucket_state*> LogKVStore::listPersistedVbuckets() {
+    std::vector<vbucket_state*> result;
+    for (const auto& vb : cachedVBStates) {
+        result.emplace_back(vb.get());
+    }
+    return result;
+}
+
+void LogKVStore::set(const Item& item, SetCallback cb) {
+    if (!in_transaction) {
+        throw std::logic_error(
+                "LogKVStore::set: in_transaction must be true to perform a "
+                "set operation.");
+    }
+    pendingReqs->emplace_back(item, std::move(cb));
+}
+
+void LogKVStore::del(const Item& item, KVStore::DeleteCallback cb) {
+    if (!in_transaction) {
+        throw std::logic_error(
+                "LogKVStore::del: in_transaction must be true to perform a "
+                "delete operation.");
+    }
+    pendingReqs->emplace_back(item, std::move(cb));
+}
+
+std::unique_ptr<Item> LogKVStore::readItem(Vbid vbid,
+                                           const Location& location,
+                                           GetMetaOnly getMetaOnly,
+                                           FileStats& stats) {
+    std::vector<uint8_t> buffer(location.length);
+    try {
+        if (location.segment->read(location.offset,
+                                   buffer.data(),
+                                   buffer.size(),
+                                   stats) != buffer.size()) {
+            logger.warn("LogKVStore::readItem: {} short read from {}:{}",
+                        vbid,
+                        location.segment->path,
+                        location.offset);
+            return nullptr;
+        }
+    } catch (const std::system_error& e) {
+        logger.warn("LogKVStore::readItem: {} {}", vbid, e.what());
+        return nullptr;
+    }
+
+    Record record;
+    MetaData meta;
+    cb::const_char_buffer value;
+    if (!parseRecord(buffer.data(), buffer.size(), record) ||
+        record.header.type != static_cast<uint8_t>(RecordType::Document) ||
+        !record.decodeDocument(meta, value)) {
+        logger.warn("LogKVStore::readItem: {} invalid record at {}:{}",
+                    vbid,
+                    location.segment->path,
+                    location.offset);
+        return nullptr;
+    }
+    return makeItem(vbid, record.key(), meta, value, getMetaOnly);
+}
+
+GetValue LogKVStore::get(const DiskDocKey& key, Vbid vb) {
+    return getWithHeader(nullptr, key, vb, GetMetaOnly::No);
+}
+
+GetValue LogKVStore::getWithHeader(void* dbHandle,
+                                   const DiskDocKey& key,
+                                   Vbid vbid,
+                                   GetMetaOnly getMetaOnly) {
+    const auto start = std::chrono::steady_clock::now();
+    auto log = getVBLog(vbid);
+    Location location;
+    if (!log || !log->find(toKeyString(key), location)) {
+        return GetValue{nullptr, ENGINE_KEY_ENOENT};
+    }
+
+    auto item = readItem(vbid, location, getMetaOnly, st.fsStats);
+    if (!item) {
+        ++st.numGetFailure;
+        return GetValue{nullptr, ENGINE_TMPFAIL};
+    }
+
+    st.readTimeHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start));
+    st.readSizeHisto.add(location.length);
+    return GetValue(std::move(item),
+                    ENGINE_SUCCESS,
+                    -1,
+                    getMetaOnly == GetMetaOnly::Yes);
+}
+
+void LogKVStore::getMulti(Vbid vbid, vb_bgfetch_queue_t& itms) {
+    auto log = getVBLog(vbid);
+
+    std::vector<std::pair<vb_bgfetch_queue_t::value_type*, Location>> reads;
+    reads.reserve(itms.size());
+    for (auto& it : itms) {
+        Location location;
+        if (log && log->find(toKeyString(it.first), location)) {
+            reads.emplace_back(&it, std::move(location));
+            continue;
+        }
+        it.second.value.setStatus(ENGINE_KEY_ENOENT);
+        for (auto& fetch : it.second.bgfetched_list) {
+            fetch->value->setStatus(ENGINE_KEY_ENOENT);
+        }
+    }
+
+    // Issue the reads in file order, so documents written by the same flush
+    // batch are read sequentially.
+    std::sort(reads.begin(), reads.end(), [](const auto& a, const auto& b) {
+        return std::make_pair(a.second.segment->id, a.second.offset) <
+               std::make_pair(b.second.segment->id, b.second.offset);
+    });
+
+    for (auto& read : reads) {
+        auto& bg_itm_ctx = read.first->second;
+        auto item = readItem(
+                vbid, read.second, bg_itm_ctx.isMetaOnly, st.fsStats);
+        if (!item) {
+            ++st.numGetFailure;
+            bg_itm_ctx.value.setStatus(ENGINE_TMPFAIL);
+            for (auto& fetch : bg_itm_ctx.bgfetched_list) {
+                fetch->value->setStatus(ENGINE_TMPFAIL);
+            }
+            continue;
+        }
+
+        ++st.io_bg_fetch_docs_read;
+        st.io_bgfetch_doc_bytes += read.second.length;
+        bg_itm_ctx.value =
+                GetValue(std::move(item),
+                         ENGINE_SUCCESS,
+                         -1,
+                         bg_itm_ctx.isMetaOnly == GetMetaOnly::Yes);
+        for (auto& fetch : bg_itm_ctx.bgfetched_list) {
+            fetch->value = &bg_itm_ctx.value;
+            st.readTimeHisto.add(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() -
+                            fetch->initTime));
+            st.readSizeHisto.add(read.second.length);
+        }
+    }
+
+    // One read per document found
+    st.getMultiFsReadCount += reads.size();
+    st.getMultiFsReadHisto.add(reads.size());
+    if (!itms.empty()) {
+        st.getMultiFsReadPerDocHisto.add(reads.size() / itms.size());
+    }
+}
+
+void LogKVStore::getRange(Vbid vbid,
+                          const DiskDocKey& startKey,
+                          const DiskDocKey& endKey,
+                          const GetRangeCb& cb) {
+    auto log = getVBLog(vbid);
+    if (!log) {
+        return;
+    }
+
+    std::vector<Location> locations;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+        const auto end = toKeyString(endKey);
+        for (auto it = log->keys.lower_bound(toKeyString(startKey));
+             it != log->keys.end() && it->first < end;
+             ++it) {
+            if (!it->second.deleted) {
+                locations.push_back({log->segments.at(it->second.segment),
+                                     it->second.offset,
+                                     it->second.length});
+            }
+        }
+    }
+
+    for (const auto& location : locations) {
+        auto item = readItem(vbid, location, GetMetaOnly::No, st.fsStats);
+        if (!item) {
+            throw std::runtime_error(
+                    "LogKVStore::getRange: failed to read a document from " +
+                    location.segment->path);
+        }
+        cb(GetValue(std::move(item)));
+    }
+}
+
+void LogKVStore::reset(Vbid vbid) {
+    auto vbstate = getVBucketState(vbid);
+    if (!vbstate) {
+        throw std::invalid_argument(
+                "LogKVStore::reset: No entry in cached "
+                "states for " +
+                vbid.to_string());
+    }
+
+    std::shared_ptr<VBLog> log;
+    {
+        std::lock_guard<std::mutex> lock(vbLogsMutex);
+        log = std::move(vbLogs[vbid.get()]);
+        // A new log must not reuse the files being removed below
+        vbRevisions[vbid.get()]++;
+    }
+    if (log) {
+        dropVBLog(*log);
+        removeSegmentFiles(vbid, log->revision);
+    }
+
+    vbstate->reset();
+    snapshotVBucket(
+            vbid, *vbstate, VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT);
+}
+
+void LogKVStore::delVBucket(Vbid vbid, uint64_t fileRev) {
+    std::shared_ptr<VBLog> log;
+    {
+        std::lock_guard<std::mutex> lock(vbLogsMutex);
+        auto& current = vbLogs[vbid.get()];
+        if (current && current->revision == fileRev) {
+            log = std::move(current);
+        }
+        if (vbRevisions[vbid.get()] == fileRev) {
+            vbRevisions[vbid.get()]++;
+        }
+    }
+    if (log) {
+        dropVBLog(*log);
+    }
+    removeSegmentFiles(vbid, fileRev);
+}
+
+uint64_t LogKVStore::prepareToDeleteImpl(Vbid vbid) {
+    std::shared_ptr<VBLog> log;
+    uint64_t revision;
+    {
+        std::lock_guard<std::mutex> lock(vbLogsMutex);
+        log = std::move(vbLogs[vbid.get()]);
+        revision = vbRevisions[vbid.get()]++;
+    }
+    if (log) {
+        dropVBLog(*log);
+        revision = log->revision;
+    }
+    return revision;
+}
+
+bool LogKVStore::snapshotVBucket(Vbid vbid,
+                                 const vbucket_state& vbstate,
+                                 VBStatePersist options) {
+    const auto start = std::chrono::steady_clock::now();
+    auto log = getOrCreateVBLog(vbid);
+    std::lock_guard<std::mutex> writeLock(log->writeMutex);
+
+    if (updateCachedVBState(vbid, vbstate) &&
+        (options == VBStatePersist::VBSTATE_PERSIST_WITHOUT_COMMIT ||
+         options == VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT)) {
+        // There's no transaction to add the vbstate to, so both persist
+        // options write (and sync) it immediately.
+        const auto state = *getVBucketState(vbid);
+        LogBatch batch(log->nextLsn);
+        batch.setVBState(state);
+        size_t bytesWritten;
+        if (log->dropped ||
+            !writeBatch(*log, batch, state.highSeqno, bytesWritten)) {
+            ++st.numVbSetFailure;
+            logger.warn("LogKVStore::snapshotVBucket: failed to persist {}",
+                        vbid);
+            return false;
+        }
+    }
+
+    st.snapshotHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start));
+    return true;
+}
+
+ScanContext* LogKVStore::initScanContext(
+        std::shared_ptr<StatusCallback<GetValue>> cb,
+        std::shared_ptr<StatusCallback<CacheLookup>> cl,
+        Vbid vbid,
+        uint64_t startSeqno,
+        DocumentFilter options,
+        ValueFilter valOptions) {
+    size_t scanId = scanCounter++;
+
+    if (!getVBucketState(vbid)) {
+        logger.warn("LogKVStore::initScanContext {} vbstate is null", vbid);
+        return nullptr;
+    }
+
+    vbucket_state vbstate;
+    std::vector<LogScanContext::Entry> entries;
+    std::map<uint32_t, std::shared_ptr<LogSegment>> segments;
+    auto log = getVBLog(vbid);
+    if (log) {
+        std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+        vbstate = log->persisted;
+        for (auto it = log->bySeqno.lower_bound(startSeqno);
+             it != log->bySeqno.end() && it->first <= vbstate.highSeqno;
+             ++it) {
+            const auto& entry = it->second->second;
+            entries.push_back(
+                    {it->first, entry.offset, entry.segment, entry.length});
+        }
+        segments = log->segments;
+    } else {
+        vbstate = *getVBucketState(vbid);
+    }
+
+    auto ctx = new LogScanContext(cb,
+                                  cl,
+                                  vbid,
+                                  scanId,
+                                  startSeqno,
+                                  vbstate.highSeqno,
+                                  vbstate.purgeSeqno,
+                                  options,
+                                  valOptions,
+                                  entries.size(),
+                                  vbstate,
+                                  configuration,
+                                  getDroppedCollections(vbid),
+                                  std::move(entries),
+                                  std::move(segments));
+    ctx->logger = &logger;
+    return ctx;
+}
+
+scan_error_t LogKVStore::scan(ScanContext* sctx) {
+    if (!sctx) {
+        return scan_failed;
+    }
+
+    auto ctx = static_cast<LogScanContext*>(sctx);
+
+    if (ctx->lastReadSeqno == ctx->maxSeqno) {
+        return scan_success;
+    }
+
+    auto startSeqno = ctx->startSeqno;
+    if (ctx->lastReadSeqno != 0) {
+        startSeqno = ctx->lastReadSeqno + 1;
+    }
+
+    GetMetaOnly isMetaOnly = ctx->valFilter == ValueFilter::KEYS_ONLY
+                                     ? GetMetaOnly::Yes
+                                     : GetMetaOnly::No;
+    bool onlyKeys = ctx->valFilter == ValueFilter::KEYS_ONLY;
+
+    auto it = std::lower_bound(
+            ctx->entries.begin(),
+            ctx->entries.end(),
+            startSeqno,
+            [](const LogScanContext::Entry& entry, int64_t seqno) {
+                return entry.bySeqno < seqno;
+            });
+
+    std::vector<uint8_t> buffer;
+    for (; it != ctx->entries.end(); ++it) {
+        const auto seqno = it->bySeqno;
+        buffer.resize(it->length);
+        const auto& segment = ctx->segments.at(it->segment);
+        Record record;
+        MetaData meta;
+        cb::const_char_buffer value;
+        try {
+            if (segment->read(it->offset,
+                              buffer.data(),
+                              buffer.size(),
+                              st.fsStats) != buffer.size() ||
+                !parseRecord(buffer.data(), buffer.size(), record) ||
+                !record.decodeDocument(meta, value)) {
+                logger.warn("LogKVStore::scan {} invalid record at {}:{}",
+                            ctx->vbid,
+                            segment->path,
+                            it->offset);
+                return scan_failed;
+            }
+        } catch (const std::system_error& e) {
+            logger.warn("LogKVStore::scan {} {}", ctx->vbid, e.what());
+            return scan_failed;
+        }
+
+        const auto keyBuf = record.key();
+        const DiskDocKey diskKey{keyBuf.data(), keyBuf.size()};
+
+        if (isTombstone(meta) &&
+            ctx->docFilter == DocumentFilter::NO_DELETES) {
+            continue;
+        }
+
+        auto docKey = diskKey.getDocKey();
+
+        // Determine if the key is logically deleted, if it is we skip the key
+        // Note that system event keys (like create scope) are never skipped
+        // here
+        if (!docKey.getCollectionID().isSystem()) {
+            if (ctx->docFilter !=
+                DocumentFilter::ALL_ITEMS_AND_DROPPED_COLLECTIONS) {
+                if (ctx->collectionsContext.isLogicallyDeleted(docKey, seqno)) {
+                    ctx->lastReadSeqno = seqno;
+                    continue;
+                }
+            }
+
+            CacheLookup lookup(diskKey, seqno, ctx->vbid);
+
+            ctx->lookup->callback(lookup);
+            if (ctx->lookup->getStatus() == ENGINE_KEY_EEXISTS) {
+                ctx->lastReadSeqno = seqno;
+                continue;
+            } else if (ctx->lookup->getStatus() == ENGINE_ENOMEM) {
+                return scan_again;
+            }
+        }
+
+        auto itm = makeItem(ctx->vbid, keyBuf, meta, value, isMetaOnly);
+
+        // When we are suppose to return the values as compressed AND
+        // the value isn't compressed, we need to compress the value.
+        if (ctx->valFilter == ValueFilter::VALUES_COMPRESSED &&
+            !mcbp::datatype::is_snappy(meta.datatype)) {
+            if (!itm->compressValue(true)) {
+                logger.warn(
+                        "LogKVStore::scan failed to compress value - {} "
+                        "key:{} seqno:{}",
+                        ctx->vbid,
+                        cb::UserData{diskKey.to_string()},
+                        seqno);
+                continue;
+            }
+        } else if (ctx->valFilter == ValueFilter::VALUES_DECOMPRESSED &&
+                   mcbp::datatype::is_snappy(meta.datatype)) {
+            itm->decompressValue();
+        }
+
+        GetValue rv(std::move(itm), ENGINE_SUCCESS, -1, onlyKeys);
+        ctx->callback->callback(rv);
+        if (ctx->callback->getStatus() == ENGINE_ENOMEM) {
+            return scan_again;
+        }
+        ctx->lastReadSeqno = seqno;
+    }
+
+    return scan_success;
+}
+
+void LogKVStore::destroyScanContext(ScanContext* ctx) {
+    delete static_cast<LogScanContext*>(ctx);
+}
+
+vbucket_state* LogKVStore::getVBucketState(Vbid vbid) {
+    return cachedVBStates[vbid.get()].get();
+}
+
+Vbid LogKVStore::getDBFileId(const cb::mcbp::Request& req) {
+    return req.getVBucket();
+}
+
+size_t LogKVStore::getItemCount(Vbid vbid) {
+    auto log = getVBLog(vbid);
+    if (!log) {
+        return 0;
+    }
+    std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+    return log->itemCount;
+}
+
+size_t LogKVStore::getNumPersistedDeletes(Vbid vbid) {
+    auto log = getVBLog(vbid);
+    if (!log) {
+        return 0;
+    }
+    std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+    return log->deletedCount;
+}
+
+DBFileInfo LogKVStore::getDbFileInfo(Vbid vbid) {
+    auto log = getVBLog(vbid);
+    if (!log) {
+        return {};
+    }
+    return log->getFileInfo();
+}
+
+DBFileInfo LogKVStore::getAggrDbFileInfo() {
+    std::vector<std::shared_ptr<VBLog>> logs;
+    {
+        std::lock_guard<std::mutex> lock(vbLogsMutex);
+        for (const auto& log : vbLogs) {
+            if (log) {
+                logs.push_back(log);
+            }
+        }
+    }
+    DBFileInfo total;
+    for (const auto& log : logs) {
+        const auto info = log->getFileInfo();
+        total.fileSize += info.fileSize;
+        total.spaceUsed += info.spaceUsed;
+    }
+    return total;
+}
+
+ENGINE_ERROR_CODE LogKVStore::getAllKeys(
+        Vbid vbid,
+        const DiskDocKey& start_key,
+        uint32_t count,
+        std::shared_ptr<Callback<const DiskDocKey&>> cb) {
+    auto log = getVBLog(vbid);
+    if (!log) {
+        return ENGINE_SUCCESS;
+    }
+
+    std::vector<std::string> keys;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+        for (auto it = log->keys.lower_bound(toKeyString(start_key));
+             it != log->keys.end() && keys.size() < count;
+             ++it) {
+            if (!it->second.deleted) {
+                keys.push_back(it->first);
+            }
+        }
+    }
+
+    for (const auto& key : keys) {
+        DiskDocKey diskKey{key.data(), key.size()};
+        cb->callback(diskKey);
+    }
+    return ENGINE_SUCCESS;
+}
+
+bool LogKVStore::compactDB(compaction_ctx* ctx) {
+    const auto start = std::chrono::steady_clock::now();
+    const Vbid vbid = ctx->compactConfig.db_file_id;
+
+    logger.debug(
+            "LogKVStore::compactDB {} purge_before_ts:{} purge_before_seq:{}"
+            " drop_deletes:{} retain_erroneous_tombstones:{}",
+            vbid,
+            ctx->compactConfig.purge_before_ts,
+            ctx->compactConfig.purge_before_seq,
+            ctx->compactConfig.drop_deletes,
+            ctx->compactConfig.retain_erroneous_tombstones);
+
+    auto log = getVBLog(vbid);
+    if (!log) {
+        logger.warn("LogKVStore::compactDB: {} has no data", vbid);
+        ++st.numCompactionFailure;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> compactionLock(log->compactionMutex);
+    ctx->eraserContext = std::make_unique<Collections::VB::EraserContext>(
+            getDroppedCollections(vbid));
+
+    // Everything written so far is compacted; later writes go to a new
+    // segment.
+    std::vector<std::shared_ptr<LogSegment>> segments;
+    {
+        std::lock_guard<std::mutex> writeLock(log->writeMutex);
+        sealActiveSegment(*log);
+        std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+        ctx->highCompletedSeqno = log->persisted.persistedCompletedSeqno;
+        for (const auto& segment : log->segments) {
+            segments.push_back(segment.second);
+        }
+    }
+
+    if (!compactSegments(*log, segments, ctx)) {
+        ++st.numCompactionFailure;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> writeLock(log->writeMutex);
+        if (log->dropped) {
+            return false;
+        }
+
+        auto* state = getVBucketState(vbid);
+        if (state) {
+            state->onDiskPrepares -= ctx->stats.preparesPurged;
+            state->purgeSeqno = ctx->max_purged_seq;
+        }
+
+        vbucket_state persisted;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+            persisted = log->persisted;
+        }
+        persisted.onDiskPrepares -= ctx->stats.preparesPurged;
+        persisted.purgeSeqno = ctx->max_purged_seq;
+
+        LogBatch batch(log->nextLsn);
+        batch.setVBState(persisted);
+        if (ctx->eraserContext->needToUpdateCollectionsMetadata()) {
+            batch.addLocal(droppedCollectionsKey, {}, true);
+        }
+        size_t bytesWritten;
+        if (!writeBatch(*log, batch, persisted.highSeqno, bytesWritten)) {
+            ++st.numCompactionFailure;
+            return false;
+        }
+    }
+
+    st.compactHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start));
+    return true;
+}
+
+/**
+ * Apply the compaction rules (the same as CouchKVStore's time_purge_hook)
+ * to a live document.
+ *
+ * @param endOfCollections deleted system events, to be passed to the
+ *        eraser once every document has been visited
+ * @return true if the document should be dropped
+ */
+static bool purgeDocument(
+        compaction_ctx& ctx,
+        const DiskDocKey& diskKey,
+        const MetaData& meta,
+        cb::const_char_buffer value,
+        int64_t lastSeqno,
+        std::vector<std::pair<DiskDocKey, uint32_t>>& endOfCollections) {
+    const auto seqno = meta.bySeqno;
+    const bool prepare =
+            meta.getOperation() == MetaData::Operation::PreparedSyncWrite;
+    const bool tombstone = isTombstone(meta);
+
+    if (ctx.droppedKeyCb) {
+        if (ctx.eraserContext->isLogicallyDeleted(diskKey.getDocKey(),
+                                                  seqno)) {
+            // Inform vb that the key@seqno is dropped
+            ctx.droppedKeyCb(diskKey, seqno);
+            if (!tombstone) {
+                ctx.stats.collectionsItemsPurged++;
+            } else {
+                ctx.stats.collectionsDeletedItemsPurged++;
+            }
+            if (prepare) {
+                ctx.stats.preparesPurged++;
+            }
+            return true;
+        } else if (tombstone) {
+            // Segments aren't in seqno order, so the end of a collection
+            // can only be processed once all its documents have been seen.
+            endOfCollections.emplace_back(diskKey, meta.flags);
+        }
+    }
+
+    if (tombstone) {
+        if (seqno != lastSeqno) {
+            if (ctx.compactConfig.drop_deletes) {
+                ctx.max_purged_seq =
+                        std::max(ctx.max_purged_seq, uint64_t(seqno));
+                ctx.stats.tombstonesPurged++;
+                return true;
+            }
+
+            const auto exptime = meta.exptime;
+            if (exptime < ctx.compactConfig.purge_before_ts &&
+                (exptime || !ctx.compactConfig.retain_erroneous_tombstones) &&
+                (!ctx.compactConfig.purge_before_seq ||
+                 uint64_t(seqno) <= ctx.compactConfig.purge_before_seq)) {
+                ctx.max_purged_seq =
+                        std::max(ctx.max_purged_seq, uint64_t(seqno));
+                ctx.stats.tombstonesPurged++;
+                return true;
+            }
+        }
+    } else {
+        if (prepare) {
+            // Completed prepares can go; incomplete ones are kept without
+            // being expired or added to the bloom filter.
+            if (uint64_t(seqno) <= ctx.highCompletedSeqno) {
+                ctx.stats.preparesPurged++;
+                return true;
+            }
+            return false;
+        }
+
+        time_t currtime = ep_real_time();
+        const auto op = meta.getOperation();
+        if (ctx.expiryCallback && meta.exptime && meta.exptime < currtime &&
+            (op == MetaData::Operation::Mutation ||
+             op == MetaData::Operation::CommittedSyncWrite)) {
+            // Only documents with xattrs need their body passed on
+            const bool xattr = mcbp::datatype::is_xattr(meta.datatype);
+            auto item = makeItem(ctx.compactConfig.db_file_id,
+                                 {reinterpret_cast<const char*>(diskKey.data()),
+                                  diskKey.size()},
+                                 meta,
+                                 value,
+                                 xattr ? GetMetaOnly::No : GetMetaOnly::Yes);
+            if (xattr && mcbp::datatype::is_snappy(meta.datatype)) {
+                item->decompressValue();
+            }
+            ctx.expiryCallback->callback(*item, currtime);
+        }
+    }
+
+    if (ctx.bloomFilterCallback) {
+        bool deleted = tombstone;
+        auto vbid = ctx.compactConfig.db_file_id;
+        try {
+            ctx.bloomFilterCallback->callback(
+                    vbid, diskKey.getDocKey(), deleted);
+        } catch (std::runtime_error& re) {
+            EP_LOG_WARN(
+                    "LogKVStore: exception occurred when invoking the "
+                    "bloomfilter callback on {} - Details: {}",
+                    vbid,
+                    re.what());
+        }
+    }
+    return false;
+}
+
+bool LogKVStore::compactSegments(
+        VBLog& log,
+        const std::vector<std::shared_ptr<LogSegment>>& segments,
+        compaction_ctx* ctx) {
+    auto& stats = st.fsStatsCompaction;
+
+    int64_t lastSeqno = 0;
+    uint64_t startFloor;
+    std::vector<uint64_t> commitLsns;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(log.indexMutex);
+        if (!log.bySeqno.empty()) {
+            lastSeqno = log.bySeqno.rbegin()->first;
+        }
+        startFloor = log.rollbackFloor;
+        for (const auto& point : log.commitPoints) {
+            if (point.lsn >= startFloor) {
+                commitLsns.push_back(point.lsn);
+            }
+        }
+    }
+    const uint64_t maxLsn = log.nextLsn - 1;
+
+    // @return true if a retained commit point lies in [lsn, supersededBy)
+    auto isCommitRetained = [&commitLsns](uint64_t lsn, uint64_t supersededBy) {
+        auto it = std::lower_bound(commitLsns.begin(), commitLsns.end(), lsn);
+        return it != commitLsns.end() && *it < supersededBy;
+    };
+
+    CompactionWriter writer([this, &log]() { return createSegment(log); },
+                            logConfig.getSegmentSize(),
+                            stats);
+    writer.rollbackFloor = startFloor;
+
+    struct Move {
+        std::string key;
+        bool local;
+        uint32_t segment;
+        uint64_t offset;
+        Location to;
+    };
+    std::vector<Move> moves;
+    std::vector<Move> purges;
+    std::vector<std::pair<DiskDocKey, uint32_t>> endOfCollections;
+    bool docsPurged = false;
+
+    auto abandon = [&writer]() {
+        for (auto& segment : writer.segments) {
+            try {
+                segment->unlink();
+            } catch (const std::system_error&) {
+            }
+        }
+    };
+
+    try {
+        for (const auto& segment : segments) {
+            SegmentReader reader(*segment, stats, segment->size);
+            while (reader.next()) {
+                if (log.dropped || compactorShutdown) {
+                    abandon();
+                    return false;
+                }
+
+                const auto& record = reader.getRecord();
+                const auto& header = record.header;
+                const auto offset = reader.getOffset();
+                const auto keyBuf = record.key();
+                std::string key{keyBuf.data(), keyBuf.size()};
+
+                if (header.type == static_cast<uint8_t>(RecordType::Local)) {
+                    bool keep = false;
+                    {
+                        std::shared_lock<std::shared_timed_mutex> lock(
+                                log.indexMutex);
+                        auto it = log.localDocs.find(key);
+                        if (it != log.localDocs.end()) {
+                            keep = it->second.segment == segment->id &&
+                                   it->second.offset == offset;
+                            if (!keep && it->second.lsn > header.lsn) {
+                                // Old versions of local documents (the
+                                // vbstate in particular) are needed to roll
+                                // back to a commit point made before they
+                                // were replaced; keep them while such a
+                                // commit point is retained.
+                                keep = isCommitRetained(header.lsn,
+                                                        it->second.lsn);
+                                if (!keep) {
+                                    writer.rollbackFloor =
+                                            std::max(writer.rollbackFloor,
+                                                     it->second.lsn);
+                                }
+                            }
+                        }
+                    }
+                    // Local tombstones are never purged, as they may hide
+                    // older versions kept for rollback.
+                    if (keep) {
+                        moves.push_back({std::move(key),
+                                         true,
+                                         segment->id,
+                                         offset,
+                                         writer.add(record)});
+                    }
+                    continue;
+                }
+
+                if (header.type != static_cast<uint8_t>(RecordType::Document)) {
+                    continue;
+                }
+
+                bool live = false;
+                {
+                    std::shared_lock<std::shared_timed_mutex> lock(
+                            log.indexMutex);
+                    auto it = log.keys.find(key);
+                    if (it != log.keys.end()) {
+                        live = it->second.segment == segment->id &&
+                               it->second.offset == offset;
+                        if (!live && it->second.lsn > header.lsn) {
+                            writer.rollbackFloor = std::max(
+                                    writer.rollbackFloor, it->second.lsn);
+                        }
+                    }
+                }
+                if (!live) {
+                    continue;
+                }
+
+                if (ctx) {
+                    MetaData meta;
+                    cb::const_char_buffer value;
+                    if (!record.decodeDocument(meta, value)) {
+                        throw std::runtime_error("invalid document in " +
+                                                 segment->path);
+                    }
+                    if (purgeDocument(*ctx,
+                                      DiskDocKey{keyBuf.data(), keyBuf.size()},
+                                      meta,
+                                      value,
+                                      lastSeqno,
+                                      endOfCollections)) {
+                        purges.push_back({std::move(key),
+                                          false,
+                                          segment->id,
+                                          offset,
+                                          {}});
+                        if (!docsPurged) {
+                            docsPurged = true;
+                            writer.rollbackFloor =
+                                    std::max(writer.rollbackFloor, maxLsn);
+                        }
+                        continue;
+                    }
+                }
+                moves.push_back({std::move(key),
+                                 false,
+                                 segment->id,
+                                 offset,
+                                 writer.add(record)});
+            }
+        }
+
+        if (ctx) {
+            for (const auto& end : endOfCollections) {
+                ctx->eraserContext->processEndOfCollection(
+                        end.first.getDocKey(), SystemEvent(end.second));
+            }
+        }
+        writer.finish();
+    } catch (const std::exception& e) {
+        logger.warn("LogKVStore::compactSegments: {} failed: {}",
+                    log.vbid,
+                    e.what());
+        abandon();
+        return false;
+    }
+
+    const auto newFloor = writer.rollbackFloor;
+    std::lock_guard<std::mutex> writeLock(log.writeMutex);
+    if (log.dropped) {
+        abandon();
+        return false;
+    }
+
+    if (newFloor > startFloor && writer.segments.empty()) {
+        // Nothing was kept, so there's no output segment to carry the new
+        // floor; record it at the end of the log instead.
+        {
+            std::lock_guard<std::shared_timed_mutex> lock(log.indexMutex);
+            log.rollbackFloor = std::max(log.rollbackFloor, newFloor);
+        }
+        LogBatch batch(log.nextLsn);
+        batch.commitFlags = RecordFlags::Compaction;
+        size_t bytesWritten;
+        if (!writeBatch(log, batch, 0, bytesWritten)) {
+            return false;
+        }
+    }
+
+    {
+        std::lock_guard<std::shared_timed_mutex> lock(log.indexMutex);
+        for (const auto& segment : writer.segments) {
+            log.segments[segment->id] = segment;
+        }
+
+        // Anything written since the record was copied supersedes the copy
+        for (const auto& move : moves) {
+            bool repointed = false;
+            if (move.local) {
+                auto it = log.localDocs.find(move.key);
+                if (it != log.localDocs.end() &&
+                    it->second.segment == move.segment &&
+                    it->second.offset == move.offset) {
+                    it->second.segment = move.to.segment->id;
+                    it->second.offset = move.to.offset;
+                    repointed = true;
+                }
+            } else {
+                auto it = log.keys.find(move.key);
+                if (it != log.keys.end() &&
+                    it->second.segment == move.segment &&
+                    it->second.offset == move.offset) {
+                    it->second.segment = move.to.segment->id;
+                    it->second.offset = move.to.offset;
+                    repointed = true;
+                }
+            }
+            if (!repointed) {
+                move.to.segment->garbage += move.to.length;
+            }
+        }
+
+        for (const auto& purge : purges) {
+            auto it = log.keys.find(purge.key);
+            if (it != log.keys.end() && it->second.segment == purge.segment &&
+                it->second.offset == purge.offset) {
+                log.removeDocument(it);
+            }
+        }
+
+        for (const auto& segment : segments) {
+            log.segments.erase(segment->id);
+        }
+
+        log.rollbackFloor = std::max(log.rollbackFloor, newFloor);
+        while (!log.commitPoints.empty() &&
+               log.commitPoints.front().lsn < log.rollbackFloor) {
+            log.commitPoints.pop_front();
+        }
+    }
+
+    for (const auto& segment : segments) {
+        try {
+            segment->unlink();
+        } catch (const std::system_error& e) {
+            logger.warn("LogKVStore::compactSegments: {}", e.what());
+        }
+    }
+    segmentsCompacted += segments.size();
+    return true;
+}
+
+void LogKVStore::runBackgroundCompactor() {
+    std::unique_lock<std::mutex> lh(compactorMutex);
+    while (!compactorShutdown) {
+        compactorCv.wait_for(lh, std::chrono::seconds(10), [this] {
+            return compactorShutdown || compactorWakeup;
+        });
+        if (compactorShutdown) {
+            break;
+        }
+        compactorWakeup = false;
+        lh.unlock();
+        compactGarbageSegments();
+        lh.lock();
+    }
+}
+
+void LogKVStore::compactGarbageSegments() {
+    std::vector<std::shared_ptr<VBLog>> logs;
+    {
+        std::lock_guard<std::mutex> lock(vbLogsMutex);
+        for (const auto& log : vbLogs) {
+            if (log) {
+                logs.push_back(log);
+            }
+        }
+    }
+
+    const auto threshold = logConfig.getCompactionThreshold();
+    for (const auto& log : logs) {
+        if (compactorShutdown) {
+            return;
+        }
+        std::unique_lock<std::mutex> compactionLock(log->compactionMutex,
+                                                    std::try_to_lock);
+        if (!compactionLock || log->dropped) {
+            continue;
+        }
+
+        std::vector<std::shared_ptr<LogSegment>> candidates;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+            for (const auto& entry : log->segments) {
+                const auto& segment = *entry.second;
+                const auto size = segment.size.load();
+                const auto garbage = segment.garbage.load();
+                if (segment.sealed && size && garbage &&
+                    garbage >= threshold * size) {
+                    candidates.push_back(entry.second);
+                }
+            }
+        }
+        if (!candidates.empty()) {
+            compactSegments(*log, candidates, nullptr);
+        }
+    }
+}
+
+std::unique_ptr<KVFileHandle, KVFileHandleDeleter> LogKVStore::makeFileHandle(
+        Vbid vbid) {
+    std::unique_ptr<LogKVFileHandle, KVFileHandleDeleter> kvfh(
+            new LogKVFileHandle(*this, vbid));
+    return std::move(kvfh);
+}
+
+RollbackResult LogKVStore::rollback(Vbid vbid,
+                                    uint64_t rollbackSeqno,
+                                    std::shared_ptr<RollbackCB> cb) {
+    logger.info("LogKVStore::rollback {} seqno:{}", vbid, rollbackSeqno);
+
+    auto log = getVBLog(vbid);
+    if (!log) {
+        return RollbackResult(false);
+    }
+
+    std::lock_guard<std::mutex> compactionLock(log->compactionMutex);
+    std::unique_lock<std::mutex> writeLock(log->writeMutex);
+
+    LsnRange discard;
+    std::vector<Location> rolledBack;
+    std::deque<CommitPoint> commitPoints;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(log->indexMutex);
+        auto point = std::find_if(log->commitPoints.rbegin(),
+                                  log->commitPoints.rend(),
+                                  [rollbackSeqno](const CommitPoint& p) {
+                                      return p.highSeqno <=
+                                             int64_t(rollbackSeqno);
+                                  });
+        if (point == log->commitPoints.rend() ||
+            point->lsn < log->rollbackFloor) {
+            logger.warn(
+                    "LogKVStore::rollback {} no commit point at or before "
+                    "seqno:{} is available",
+                    vbid,
+                    rollbackSeqno);
+            return RollbackResult(false);
+        }
+        discard.first = point->lsn + 1;
+        discard.last = log->nextLsn - 1;
+
+        for (const auto& entry : log->keys) {
+            if (discard.contains(entry.second.lsn)) {
+                rolledBack.push_back({log->segments.at(entry.second.segment),
+                                      entry.second.offset,
+                                      entry.second.length});
+            }
+        }
+        for (const auto& p : log->commitPoints) {
+            if (p.lsn < discard.first) {
+                commitPoints.push_back(p);
+            }
+        }
+    }
+
+    // The items being rolled back, for the callback
+    std::vector<std::unique_ptr<Item>> items;
+    for (const auto& location : rolledBack) {
+        auto item = readItem(vbid, location, GetMetaOnly::Yes, st.fsStats);
+        if (!item) {
+            return RollbackResult(false);
+        }
+        items.push_back(std::move(item));
+    }
+
+    // Until the rolled back records have been removed from the segments,
+    // the marker makes sure a restart doesn't bring them back.
+    const auto markerPath = getRollbackMarkerPath(vbid, log->revision);
+    try {
+        writeRollbackMarker(markerPath, discard);
+    } catch (const std::system_error& e) {
+        logger.warn("LogKVStore::rollback {} {}", vbid, e.what());
+        return RollbackResult(false);
+    }
+
+    sealActiveSegment(*log);
+    std::vector<std::shared_ptr<LogSegment>> segments;
+    {
+        std::lock_guard<std::shared_timed_mutex> lock(log->indexMutex);
+        replay(*log, discard);
+        log->commitPoints = commitPoints;
+        for (const auto& segment : log->segments) {
+            segments.push_back(segment.second);
+        }
+    }
+    const bool stateFound = readVBState(*log);
+    writeLock.unlock();
+
+    if (compactSegments(*log, segments, nullptr)) {
+        std::remove(markerPath.c_str());
+    }
+
+    if (!stateFound) {
+        logger.critical("LogKVStore::rollback {} vbstate not found", vbid);
+        return RollbackResult(false);
+    }
+
+    auto fh = makeFileHandle(vbid);
+    cb->setDbHeader(reinterpret_cast<void*>(fh.get()));
+    for (auto& item : items) {
+        GetValue rv(std::move(item), ENGINE_SUCCESS, -1, true);
+        cb->callback(rv);
+    }
+
+    auto vbstate = getVBucketState(vbid);
+    return RollbackResult(true,
+                          vbstate->highSeqno,
+                          vbstate->lastSnapStart,
+                          vbstate->lastSnapEnd);
+}
+
+Collections::KVStore::Manifest LogKVStore::getCollectionsManifest(Vbid vbid) {
+    std::string manifest;
+    std::string openCollections;
+    std::string openScopes;
+    std::string droppedCollections;
+    auto log = getVBLog(vbid);
+    if (log) {
+        manifest = readLocalDoc(*log, manifestKey);
+        openCollections = readLocalDoc(*log, openCollectionsKey);
+        openScopes = readLocalDoc(*log, openScopesKey);
+        droppedCollections = readLocalDoc(*log, droppedCollectionsKey);
+    }
+    return Collections::KVStore::decodeManifest(
+            {reinterpret_cast<const uint8_t*>(manifest.data()),
+             manifest.length()},
+            {reinterpret_cast<const uint8_t*>(openCollections.data()),
+             openCollections.length()},
+            {reinterpret_cast<const uint8_t*>(openScopes.data()),
+             openScopes.length()},
+            {reinterpret_cast<const uint8_t*>(droppedCollections.data()),
+             droppedCollections.length()});
+}
+
+std::vector<Collections::KVStore::DroppedCollection>
+LogKVStore::getDroppedCollections(Vbid vbid) {
+    std::string dropped;
+    auto log = getVBLog(vbid);
+    if (log) {
+        dropped = readLocalDoc(*log, droppedCollectionsKey);
+    }
+    return Collections::KVStore::decodeDroppedCollections(
+            {reinterpret_cast<const uint8_t*>(dropped.data()),
+             dropped.length()});
+}
+
+void LogKVStore::updateCollectionsMeta(
+        VBLog& log,
+        LogBatch& batch,
+        Collections::VB::Flush& collectionsFlush) {
+    updateManifestUid(batch);
+
+    // If the updateOpenCollections reads the dropped collections, it can pass
+    // them to updateDroppedCollections, thus we only read the dropped list
+    // once per update.
+    boost::optional<std::vector<Collections::KVStore::DroppedCollection>>
+            dropped;
+
+    if (!collectionsMeta.collections.empty() ||
+        !collectionsMeta.droppedCollections.empty()) {
+        dropped = updateOpenCollections(log, batch);
+    }
+
+    if (!collectionsMeta.droppedCollections.empty()) {
+        if (!dropped.is_initialized()) {
+            dropped = getDroppedCollections(log.vbid);
+        }
+        updateDroppedCollections(log, batch, *dropped);
+        collectionsFlush.setNeedsPurge();
+    }
+
+    if (!collectionsMeta.scopes.empty() ||
+        !collectionsMeta.droppedScopes.empty()) {
+        updateScopes(log, batch);
+    }
+
+    collectionsMeta.clear();
+}
+
+void LogKVStore::updateManifestUid(LogBatch& batch) {
+    // write back, no read required
+    auto buf = Collections::KVStore::encodeManifestUid(collectionsMeta);
+    batch.addLocal(manifestKey,
+                   {reinterpret_cast<const char*>(buf.data()), buf.size()});
+}
+
+std::vector<Collections::KVStore::DroppedCollection>
+LogKVStore::updateOpenCollections(VBLog& log, LogBatch& batch) {
+    auto dropped = getDroppedCollections(log.vbid);
+    auto collections = readLocalDoc(log, openCollectionsKey);
+    auto buf = Collections::KVStore::encodeOpenCollections(
+            dropped,
+            collectionsMeta,
+            {reinterpret_cast<const uint8_t*>(collections.data()),
+             collections.length()});
+    batch.addLocal(openCollectionsKey,
+                   {reinterpret_cast<const char*>(buf.data()), buf.size()});
+    return dropped;
+}
+
+void LogKVStore::updateDroppedCollections(
+        VBLog& log,
+        LogBatch& batch,
+        std::vector<Collections::KVStore::DroppedCollection> dropped) {
+    for (const auto& drop : collectionsMeta.droppedCollections) {
+        // Delete the 'stats' document for the collection
+        batch.addLocal(getCollectionsStatsKey(drop.collectionId), {}, true);
+    }
+
+    auto buf = Collections::KVStore::encodeDroppedCollections(
+            collectionsMeta, std::move(dropped));
+    batch.addLocal(droppedCollectionsKey,
+                   {reinterpret_cast<const char*>(buf.data()), buf.size()});
+}
+
+void LogKVStore::updateScopes(VBLog& log, LogBatch& batch) {
+    auto scopes = readLocalDoc(log, openScopesKey);
+    auto buf = Collections::KVStore::encodeScopes(
+            collectionsMeta,
+            {reinterpret_cast<const uint8_t*>(scopes.data()), scopes.length()});
+    batch.addLocal(openScopesKey,
+                   {reinterpret_cast<const char*>(buf.data()), buf.size()});
+}
+
+std::string LogKVStore::getCollectionsStatsKey(CollectionID cid) {
+    return std::string{"|" + cid.to_string() + "|"};
+}
+
+Collections::VB::PersistedStats LogKVStore::getCollectionStats(
+        const KVFileHandle& kvFileHandle, CollectionID cid) {
+    const auto& kvfh = static_cast<const LogKVFileHandle&>(kvFileHandle);
+    auto log = getVBLog(kvfh.vbid);
+    if (!log) {
+        return {};
+    }
+    auto stats = readLocalDoc(*log, getCollectionsStatsKey(cid));
+    if (stats.empty()) {
+        return {};
+    }
+    return Collections::VB::PersistedStats(stats.c_str(), stats.size());
+}
+
+bool LogKVStore::getStat(const char* name, size_t& value) {
+    if (strcmp("failure_compaction", name) == 0) {
+        value = st.numCompactionFailure.load();
+    } else if (strcmp("failure_get", name) == 0) {
+        value = st.numGetFailure.load();
+    } else if (strcmp("io_document_write_bytes", name) == 0) {
+        value = st.io_document_write_bytes;
+    } else if (strcmp("io_flusher_write_bytes", name) == 0) {
+        value = st.fsStats.totalBytesWritten;
+    } else if (strcmp("io_total_read_bytes", name) == 0) {
+        value = st.fsStats.totalBytesRead.load() +
+                st.fsStatsCompaction.totalBytesRead.load();
+    } else if (strcmp("io_total_write_bytes", name) == 0) {
+        value = st.fsStats.totalBytesWritten.load() +
+                st.fsStatsCompaction.totalBytesWritten.load();
+    } else if (strcmp("io_compaction_read_bytes", name) == 0) {
+        value = st.fsStatsCompaction.totalBytesRead;
+    } else if (strcmp("io_compaction_write_bytes", name) == 0) {
+        value = st.fsStatsCompaction.totalBytesWritten;
+    } else if (strcmp("io_bg_fetch_read_count", name) == 0) {
+        value = st.getMultiFsReadCount;
+    } else if (strcmp("logstore_segments_compacted", name) == 0) {
+        value = segmentsCompacted;
+    } else if (strcmp("logstore_num_segments", name) == 0) {
+        std::lock_guard<std::mutex> lock(vbLogsMutex);
+        value = 0;
+        for (const auto& log : vbLogs) {
+            if (log) {
+                std::shared_lock<std::shared_timed_mutex> indexLock(
+                        log->indexMutex);
+                value += log->segments.size();
+            }
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void LogKVStore::addStats(const AddStatFn& add_stat,
+                          const void* c,
+                          const std::string& args) {
+    KVStore::addStats(add_stat, c, args);
+    const auto prefix = getStatsPrefix();
+
+    size_t value;
+    for (const char* name :
+         {"logstore_num_segments", "logstore_segments_compacted"}) {
+        if (getStat(name, value)) {
+            add_prefixed_stat(prefix, name, value, add_stat, c);
+        }
+    }
+    const auto info = getAggrDbFileInfo();
+    add_prefixed_stat(
+            prefix, "logstore_data_size", info.fileSize, add_stat, c);
+    add_prefixed_stat(
+            prefix, "logstore_live_data_size", info.spaceUsed, add_stat, c);
+}
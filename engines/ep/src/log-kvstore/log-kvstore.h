@@ -0,0 +1,409 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * Log-structured KVStore implementation.
+ *
+ * Each vBucket is stored as an append-only log split into segment files
+ * (<dbname>/logstore.<shard>/<vbid>.<revision>.<segment>.log). A flusher
+ * batch is serialised into one buffer and written with a single (O_DIRECT
+ * where supported) write followed by a single sync, so a commit costs one
+ * sequential write regardless of the number of documents in it.
+ *
+ * Every record is checksummed and stamped with a per-vBucket log sequence
+ * number (LSN). Each batch is terminated by a Commit record; on open the
+ * segments are replayed and anything after the last valid Commit record of
+ * a segment (a torn write) is ignored. Records are applied by LSN rather
+ * than by file position, which lets compaction move records between
+ * segments without rewriting anything else.
+ *
+ * The index is an in-memory key directory (key -> location of the latest
+ * version) plus a by-seqno view of it used for backfills. It is rebuilt by
+ * replaying the segments on open; reads take a single pread() per document.
+ *
+ * A background thread rewrites the live records of sealed segments whose
+ * garbage ratio exceeds logstore_compaction_threshold. compactDB() rewrites
+ * the whole vBucket, which is the only point where tombstones, completed
+ * prepares and dropped collections are purged.
+ */
+
+#include "collections/collection_persisted_stats.h"
+#include "kvstore.h"
+#include "rollback_result.h"
+#include "vbucket_bgfetch_item.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LogKVStoreConfig;
+class LogRequest;
+struct kvstats_ctx;
+
+namespace logkv {
+class LogBatch;
+class LogSegment;
+class VBLog;
+struct Location;
+struct LsnRange;
+} // namespace logkv
+
+/**
+ * A persistence store based on an append-only log.
+ */
+class LogKVStore : public KVStore {
+public:
+    /**
+     * Constructor
+     *
+     * @param config    Configuration information
+     */
+    explicit LogKVStore(LogKVStoreConfig& config);
+
+    ~LogKVStore() override;
+
+    void operator=(LogKVStore& from) = delete;
+
+    /**
+     * Reset database to a clean state.
+     */
+    void reset(Vbid vbucketId) override;
+
+    /**
+     * Begin a transaction (if not already in one).
+     */
+    bool begin(std::unique_ptr<TransactionContext> txCtx) override;
+
+    /**
+     * Commit a transaction (unless not currently in one).
+     *
+     * Returns false if the commit fails.
+     */
+    bool commit(VB::Commit& commitData) override;
+
+    /**
+     * Rollback a transaction (unless not currently in one).
+     */
+    void rollback() override;
+
+    void addStats(const AddStatFn& add_stat,
+                  const void* c,
+                  const std::string& args) override;
+
+    /*
+     * Get a LogKVStore specific stat
+     *
+     * @param name The name of the statistic to fetch.
+     * @param[out] value Value of the given stat (if exists).
+     * @return True if the stat exists, is of type size_t and was successfully
+     *         returned, else false.
+     */
+    bool getStat(const char* name, size_t& value) override;
+
+    /**
+     * Query the properties of the underlying storage.
+     */
+    StorageProperties getStorageProperties() override;
+
+    void set(const Item& item, KVStore::SetCallback cb) override;
+
+    GetValue get(const DiskDocKey& key, Vbid vb) override;
+
+    GetValue getWithHeader(void* dbHandle,
+                           const DiskDocKey& key,
+                           Vbid vb,
+                           GetMetaOnly getMetaOnly) override;
+
+    /**
+     * Fetch a batch of documents. The lookups are done against the key
+     * directory first and the reads are then issued in file order.
+     */
+    void getMulti(Vbid vb, vb_bgfetch_queue_t& itms) override;
+
+    void getRange(Vbid vb,
+                  const DiskDocKey& startKey,
+                  const DiskDocKey& endKey,
+                  const GetRangeCb& cb) override;
+
+    void del(const Item& itm, DeleteCallback cb) override;
+
+    void delVBucket(Vbid vbucket, uint64_t fileRev) override;
+
+    std::vector<vbucket_state*> listPersistedVbuckets() override;
+
+    bool snapshotVBucket(Vbid vbucketId,
+                         const vbucket_state& vbstate,
+                         VBStatePersist options) override;
+
+    /**
+     * Rewrite every segment of the vBucket, purging what the compaction
+     * context allows. Writes may continue concurrently; they go to a fresh
+     * segment which is not part of the compaction.
+     */
+    bool compactDB(compaction_ctx* ctx) override;
+
+    Vbid getDBFileId(const cb::mcbp::Request& req) override;
+
+    vbucket_state* getVBucketState(Vbid vbucketId) override;
+
+    size_t getNumPersistedDeletes(Vbid vbid) override;
+
+    DBFileInfo getDbFileInfo(Vbid vbid) override;
+
+    DBFileInfo getAggrDbFileInfo() override;
+
+    size_t getItemCount(Vbid vbid) override;
+
+    /**
+     * Roll the vBucket back to the most recent commit whose high seqno is
+     * not above rollbackSeqno. Fails (so the caller rolls back to zero) if
+     * compaction has already discarded versions needed for that commit.
+     */
+    RollbackResult rollback(Vbid vbid,
+                            uint64_t rollbackSeqno,
+                            std::shared_ptr<RollbackCB> cb) override;
+
+    void pendingTasks() override {
+        // Deletions and compaction are handled synchronously or by the
+        // background compactor; nothing is deferred to the flusher.
+    }
+
+    ENGINE_ERROR_CODE getAllKeys(
+            Vbid vbid,
+            const DiskDocKey& start_key,
+            uint32_t count,
+            std::shared_ptr<Callback<const DiskDocKey&>> cb) override;
+
+    ScanContext* initScanContext(
+            std::shared_ptr<StatusCallback<GetValue>> cb,
+            std::shared_ptr<StatusCallback<CacheLookup>> cl,
+            Vbid vbid,
+            uint64_t startSeqno,
+            DocumentFilter options,
+            ValueFilter valOptions) override;
+
+    scan_error_t scan(ScanContext* sctx) override;
+
+    void destroyScanContext(ScanContext* ctx) override;
+
+    class LogKVFileHandle : public ::KVFileHandle {
+    public:
+        LogKVFileHandle(LogKVStore& kvstore, Vbid vbid)
+            : ::KVFileHandle(kvstore), vbid(vbid) {
+        }
+        Vbid vbid;
+    };
+
+    std::unique_ptr<KVFileHandle, KVFileHandleDeleter> makeFileHandle(
+            Vbid vbid) override;
+
+    void freeFileHandle(KVFileHandle* kvFileHandle) const override {
+        delete kvFileHandle;
+    }
+
+    Collections::VB::PersistedStats getCollectionStats(
+            const KVFileHandle& kvFileHandle,
+            CollectionID collection) override;
+
+    void prepareToCreateImpl(Vbid vbid) override {
+        // A new log is created on the first write to the vBucket.
+    }
+
+    uint64_t prepareToDeleteImpl(Vbid vbid) override;
+
+    Collections::KVStore::Manifest getCollectionsManifest(Vbid vbid) override;
+
+    std::vector<Collections::KVStore::DroppedCollection> getDroppedCollections(
+            Vbid vbid) override;
+
+private:
+    using PendingRequestQueue = std::deque<LogRequest>;
+
+    /// @return the log of the given vBucket, or nullptr if it has none
+    std::shared_ptr<logkv::VBLog> getVBLog(Vbid vbid);
+
+    /// @return the log of the given vBucket, creating it if necessary
+    std::shared_ptr<logkv::VBLog> getOrCreateVBLog(Vbid vbid);
+
+    /// Open and replay all the logs found in the data directory.
+    void openVBLogs();
+
+    /**
+     * Rebuild the index of the log by replaying its segments, ignoring any
+     * record (and commit) with an LSN in the discard range. The caller must
+     * have exclusive access to the log.
+     */
+    void replay(logkv::VBLog& log, const logkv::LsnRange& discard);
+
+    /**
+     * Load the persisted vbucket_state of the given log into
+     * cachedVBStates.
+     * @return false if the log has no (valid) vbstate document
+     */
+    bool readVBState(logkv::VBLog& log);
+
+    /**
+     * Mark the log as dropped and wait for any write or compaction of it
+     * which is in progress to finish.
+     */
+    void dropVBLog(logkv::VBLog& log);
+
+    bool saveDocs(logkv::VBLog& log,
+                  VB::Commit& commitData,
+                  kvstats_ctx& kvctx,
+                  PendingRequestQueue& commitBatch);
+
+    void commitCallback(bool success, PendingRequestQueue& commitBatch);
+
+    /**
+     * Write the batch to the active segment of the log (one write, one
+     * sync) and apply it to the index. The caller must hold the log's
+     * writeMutex.
+     *
+     * @param highSeqno high seqno to record in the batch's Commit record
+     * @param[out] bytesWritten physical bytes written to disk
+     * @return false if the write failed; the index is then unchanged
+     */
+    bool writeBatch(logkv::VBLog& log,
+                    logkv::LogBatch& batch,
+                    int64_t highSeqno,
+                    size_t& bytesWritten);
+
+    /// Create a new, empty segment file for the log.
+    std::shared_ptr<logkv::LogSegment> createSegment(logkv::VBLog& log);
+
+    /// @return the segment batches are appended to, creating it if needed
+    std::shared_ptr<logkv::LogSegment> getActiveSegment(logkv::VBLog& log);
+
+    /**
+     * Close the active segment (if any) so that the next write starts a
+     * new one. The caller must hold the log's writeMutex.
+     */
+    void sealActiveSegment(logkv::VBLog& log);
+
+    /**
+     * Read the document record at the given location.
+     * @return the item, or nullptr if the record is not a valid document
+     */
+    std::unique_ptr<Item> readItem(Vbid vbid,
+                                   const logkv::Location& location,
+                                   GetMetaOnly getMetaOnly,
+                                   FileStats& stats);
+
+    /**
+     * Rewrite the live records of the given (sealed) segments into new
+     * segments and drop the originals. If ctx is non-null, documents may
+     * also be purged as described by the compaction context. The caller
+     * must hold the log's compactionMutex.
+     *
+     * @return false if the log was dropped or an IO error occurred
+     */
+    bool compactSegments(
+            logkv::VBLog& log,
+            const std::vector<std::shared_ptr<logkv::LogSegment>>& segments,
+            compaction_ctx* ctx);
+
+    /// Main loop of the background segment compactor.
+    void runBackgroundCompactor();
+
+    /// Compact the sealed segments above the garbage threshold.
+    void compactGarbageSegments();
+
+    std::string getSegmentPath(Vbid vbid,
+                               uint64_t revision,
+                               uint32_t segment) const;
+
+    /**
+     * Path of the marker recording an unfinished rollback; while it exists
+     * the records in its LSN range are ignored when the log is opened.
+     */
+    std::string getRollbackMarkerPath(Vbid vbid, uint64_t revision) const;
+
+    /// Remove all the segment files of the given vBucket revision.
+    void removeSegmentFiles(Vbid vbid, uint64_t revision);
+
+    /// @return the value of the local document, or "" if it does not exist
+    std::string readLocalDoc(logkv::VBLog& log, const std::string& key);
+
+    void updateCollectionsMeta(logkv::VBLog& log,
+                               logkv::LogBatch& batch,
+                               Collections::VB::Flush& collectionsFlush);
+
+    void updateManifestUid(logkv::LogBatch& batch);
+
+    std::vector<Collections::KVStore::DroppedCollection> updateOpenCollections(
+            logkv::VBLog& log, logkv::LogBatch& batch);
+
+    void updateDroppedCollections(
+            logkv::VBLog& log,
+            logkv::LogBatch& batch,
+            std::vector<Collections::KVStore::DroppedCollection> dropped);
+
+    void updateScopes(logkv::VBLog& log, logkv::LogBatch& batch);
+
+    std::string getCollectionsStatsKey(CollectionID cid);
+
+    LogKVStoreConfig& logConfig;
+
+    /// Directory holding the segment files of this shard
+    const std::string dbPath;
+
+    /**
+     * The log of each vBucket (null if the vBucket has none), and the
+     * revision the next log created for that vBucket will have. Guarded by
+     * vbLogsMutex.
+     */
+    std::vector<std::shared_ptr<logkv::VBLog>> vbLogs;
+    std::vector<uint64_t> vbRevisions;
+    std::mutex vbLogsMutex;
+
+    // Used for queueing mutation requests (in `set` and `del`) and flushing
+    // them to disk (in `commit`).
+    // unique_ptr for pimpl.
+    std::unique_ptr<PendingRequestQueue> pendingReqs;
+
+    // This variable is used to verify that the KVStore API is used correctly
+    // when LogKVStore is used as store. "Correctly" means that the caller
+    // must use the API in the following way:
+    //      - begin() x1
+    //      - set() / del() xN
+    //      - commit()
+    bool in_transaction;
+
+    std::unique_ptr<TransactionContext> transactionCtx;
+
+    std::atomic<size_t> scanCounter; // atomic counter for generating scan id
+
+    /// Number of segments rewritten by compaction
+    std::atomic<size_t> segmentsCompacted{0};
+
+    // Background compactor. compactorWakeup is guarded by compactorMutex.
+    std::thread compactorThread;
+    std::mutex compactorMutex;
+    std::condition_variable compactorCv;
+    std::atomic<bool> compactorShutdown{false};
+    bool compactorWakeup{false};
+
+    BucketLogger& logger;
+};
@@ -0,0 +1,59 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "kvstore_config.h"
+
+class Configuration;
+
+// This class represents the LogKVStore specific configuration.
+// LogKVStore uses this in place of the KVStoreConfig base class.
+class LogKVStoreConfig : public KVStoreConfig {
+public:
+    // Initialize the object from the central EPEngine Configuration
+    LogKVStoreConfig(Configuration& config,
+                     uint16_t numShards,
+                     uint16_t shardid);
+
+    // Return the size at which the active log segment is sealed and a new
+    // one is started.
+    size_t getSegmentSize() const {
+        return segmentSize;
+    }
+
+    // Return true if segments should be written with O_DIRECT.
+    bool getDirectIo() const {
+        return directIo;
+    }
+
+    // Return the fraction of dead bytes in a sealed segment above which
+    // the background compactor rewrites it.
+    float getCompactionThreshold() const {
+        return compactionThreshold;
+    }
+
+private:
+    // Size in bytes at which a log segment is sealed
+    size_t segmentSize = 0;
+
+    // Bypass the page cache when writing log segments
+    bool directIo = false;
+
+    // Garbage ratio which makes a sealed segment eligible for compaction
+    float compactionThreshold = 0;
+};
@@ -0,0 +1,289 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mapped_access_log.h"
+
+extern "C" {
+#include "crc32.h"
+}
+
+#include <folly/portability/Unistd.h>
+#include <gsl/gsl>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+static const std::array<uint8_t, 8> magic{
+        {'c', 'b', 'a', 'l', 'o', 'g', 0, 1}};
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = uint8_t(v >> 8);
+    p[1] = uint8_t(v);
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    for (int i = 3; i >= 0; --i) {
+        p[i] = uint8_t(v);
+        v >>= 8;
+    }
+}
+
+static void putU64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; --i) {
+        p[i] = uint8_t(v);
+        v >>= 8;
+    }
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return uint16_t(p[0]) << 8 | p[1];
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 |
+           p[3];
+}
+
+static uint64_t getU64(const uint8_t* p) {
+    return uint64_t(getU32(p)) << 32 | getU32(p + 4);
+}
+
+MappedAccessLogWriter::MappedAccessLogWriter(std::string path)
+    : path(std::move(path)) {
+    file = std::fopen(this->path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::system_error(errno,
+                                std::system_category(),
+                                "MappedAccessLogWriter: failed to create " +
+                                        this->path);
+    }
+    // Reserve space for the header, written by commit()
+    std::array<uint8_t, MappedAccessLogFormat::HeaderSize> header{};
+    write(header.data(), header.size());
+}
+
+MappedAccessLogWriter::~MappedAccessLogWriter() {
+    if (file != nullptr) {
+        // Not committed; don't leave a partial file behind
+        std::fclose(file);
+        std::remove(path.c_str());
+    }
+}
+
+void MappedAccessLogWriter::addVBucket(Vbid vbid,
+                                       std::vector<StoredDocKey> keys) {
+    for (const auto& entry : directory) {
+        if (entry.vbid == vbid) {
+            throw std::logic_error("MappedAccessLogWriter::addVBucket: " +
+                                   vbid.to_string() + " already added");
+        }
+    }
+    if (keys.empty()) {
+        return;
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint8_t> section((keys.size() + 1) * sizeof(uint32_t));
+    uint32_t keyOffset = 0;
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        putU32(section.data() + ii * sizeof(uint32_t), keyOffset);
+        keyOffset += gsl::narrow<uint32_t>(keys[ii].size());
+    }
+    putU32(section.data() + keys.size() * sizeof(uint32_t), keyOffset);
+    section.reserve(section.size() + keyOffset);
+    for (const auto& key : keys) {
+        section.insert(section.end(), key.data(), key.data() + key.size());
+    }
+
+    directory.push_back({vbid,
+                         gsl::narrow<uint32_t>(keys.size()),
+                         offset,
+                         section.size(),
+                         crc32buf(section.data(), section.size())});
+    write(section.data(), section.size());
+    numKeys += keys.size();
+}
+
+size_t MappedAccessLogWriter::commit() {
+    const uint64_t directoryOffset = offset;
+    std::array<uint8_t, MappedAccessLogFormat::DirectoryEntrySize> buf;
+    for (const auto& entry : directory) {
+        buf.fill(0);
+        putU16(buf.data(), entry.vbid.get());
+        putU32(buf.data() + 4, entry.numKeys);
+        putU64(buf.data() + 8, entry.offset);
+        putU64(buf.data() + 16, entry.length);
+        putU32(buf.data() + 24, entry.crc);
+        write(buf.data(), buf.size());
+    }
+
+    std::array<uint8_t, MappedAccessLogFormat::HeaderSize> header{};
+    std::copy(magic.begin(), magic.end(), header.begin());
+    putU32(header.data() + 8, MappedAccessLogFormat::Version);
+    putU32(header.data() + 12, gsl::narrow<uint32_t>(directory.size()));
+    putU64(header.data() + 16, numKeys);
+    putU64(header.data() + 24, directoryOffset);
+    if (std::fseek(file, 0, SEEK_SET) != 0) {
+        throw std::system_error(errno,
+                                std::system_category(),
+                                "MappedAccessLogWriter::commit: seek failed");
+    }
+    write(header.data(), header.size());
+
+    // The AccessScanner renames the log over the previous one once it's
+    // committed, so (as MutationLog::close() does) make sure it's on disk
+    // first; otherwise a crash could leave neither log intact.
+    bool synced = std::fflush(file) == 0;
+    if (synced) {
+        int ret;
+        while ((ret = fsync(fileno(file))) == -1 && errno == EINTR) {
+            // Retry
+        }
+        synced = ret == 0;
+    }
+    const int error = errno;
+    std::fclose(file);
+    file = nullptr;
+    if (!synced) {
+        std::remove(path.c_str());
+        throw std::system_error(error,
+                                std::system_category(),
+                                "MappedAccessLogWriter::commit: sync failed");
+    }
+    return numKeys;
+}
+
+void MappedAccessLogWriter::write(const void* data, size_t size) {
+    if (std::fwrite(data, 1, size, file) != size) {
+        throw std::system_error(errno,
+                                std::system_category(),
+                                "MappedAccessLogWriter: failed to write " +
+                                        path);
+    }
+    offset += size;
+}
+
+MappedAccessLog::MappedAccessLog(const std::string& path)
+    : map(path.c_str(), cb::io::MemoryMappedFile::Mode::RDONLY) {
+    auto content = map.content();
+    base = reinterpret_cast<const uint8_t*>(content.data());
+    size = content.size();
+
+    if (size < MappedAccessLogFormat::HeaderSize ||
+        !std::equal(magic.begin(), magic.end(), base)) {
+        throw ReadException("MappedAccessLog: " + path +
+                            " is not a mapped access log");
+    }
+    const auto version = getU32(base + 8);
+    if (version != MappedAccessLogFormat::Version) {
+        throw ReadException("MappedAccessLog: " + path +
+                            " has unsupported version " +
+                            std::to_string(version));
+    }
+    const auto numVBuckets = getU32(base + 12);
+    numKeys = getU64(base + 16);
+    const auto directoryOffset = getU64(base + 24);
+    if (directoryOffset > size ||
+        (size - directoryOffset) / MappedAccessLogFormat::DirectoryEntrySize <
+                numVBuckets) {
+        throw ReadException("MappedAccessLog: " + path +
+                            " has a truncated directory");
+    }
+
+    const uint8_t* entry = base + directoryOffset;
+    for (uint32_t ii = 0; ii < numVBuckets;
+         ++ii, entry += MappedAccessLogFormat::DirectoryEntrySize) {
+        Vbid vbid(getU16(entry));
+        Section section{getU64(entry + 8),
+                        getU64(entry + 16),
+                        getU32(entry + 4),
+                        getU32(entry + 24)};
+        if (section.offset < MappedAccessLogFormat::HeaderSize ||
+            section.offset > directoryOffset ||
+            section.length > directoryOffset - section.offset ||
+            section.length <
+                    (uint64_t(section.numKeys) + 1) * sizeof(uint32_t)) {
+            throw ReadException("MappedAccessLog: " + path +
+                                " has an invalid section for " +
+                                vbid.to_string());
+        }
+        vbuckets.push_back(vbid);
+        sections[vbid] = section;
+    }
+}
+
+bool MappedAccessLog::isMappedAccessLog(const std::string& path) {
+    std::FILE* fp = std::fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    std::array<uint8_t, 8> buf{};
+    const bool match = std::fread(buf.data(), 1, buf.size(), fp) ==
+                               buf.size() &&
+                       buf == magic;
+    std::fclose(fp);
+    return match;
+}
+
+std::vector<Vbid> MappedAccessLog::getVBuckets() const {
+    return vbuckets;
+}
+
+MappedAccessLog::Keys MappedAccessLog::getKeys(Vbid vbid) const {
+    auto it = sections.find(vbid);
+    if (it == sections.end()) {
+        return {};
+    }
+    const auto& section = it->second;
+    const uint8_t* start = base + section.offset;
+    // crc32buf takes a non-const pointer but does not modify the buffer
+    if (crc32buf(const_cast<uint8_t*>(start), section.length) != section.crc) {
+        throw ReadException("MappedAccessLog::getKeys: CRC mismatch for " +
+                            vbid.to_string());
+    }
+
+    // Validate the key offsets once so at() can trust them
+    const uint64_t keyBytes =
+            section.length - (uint64_t(section.numKeys) + 1) * sizeof(uint32_t);
+    uint32_t previous = 0;
+    for (uint32_t ii = 0; ii <= section.numKeys; ++ii) {
+        const auto current = getU32(start + ii * sizeof(uint32_t));
+        if (current < previous || current > keyBytes) {
+            throw ReadException("MappedAccessLog::getKeys: invalid key offset "
+                                "for " +
+                                vbid.to_string());
+        }
+        previous = current;
+    }
+    return {start, section.numKeys};
+}
+
+MappedAccessLog::Keys::Keys(const uint8_t* section, uint32_t count)
+    : offsets(section),
+      keyData(section + (size_t(count) + 1) * sizeof(uint32_t)),
+      count(count) {
+}
+
+DocKey MappedAccessLog::Keys::at(size_t index) const {
+    const auto begin = getU32(offsets + index * sizeof(uint32_t));
+    const auto end = getU32(offsets + (index + 1) * sizeof(uint32_t));
+    return {keyData + begin, end - begin, DocKeyEncodesCollectionId::Yes};
+}
@@ -0,0 +1,241 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * Memory-mapped access log.
+ *
+ * An alternative on-disk format for the access.log (see mutation_log.h for
+ * the original format). Instead of a stream of small CRC'd blocks of
+ * individually encoded entries, the keys are stored grouped by vBucket in one
+ * contiguous section per vBucket, sorted in key order (which is the order of
+ * the by-id B-tree on disk, so fetching the keys in file order reads the data
+ * files sequentially).
+ *
+ * The file is read through a read-only memory mapping; keys are handed out as
+ * DocKey views pointing directly into the mapping, so reading the log needs
+ * no per-entry parsing or copying.
+ *
+ * Layout (all integers big-endian):
+ *
+ *     Header (32 bytes):
+ *         magic[8]         "cbalog\0\1"
+ *         uint32 version
+ *         uint32 numVBuckets
+ *         uint64 numKeys
+ *         uint64 directoryOffset
+ *     Section per vBucket (at the offset recorded in the directory):
+ *         uint32 keyOffsets[numKeys + 1]  (relative to the start of the keys)
+ *         uint8  keys[]                   (collection-encoded DocKeys)
+ *     Directory (numVBuckets entries of 32 bytes, at directoryOffset):
+ *         uint16 vbid
+ *         uint16 reserved
+ *         uint32 numKeys
+ *         uint64 offset     (of the section from the start of the file)
+ *         uint64 length     (of the section in bytes)
+ *         uint32 crc        (crc32 of the section)
+ *         uint32 reserved
+ */
+
+#include "storeddockey.h"
+
+#include <memcached/dockey.h>
+#include <memcached/vbucket.h>
+#include <platform/memorymap.h>
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace MappedAccessLogFormat {
+/// Size of the file header
+static const size_t HeaderSize = 32;
+/// Size of a single vBucket directory entry
+static const size_t DirectoryEntrySize = 32;
+/// Current version of the format
+static const uint32_t Version = 1;
+} // namespace MappedAccessLogFormat
+
+/**
+ * Writes a memory-mappable access log. The keys of each vBucket are added in
+ * one call to addVBucket(); the file is only valid once commit() has been
+ * called.
+ */
+class MappedAccessLogWriter {
+public:
+    /**
+     * Create (truncating any existing file) the access log at the given path.
+     * @throws std::system_error if the file cannot be created
+     */
+    explicit MappedAccessLogWriter(std::string path);
+
+    ~MappedAccessLogWriter();
+
+    /**
+     * Append the keys of the given vBucket to the log. The keys are sorted
+     * before being written.
+     * @throws std::logic_error if the vBucket has already been added
+     * @throws std::system_error on write failure
+     */
+    void addVBucket(Vbid vbid, std::vector<StoredDocKey> keys);
+
+    /**
+     * Write the directory and header, sync the file to disk and close it.
+     * @return the number of keys written
+     * @throws std::system_error on write or sync failure
+     */
+    size_t commit();
+
+    size_t getNumKeys() const {
+        return numKeys;
+    }
+
+private:
+    void write(const void* data, size_t size);
+
+    struct DirectoryEntry {
+        Vbid vbid;
+        uint32_t numKeys;
+        uint64_t offset;
+        uint64_t length;
+        uint32_t crc;
+    };
+
+    const std::string path;
+    std::FILE* file;
+    uint64_t offset{0};
+    size_t numKeys{0};
+    std::vector<DirectoryEntry> directory;
+};
+
+/**
+ * Read-only view of a memory-mapped access log.
+ */
+class MappedAccessLog {
+public:
+    /**
+     * Exception thrown if the file is not a valid mapped access log.
+     */
+    class ReadException : public std::runtime_error {
+    public:
+        explicit ReadException(const std::string& s) : std::runtime_error(s) {
+        }
+    };
+
+    /**
+     * Map and validate the header and directory of the given file.
+     * @throws ReadException if the file is not a valid mapped access log
+     * @throws std::system_error if the file cannot be mapped
+     */
+    explicit MappedAccessLog(const std::string& path);
+
+    /**
+     * @return true if the given file exists and starts with the mapped
+     *         access log magic (i.e. it is not a MutationLog based log).
+     */
+    static bool isMappedAccessLog(const std::string& path);
+
+    /**
+     * The keys of one vBucket, as DocKey views into the mapped file. Only
+     * valid for the lifetime of the MappedAccessLog.
+     */
+    class Keys {
+    public:
+        class iterator {
+        public:
+            iterator(const Keys& keys, size_t index)
+                : keys(keys), index(index) {
+            }
+
+            DocKey operator*() const {
+                return keys.at(index);
+            }
+
+            iterator& operator++() {
+                ++index;
+                return *this;
+            }
+
+            bool operator!=(const iterator& other) const {
+                return index != other.index;
+            }
+
+        private:
+            const Keys& keys;
+            size_t index;
+        };
+
+        Keys() = default;
+
+        Keys(const uint8_t* section, uint32_t count);
+
+        size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        DocKey at(size_t index) const;
+
+        iterator begin() const {
+            return {*this, 0};
+        }
+
+        iterator end() const {
+            return {*this, count};
+        }
+
+    private:
+        const uint8_t* offsets{nullptr};
+        const uint8_t* keyData{nullptr};
+        uint32_t count{0};
+    };
+
+    /// @return the vBuckets present in the log, in file order
+    std::vector<Vbid> getVBuckets() const;
+
+    /**
+     * @return the keys of the given vBucket (empty if not present)
+     * @throws ReadException if the vBucket's section fails its CRC check
+     */
+    Keys getKeys(Vbid vbid) const;
+
+    size_t getNumKeys() const {
+        return numKeys;
+    }
+
+private:
+    struct Section {
+        uint64_t offset;
+        uint64_t length;
+        uint32_t numKeys;
+        uint32_t crc;
+    };
+
+    cb::io::MemoryMappedFile map;
+    const uint8_t* base{nullptr};
+    size_t size{0};
+    size_t numKeys{0};
+    std::vector<Vbid> vbuckets;
+    std::unordered_map<Vbid, Section> sections;
+};
@@ -22,7 +22,7 @@
 
 #include "bucket_logger.h"
 #include "memory_tracker.h"
-#include "objectregistry.h"
+#include "stats.h"
 #include "utility.h"
 
 std::atomic<bool> MemoryTracker::tracking{false};
@@ -56,15 +56,13 @@ MemoryTracker* MemoryTracker::getInstance(
         std::lock_guard<std::mutex> lock(instance_mutex);
         tmp = instance.load();
         if (tmp == nullptr) {
-            // Note that object construction and hook attaching is
-            // split. The issue is that until the constructor
-            // completes (and {instance} is assigned) it is not
-            // possible to 'service' any memory allocator callbacks -
-            // as the New/Delete hooks need to read {instance}.hooks_api
+            // Note that object construction and starting the stats
+            // thread is split, so the thread never sees a partially
+            // constructed tracker.
             tmp = new MemoryTracker(hooks_api_);
             instance.store(tmp);
 
-            instance.load()->connectHooks();
+            instance.load()->startStatsThread();
         }
     }
     return tmp;
@@ -79,59 +77,37 @@ void MemoryTracker::destroyInstance() {
     }
 }
 
-void MemoryTracker::NewHook(const void* ptr, size_t) {
-    if (ptr != NULL) {
-        const auto* tracker = MemoryTracker::instance.load();
-        void* p = const_cast<void*>(ptr);
-        size_t alloc = tracker->hooks_api.get_allocation_size(p);
-        ObjectRegistry::memoryAllocated(alloc);
-    }
-}
-
-void MemoryTracker::DeleteHook(const void* ptr) {
-    if (ptr != NULL) {
-        const auto* tracker = MemoryTracker::instance.load();
-        void* p = const_cast<void*>(ptr);
-        size_t alloc = tracker->hooks_api.get_allocation_size(p);
-        ObjectRegistry::memoryDeallocated(alloc);
-    }
-}
-
 MemoryTracker::MemoryTracker(const ServerAllocatorIface& hooks_api_)
     : hooks_api(hooks_api_) {
-    // Just create the object, actual hook registration happens
-    // once we have a concrete object constructed.
+    // Just create the object, the stats thread is started once we have a
+    // concrete object constructed.
 }
 
-void MemoryTracker::connectHooks() {
+void MemoryTracker::startStatsThread() {
     if (getenv("EP_NO_MEMACCOUNT") != NULL) {
         EP_LOG_INFO("Memory allocation tracking disabled");
         return;
     }
+    if (!EPStats::isMemoryTrackingEnabled()) {
+        EP_LOG_WARN("Allocator cannot track memory allocations");
+        return;
+    }
     stats.ext_stats.resize(hooks_api.get_extra_stats_size());
 
-    if (hooks_api.add_new_hook(&NewHook)) {
-        EP_LOG_DEBUG("Registered add hook");
-        if (hooks_api.add_delete_hook(&DeleteHook)) {
-            EP_LOG_DEBUG("Registered delete hook");
-            tracking = true;
-            updateStats();
-            if (cb_create_named_thread(&statsThreadId,
-                                       statsThreadMainLoop,
-                                       this, 0, "mc:mem stats") != 0) {
-                throw std::runtime_error(
-                        "Error creating thread to update stats");
-            }
-            return;
-        }
-        hooks_api.remove_new_hook(&NewHook);
+    // Per-bucket memory usage is read from each bucket's allocator arena
+    // (see cb::ArenaMalloc), so no new/delete hooks are registered; this
+    // thread just refreshes the allocator-wide stats.
+    tracking = true;
+    updateStats();
+    if (cb_create_named_thread(
+                &statsThreadId, statsThreadMainLoop, this, 0, "mc:mem stats") !=
+        0) {
+        tracking = false;
+        throw std::runtime_error("Error creating thread to update stats");
     }
-    EP_LOG_WARN("Failed to register allocator hooks");
 }
 
 MemoryTracker::~MemoryTracker() {
-    hooks_api.remove_new_hook(&NewHook);
-    hooks_api.remove_delete_hook(&DeleteHook);
     if (tracking) {
         tracking = false;
         shutdown_cv.notify_all();
@@ -26,8 +26,10 @@
 #include <string>
 
 /**
- * This class is used by ep-engine to hook into memcached's memory tracking
- * capabilities.
+ * This class is used by ep-engine to read memcached's allocator stats.
+ *
+ * Memory used by each bucket is not tracked here; each bucket allocates from
+ * its own arena(s) (see cb::ArenaMalloc) and reads its usage from the arena.
  */
 class MemoryTracker {
 public:
@@ -59,16 +61,13 @@ public:
 private:
     MemoryTracker(const ServerAllocatorIface& hooks_api_);
 
-    // Helper function for construction - connects the tracker
-    // to the memory allocator via alloc_hooks.
-    void connectHooks();
+    // Helper function for construction - starts the thread which
+    // periodically refreshes the allocator stats.
+    void startStatsThread();
 
     // Function for the stats updater main loop.
     static void statsThreadMainLoop(void* arg);
 
-    static void NewHook(const void* ptr, size_t);
-    static void DeleteHook(const void* ptr);
-
     // Wheter or not we have the ability to accurately track memory allocations
     static std::atomic<bool> tracking;
     // Singleton memory tracker and mutex guarding it's creation.
@@ -83,7 +82,6 @@ private:
     // Condition variable used to signal shutdown to the stats thread.
     std::condition_variable shutdown_cv;
 
-    // Memory allocator hooks API to use (needed by New / Delete hook
-    // functions)
+    // Memory allocator hooks API used to read allocator stats
     ServerAllocatorIface hooks_api;
 };
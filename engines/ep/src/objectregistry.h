@@ -54,10 +54,6 @@ public:
 
     static EventuallyPersistentEngine *onSwitchThread(EventuallyPersistentEngine *engine,
                                                       bool want_old_thread_local = false);
-
-    static void setStats(std::atomic<size_t>* init_track);
-    static bool memoryAllocated(size_t mem);
-    static bool memoryDeallocated(size_t mem);
 };
 
 /**
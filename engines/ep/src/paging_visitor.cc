@@ -28,6 +28,7 @@
 #include "kv_bucket.h"
 #include "kv_bucket_iface.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
@@ -101,7 +102,7 @@ bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
      * doEviction can modify the value, and when we want to
      * add it to the histogram we want to use the original value.
      */
-    auto storedValueFreqCounter = v.getFreqCounterValue();
+    auto storedValueFreqCounter = getEvictionFreqCounter(v);
     bool evicted = true;
 
     /*
@@ -155,8 +156,9 @@ bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
              * visited (and assuming their frequency counter is not
              * incremented in between visits of the item pager).
              */
-            if (storedValueFreqCounter > 0) {
-                v.setFreqCounterValue(storedValueFreqCounter - 1);
+            const auto freqCounter = v.getFreqCounterValue();
+            if (freqCounter > 0) {
+                v.setFreqCounterValue(freqCounter - 1);
             }
         }
     }
@@ -218,6 +220,13 @@ void PagingVisitor::visitBucket(const VBucketPtr& vb) {
     if (current > lower) {
         double p = (current - static_cast<double>(lower)) / current;
         adjustPercent(p, vb->getState());
+        if (meanVBucketMemory > 0) {
+            const double pressure = std::min(
+                    2.0,
+                    std::max(0.5,
+                             double(vb->getMemoryUsed()) / meanVBucketMemory));
+            percent = std::min(0.9, percent * pressure);
+        }
         if (vBucketFilter(vb->getId())) {
             currentBucket = vb;
             maxCas = currentBucket->getMaxCas();
@@ -236,6 +245,12 @@ void PagingVisitor::visitBucket(const VBucketPtr& vb) {
                                         : ItemEviction::learningPopulation;
             itemEviction.setUpdateInterval(interval);
 
+            if (sampleSize > 0) {
+                evictSampled(*vb);
+                removeClosedUnrefCheckpoints(*vb);
+                return;
+            }
+
             vb->ht.visit(*this);
             /**
              * Note: We are not taking a reader lock on the vbucket state.
@@ -381,6 +396,146 @@ bool PagingVisitor::doEviction(const HashTable::HashBucketLock& lh,
     return false;
 }
 
+void PagingVisitor::enableSampledEviction(size_t sampleSize,
+                                          size_t evictPerc,
+                                          size_t bytesToFree,
+                                          size_t itemMemory) {
+    this->sampleSize = sampleSize;
+    sampleEvictPerc = std::min(std::max(evictPerc, size_t(1)), size_t(100));
+    sampleBytesToFree = bytesToFree;
+    sampleItemMemory = itemMemory;
+}
+
+void PagingVisitor::setMemoryAttribution(
+        size_t meanVBucketMemory,
+        std::unordered_map<CollectionID, double> collectionPressure) {
+    this->meanVBucketMemory = meanVBucketMemory;
+    this->collectionPressure = std::move(collectionPressure);
+}
+
+uint8_t PagingVisitor::getEvictionFreqCounter(const StoredValue& v) const {
+    const auto freqCounter = v.getFreqCounterValue();
+    if (collectionPressure.empty()) {
+        return freqCounter;
+    }
+    auto it = collectionPressure.find(v.getKey().getCollectionID());
+    if (it == collectionPressure.end()) {
+        return freqCounter;
+    }
+    return static_cast<uint8_t>(freqCounter / it->second);
+}
+
+bool PagingVisitor::SampleCollector::visit(const HashTable::HashBucketLock& lh,
+                                           StoredValue& v) {
+    if (v.isPending() || v.isCompleted()) {
+        return true;
+    }
+
+    auto& vb = *pager.currentBucket;
+    bool isExpired = (vb.getState() == vbucket_state_active) &&
+                     v.isExpired(pager.startTime) && !v.isDeleted();
+    if (isExpired || v.isTempNonExistentItem() || v.isTempDeletedItem()) {
+        std::unique_ptr<Item> it = v.toItem(vb.getId());
+        pager.expired.push_back(*it.get());
+        return true;
+    }
+
+    if (!vb.eligibleToPageOut(lh, v)) {
+        return true;
+    }
+
+    // Age as per PagingVisitor::visit()
+    uint64_t age =
+            (pager.maxCas > v.getCas()) ? (pager.maxCas - v.getCas()) : 0;
+    age = age >> ItemEviction::casBitsNotTime;
+    pager.candidates.push_back(
+            {StoredDocKey(v.getKey()), pager.getEvictionFreqCounter(v), age});
+    return true;
+}
+
+void PagingVisitor::evictSampled(VBucket& vb) {
+    // This vBucket's share of the bytes to free, by its share of the item
+    // memory of all the vBuckets being visited.
+    const size_t vbItemMemory = vb.ht.getItemMemory();
+    size_t target = sampleBytesToFree;
+    if (sampleItemMemory > vbItemMemory) {
+        target = static_cast<size_t>(double(sampleBytesToFree) *
+                                     vbItemMemory / sampleItemMemory);
+    }
+
+    // Bound the work done on a single vBucket; enough rounds to sample each
+    // item about twice, and give up early if repeated rounds find nothing
+    // to evict.
+    const size_t maxRounds =
+            std::max(size_t(1), vb.ht.getNumInMemoryItems() / sampleSize) * 2;
+    const size_t maxEmptyRounds = 3;
+
+    SampleCollector collector(*this);
+    size_t emptyRounds = 0;
+    for (size_t round = 0; round < maxRounds && emptyRounds < maxEmptyRounds;
+         ++round) {
+        const size_t itemMemory = vb.ht.getItemMemory();
+        if (vbItemMemory > itemMemory && vbItemMemory - itemMemory >= target) {
+            break;
+        }
+        if (stats.getEstimatedTotalMemoryUsed() <= stats.mem_low_wat) {
+            isBelowLowWaterMark = true;
+            break;
+        }
+
+        candidates.clear();
+        vb.ht.visitSample(collector, sampleSize, sampleRng());
+        ++stats.pagerSampledRounds;
+        emptyRounds = (evictCandidates(vb) == 0) ? emptyRounds + 1 : 0;
+    }
+    candidates.clear();
+}
+
+size_t PagingVisitor::evictCandidates(VBucket& vb) {
+    if (candidates.empty()) {
+        return 0;
+    }
+
+    // Lowest frequency first; of equal frequency, oldest first.
+    const size_t toEvict = std::max(
+            size_t(1), candidates.size() * sampleEvictPerc / 100);
+    auto end = candidates.begin() + std::min(toEvict, candidates.size());
+    std::partial_sort(candidates.begin(),
+                      end,
+                      candidates.end(),
+                      [](const EvictionCandidate& a,
+                         const EvictionCandidate& b) {
+                          if (a.freqCounter != b.freqCounter) {
+                              return a.freqCounter < b.freqCounter;
+                          }
+                          return a.age > b.age;
+                      });
+
+    auto& frequencyValuesEvictedHisto =
+            ((vb.getState() == vbucket_state_active) ||
+             (vb.getState() == vbucket_state_pending))
+                    ? stats.activeOrPendingFrequencyValuesEvictedHisto
+                    : stats.replicaFrequencyValuesEvictedHisto;
+
+    size_t evicted = 0;
+    setUpHashBucketVisit();
+    for (auto it = candidates.begin(); it != end; ++it) {
+        // The item may have changed since it was sampled; re-check it under
+        // the hash bucket lock.
+        auto res = vb.ht.findOnlyCommitted(it->key);
+        if (res.storedValue == nullptr ||
+            !vb.eligibleToPageOut(res.lock, *res.storedValue)) {
+            continue;
+        }
+        if (doEviction(res.lock, res.storedValue)) {
+            frequencyValuesEvictedHisto.addValue(it->freqCounter);
+            ++evicted;
+        }
+    }
+    tearDownHashBucketVisit();
+    return evicted;
+}
+
 void PagingVisitor::setUpHashBucketVisit() {
     // Grab a locked ReadHandle
     readHandle = currentBucket->lockCollections();
@@ -21,10 +21,14 @@
 #include "hash_table.h"
 #include "item_eviction.h"
 #include "item_pager.h"
+#include "storeddockey.h"
 #include "vb_visitors.h"
 
 #include <atomic>
 #include <list>
+#include <random>
+#include <unordered_map>
+#include <vector>
 
 class EPStats;
 class Item;
@@ -97,6 +101,42 @@ public:
      */
     void tearDownHashBucketVisit() override;
 
+    /**
+     * Switch the ItemPager from scanning whole hash tables to sampled
+     * eviction: each round scores a random sample of the hash table by
+     * frequency counter and age and immediately evicts the lowest scoring
+     * candidates, until the given number of bytes has been freed (or memory
+     * drops below the low watermark).
+     *
+     * @param sampleSize number of items sampled per round
+     * @param evictPerc percentage of each sample to evict (1-100)
+     * @param bytesToFree bytes the pager wants freed across all vBuckets
+     * @param itemMemory item memory of all the vBuckets to be visited; each
+     *        vBucket is asked to free its share of bytesToFree
+     */
+    void enableSampledEviction(size_t sampleSize,
+                               size_t evictPerc,
+                               size_t bytesToFree,
+                               size_t itemMemory);
+
+    /**
+     * Weight eviction by where memory is being used.
+     *
+     * Each vBucket's eviction percentage is scaled by its memory use
+     * relative to the mean (clamped to 0.5x - 2x); the frequency counters of
+     * items in collections using more than their fair share of memory are
+     * divided by the collection's pressure, making them more likely to be
+     * evicted.
+     *
+     * @param meanVBucketMemory mean memory used by the vBuckets to be visited
+     *        (zero to not weight by vBucket)
+     * @param collectionPressure collections over their fair share, mapped to
+     *        the ratio of their memory to that share
+     */
+    void setMemoryAttribution(
+            size_t meanVBucketMemory,
+            std::unordered_map<CollectionID, double> collectionPressure);
+
     /**
      * Get the number of items ejected during the visit.
      */
@@ -134,6 +174,48 @@ private:
 
     bool doEviction(const HashTable::HashBucketLock& lh, StoredValue* v);
 
+    /**
+     * @return the item's frequency counter, weighted down if its collection
+     *         is using more than its share of memory.
+     */
+    uint8_t getEvictionFreqCounter(const StoredValue& v) const;
+
+    /**
+     * Evict from the given vBucket by sampled eviction until it has freed
+     * its share of the bytes to free.
+     */
+    void evictSampled(VBucket& vb);
+
+    /**
+     * Evict the lowest scoring of the current candidates.
+     * @return number of items evicted
+     */
+    size_t evictCandidates(VBucket& vb);
+
+    /// An item sampled for sampled eviction.
+    struct EvictionCandidate {
+        StoredDocKey key;
+        uint8_t freqCounter;
+        uint64_t age;
+    };
+
+    /**
+     * HashTableVisitor used to collect a sample of eviction candidates;
+     * expired items found in the sample are queued for deletion as per a
+     * full scan.
+     */
+    class SampleCollector : public HashTableVisitor {
+    public:
+        explicit SampleCollector(PagingVisitor& pager) : pager(pager) {
+        }
+
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override;
+
+    private:
+        PagingVisitor& pager;
+    };
+
     std::list<Item> expired;
 
     KVBucket& store;
@@ -170,4 +252,20 @@ private:
     // The VB::Manifest read handle that we use to lock around HashBucket
     // visits. Will contain a nullptr if we aren't currently locking anything.
     Collections::VB::Manifest::ReadHandle readHandle;
+
+    // Sampled eviction settings; sampleSize of zero means the whole hash
+    // table is scanned instead.
+    size_t sampleSize{0};
+    size_t sampleEvictPerc{0};
+    size_t sampleBytesToFree{0};
+    size_t sampleItemMemory{0};
+
+    // See setMemoryAttribution()
+    size_t meanVBucketMemory{0};
+    std::unordered_map<CollectionID, double> collectionPressure;
+
+    // Candidates collected by the current sampling round.
+    std::vector<EvictionCandidate> candidates;
+
+    std::mt19937_64 sampleRng{std::random_device{}()};
 };
@@ -67,6 +67,7 @@ EPStats::EPStats()
       cursorsDropped(0),
       cursorMemoryFreed(0),
       pagerRuns(0),
+      pagerSampledRounds(0),
       expiryPagerRuns(0),
       freqDecayerRuns(0),
       itemsExpelledFromCheckpoints(0),
@@ -74,7 +75,6 @@ EPStats::EPStats()
       numValueEjects(0),
       numFailedEjects(0),
       numNotMyVBuckets(0),
-      estimatedTotalMemory(0),
       forceShutdown(false),
       oom_errors(0),
       tmp_oom_errors(0),
@@ -125,6 +125,12 @@ EPStats::EPStats()
       diskCommitHisto(),
       timingLog(NULL),
       maxDataSize(DEFAULT_MAX_DATA_SIZE) {
+    for (auto& slot : collectionMemorySlots) {
+        slot.store(NoCollection);
+    }
+    for (auto& dropped : collectionMemorySlotDropped) {
+        dropped.store(false);
+    }
 }
 
 EPStats::~EPStats() {
@@ -137,52 +143,6 @@ void EPStats::setMaxDataSize(size_t size) {
     }
 }
 
-void EPStats::memAllocated(size_t sz) {
-    if (isShutdown) {
-        return;
-    }
-
-    if (0 == sz) {
-        return;
-    }
-
-    auto& coreMemory = coreLocal.get()->totalMemory;
-
-    // Update the coreMemory and also create a local copy of the old value + sz
-    // This value will be used to check the threshold
-    auto value = coreMemory.fetch_add(sz) + sz;
-
-    maybeUpdateEstimatedTotalMemUsed(coreMemory, value);
-}
-
-void EPStats::memDeallocated(size_t sz) {
-    if (isShutdown) {
-        return;
-    }
-
-    if (0 == sz) {
-        return;
-    }
-
-    auto& coreMemory = coreLocal.get()->totalMemory;
-
-    // Update the coreMemory and also create a local copy of the old value - sz
-    // This value will be used to check the threshold
-    auto value = coreMemory.fetch_sub(sz) - sz;
-
-    maybeUpdateEstimatedTotalMemUsed(coreMemory, value);
-}
-
-void EPStats::maybeUpdateEstimatedTotalMemUsed(
-        cb::RelaxedAtomic<int64_t>& coreMemory, int64_t value) {
-    // If this thread succeeds in swapping, this thread updates total
-    // @todo: remove this function and callers - it is deadcode
-    if (std::abs(value) > 0) {
-        // Swap the core's value to 0 and update total with whatever we got
-        estimatedTotalMemory->fetch_add(coreMemory.exchange(0));
-    }
-}
-
 size_t EPStats::getPreciseTotalMemoryUsed() const {
     if (isMemoryTrackingEnabled()) {
         return cb::ArenaMalloc::getPreciseAllocated(arena);
@@ -254,6 +214,108 @@ size_t EPStats::getNumItem() const {
     return std::max(int64_t(0), result);
 }
 
+void EPStats::collectionMemoryChanged(CollectionID cid, int64_t delta) {
+    if (delta == 0 || isShutdown) {
+        return;
+    }
+    auto& collectionMemory = coreLocal.get()->collectionMemory;
+    while (true) {
+        const auto slot = getCollectionMemorySlot(cid);
+        collectionMemory[slot].fetch_add(delta);
+        // The slot may have been released (and claimed by another collection)
+        // since it was looked up; if so take the delta back out of it and
+        // account it to the collection's current slot.
+        if (slot == MaxTrackedCollections ||
+            collectionMemorySlots[slot].load() == uint32_t(cid)) {
+            return;
+        }
+        collectionMemory[slot].fetch_sub(delta);
+    }
+}
+
+size_t EPStats::getCollectionMemorySlot(CollectionID cid) {
+    const uint32_t id = uint32_t(cid);
+    for (size_t slot = 0; slot < MaxTrackedCollections; ++slot) {
+        auto owner = collectionMemorySlots[slot].load();
+        if (owner == id) {
+            return slot;
+        }
+        if (owner == NoCollection) {
+            // Claim the slot; if we lose the race check who won it.
+            if (collectionMemorySlots[slot].compare_exchange_strong(owner,
+                                                                    id) ||
+                owner == id) {
+                return slot;
+            }
+        }
+    }
+    return MaxTrackedCollections;
+}
+
+std::unordered_map<CollectionID, size_t> EPStats::getCollectionMemoryUsed()
+        const {
+    std::unordered_map<CollectionID, size_t> result;
+    for (size_t slot = 0; slot < MaxTrackedCollections; ++slot) {
+        const auto owner = collectionMemorySlots[slot].load();
+        if (owner == NoCollection || collectionMemorySlotDropped[slot]) {
+            continue;
+        }
+        int64_t total = 0;
+        for (const auto& core : coreLocal) {
+            total += core->collectionMemory[slot];
+        }
+        result[CollectionID(owner)] = size_t(std::max(int64_t(0), total));
+    }
+    return result;
+}
+
+size_t EPStats::getUntrackedCollectionMemoryUsed() const {
+    int64_t result = 0;
+    for (const auto& core : coreLocal) {
+        result += core->collectionMemory[MaxTrackedCollections];
+    }
+    return std::max(int64_t(0), result);
+}
+
+void EPStats::collectionDropped(CollectionID cid) {
+    std::lock_guard<std::mutex> lh(collectionMemorySlotsMutex);
+    for (size_t slot = 0; slot < MaxTrackedCollections; ++slot) {
+        if (collectionMemorySlots[slot].load() == uint32_t(cid)) {
+            collectionMemorySlotDropped[slot] = true;
+            return;
+        }
+    }
+}
+
+void EPStats::releaseDroppedCollectionSlots() {
+    std::lock_guard<std::mutex> lh(collectionMemorySlotsMutex);
+    for (size_t slot = 0; slot < MaxTrackedCollections; ++slot) {
+        if (!collectionMemorySlotDropped[slot]) {
+            continue;
+        }
+        int64_t total = 0;
+        for (const auto& core : coreLocal) {
+            total += core->collectionMemory[slot];
+        }
+        if (total > 0) {
+            // Not all of the collection's items have been purged yet
+            continue;
+        }
+        // The counters are adjusted rather than reset, so that a concurrent
+        // update of the slot isn't discarded (collectionMemoryChanged moves
+        // such an update to the right slot once it sees the slot has been
+        // released). A negative total is for items which were added while
+        // the collection was untracked, so hand it back to that figure.
+        if (total < 0) {
+            auto& collectionMemory = coreLocal.get()->collectionMemory;
+            collectionMemory[slot].fetch_sub(total);
+            collectionMemory[MaxTrackedCollections].fetch_add(total);
+        }
+        collectionMemorySlots[slot].store(NoCollection);
+        collectionMemorySlotDropped[slot] = false;
+    }
+}
+
 void EPStats::setLowWaterMark(size_t value) {
     mem_low_wat.store(value);
     mem_low_wat_percent.store((double)(value) / getMaxDataSize());
@@ -274,6 +336,7 @@ void EPStats::reset() {
     cursorsDropped.store(0);
     cursorMemoryFreed.store(0);
     pagerRuns.store(0);
+    pagerSampledRounds.store(0);
     expiryPagerRuns.store(0);
     freqDecayerRuns.store(0);
     itemsExpelledFromCheckpoints.store(0);
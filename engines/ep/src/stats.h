@@ -21,6 +21,7 @@
 #include "objectregistry.h"
 
 #include <folly/CachelinePadded.h>
+#include <memcached/dockey.h>
 #include <memcached/durability_spec.h>
 #include <memcached/types.h>
 #include <platform/cb_arena_malloc.h>
@@ -33,6 +34,9 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
 
 // If we're running with TSAN/ASAN our global new operator replacement does
 // not work, so any new/delete will not call through cb_malloc so ArenaMalloc
@@ -134,11 +138,43 @@ public:
     /// @returns number of Item objects which exist.
     size_t getNumItem() const;
 
-    // account for allocated mem
-    void memAllocated(size_t sz);
+    /// Number of collections whose item memory is tracked individually; any
+    /// further collections are accounted together.
+    static const size_t MaxTrackedCollections = 64;
 
-    // account for deallocated mem
-    void memDeallocated(size_t sz);
+    /**
+     * Account a change in the memory used by the items (StoredValues) of the
+     * given collection. Called for every item size change, so the delta is
+     * applied to a core-local counter which is only summed when read.
+     */
+    void collectionMemoryChanged(CollectionID cid, int64_t delta);
+
+    /**
+     * @returns the memory used by the items of each individually tracked
+     * collection, summed across all vBuckets.
+     */
+    std::unordered_map<CollectionID, size_t> getCollectionMemoryUsed() const;
+
+    /// @returns the memory used by the items of collections first seen while
+    /// every slot was claimed by another collection.
+    size_t getUntrackedCollectionMemoryUsed() const;
+
+    /**
+     * Mark the collection as dropped from the bucket: it is no longer
+     * reported, and its slot is released once its items have been purged
+     * (see releaseDroppedCollectionSlots).
+     */
+    void collectionDropped(CollectionID cid);
+
+    /**
+     * Release the slots of dropped collections whose items have all been
+     * purged, so that they can be claimed by new collections. Sums the
+     * core-local counters of the dropped collections, so is called
+     * periodically rather than when accounting. A released slot's counters
+     * are handed on summing to zero rather than reset, so an update racing
+     * with the release is neither lost nor left in the slot.
+     */
+    void releaseDroppedCollectionSlots();
 
     /**
      * Set the low water mark to the new value.
@@ -253,6 +289,8 @@ public:
 
     //! Number of times we needed to kick in the pager
     Counter pagerRuns;
+    //! Number of sampling rounds run by the pager's sampled eviction
+    Counter pagerSampledRounds;
     //! Number of times the expiry pager runs for purging expired items
     Counter expiryPagerRuns;
     //! Number of times the item frequency decayer runs
@@ -268,11 +306,6 @@ public:
     //! Number of times "Not my bucket" happened
     Counter numNotMyVBuckets;
 
-    //! The total amount of memory used by this bucket (From memory tracking)
-    // This is a signed variable as depending on how/when the thread-local
-    // counters merge their info, this could be negative
-    folly::CachelinePadded<cb::RelaxedAtomic<int64_t>> estimatedTotalMemory;
-
     //! Core-local statistics
     CoreStore<folly::CachelinePadded<CoreLocalStats>> coreLocal;
 
@@ -538,21 +571,36 @@ public:
     std::ostream *timingLog;
 
 protected:
+    //! Max allowable memory size.
+    std::atomic<size_t> maxDataSize;
+
+private:
     /**
-     * Check abs(value) against memUsedMergeThreshold, if it is greater then
-     * The thread will attempt to reset coreMemory to zero. If the thread
-     * succesfully resets coreMemory to zero than value is accumulated into
-     * estimatedTotalMemory
-     * @param coreMemory reference to the atomic int64 that the thread is
-     *        associated with.
-     * @param value The expected value of coreMemory for cmpxchg purposes and
-     *        also the value which may be added into estimatedTotalMemory.
+     * @returns the index into CoreLocalStats::collectionMemory for the given
+     * collection, claiming a free slot the first time a collection is seen.
+     * MaxTrackedCollections if all slots have been claimed.
      */
-    void maybeUpdateEstimatedTotalMemUsed(
-            cb::RelaxedAtomic<int64_t>& coreMemory, int64_t value);
+    size_t getCollectionMemorySlot(CollectionID cid);
 
-    //! Max allowable memory size.
-    std::atomic<size_t> maxDataSize;
+    /// Marks an unclaimed collectionMemorySlots entry.
+    static const uint32_t NoCollection = std::numeric_limits<uint32_t>::max();
+
+    /**
+     * The collection owning each slot of CoreLocalStats::collectionMemory.
+     * Slots are claimed lock-free, and released once the owning collection
+     * has been dropped and its items purged. A collection which was first
+     * seen while every slot was claimed may be tracked once a slot is
+     * released; its earlier items stay in the untracked figure.
+     */
+    std::array<std::atomic<uint32_t>, MaxTrackedCollections>
+            collectionMemorySlots;
+
+    /// Set for the slots whose collection has been dropped.
+    std::array<std::atomic<bool>, MaxTrackedCollections>
+            collectionMemorySlotDropped;
+
+    /// Serialises marking slots dropped and releasing them.
+    std::mutex collectionMemorySlotsMutex;
 };
 
 /**
@@ -573,9 +621,6 @@ public:
     // counters merge their info, this could be negative.
     using Counter = cb::RelaxedAtomic<int64_t>;
 
-    //! The total amount of memory used by this bucket (From memory tracking)
-    Counter totalMemory;
-
     //! Total size of stored objects.
     Counter currentSize;
 
@@ -599,6 +644,11 @@ public:
 
     //! Total number of Item objects
     Counter numItem;
+
+    //! Memory used by items of each collection, indexed by the slot the
+    //! collection was assigned (see EPStats::collectionMemoryChanged); the
+    //! final entry accounts all untracked collections.
+    std::array<Counter, EPStats::MaxTrackedCollections + 1> collectionMemory;
 };
 
 /**
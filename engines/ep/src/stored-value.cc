@@ -17,6 +17,7 @@
 
 #include "stored-value.h"
 
+#include "compression_dictionary.h"
 #include "ep_time.h"
 #include "item.h"
 #include "objectregistry.h"
@@ -26,6 +27,7 @@
 #include <platform/cb_malloc.h>
 #include <platform/compress.h>
 
+#include <cstring>
 #include <sstream>
 
 const int64_t StoredValue::state_pending_seqno = -2;
@@ -36,7 +38,8 @@ const int64_t StoredValue::state_temp_init = -5;
 StoredValue::StoredValue(const Item& itm,
                          UniquePtr n,
                          EPStats& stats,
-                         bool isOrdered)
+                         bool isOrdered,
+                         uint8_t inlineCapacity)
     : value(itm.getValue()),
       chain_next_or_replacement(std::move(n)),
       cas(itm.getCas()),
@@ -47,7 +50,8 @@ StoredValue::StoredValue(const Item& itm,
       revSeqno(itm.getRevSeqno()),
       datatype(itm.getDataType()),
       deletionSource(0),
-      committed(static_cast<uint8_t>(CommittedState::CommittedViaMutation)) {
+      committed(static_cast<uint8_t>(CommittedState::CommittedViaMutation)),
+      dictionaryCompressed(0) {
     // Initialise bit fields
     setDeletedPriv(itm.isDeleted());
     setOrdered(isOrdered);
@@ -56,12 +60,23 @@ StoredValue::StoredValue(const Item& itm,
     setStale(false);
     setCommitted(itm.getCommitted());
     setAge(0);
+    setInline(inlineCapacity != 0);
     // dirty initialised below
 
     // Placement-new the key which lives in memory directly after this
     // object.
     new (key()) SerialisedDocKey(itm.getKey());
 
+    // Followed by the inline value area (if any), which the value is moved
+    // into if it fits.
+    if (isInline()) {
+        auto* inlineValue = getInlineValue();
+        inlineValue->capacity = inlineCapacity;
+        inlineValue->size = 0;
+        inlineValue->inUse = false;
+        replaceValue(itm.getValue());
+    }
+
     if (isTempInitialItem()) {
         markClean();
     } else {
@@ -93,7 +108,8 @@ StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
       exptime(other.exptime),
       flags(other.flags),
       revSeqno(other.revSeqno),
-      datatype(other.datatype) {
+      datatype(other.datatype),
+      dictionaryCompressed(other.dictionaryCompressed) {
     setDirty(other.isDirty());
     setDeletedPriv(other.isDeleted());
     setOrdered(other.isOrdered());
@@ -102,11 +118,20 @@ StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
     setStale(false);
     setCommitted(other.getCommitted());
     setAge(0);
+    setInline(other.isInline());
     // Placement-new the key which lives in memory directly after this
     // object.
     StoredDocKey sKey(other.getKey());
     new (key()) SerialisedDocKey(sKey);
 
+    // Followed by a copy of the inline value area (if any).
+    if (isInline()) {
+        const auto* otherInline = other.getInlineValue();
+        std::memcpy(getInlineValue(),
+                    otherInline,
+                    getInlineValueSize(otherInline->capacity));
+    }
+
     if (isDeleted()) {
         setDeletionSource(other.getDeletionSource());
     }
@@ -169,7 +194,8 @@ void StoredValue::restoreValue(const Item& itm) {
     auto freq = itm.getFreqCounterValue();
     auto age = getAge();
 
-    value = itm.getValue();
+    replaceValue(itm.getValue());
+    dictionaryCompressed = 0;
 
     setFreqCounterValue(freq);
     setCommitted(itm.getCommitted());
@@ -196,17 +222,43 @@ void StoredValue::restoreMeta(const Item& itm) {
 }
 
 size_t StoredValue::uncompressedValuelen() const {
-    if (!value) {
+    const auto data = getValueBuffer();
+    if (data.data() == nullptr) {
         return 0;
     }
+    if (isDictionaryCompressed()) {
+        return CompressionDictionary::getDecompressedSize(data);
+    }
     if (mcbp::datatype::is_snappy(datatype)) {
         return cb::compression::get_uncompressed_length(
-                cb::compression::Algorithm::Snappy,
-                {value->getData(), value->valueSize()});
+                cb::compression::Algorithm::Snappy, data);
     }
     return valuelen();
 }
 
+void StoredValue::replaceValue(const value_t& data) {
+    // Maintain the tag
+    auto tag = getValueTag();
+    if (isInline() && data &&
+        data->valueSize() <= getInlineValue()->capacity) {
+        auto* inlineValue = getInlineValue();
+        std::memcpy(inlineValue->data, data->getData(), data->valueSize());
+        inlineValue->size = uint8_t(data->valueSize());
+        inlineValue->inUse = true;
+        value.reset();
+    } else {
+        if (isInline()) {
+            getInlineValue()->inUse = false;
+        }
+        value = data;
+    }
+    setValueTag(tag);
+}
+
+value_t StoredValue::getDecompressedValue() const {
+    return value_t(CompressionDictionary::decompress(getValueBuffer()));
+}
+
 bool StoredValue::del(DeleteSource delSource) {
     if (isOrdered()) {
         return static_cast<OrderedStoredValue*>(this)->deleteImpl(delSource);
@@ -215,8 +267,10 @@ bool StoredValue::del(DeleteSource delSource) {
     }
 }
 
-size_t StoredValue::getRequiredStorage(const DocKey& key) {
-    return sizeof(StoredValue) + SerialisedDocKey::getObjectSize(key.size());
+size_t StoredValue::getRequiredStorage(const DocKey& key,
+                                       uint8_t inlineCapacity) {
+    return sizeof(StoredValue) + SerialisedDocKey::getObjectSize(key.size()) +
+           (inlineCapacity ? getInlineValueSize(inlineCapacity) : 0);
 }
 
 std::unique_ptr<Item> StoredValue::toItem(
@@ -324,7 +378,7 @@ bool StoredValue::operator!=(const StoredValue& other) const {
 }
 
 bool StoredValue::deleteImpl(DeleteSource delSource) {
-    if (isDeleted() && !getValue()) {
+    if (isDeleted() && !value && !hasInlineValue()) {
         // SV is already marked as deleted and has no value - no further
         // deletion possible.
         return false;
@@ -344,17 +398,37 @@ bool StoredValue::deleteImpl(DeleteSource delSource) {
 std::unique_ptr<Item> StoredValue::toItemBase(Vbid vbid,
                                               HideLockedCas hideLockedCas,
                                               IncludeValue includeValue) const {
-    auto item = std::make_unique<Item>(
-            getKey(),
-            getFlags(),
-            getExptime(),
-            includeValue == IncludeValue::Yes ? value : value_t{},
-            datatype,
-            hideLockedCas == HideLockedCas::Yes ? static_cast<uint64_t>(-1)
-                                                : getCas(),
-            bySeqno,
-            vbid,
-            getRevSeqno());
+    const uint64_t cas = hideLockedCas == HideLockedCas::Yes
+                                 ? static_cast<uint64_t>(-1)
+                                 : getCas();
+    std::unique_ptr<Item> item;
+    if (includeValue == IncludeValue::Yes && hasInlineValue() &&
+        !isDictionaryCompressed()) {
+        // Copy the inline value straight into the Item's Blob, rather than
+        // going through the temporary Blob created by getValue().
+        const auto data = getValueBuffer();
+        item = std::make_unique<Item>(getKey(),
+                                      getFlags(),
+                                      getExptime(),
+                                      data.data(),
+                                      data.size(),
+                                      datatype,
+                                      cas,
+                                      bySeqno,
+                                      vbid,
+                                      getRevSeqno());
+    } else {
+        item = std::make_unique<Item>(
+                getKey(),
+                getFlags(),
+                getExptime(),
+                includeValue == IncludeValue::Yes ? getValue() : value_t{},
+                datatype,
+                cas,
+                bySeqno,
+                vbid,
+                getRevSeqno());
+    }
 
     item->setNRUValue(getNru());
     item->setFreqCounterValue(getFreqCounterValue());
@@ -390,20 +464,22 @@ void StoredValue::setValueImpl(const Item& itm) {
         setResident(false);
     } else {
         setResident(true);
-        replaceValue(itm.getValue().get());
+        replaceValue(itm.getValue());
+        dictionaryCompressed = 0;
     }
     setCommitted(itm.getCommitted());
 }
 
 bool StoredValue::compressValue() {
-    if (!mcbp::datatype::is_snappy(datatype)) {
+    if (!mcbp::datatype::is_snappy(datatype) && !isDictionaryCompressed()) {
         // Attempt compression only if datatype indicates
         // that the value is not compressed already
+        const auto data = getValueBuffer();
         cb::compression::Buffer deflated;
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
-                                     {value->getData(), value->valueSize()},
+                                     data,
                                      deflated)) {
-            if (deflated.size() > value->valueSize()) {
+            if (deflated.size() > data.size()) {
                 // No point of keeping it compressed if the deflated length
                 // is greater than the original length
                 return true;
@@ -426,6 +502,13 @@ void StoredValue::storeCompressedBuffer(cb::const_char_buffer deflated) {
     replaceValue(std::move(data));
 }
 
+void StoredValue::storeDictionaryCompressedBuffer(
+        cb::const_char_buffer deflated) {
+    std::unique_ptr<Blob> data(Blob::New(deflated.data(), deflated.size()));
+    replaceValue(std::move(data));
+    dictionaryCompressed = 1;
+}
+
 /**
  * Get an item_info from the StoredValue
  */
@@ -444,9 +527,13 @@ boost::optional<item_info> StoredValue::getItemInfo(uint64_t vbuuid) const {
     info.datatype = datatype;
     info.document_state =
             isDeleted() ? DocumentState::Deleted : DocumentState::Alive;
-    if (getValue()) {
-        info.value[0].iov_base = const_cast<char*>(getValue()->getData());
-        info.value[0].iov_len = getValue()->valueSize();
+    // Note: A dictionary compressed value can't be exposed without a copy;
+    // it only is for documents without XATTRs, so the (predicate) users of
+    // the item_info don't need the value.
+    const auto data = getValueBuffer();
+    if (data.data() != nullptr && !isDictionaryCompressed()) {
+        info.value[0].iov_base = const_cast<char*>(data.data());
+        info.value[0].iov_len = data.size();
     }
     info.key = getKey();
     return info;
@@ -515,6 +602,9 @@ std::ostream& operator<<(std::ostream& os, const StoredValue& sv) {
     os << (mcbp::datatype::is_xattr(sv.getDatatype()) ? 'X' : '.');
     os << (mcbp::datatype::is_snappy(sv.getDatatype()) ? 'C' : '.');
     os << (mcbp::datatype::is_json(sv.getDatatype()) ? 'J' : '.');
+    if (sv.isDictionaryCompressed()) {
+        os << 'Z';
+    }
     os << ' ';
 
     // dirty (Written), deleted, new, locked
@@ -576,15 +666,19 @@ std::ostream& operator<<(std::ostream& os, const StoredValue& sv) {
     os << " fc:" << uint32_t(sv.getFreqCounterValue());
 
     os << " vallen:" << sv.valuelen();
-    if (sv.getValue().get()) {
-        os << " val age:" << uint32_t(sv.getValue()->getAge()) << " :\"";
-        const char* data = sv.getValue()->getData();
+    const auto data = sv.getValueBuffer();
+    if (data.data() != nullptr) {
+        if (sv.hasInlineValue()) {
+            os << " inline :\"";
+        } else {
+            os << " val age:" << uint32_t(sv.value->getAge()) << " :\"";
+        }
         // print up to first 40 bytes of value.
-        const size_t limit = std::min(size_t(40), sv.getValue()->valueSize());
+        const size_t limit = std::min(size_t(40), data.size());
         for (size_t ii = 0; ii < limit; ii++) {
             os << data[ii];
         }
-        if (limit < sv.getValue()->valueSize()) {
+        if (limit < data.size()) {
             os << " <cut>";
         }
         os << "\"";
@@ -27,11 +27,14 @@
 #include <memcached/3rd_party/folly/AtomicBitSet.h>
 #include <memcached/types.h>
 #include <platform/n_byte_integer.h>
+#include <platform/sized_buffer.h>
 
 #include <boost/intrusive/list.hpp>
 #include <memcached/durability_spec.h>
 #include <relaxed_atomic.h>
 
+#include <cstddef>
+
 class Item;
 class OrderedStoredValue;
 
@@ -80,8 +83,26 @@ class OrderedStoredValue;
  *               + - - - - - - - - - +
  *  variable {   | key[]             |
  *   length  {   | ...               |
+ *               + - - - - - - - - - +
+ *  optional {   | InlineValue       |
  *               +-------------------+
  *
+ * Inline values
+ * =============
+ *
+ * Small values may be stored in an InlineValue area directly after the key
+ * instead of in a separately allocated Blob (see
+ * StoredValueFactory::maxInlineValueSize). This saves the allocation,
+ * the Blob header and the pointer chase for values such as counters.
+ * The area is sized when the StoredValue is created; a later value which
+ * doesn't fit is stored in a Blob as normal (and the area is reused once
+ * a value fits again). While the value is inline `value` is null (its tag
+ * is still used for the frequency counter and age), and getValue() creates
+ * a Blob holding a copy of the value when it needs to be shared (for
+ * example with an Item returned to a client). The whole area is accounted
+ * as metadata, and an inline value is not ejected under value eviction as
+ * that would free no memory.
+ *
  * OrderedStoredValue
  * ==================
  *
@@ -174,6 +195,15 @@ public:
      */
     void storeCompressedBuffer(cb::const_char_buffer deflated);
 
+    /**
+     * Replace the existing value with the given buffer compressed with a
+     * CompressionDictionary. Unlike Snappy the datatype isn't changed; the
+     * value is decompressed by getValue() (see isDictionaryCompressed()).
+     *
+     * @param deflated the input buffer holding compressed data
+     */
+    void storeDictionaryCompressedBuffer(cb::const_char_buffer deflated);
+
     // Custom deleter for StoredValue objects.
     struct Deleter {
         void operator()(StoredValue* val);
@@ -233,7 +263,9 @@ public:
      *                  value exists but has zero length
      */
     bool isCompressible() {
-        if (mcbp::datatype::is_snappy(datatype) || !valuelen()) {
+        // Inline values are too small to be worth compressing
+        if (mcbp::datatype::is_snappy(datatype) || isDictionaryCompressed() ||
+            !valuelen() || hasInlineValue()) {
             return false;
         }
         return value->isCompressible();
@@ -246,7 +278,10 @@ public:
         }
 
         if (policy == EvictionPolicy::Value) {
-            return isResident() && !isDirty() && !isDeleted();
+            // Ejecting an inline value wouldn't free any memory - the inline
+            // area is part of the StoredValue.
+            return isResident() && !isDirty() && !isDeleted() &&
+                   !hasInlineValue();
         } else {
             return !isDirty() && !isDeleted();
         }
@@ -285,11 +320,75 @@ public:
 
     /**
      * Get this item's value.
+     *
+     * If the value is held inline a new Blob is created holding a copy of
+     * it; use getValueBuffer() when the value only needs to be read, or
+     * hasValue() to check there is one. If the value is dictionary
+     * compressed a new Blob is created holding the decompressed value.
+     */
+    value_t getValue() const {
+        if (isDictionaryCompressed()) {
+            return getDecompressedValue();
+        }
+        if (hasInlineValue()) {
+            return value_t(std::unique_ptr<Blob>(Blob::New(
+                    getInlineValue()->data, getInlineValue()->size)));
+        }
+        return value;
+    }
+
+    /// @return true if this item has a value, either inline or in a Blob
+    bool hasValue() const {
+        return hasInlineValue() || value;
+    }
+
+    /**
+     * Get a view of this item's value, without creating a Blob for inline
+     * values. Only valid while the StoredValue (and its value) doesn't
+     * change, i.e. while the HashBucketLock is held.
+     *
+     * Note: This is the value as stored, which may be dictionary compressed
+     * (see isDictionaryCompressed()).
+     *
+     * @return the value, or an empty buffer if there isn't one
+     */
+    cb::const_char_buffer getValueBuffer() const {
+        if (hasInlineValue()) {
+            return {getInlineValue()->data, getInlineValue()->size};
+        }
+        if (!value) {
+            return {};
+        }
+        return {value->getData(), value->valueSize()};
+    }
+
+    /**
+     * Get the Blob holding this item's value without taking a reference to
+     * it (see DefragmentVisitor).
+     *
+     * @return the Blob, or null if the value is held inline or isn't
+     *         resident
      */
-    const value_t &getValue() const {
+    const value_t& getValueBlob() const {
         return value;
     }
 
+    /**
+     * True if the value is currently held inline (see InlineValue).
+     */
+    bool hasInlineValue() const {
+        return isInline() && getInlineValue()->inUse;
+    }
+
+    /**
+     * True if the value is compressed with a CompressionDictionary (by the
+     * ItemCompressor). This is internal to the StoredValue: the datatype
+     * doesn't include it, and getValue() returns the decompressed value.
+     */
+    bool isDictionaryCompressed() const {
+        return dictionaryCompressed;
+    }
+
     /**
      * Get the expiration time of this item.
      *
@@ -497,6 +596,9 @@ public:
      }
 
     size_t valuelen() const {
+        if (hasInlineValue()) {
+            return getInlineValue()->size;
+        }
         if (!value) {
             return 0;
         }
@@ -515,7 +617,8 @@ public:
      * @return the amount of memory used by this item.
      */
     size_t size() const {
-        return getObjectSize() + valuelen();
+        // An inline value is already part of the object (see metaDataSize()).
+        return hasInlineValue() ? metaDataSize() : metaDataSize() + valuelen();
     }
 
     /**
@@ -526,9 +629,16 @@ public:
      * For uncompressed items this is the same as size().
      */
     size_t uncompressedSize() const {
-        return getObjectSize() + uncompressedValuelen();
+        return metaDataSize() + uncompressedValuelen() -
+               (hasInlineValue() ? valuelen() : 0);
     }
 
+    /**
+     * Get the size of this item excluding any Blob value. The whole inline
+     * value area (if any) is counted here, including capacity not used by
+     * the current value, as it stays allocated for the lifetime of the
+     * StoredValue whether or not a value is held in it.
+     */
     size_t metaDataSize() const {
         return getObjectSize();
     }
@@ -572,6 +682,10 @@ public:
     void resetValue() {
         auto age = getAge();
         value.reset();
+        if (isInline()) {
+            getInlineValue()->inUse = false;
+        }
+        dictionaryCompressed = 0;
         setAge(age);
     }
 
@@ -581,22 +695,18 @@ public:
      * @param data The Blob to take-over
      */
     void replaceValue(std::unique_ptr<Blob> data) {
-        // Maintain the tag
-        auto tag = getValueTag();
-        value.reset(data.release());
-        setValueTag(tag);
+        replaceValue(value_t(std::move(data)));
     }
 
     /**
-     * Replace the value with the given value_t
+     * Replace the value with the given value_t. The value is copied into
+     * the inline value area if it fits.
      * @param value replace current value with this one
      */
-    void replaceValue(const value_t& value) {
-        // Maintain the tag
-        auto tag = getValueTag();
-        this->value = value;
-        setValueTag(tag);
-    }
+    void replaceValue(const value_t& value);
+
+    /// Decompress the value (which must be dictionary compressed)
+    value_t getDecompressedValue() const;
 
     /**
      * True if this object is logically deleted.
@@ -735,8 +845,9 @@ public:
     static const int64_t state_temp_init;
 
     /**
-     * Return the size in byte of this object; both the fixed fields and the
-     * variable-length key. Doesn't include value size (allocated externally).
+     * Return the size in byte of this object; the fixed fields, the
+     * variable-length key and the inline value area (if any). Doesn't include
+     * value size (allocated externally, or counted by valuelen() if inline).
      */
     inline size_t getObjectSize() const;
 
@@ -766,8 +877,14 @@ public:
 
     bool operator!=(const StoredValue& other) const;
 
-    /// Return how many bytes are need to store item given key as a StoredValue
-    static size_t getRequiredStorage(const DocKey& key);
+    /**
+     * Return how many bytes are need to store item given key as a StoredValue
+     *
+     * @param key the key of the item
+     * @param inlineCapacity the size of the inline value area (0 for none)
+     */
+    static size_t getRequiredStorage(const DocKey& key,
+                                     uint8_t inlineCapacity = 0);
 
     /**
      * @return the deletion source of the stored value
@@ -840,11 +957,14 @@ protected:
      *           which the new item is being inserted).
      * @param stats EPStats to update for this new StoredValue
      * @param isOrdered Are we constructing an OrderedStoredValue?
+     * @param inlineCapacity the size of the inline value area allocated
+     *        after the key (0 for none)
      */
     StoredValue(const Item& itm,
                 UniquePtr n,
                 EPStats& stats,
-                bool isOrdered);
+                bool isOrdered,
+                uint8_t inlineCapacity = 0);
 
     // Destructor. protected, as needs to be carefully deleted (via
     // StoredValue::Destructor) depending on the value of isOrdered flag.
@@ -873,6 +993,35 @@ protected:
      */
     inline SerialisedDocKey* key();
 
+    /**
+     * The inline value area, allocated directly after the key for
+     * StoredValues created with an inline capacity.
+     */
+    struct InlineValue {
+        /// The number of bytes data can hold
+        uint8_t capacity;
+        /// The size of the value currently in data
+        uint8_t size;
+        /// True if data holds the value (in which case value is null)
+        bool inUse;
+        char data[1];
+    };
+
+    /// @return the allocation size of an InlineValue of the given capacity
+    static size_t getInlineValueSize(uint8_t capacity) {
+        return offsetof(InlineValue, data) + capacity;
+    }
+
+    /// @return the inline value area. Only valid if isInline()
+    InlineValue* getInlineValue() {
+        return reinterpret_cast<InlineValue*>(
+                reinterpret_cast<char*>(key()) + getKey().getObjectSize());
+    }
+
+    const InlineValue* getInlineValue() const {
+        return const_cast<StoredValue&>(*this).getInlineValue();
+    }
+
     /**
      * Logically mark this SV as deleted.
      * Implementation for StoredValue instances (dispatched to by del() based
@@ -915,6 +1064,14 @@ protected:
         bits.set(orderedIndex, value);
     }
 
+    bool isInline() const {
+        return bits.test(inlineIndex);
+    }
+
+    void setInline(bool value) {
+        bits.set(inlineIndex, value);
+    }
+
     void setDeletedPriv(bool value) {
         bits.set(deletedIndex, value);
     }
@@ -1011,8 +1168,9 @@ protected:
      */
     static constexpr size_t dirtyIndex = 0;
     static constexpr size_t deletedIndex = 1;
-    // Bit 2 of bits is currently unused and may be used for new purposes.
-    // static constexpr size_t unused = 2;
+    // inline := true if the StoredValue has an inline value area (see
+    //           InlineValue)
+    static constexpr size_t inlineIndex = 2;
     // ordered := true if this is an instance of OrderedStoredValue
     static constexpr size_t orderedIndex = 3;
     // 2 bit nru managed via setNru/getNru
@@ -1036,6 +1194,8 @@ protected:
     uint8_t deletionSource : 1;
     /// 3-bit value which encodes the CommittedState of the StoredValue
     uint8_t committed : 3;
+    /// If the value is compressed with a CompressionDictionary
+    uint8_t dictionaryCompressed : 1;
 
     friend std::ostream& operator<<(std::ostream& os, const StoredValue& sv);
     friend void to_json(nlohmann::json& json, const StoredValue& sv);
@@ -1210,9 +1370,12 @@ SerialisedDocKey* StoredValue::key() {
 
 size_t StoredValue::getObjectSize() const {
     // Size of fixed part of OrderedStoredValue or StoredValue, plus size of
-    // (variable) key.
+    // (variable) key and inline value area.
+    const size_t inlineSize =
+            isInline() ? getInlineValueSize(getInlineValue()->capacity) : 0;
     if (isOrdered()) {
-        return sizeof(OrderedStoredValue) + getKey().getObjectSize();
+        return sizeof(OrderedStoredValue) + getKey().getObjectSize() +
+               inlineSize;
     }
-    return sizeof(*this) + getKey().getObjectSize();
+    return sizeof(*this) + getKey().getObjectSize() + inlineSize;
 }
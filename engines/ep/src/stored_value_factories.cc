@@ -19,16 +19,42 @@
 
 #include "item.h"
 
+#include <algorithm>
+#include <limits>
+
+StoredValueFactory::StoredValueFactory(EPStats& s, size_t maxInlineValueSize)
+    : stats(&s),
+      maxInlineValueSize(uint8_t(
+              std::min(maxInlineValueSize,
+                       size_t(std::numeric_limits<uint8_t>::max())))) {
+}
+
 StoredValue::UniquePtr StoredValueFactory::operator()(
         const Item& itm, StoredValue::UniquePtr next) {
     // Allocate a buffer to store the StoredValue and any trailing bytes
     // that maybe required.
+    const auto inlineCapacity = getInlineCapacity(itm);
     return StoredValue::UniquePtr(
-            new (::operator new(StoredValue::getRequiredStorage(itm.getKey())))
+            new (::operator new(StoredValue::getRequiredStorage(
+                    itm.getKey(), inlineCapacity)))
                     StoredValue(itm,
                                 std::move(next),
                                 *stats,
-                                /*isOrdered*/ false));
+                                /*isOrdered*/ false,
+                                inlineCapacity));
+}
+
+uint8_t StoredValueFactory::getInlineCapacity(const Item& itm) const {
+    const auto& value = itm.getValue();
+    if (!value || value->valueSize() == 0 ||
+        value->valueSize() > maxInlineValueSize) {
+        return 0;
+    }
+    // Round up to a multiple of 8 bytes (the allocator rounds up the
+    // allocation anyway) so a value which grows slightly (for example a
+    // counter gaining a digit) can stay inline.
+    const size_t rounded = (value->valueSize() + 7) & ~size_t(7);
+    return uint8_t(std::min(rounded, size_t(maxInlineValueSize)));
 }
 
 StoredValue::UniquePtr StoredValueFactory::copyStoredValue(
@@ -63,8 +63,13 @@ class StoredValueFactory : public AbstractStoredValueFactory {
 public:
     using value_type = StoredValue;
 
-    StoredValueFactory(EPStats& s) : stats(&s) {
-    }
+    /**
+     * @param s the stats to update
+     * @param maxInlineValueSize values up to this size (at most 255 bytes)
+     *        are stored inline in the StoredValue (see
+     *        StoredValue::InlineValue). 0 to always use a Blob.
+     */
+    StoredValueFactory(EPStats& s, size_t maxInlineValueSize = 0);
 
     /**
      * Create an concrete StoredValue object.
@@ -76,7 +81,11 @@ public:
             const StoredValue& other, StoredValue::UniquePtr next) override;
 
 private:
+    /// @return the size of the inline value area for the given item
+    uint8_t getInlineCapacity(const Item& itm) const;
+
     EPStats* stats;
+    const uint8_t maxInlineValueSize;
 };
 
 /**
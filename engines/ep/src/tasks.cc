@@ -16,6 +16,7 @@
  */
 #include "tasks.h"
 #include "bgfetcher.h"
+#include "compaction_throttle.h"
 #include "ep_bucket.h"
 #include "ep_engine.h"
 #include "executorpool.h"
@@ -64,7 +65,27 @@ bool CompactTask::run() {
      */
     compactionConfig.retain_erroneous_tombstones =
                              bucket.isRetainErroneousTombstones();
-    return bucket.doCompact(compactionConfig, purgeSeqno, cookie);
+
+    if (!started) {
+        // Wait for compactions to be back within the node-wide rate limit
+        // before starting; snooze rather than block this writer thread.
+        auto& throttle = CompactionThrottle::get();
+        const auto delay =
+                throttle.getDelay(CompactionThrottle::Clock::now());
+        if (delay.count() > 0) {
+            throttle.recordDelay(delay);
+            snooze(std::chrono::duration<double>(delay).count());
+            return true;
+        }
+        if (!bucket.beginCompaction(compactionConfig.db_file_id, getId())) {
+            // Another compaction of this vBucket is running; it will wake us
+            // when it completes.
+            snooze(60);
+            return true;
+        }
+        started = true;
+    }
+    return bucket.doCompact(compactionConfig, purgeSeqno, cookie, getId());
 }
 
 bool StatSnap::run() {
@@ -77,6 +98,12 @@ bool StatSnap::run() {
     return true;
 }
 
+bool CompressionDictionaryTrainerTask::run() {
+    TRACE_EVENT0("ep-engine/task", "CompressionDictionaryTrainerTask");
+    engine->getKVBucket()->trainCompressionDictionaries();
+    return false;
+}
+
 MultiBGFetcherTask::MultiBGFetcherTask(EventuallyPersistentEngine* e,
                                        BgFetcher* b)
     : GlobalTask(e,
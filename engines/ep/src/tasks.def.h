@@ -42,6 +42,7 @@ TASK(WarmupCheckforAccessLog, READER_TASK_IDX, 0)
 TASK(WarmupLoadAccessLog, READER_TASK_IDX, 0)
 TASK(WarmupLoadingKVPairs, READER_TASK_IDX, 0)
 TASK(WarmupLoadingData, READER_TASK_IDX, 0)
+TASK(WarmupVBucketScan, READER_TASK_IDX, 0)
 TASK(WarmupCompletion, READER_TASK_IDX, 0)
 TASK(VKeyStatBGFetchTask, READER_TASK_IDX, 3)
 
@@ -70,7 +71,6 @@ TASK(ExpiredItemPagerVisitor, NONIO_TASK_IDX, 1)
 TASK(DcpConsumerTask, NONIO_TASK_IDX, 2)
 TASK(DurabilityCompletionTask, NONIO_TASK_IDX, 1)
 TASK(DurabilityTimeoutTask, NONIO_TASK_IDX, 1)
-TASK(DurabilityTimeoutVisitor, NONIO_TASK_IDX, 1)
 TASK(ConnNotifierCallback, NONIO_TASK_IDX, 5)
 TASK(ClosedUnrefCheckpointRemoverTask, NONIO_TASK_IDX, 6)
 TASK(ClosedUnrefCheckpointRemoverVisitorTask, NONIO_TASK_IDX, 6)
@@ -78,6 +78,8 @@ TASK(VBucketMemoryDeletionTask, NONIO_TASK_IDX, 6)
 TASK(StatCheckpointTask, NONIO_TASK_IDX, 7)
 TASK(DefragmenterTask, NONIO_TASK_IDX, 7)
 TASK(ItemCompressorTask, NONIO_TASK_IDX, 7)
+TASK(CompressionDictionaryTrainerTask, NONIO_TASK_IDX, 7)
+TASK(HashTableMaintenanceTask, NONIO_TASK_IDX, 7)
 TASK(EphTombstoneHTCleaner, NONIO_TASK_IDX, 7)
 TASK(EphTombstoneStaleItemDeleter, NONIO_TASK_IDX, 7)
 TASK(ItemFreqDecayerTask, NONIO_TASK_IDX, 7)
@@ -94,6 +94,8 @@ private:
     uint64_t purgeSeqno;
     const void* cookie;
     std::string desc;
+    /// True once this task has claimed its vBucket via beginCompaction().
+    bool started = false;
 };
 
 /**
@@ -126,6 +128,32 @@ private:
     bool runOnce;
 };
 
+/**
+ * A task that trains the compression dictionaries of the collections sampled
+ * by the ItemCompressor.
+ */
+class CompressionDictionaryTrainerTask : public GlobalTask {
+public:
+    CompressionDictionaryTrainerTask(EventuallyPersistentEngine* e)
+        : GlobalTask(e,
+                     TaskId::CompressionDictionaryTrainerTask,
+                     0,
+                     false) {
+    }
+
+    bool run();
+
+    std::string getDescription() {
+        return "Training compression dictionaries";
+    }
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // Training from the default 1 MiB of samples takes around 100ms per
+        // collection.
+        return std::chrono::seconds(1);
+    }
+};
+
 /**
  * A task for fetching items from disk.
  */
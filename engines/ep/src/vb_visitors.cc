@@ -41,6 +41,30 @@ PauseResumeVBAdapter::PauseResumeVBAdapter(
     : htVisitor(std::move(htVisitor)) {
 }
 
+bool FusedHTVisitor::visit(const HashTable::HashBucketLock& lh,
+                           StoredValue& v) {
+    // Check before visiting, as the last action may replace the StoredValue
+    const bool lastInBucket = !v.getNext();
+    for (auto* action : actions) {
+        // Every action gets to see the item even if an earlier one asked
+        // to pause
+        if (!action->visit(lh, v)) {
+            pauseRequested = true;
+        }
+    }
+    if (pauseRequested && lastInBucket) {
+        pauseRequested = false;
+        return false;
+    }
+    return true;
+}
+
+void FusedHTVisitor::setCurrentVBucket(VBucket& vb) {
+    for (auto* action : actions) {
+        action->setCurrentVBucket(vb);
+    }
+}
+
 bool PauseResumeVBAdapter::visit(VBucket& vb) {
     // Check if this vbucket_id matches the position we should resume
     // from. If so then call the visitor using our stored HashTable::Position.
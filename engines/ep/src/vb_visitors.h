@@ -21,6 +21,8 @@
 #include "vb_filter.h"
 #include "vbucket_fwd.h"
 
+#include <vector>
+
 using namespace std::chrono_literals;
 
 class HashTableVisitor;
@@ -158,6 +160,40 @@ public:
     }
 };
 
+/**
+ * Visits each StoredValue once on behalf of a set of VBucketAwareHTVisitors
+ * (the "actions"), so that background tasks which would otherwise each
+ * walk every HashTable can share a single pass.
+ *
+ * The actions are not owned by the FusedHTVisitor, and may be changed
+ * between (but not during) visits. They are called in order for every
+ * StoredValue; an action which may replace the StoredValue (such as the
+ * DefragmentVisitor) must therefore be last.
+ *
+ * Once any of the actions asks to pause (typically because its deadline was
+ * reached) the visit carries on to the end of the current hash bucket
+ * before pausing: a paused HashTable visit resumes from the next hash
+ * bucket, and the actions share a pass so none of them may skip the rest
+ * of the bucket.
+ */
+class FusedHTVisitor : public VBucketAwareHTVisitor {
+public:
+    void setActions(std::vector<VBucketAwareHTVisitor*> newActions) {
+        actions = std::move(newActions);
+        pauseRequested = false;
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override;
+
+    void setCurrentVBucket(VBucket& vb) override;
+
+private:
+    std::vector<VBucketAwareHTVisitor*> actions;
+
+    /// Set once an action has asked to pause
+    bool pauseRequested = false;
+};
+
 /**
  * Adapts a VBucketAwareHTVisitor, recording the position into the
  * HashTable the visit reached when it paused; and resumes Visiting from that
@@ -179,6 +215,20 @@ public:
         return hashtable_position;
     }
 
+    /// Returns the vBucket the next visit resumes in.
+    Vbid getResumeVBucket() const {
+        return resume_vbucket_id;
+    }
+
+    /**
+     * Set where the next visit resumes from; allows one adapter to continue
+     * visits which paused at different positions.
+     */
+    void setResumePosition(Vbid vbid, HashTable::Position position) {
+        resume_vbucket_id = vbid;
+        hashtable_position = position;
+    }
+
     /// Returns the wrapped HashTable visitor.
     VBucketAwareHTVisitor& getHTVisitor() {
         return *htVisitor;
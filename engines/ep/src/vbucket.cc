@@ -23,6 +23,7 @@
 #include "checkpoint_manager.h"
 #include "collections/collection_persisted_stats.h"
 #include "conflict_resolution.h"
+#include "cuckoo_filter.h"
 #include "dcp/dcpconnmap.h"
 #include "durability/active_durability_monitor.h"
 #include "durability/passive_durability_monitor.h"
@@ -214,6 +215,7 @@ VBucket::VBucket(Vbid i,
       takeover_backed_up(false),
       persistedRange(lastSnapStart, lastSnapEnd),
       receivingInitialDiskSnapshot(false),
+      useCuckooFilter(config.getBfilterType() == "cuckoo"),
       rollbackItemCount(0),
       hlc(maxCas,
           hlcEpochSeqno,
@@ -235,6 +237,15 @@ VBucket::VBucket(Vbid i,
         conflictResolver.reset(new RevisionSeqnoResolution());
     }
 
+    // Start the revisions of every VBucket from a different base, so a
+    // snapshot of a VBucket which was deleted (and recreated) can't be taken
+    // as valid.
+    static std::atomic<uint64_t> nextHotKeyRevisionBase{0};
+    const auto hotKeyRevisionBase = nextHotKeyRevisionBase.fetch_add(1) << 32;
+    for (auto& revision : hotKeyRevisions) {
+        revision.store(hotKeyRevisionBase);
+    }
+
     pendingOpsStart = std::chrono::steady_clock::time_point();
     stats.coreLocal.get()->memOverhead.fetch_add(
             sizeof(VBucket) + ht.memorySize() + sizeof(CheckpointManager));
@@ -555,6 +566,12 @@ void VBucket::setState_UNLOCKED(
 
     state = to;
 
+    // Snapshots of the keys taken in the previous state are no longer valid
+    // (for example the VBucket may since have been rolled back).
+    for (auto& revision : hotKeyRevisions) {
+        revision.fetch_add(1, std::memory_order_release);
+    }
+
     setupSyncReplication(meta.is_null() ? nlohmann::json{}
                                         : meta.at("topology"));
 }
@@ -690,6 +707,13 @@ void VBucket::processDurabilityTimeout(
     getActiveDM().processTimeout(asOf);
 }
 
+void VBucket::scheduleDurabilityTimeout(
+        std::chrono::steady_clock::time_point expiry) {
+    if (syncWriteTimeoutCb) {
+        syncWriteTimeoutCb(getId(), expiry);
+    }
+}
+
 void VBucket::notifySyncWritesPendingCompletion() {
     syncWriteResolvedCb(getId());
 }
@@ -795,8 +819,7 @@ void VBucket::handlePreExpiry(const HashTable::HashBucketLock& hbl,
                 cb::UserDataView(ss.str()).getSanitizedValue());
     }
 
-    value_t value = v.getValue();
-    if (value) {
+    if (v.hasValue()) {
         std::unique_ptr<Item> itm(v.toItem(id));
         item_info itm_info;
         EventuallyPersistentEngine* engine = ObjectRegistry::getCurrentEngine();
@@ -1087,8 +1110,7 @@ void VBucket::createFilter(size_t key_count, double probability) {
     //      - Rebalance
     LockHolder lh(bfMutex);
     if (bFilter == nullptr && tempFilter == nullptr) {
-        bFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                        BFILTER_ENABLED);
+        bFilter = makeFilter(key_count, probability, BFILTER_ENABLED);
     } else {
         EP_LOG_WARN("({}) Bloom filter / Temp filter already exist!", id);
     }
@@ -1099,8 +1121,7 @@ void VBucket::initTempFilter(size_t key_count, double probability) {
     // if the main filter is found to exist, set its state to
     // COMPACTING as well.
     LockHolder lh(bfMutex);
-    tempFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                     BFILTER_COMPACTING);
+    tempFilter = makeFilter(key_count, probability, BFILTER_COMPACTING);
     if (bFilter) {
         bFilter->setStatus(BFILTER_COMPACTING);
     }
@@ -1122,6 +1143,15 @@ void VBucket::addToFilter(const DocKey& key) {
     }
 }
 
+void VBucket::removeFromFilter(const DocKey& key) {
+    // Not from the temp filter: the compaction may not have added the key
+    // to it yet.
+    LockHolder lh(bfMutex);
+    if (bFilter) {
+        bFilter->removeKey(key);
+    }
+}
+
 bool VBucket::maybeKeyExistsInFilter(const DocKey& key) {
     LockHolder lh(bfMutex);
     if (bFilter) {
@@ -1222,6 +1252,68 @@ size_t VBucket::getNumOfKeysInFilter() {
     }
 }
 
+/**
+ * Adds the committed keys of a HashTable to a filter.
+ */
+class FilterKeyVisitor : public HashTableVisitor {
+public:
+    explicit FilterKeyVisitor(KeyFilter& filter) : filter(filter) {
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
+        if (!v.isTempItem() && v.isCommitted()) {
+            filter.addKey(v.getKey());
+        }
+        return true;
+    }
+
+private:
+    KeyFilter& filter;
+};
+
+std::string VBucket::snapshotFilter() {
+    const auto highSeqno = getPersistenceSeqno();
+    if (highSeqno != uint64_t(getHighSeqno())) {
+        return {};
+    }
+
+    std::unique_ptr<CuckooFilter> snapshot;
+    {
+        LockHolder lh(bfMutex);
+        auto* filter = dynamic_cast<CuckooFilter*>(bFilter.get());
+        if (!filter || filter->getStatus() != BFILTER_ENABLED) {
+            return {};
+        }
+        snapshot = std::make_unique<CuckooFilter>(*filter);
+    }
+
+    FilterKeyVisitor visitor(*snapshot);
+    ht.visit(visitor);
+    return snapshot->serialize(highSeqno);
+}
+
+bool VBucket::restoreFilter(const std::string& data, uint64_t highSeqno) {
+    auto filter = CuckooFilter::deserialize(data, highSeqno);
+    if (!filter) {
+        return false;
+    }
+    LockHolder lh(bfMutex);
+    if (bFilter || tempFilter) {
+        return false;
+    }
+    bFilter = std::move(filter);
+    return true;
+}
+
+std::unique_ptr<KeyFilter> VBucket::makeFilter(size_t key_count,
+                                               double probability,
+                                               bfilter_status_t status) {
+    if (useCuckooFilter) {
+        return std::make_unique<CuckooFilter>(key_count, status);
+    }
+    return std::make_unique<BloomFilter>(key_count, probability, status);
+}
+
 VBNotifyCtx VBucket::queueItem(queued_item& item, const VBQueueItemCtx& ctx) {
     // Ensure that durable writes are queued with the same seqno-order in both
     // Backfill/CheckpointManager Queues and DurabilityMonitor. Note that
@@ -1241,6 +1333,7 @@ VBNotifyCtx VBucket::queueItem(queued_item& item, const VBQueueItemCtx& ctx) {
                                               ctx.preLinkDocumentContext);
         notifyCtx.notifyReplication = true;
     notifyCtx.bySeqno = item->getBySeqno();
+    bumpHotKeyRevision(item->getKey());
     notifyCtx.syncWrite = item->isPending() ? SyncWriteOperation::Yes
                                             : SyncWriteOperation::No;
 
@@ -2644,6 +2737,13 @@ GetValue VBucket::getInternal(
     const bool getDeletedValue = (options & GET_DELETED_VALUE);
     const bool bgFetchRequired = (options & QUEUE_BG_FETCH);
 
+    if ((options & OPTIMISTIC_READ) && getReplicaItem == ForGetReplicaOp::No) {
+        auto gv = getInternalOptimistic(options, getKeyOnly, cHandle);
+        if (gv) {
+            return std::move(*gv);
+        }
+    }
+
     auto res = fetchValidValue(WantsDeleted::Yes,
                                trackReference,
                                QueueExpired::Yes,
@@ -2698,29 +2798,7 @@ GetValue VBucket::getInternal(
                     cHandle.getKey(), cookie, engine, queueBgFetch, *v);
         }
 
-        std::unique_ptr<Item> item;
-        if (getKeyOnly == GetKeyOnly::Yes) {
-            item = v->toItem(getId(),
-                             StoredValue::HideLockedCas::No,
-                             StoredValue::IncludeValue::No);
-        } else {
-            const auto hideLockedCas =
-                    ((options & HIDE_LOCKED_CAS) &&
-                                     v->isLocked(ep_current_time())
-                             ? StoredValue::HideLockedCas::Yes
-                             : StoredValue::HideLockedCas::No);
-            item = v->toItem(getId(), hideLockedCas);
-        }
-
-        if (options & TRACK_STATISTICS) {
-            opsGet++;
-        }
-
-        return GetValue(std::move(item),
-                        ENGINE_SUCCESS,
-                        v->getBySeqno(),
-                        !v->isResident(),
-                        v->getNRUValue());
+        return makeGetValue(*v, options, getKeyOnly);
     } else {
         if (!getDeletedValue && (eviction == EvictionPolicy::Value)) {
             return GetValue();
@@ -2744,6 +2822,77 @@ GetValue VBucket::getInternal(
     }
 }
 
+boost::optional<GetValue> VBucket::getInternalOptimistic(
+        get_options_t options,
+        GetKeyOnly getKeyOnly,
+        const Collections::VB::Manifest::CachingReadHandle& cHandle) {
+    auto res = ht.findForReadOptimistic(cHandle.getKey(), WantsDeleted::Yes);
+    if (!res.lock.owns_lock()) {
+        // The hash bucket is being modified.
+        return {};
+    }
+
+    const auto* v = res.storedValue;
+    if (!v) {
+        // Without a value eviction bucket the key may still be on disk.
+        if (!(options & GET_DELETED_VALUE) &&
+            eviction == EvictionPolicy::Value) {
+            return GetValue();
+        }
+        return {};
+    }
+
+    // Expired and temporary items need the HashTable to be modified, and
+    // non-resident ones a background fetch; leave them to the locked path,
+    // along with the (rare) prepares which may already be visible.
+    if (v->isTempItem() || v->isPreparedMaybeVisible() ||
+        (!v->isDeleted() && v->isExpired(ep_real_time()))) {
+        return {};
+    }
+
+    if ((v->isDeleted() && !(options & GET_DELETED_VALUE)) ||
+        cHandle.isLogicallyDeleted(v->getBySeqno())) {
+        return GetValue();
+    }
+
+    if (!v->isResident() && !(options & ALLOW_META_ONLY)) {
+        return {};
+    }
+
+    auto gv = makeGetValue(*v, options, getKeyOnly);
+    if (options & TRACK_REFERENCE) {
+        ht.trackOptimisticRead(cHandle.getKey(), res);
+    }
+    return std::move(gv);
+}
+
+GetValue VBucket::makeGetValue(const StoredValue& v,
+                               get_options_t options,
+                               GetKeyOnly getKeyOnly) {
+    std::unique_ptr<Item> item;
+    if (getKeyOnly == GetKeyOnly::Yes) {
+        item = v.toItem(getId(),
+                        StoredValue::HideLockedCas::No,
+                        StoredValue::IncludeValue::No);
+    } else {
+        const auto hideLockedCas =
+                ((options & HIDE_LOCKED_CAS) && v.isLocked(ep_current_time())
+                         ? StoredValue::HideLockedCas::Yes
+                         : StoredValue::HideLockedCas::No);
+        item = v.toItem(getId(), hideLockedCas);
+    }
+
+    if (options & TRACK_STATISTICS) {
+        opsGet++;
+    }
+
+    return GetValue(std::move(item),
+                    ENGINE_SUCCESS,
+                    v.getBySeqno(),
+                    !v.isResident(),
+                    v.getNRUValue());
+}
+
 ENGINE_ERROR_CODE VBucket::getMetaData(
         const void* cookie,
         EventuallyPersistentEngine& engine,
@@ -2895,6 +3044,7 @@ GetValue VBucket::getLocked(
         auto it = v->toItem(getId());
         it->setCas(nextHLCCas());
         v->setCas(it->getCas());
+        bumpHotKeyRevision(cHandle.getKey());
 
         return GetValue(std::move(it));
     }
@@ -3009,6 +3159,10 @@ void VBucket::dump() const {
               << "]" << std::endl;
 }
 
+size_t VBucket::getMemoryUsed() const {
+    return ht.getItemMemory() + checkpointManager->getMemoryUsage();
+}
+
 void VBucket::setMutationMemoryThreshold(size_t memThreshold) {
     if (memThreshold > 0 && memThreshold <= 100) {
         mutationMemThreshold = static_cast<double>(memThreshold) / 100.0;
@@ -3054,6 +3208,7 @@ void VBucket::_addStats(VBucketStatsDetailLevel detail,
                 add_stat,
                 c);
         addStat("ht_cache_size", ht.getCacheSize(), add_stat, c);
+        addStat("mem_used", getMemoryUsed(), add_stat, c);
         addStat("ht_size", ht.getSize(), add_stat, c);
         addStat("num_ejects", ht.getNumEjects(), add_stat, c);
         addStat("ops_create", opsCreate.load(), add_stat, c);
@@ -3602,8 +3757,8 @@ VBucket::processExpiredItem(
      * but functionally correct and for performance reasons
      * only the system xattrs need to be stored.
      */
-    value_t value = v.getValue();
-    bool onlyMarkDeleted = value && mcbp::datatype::is_xattr(v.getDatatype());
+    bool onlyMarkDeleted =
+            v.hasValue() && mcbp::datatype::is_xattr(v.getDatatype());
     v.setRevSeqno(v.getRevSeqno() + 1);
     VBNotifyCtx notifyCtx;
     StoredValue* newSv;
@@ -3834,9 +3989,8 @@ std::unique_ptr<Item> VBucket::pruneXattrDocument(
     // Need to take a copy of the value, prune it, and add it back
 
     // Create work-space document
-    std::vector<char> workspace(
-            v.getValue()->getData(),
-            v.getValue()->getData() + v.getValue()->valueSize());
+    const auto value = v.getValueBuffer();
+    std::vector<char> workspace(value.data(), value.data() + value.size());
 
     // Now attach to the XATTRs in the document
     cb::xattr::Blob xattr({workspace.data(), workspace.size()},
@@ -3912,6 +4066,11 @@ void VBucket::setFreqSaturatedCallback(std::function<void()> callbackFunction) {
     ht.setFreqSaturatedCallback(callbackFunction);
 }
 
+void VBucket::setSyncWriteTimeoutCallback(
+        SyncWriteTimeoutCallback callbackFunction) {
+    syncWriteTimeoutCb = std::move(callbackFunction);
+}
+
 ENGINE_ERROR_CODE VBucket::checkDurabilityRequirements(const Item& item) {
     if (item.isPending()) {
         if (!isValidDurabilityLevel(item.getDurabilityReqs().getLevel())) {
@@ -31,6 +31,7 @@
 #include <platform/atomic_duration.h>
 #include <platform/non_negative_counter.h>
 #include <relaxed_atomic.h>
+#include <array>
 #include <atomic>
 #include <list>
 #include <queue>
@@ -145,6 +146,16 @@ typedef std::unique_ptr<Callback<const Vbid, const VBNotifyCtx&>>
  */
 using SyncWriteResolvedCallback = std::function<void(Vbid vbid)>;
 
+/**
+ * Callback function to be invoked by ActiveDurabilityMonitor when a SyncWrite
+ * with a timeout is added, so that the VBucket is checked for timeouts once
+ * the given expiry time is reached.
+ *
+ * Will normally register the expiry with the DurabilityTimeoutTask.
+ */
+using SyncWriteTimeoutCallback = std::function<void(
+        Vbid vbid, std::chrono::steady_clock::time_point expiry)>;
+
 /**
  * Callback function invoked when an accepted SyncWrite operation has been
  * completed (has been committed / aborted / times out).
@@ -468,8 +479,34 @@ public:
     void processDurabilityTimeout(
             const std::chrono::steady_clock::time_point asOf);
 
+    /**
+     * Request a call to processDurabilityTimeout() for this VBucket once the
+     * given expiry time is reached (no-op if no SyncWriteTimeoutCallback has
+     * been set).
+     *
+     * @param expiry The expiry-time of a newly tracked SyncWrite
+     */
+    void scheduleDurabilityTimeout(
+            std::chrono::steady_clock::time_point expiry);
+
     void notifySyncWritesPendingCompletion();
 
+    /// The number of stripes the keys are spread over for their revision
+    static const size_t HotKeyRevisionStripes = 32;
+
+    /**
+     * Get the revision of the given key, used by the HotKeyCache to validate
+     * its snapshot of the key. The revision changes whenever the key (or
+     * another key of the same stripe) is mutated or locked, and when the
+     * VBucket changes state.
+     *
+     * Must be read before reading the key from the HashTable.
+     */
+    uint64_t getHotKeyRevision(const DocKey& key) const {
+        return hotKeyRevisions[key.hash() % HotKeyRevisionStripes].load(
+                std::memory_order_acquire);
+    }
+
     /**
      * For all SyncWrites which the DurabilityMonitor has resolved (to be
      * committed or aborted), perform the appropriate operation - i.e.
@@ -640,6 +677,15 @@ public:
     void createFilter(size_t key_count, double probability);
     void initTempFilter(size_t key_count, double probability);
     void addToFilter(const DocKey& key);
+
+    /**
+     * Remove a key from the filter, once the key is known to be in memory
+     * again. Only to be called for a key which was missing from the
+     * HashTable but exists on disk (hence was added to the filter); it is
+     * ignored by a bloom filter, or while compacting.
+     */
+    void removeFromFilter(const DocKey& key);
+
     virtual bool maybeKeyExistsInFilter(const DocKey& key);
     bool isTempFilterAvailable();
     void addToTempFilter(const DocKey& key);
@@ -650,6 +696,25 @@ public:
     size_t getFilterSize();
     size_t getNumOfKeysInFilter();
 
+    /**
+     * Serialise the cuckoo filter of the vbucket so it can be restored by
+     * the next warmup, instead of waiting for a compaction to build one.
+     * As the keys in the HashTable are on disk but not necessarily in the
+     * filter, they are added to the saved copy.
+     *
+     * @return the serialised filter, or empty if the vbucket has no enabled
+     *         cuckoo filter or hasn't persisted all its items
+     */
+    std::string snapshotFilter();
+
+    /**
+     * Restore a filter saved by snapshotFilter(), if the vbucket has none.
+     *
+     * @param highSeqno the persisted high seqno of the vbucket
+     * @return true if the filter was restored
+     */
+    bool restoreFilter(const std::string& data, uint64_t highSeqno);
+
     uint64_t nextHLCCas() {
         return hlc.nextHLC();
     }
@@ -697,6 +762,13 @@ public:
         return ht.getNumTempItems();
     }
 
+    /**
+     * Memory attributed to this vBucket: its HashTable items plus its
+     * checkpoints. Used by the ItemPager to direct eviction at the vBuckets
+     * causing memory pressure.
+     */
+    size_t getMemoryUsed() const;
+
     /**
      * @returns the number of system items stored in this vbucket
      */
@@ -1505,6 +1577,14 @@ public:
      */
     void setFreqSaturatedCallback(std::function<void()> callbackFunction);
 
+    /**
+     * Sets the callback function to invoke when a SyncWrite with a timeout is
+     * tracked by this VBucket.
+     *
+     * @param callbackFunction - the function to callback.
+     */
+    void setSyncWriteTimeoutCallback(SyncWriteTimeoutCallback callbackFunction);
+
     /**
      * Returns the number of deletes in the memory
      *
@@ -2087,6 +2167,12 @@ protected:
      */
     void setupSyncReplication(const nlohmann::json& topology);
 
+    /// Bump the revision of the given key (see getHotKeyRevision())
+    void bumpHotKeyRevision(const DocKey& key) {
+        hotKeyRevisions[key.hash() % HotKeyRevisionStripes].fetch_add(
+                1, std::memory_order_release);
+    }
+
     /**
      * @return a reference (if valid, i.e. vbstate=active) to the Active DM
      */
@@ -2303,6 +2389,27 @@ private:
                                             QueueBgFetch queueBgFetch,
                                             const StoredValue& v) = 0;
 
+    /**
+     * The part of getInternal() which reads the key optimistically (see
+     * HashTable::findForReadOptimistic()), for the reads which don't need
+     * the HashTable to be modified or a background fetch.
+     *
+     * @return the result of the get; none if the key must be read under the
+     *         hash bucket lock instead.
+     */
+    boost::optional<GetValue> getInternalOptimistic(
+            get_options_t options,
+            GetKeyOnly getKeyOnly,
+            const Collections::VB::Manifest::CachingReadHandle& cHandle);
+
+    /**
+     * Make the result of getInternal() for a resident (or metadata only)
+     * StoredValue.
+     */
+    GetValue makeGetValue(const StoredValue& v,
+                          get_options_t options,
+                          GetKeyOnly getKeyOnly);
+
     /**
      * Increase the expiration count global stats and in the vbucket stats
      */
@@ -2429,9 +2536,16 @@ private:
      */
     std::atomic<bool> receivingInitialDiskSnapshot;
 
+    /// @return a new (bloom or cuckoo) filter for the given number of keys
+    std::unique_ptr<KeyFilter> makeFilter(size_t key_count,
+                                          double probability,
+                                          bfilter_status_t status);
+
     std::mutex bfMutex;
-    std::unique_ptr<BloomFilter> bFilter;
-    std::unique_ptr<BloomFilter> tempFilter;    // Used during compaction.
+    std::unique_ptr<KeyFilter> bFilter;
+    std::unique_ptr<KeyFilter> tempFilter;    // Used during compaction.
+    // True if the filters are CuckooFilters, otherwise BloomFilters
+    const bool useCuckooFilter;
 
     std::atomic<uint64_t> rollbackItemCount;
 
@@ -2466,6 +2580,13 @@ private:
      */
     SyncWriteCompleteCallback syncWriteCompleteCb;
 
+    /**
+     * Callback invoked when a SyncWrite with a timeout is added, so the
+     * VBucket gets checked for timeouts when it expires. May be empty (e.g.
+     * VBuckets created directly by tests).
+     */
+    SyncWriteTimeoutCallback syncWriteTimeoutCb;
+
     /**
      * Callback invoked by a Replica VBucket after a High Prepared Seqno update
      * within the PassiveDurabilityMonitor.
@@ -2482,6 +2603,13 @@ private:
      */
     std::atomic<bool> mayContainXattrs;
 
+    /**
+     * Revisions of the keys (by stripe) for the HotKeyCache; see
+     * getHotKeyRevision(). Bumped with the HashBucketLock of the key held,
+     * after the StoredValue is updated.
+     */
+    std::array<std::atomic<uint64_t>, HotKeyRevisionStripes> hotKeyRevisions;
+
     // Durable writes are enqueued also into the DurabilityMonitor.
     // The seqno-order of items tracked by the DM must be the same as in the
     // Backfill/CheckpointManager Queues (seqno is strictly monotonic).
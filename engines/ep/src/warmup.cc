@@ -29,6 +29,7 @@
 #include "executorpool.h"
 #include "failover-table.h"
 #include "item.h"
+#include "mapped_access_log.h"
 #include "mutation_log.h"
 #include "statwriter.h"
 #include "vb_visitors.h"
@@ -40,6 +41,7 @@
 #include <platform/timeutils.h>
 #include <utilities/logtags.h>
 
+#include <algorithm>
 #include <array>
 #include <limits>
 #include <memory>
@@ -518,6 +520,49 @@ private:
     const std::string _description;
 };
 
+/**
+ * Task which scans vBuckets for the KeyDump, LoadingKVPairs or LoadingData
+ * phase when they are split into per-vBucket tasks. Each run scans one
+ * vBucket; the task is rescheduled while vBuckets remain in the phase.
+ */
+class WarmupVBucketScan : public GlobalTask {
+public:
+    WarmupVBucketScan(EPBucket& st, WarmupState::State phase, Warmup* w)
+        : GlobalTask(&st.getEPEngine(), TaskId::WarmupVBucketScan, 0, false),
+          phase(phase),
+          _warmup(w),
+          _description(std::string("Warmup - vBucket scan: ") +
+                       w->state.toString()) {
+        _warmup->addToTaskSet(uid);
+    }
+
+    std::string getDescription() override {
+        return _description;
+    }
+
+    std::chrono::microseconds maxExpectedDuration() override {
+        // Runtime is a function of the number of documents in one vBucket,
+        // can be many minutes in large datasets.
+        // Given this large variation; set max duration to a "way out" value
+        // which we don't expect to see.
+        return std::chrono::hours(1);
+    }
+
+    bool run() override {
+        TRACE_EVENT0("ep-engine/task", "WarmupVBucketScan");
+        if (_warmup->scanNextVBucket(phase)) {
+            return true;
+        }
+        _warmup->removeFromTaskSet(uid);
+        return false;
+    }
+
+private:
+    const WarmupState::State phase;
+    Warmup* _warmup;
+    const std::string _description;
+};
+
 class WarmupCompletion : public GlobalTask {
 public:
     WarmupCompletion(EPBucket& st, Warmup* w)
@@ -546,11 +591,13 @@ private:
     Warmup* _warmup;
 };
 
-static bool batchWarmupCallback(Vbid vbId,
-                                const std::set<StoredDocKey>& fetches,
-                                void* arg) {
-    WarmupCookie *c = static_cast<WarmupCookie *>(arg);
-
+/**
+ * Fetch the given keys of a vBucket from disk and apply them to the store.
+ * Keys may be any range of objects convertible to DocKey.
+ * @return false if warmup should stop loading (traffic has been enabled)
+ */
+template <class Keys>
+static bool warmupFetchKeys(Vbid vbId, const Keys& fetches, WarmupCookie* c) {
     if (!c->epstore->maybeEnableTraffic()) {
         vb_bgfetch_queue_t items2fetch;
         for (auto& key : fetches) {
@@ -610,6 +657,12 @@ static bool batchWarmupCallback(Vbid vbId,
     }
 }
 
+static bool batchWarmupCallback(Vbid vbId,
+                                const std::set<StoredDocKey>& fetches,
+                                void* arg) {
+    return warmupFetchKeys(vbId, fetches, static_cast<WarmupCookie*>(arg));
+}
+
 const char *WarmupState::toString(void) const {
     return getStateDescription(state.load());
 }
@@ -1074,6 +1127,12 @@ void Warmup::createVBuckets(uint16_t shardId) {
             EPBucket* bucket = &this->store;
             vb->setFreqSaturatedCallback(
                     [bucket]() { bucket->wakeItemFreqDecayerTask(); });
+            vb->setSyncWriteTimeoutCallback(
+                    [bucket](Vbid vbid,
+                             std::chrono::steady_clock::time_point expiry) {
+                        bucket->scheduleDurabilityTimeout(vbid, expiry);
+                    });
+            store.restoreFilter(*vb, vbs.highSeqno);
 
             // Add the new vbucket to our local map, it will later be added
             // to the bucket's vbMap once the vbuckets are fully initialised
@@ -1275,6 +1334,11 @@ void Warmup::populateVBucketMap(uint16_t shardId) {
 
 void Warmup::scheduleKeyDump()
 {
+    if (isVBucketConcurrencyEnabled()) {
+        scheduleVBucketScans(WarmupState::State::KeyDump);
+        return;
+    }
+
     threadtask_count = 0;
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
         ExTask task = std::make_shared<WarmupKeyDump>(store, i, this);
@@ -1358,12 +1422,30 @@ void Warmup::scheduleLoadingAccessLog()
     }
 }
 
+bool Warmup::loadingMappedAccessLog(const std::string& file,
+                                    uint16_t shardId,
+                                    StatusCallback<GetValue>& cb) {
+    try {
+        MappedAccessLog log(file);
+        return doWarmup(log, shardVbStates[shardId], cb) != (size_t)-1;
+    } catch (MappedAccessLog::ReadException& e) {
+        corruptAccessLog = true;
+        EP_LOG_WARN("Error reading warmup access log '{}': {}", file, e.what());
+    } catch (const std::system_error& e) {
+        EP_LOG_WARN("Failed to map warmup access log '{}': {}", file, e.what());
+    }
+    return false;
+}
+
 void Warmup::loadingAccessLog(uint16_t shardId)
 {
     LoadStorageKVPairCallback load_cb(store, true, state.getState());
     bool success = false;
     auto stTime = std::chrono::steady_clock::now();
-    if (store.accessLog[shardId].exists()) {
+    const std::string& curr = store.accessLog[shardId].getLogFile();
+    if (MappedAccessLog::isMappedAccessLog(curr)) {
+        success = loadingMappedAccessLog(curr, shardId, load_cb);
+    } else if (store.accessLog[shardId].exists()) {
         try {
             store.accessLog[shardId].open();
             if (doWarmup(store.accessLog[shardId],
@@ -1382,7 +1464,9 @@ void Warmup::loadingAccessLog(uint16_t shardId)
         std::string nm = store.accessLog[shardId].getLogFile();
         nm.append(".old");
         MutationLog old(nm);
-        if (old.exists()) {
+        if (MappedAccessLog::isMappedAccessLog(nm)) {
+            success = loadingMappedAccessLog(nm, shardId, load_cb);
+        } else if (old.exists()) {
             try {
                 old.open();
                 if (doWarmup(old, shardVbStates[shardId], load_cb) !=
@@ -1460,6 +1544,60 @@ size_t Warmup::doWarmup(MutationLog& lf,
     return cookie.loaded;
 }
 
+size_t Warmup::doWarmup(MappedAccessLog& log,
+                        const std::map<Vbid, vbucket_state>& vbmap,
+                        StatusCallback<GetValue>& cb) {
+    std::chrono::nanoseconds log_apply_duration{};
+    WarmupCookie cookie(&store, cb);
+    const size_t batchSize = std::max(size_t(1), config.getWarmupBatchSize());
+
+    // The keys are DocKey views into the mapped file; only the current batch
+    // of views is materialised, and no per-entry decoding is needed.
+    std::vector<DocKey> batch;
+    batch.reserve(batchSize);
+    auto start = std::chrono::steady_clock::now();
+    bool stop = false;
+    for (const auto& vbEntry : vbmap) {
+        const Vbid vbid = vbEntry.first;
+        VBucketPtr vb = store.getVBucket(vbid);
+        if (!vb) {
+            continue;
+        }
+
+        const auto keys = log.getKeys(vbid);
+        for (auto it = keys.begin(); !stop && it != keys.end(); ++it) {
+            const DocKey key = *it;
+            // Skip any items which are no longer valid in the VBucket.
+            if (vb->ht.findForRead(key, TrackReference::No, WantsDeleted::No)
+                        .storedValue == nullptr) {
+                continue;
+            }
+            batch.push_back(key);
+            if (batch.size() == batchSize) {
+                stop = !warmupFetchKeys(vbid, batch, &cookie);
+                batch.clear();
+            }
+        }
+        if (!stop && !batch.empty()) {
+            stop = !warmupFetchKeys(vbid, batch, &cookie);
+        }
+        batch.clear();
+        if (stop) {
+            break;
+        }
+    }
+    log_apply_duration += (std::chrono::steady_clock::now() - start);
+
+    setEstimatedWarmupCount(log.getNumKeys());
+    EP_LOG_DEBUG("Populated log in {} with(l: {}, s: {}, e: {})",
+                 cb::time2text(log_apply_duration),
+                 cookie.loaded,
+                 cookie.skipped,
+                 cookie.error);
+
+    return cookie.loaded;
+}
+
 void Warmup::scheduleLoadingKVPairs()
 {
     // We reach here only if keyDump didn't return SUCCESS or if
@@ -1468,6 +1606,11 @@ void Warmup::scheduleLoadingKVPairs()
     // keys have been warmed up at this point.
     setEstimatedWarmupCount(estimatedItemCount);
 
+    if (isVBucketConcurrencyEnabled()) {
+        scheduleVBucketScans(WarmupState::State::LoadingKVPairs);
+        return;
+    }
+
     threadtask_count = 0;
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
         ExTask task = std::make_shared<WarmupLoadingKVPairs>(store, i, this);
@@ -1516,6 +1659,11 @@ void Warmup::scheduleLoadingData()
     size_t estimatedCount = store.getEPEngine().getEpStats().warmedUpKeys;
     setEstimatedWarmupCount(estimatedCount);
 
+    if (isVBucketConcurrencyEnabled()) {
+        scheduleVBucketScans(WarmupState::State::LoadingData);
+        return;
+    }
+
     threadtask_count = 0;
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
         ExTask task = std::make_shared<WarmupLoadingData>(store, i, this);
@@ -1554,6 +1702,127 @@ void Warmup::loadDataforShard(uint16_t shardId)
     }
 }
 
+bool Warmup::isVBucketConcurrencyEnabled() const {
+    return config.getWarmupVbucketConcurrency() > 0;
+}
+
+void Warmup::scheduleVBucketScans(WarmupState::State phase) {
+    size_t numTasks = 0;
+    {
+        std::lock_guard<std::mutex> lh(vbScan.mutex);
+        vbScan.pending.clear();
+        vbScan.status.clear();
+        for (const auto& vbids : shardVbIds) {
+            for (const auto vbid : vbids) {
+                vbScan.pending.push_back(vbid);
+                vbScan.status[vbid] = VBucketScanStatus::Pending;
+            }
+        }
+        numTasks = std::min(config.getWarmupVbucketConcurrency(),
+                            vbScan.pending.size());
+        // Always schedule at least one task so the phase can complete (and
+        // transition) even if there are no vBuckets.
+        numTasks = std::max(numTasks, size_t(1));
+        vbScan.tasks = numTasks;
+        vbScan.tasksComplete = 0;
+    }
+
+    EP_LOG_INFO("Warmup::scheduleVBucketScans: {} scanning {} vBuckets with {} "
+                "tasks",
+                state.toString(),
+                vbScan.status.size(),
+                numTasks);
+
+    for (size_t i = 0; i < numTasks; i++) {
+        ExTask task = std::make_shared<WarmupVBucketScan>(store, phase, this);
+        ExecutorPool::get()->schedule(task);
+    }
+}
+
+bool Warmup::scanNextVBucket(WarmupState::State phase) {
+    Vbid vbid{0};
+    bool phaseComplete = false;
+    {
+        std::lock_guard<std::mutex> lh(vbScan.mutex);
+        if (vbScan.pending.empty()) {
+            // This task has no more work. The last task to finish moves
+            // warmup on to the next phase.
+            if (++vbScan.tasksComplete < vbScan.tasks) {
+                return false;
+            }
+            phaseComplete = true;
+        } else {
+            vbid = vbScan.pending.front();
+            vbScan.pending.pop_front();
+            vbScan.status[vbid] = VBucketScanStatus::Running;
+        }
+    }
+
+    if (phaseComplete) {
+        if (phase == WarmupState::State::KeyDump) {
+            transition(WarmupState::State::CheckForAccessLog);
+        } else {
+            transition(WarmupState::State::Done);
+        }
+        return false;
+    }
+
+    const bool memoryAvailable = scanVBucket(vbid, phase);
+
+    std::lock_guard<std::mutex> lh(vbScan.mutex);
+    vbScan.status[vbid] = VBucketScanStatus::Done;
+    if (!memoryAvailable) {
+        // skip loading remaining VBuckets as memory limit was reached
+        for (const auto skipped : vbScan.pending) {
+            vbScan.status[skipped] = VBucketScanStatus::Skipped;
+        }
+        vbScan.pending.clear();
+    }
+    return true;
+}
+
+bool Warmup::scanVBucket(Vbid vbid, WarmupState::State phase) {
+    std::shared_ptr<StatusCallback<GetValue>> cb;
+    std::shared_ptr<StatusCallback<CacheLookup>> cl;
+    ValueFilter valFilter;
+
+    switch (phase) {
+    case WarmupState::State::KeyDump:
+        cb = std::make_shared<LoadStorageKVPairCallback>(store, false, phase);
+        cl = std::make_shared<NoLookupCallback>();
+        valFilter = ValueFilter::KEYS_ONLY;
+        break;
+    case WarmupState::State::LoadingKVPairs:
+        cb = std::make_shared<LoadStorageKVPairCallback>(
+                store,
+                store.getItemEvictionPolicy() == EvictionPolicy::Full,
+                phase);
+        cl = std::make_shared<LoadValueCallback>(store.vbMap, phase);
+        valFilter = store.getValueFilterForCompressionMode();
+        break;
+    case WarmupState::State::LoadingData:
+        cb = std::make_shared<LoadStorageKVPairCallback>(store, true, phase);
+        cl = std::make_shared<LoadValueCallback>(store.vbMap, phase);
+        valFilter = store.getValueFilterForCompressionMode();
+        break;
+    default:
+        throw std::logic_error("Warmup::scanVBucket: illegal warmup state:" +
+                               std::to_string(int(phase)));
+    }
+
+    KVStore* kvstore = store.getROUnderlying(vbid);
+    ScanContext* ctx = kvstore->initScanContext(
+            cb, cl, vbid, 0, DocumentFilter::NO_DELETES, valFilter);
+    if (ctx) {
+        auto errorCode = kvstore->scan(ctx);
+        kvstore->destroyScanContext(ctx);
+        if (errorCode == scan_again) { // ENGINE_ENOMEM
+            return false;
+        }
+    }
+    return true;
+}
+
 void Warmup::scheduleCompletion() {
     ExTask task = std::make_shared<WarmupCompletion>(store, this);
     ExecutorPool::get()->schedule(task);
@@ -1697,6 +1966,46 @@ void Warmup::addStats(const AddStatFn& add_stat, const void* c) const {
     } else {
         addStat("estimated_value_count", warmupCount, add_stat, c);
     }
+
+    std::lock_guard<std::mutex> lh(vbScan.mutex);
+    if (!vbScan.status.empty()) {
+        std::array<size_t, 4> counts{};
+        for (const auto& vb : vbScan.status) {
+            counts[size_t(vb.second)]++;
+            const char* status = "pending";
+            switch (vb.second) {
+            case VBucketScanStatus::Pending:
+                break;
+            case VBucketScanStatus::Running:
+                status = "running";
+                break;
+            case VBucketScanStatus::Done:
+                status = "done";
+                break;
+            case VBucketScanStatus::Skipped:
+                status = "skipped";
+                break;
+            }
+            const auto name = "vb_" + std::to_string(vb.first.get()) + "_scan";
+            addStat(name.c_str(), status, add_stat, c);
+        }
+        addStat("vb_scan_pending",
+                counts[size_t(VBucketScanStatus::Pending)],
+                add_stat,
+                c);
+        addStat("vb_scan_running",
+                counts[size_t(VBucketScanStatus::Running)],
+                add_stat,
+                c);
+        addStat("vb_scan_done",
+                counts[size_t(VBucketScanStatus::Done)],
+                add_stat,
+                c);
+        addStat("vb_scan_skipped",
+                counts[size_t(VBucketScanStatus::Skipped)],
+                add_stat,
+                c);
+    }
 }
 
 /* In the case of CouchKVStore, all vbucket states of all the shards
@@ -38,6 +38,7 @@ class Configuration;
 class EPStats;
 class EPBucket;
 class GetValue;
+class MappedAccessLog;
 class MutationLog;
 class VBucketMap;
 class Vbid;
@@ -244,6 +245,10 @@ public:
                     const std::map<Vbid, vbucket_state>& vbmap,
                     StatusCallback<GetValue>& cb);
 
+    size_t doWarmup(MappedAccessLog& log,
+                    const std::map<Vbid, vbucket_state>& vbmap,
+                    StatusCallback<GetValue>& cb);
+
     bool isComplete() const {
         return warmupComplete.load();
     }
@@ -365,6 +370,14 @@ private:
      */
     void loadingAccessLog(uint16_t shardId);
 
+    /**
+     * Load the given memory-mapped access log for the given shard.
+     * @return true if the log was successfully loaded
+     */
+    bool loadingMappedAccessLog(const std::string& file,
+                                uint16_t shardId,
+                                StatusCallback<GetValue>& cb);
+
     /**
      * [Full-eviction only]
      * Loads both keys and values into memory for each vBucket in the given
@@ -377,6 +390,34 @@ private:
      */
     void loadDataforShard(uint16_t shardId);
 
+    /**
+     * Per-vBucket variant of keyDumpforShard, loadKVPairsforShard and
+     * loadDataforShard, used when warmup_vbucket_concurrency is non-zero.
+     * Scans the next pending vBucket of the given phase (if any).
+     *
+     * @param phase The warmup phase the scan is being performed for
+     * @return true if more vBuckets remain to be scanned in this phase
+     */
+    bool scanNextVBucket(WarmupState::State phase);
+
+    /**
+     * Scans the given vBucket from disk as required by the given phase
+     * (KeyDump, LoadingKVPairs or LoadingData).
+     *
+     * @return false if the memory limit was reached and the remaining
+     *         vBuckets should not be loaded
+     */
+    bool scanVBucket(Vbid vbid, WarmupState::State phase);
+
+    /**
+     * Schedules up to warmup_vbucket_concurrency WarmupVBucketScan tasks to
+     * scan every vBucket for the given phase.
+     */
+    void scheduleVBucketScans(WarmupState::State phase);
+
+    /// @returns true if phases should be split into per-vBucket tasks
+    bool isVBucketConcurrencyEnabled() const;
+
     /* Terminal state of warmup. Updates statistics and marks warmup as
      * completed
      */
@@ -430,6 +471,24 @@ private:
     /// contains all vBucket IDs which are present for the given shard.
     std::vector<std::vector<Vbid>> shardVbIds;
 
+    /// Progress of a vBucket in the current per-vBucket warmup phase
+    enum class VBucketScanStatus : uint8_t { Pending, Running, Done, Skipped };
+
+    /**
+     * State of the current KeyDump / LoadingKVPairs / LoadingData phase when
+     * it is split into per-vBucket tasks.
+     */
+    struct {
+        mutable std::mutex mutex;
+        /// vBuckets yet to be scanned, shared by all scan tasks
+        std::deque<Vbid> pending;
+        /// Status of every vBucket in the current phase (for stats)
+        std::map<Vbid, VBucketScanStatus> status;
+        /// Number of scan tasks scheduled / finished for the current phase
+        size_t tasks{0};
+        size_t tasksComplete{0};
+    } vbScan;
+
     cb::AtomicDuration<> estimateTime;
     std::atomic<size_t> estimatedItemCount{std::numeric_limits<size_t>::max()};
     bool cleanShutdown{true};
@@ -467,5 +526,6 @@ private:
     friend class WarmupLoadAccessLog;
     friend class WarmupLoadingKVPairs;
     friend class WarmupLoadingData;
+    friend class WarmupVBucketScan;
     friend class WarmupCompletion;
 };
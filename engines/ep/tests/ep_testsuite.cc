@@ -6882,6 +6882,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_bfilter_fp_prob",
               "ep_bfilter_key_count",
               "ep_bfilter_residency_threshold",
+              "ep_bfilter_type",
               "ep_bucket_type",
               "ep_cache_size",
               "ep_chk_expel_enabled",
@@ -6891,6 +6892,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_collections_enabled",
               "ep_collections_max_size",
               "ep_compaction_exp_mem_threshold",
+              "ep_compaction_max_bytes_per_sec",
               "ep_compaction_write_queue_cap",
               "ep_compression_mode",
               "ep_conflict_resolution_type",
@@ -6904,6 +6906,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
               "ep_dcp_conn_buffer_size",
+              "ep_dcp_conn_buffer_size_adaptive_headroom_perc",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
               "ep_dcp_conn_buffer_size_max",
@@ -6935,14 +6938,24 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_couchstore_tracing",
               "ep_couchstore_write_validation",
               "ep_couchstore_mprotect",
+              "ep_couchstore_compaction_readahead",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
+              "ep_hash_table_fused_scan",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_hot_key_cache_enabled",
+              "ep_hot_key_cache_size",
+              "ep_hot_key_cache_threshold",
               "ep_ht_locks",
+              "ep_ht_optimistic_reads",
               "ep_ht_resize_interval",
               "ep_ht_size",
+              "ep_item_compressor_algorithm",
               "ep_item_compressor_chunk_duration",
+              "ep_item_compressor_dictionary_sample_size",
+              "ep_item_compressor_dictionary_size",
+              "ep_item_compressor_dictionary_total_sample_size",
               "ep_item_compressor_interval",
               "ep_item_eviction_age_percentage",
               "ep_item_eviction_freq_counter_age_threshold",
@@ -6950,6 +6963,9 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_item_freq_decayer_percent",
               "ep_item_num_based_new_chk",
               "ep_keep_closed_chks",
+              "ep_logstore_compaction_threshold",
+              "ep_logstore_direct_io",
+              "ep_logstore_segment_size",
               "ep_magma_commit_point_every_batch",
               "ep_magma_commit_point_interval",
               "ep_magma_delete_frag_ratio",
@@ -6970,6 +6986,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_magma_write_cache_ratio",
               "ep_max_checkpoints",
               "ep_max_failover_entries",
+              "ep_max_inline_value_size",
               "ep_max_item_privileged_bytes",
               "ep_max_item_size",
               "ep_max_num_shards",
@@ -6988,6 +7005,9 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_num_reader_threads",
               "ep_num_writer_threads",
               "ep_pager_active_vb_pcnt",
+              "ep_pager_eviction_strategy",
+              "ep_pager_sampled_eviction_perc",
+              "ep_pager_sampled_eviction_sample_size",
               "ep_pager_sleep_time_ms",
               "ep_replication_throttle_cap_pcnt",
               "ep_replication_throttle_queue_cap",
@@ -7013,6 +7033,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_warmup_batch_size",
               "ep_warmup_min_items_threshold",
               "ep_warmup_min_memory_threshold",
+              "ep_warmup_vbucket_concurrency",
               "ep_xattr_enabled"}},
             {"workload",
              {"ep_workload:num_readers",
@@ -7071,6 +7092,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_bfilter_fp_prob",
               "ep_bfilter_key_count",
               "ep_bfilter_residency_threshold",
+              "ep_bfilter_type",
               "ep_bg_fetch_avg_read_amplification",
               "ep_bg_fetched",
               "ep_bg_meta_fetched",
@@ -7090,6 +7112,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_collections_enabled",
               "ep_collections_max_size",
               "ep_compaction_exp_mem_threshold",
+              "ep_compaction_max_bytes_per_sec",
               "ep_compaction_write_queue_cap",
               "ep_compression_mode",
               "ep_conflict_resolution_type",
@@ -7109,6 +7132,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
               "ep_dcp_conn_buffer_size",
+              "ep_dcp_conn_buffer_size_adaptive_headroom_perc",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
               "ep_dcp_conn_buffer_size_max",
@@ -7154,11 +7178,19 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_couchstore_tracing",
               "ep_couchstore_write_validation",
               "ep_couchstore_mprotect",
+              "ep_couchstore_compaction_readahead",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
+              "ep_hash_table_fused_scan",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_hot_key_cache_enabled",
+              "ep_hot_key_cache_hits",
+              "ep_hot_key_cache_size",
+              "ep_hot_key_cache_snapshots",
+              "ep_hot_key_cache_threshold",
               "ep_ht_locks",
+              "ep_ht_optimistic_reads",
               "ep_ht_resize_interval",
               "ep_ht_size",
               "ep_io_bg_fetch_read_count",
@@ -7169,7 +7201,11 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_io_total_read_bytes",
               "ep_io_total_write_amplification",
               "ep_io_total_write_bytes",
+              "ep_item_compressor_algorithm",
               "ep_item_compressor_chunk_duration",
+              "ep_item_compressor_dictionary_sample_size",
+              "ep_item_compressor_dictionary_size",
+              "ep_item_compressor_dictionary_total_sample_size",
               "ep_item_compressor_interval",
               "ep_item_compressor_num_compressed",
               "ep_item_compressor_num_visited",
@@ -7182,9 +7218,13 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_items_expelled_from_checkpoints",
               "ep_items_rm_from_checkpoints",
               "ep_keep_closed_chks",
+              "ep_logstore_compaction_threshold",
+              "ep_logstore_direct_io",
+              "ep_logstore_segment_size",
               "ep_kv_size",
               "ep_max_checkpoints",
               "ep_max_failover_entries",
+              "ep_max_inline_value_size",
               "ep_max_item_privileged_bytes",
               "ep_max_item_size",
               "ep_max_num_shards",
@@ -7224,6 +7264,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_num_ops_set_meta_res_fail",
               "ep_num_ops_set_ret_meta",
               "ep_num_pager_runs",
+              "ep_num_pager_sampled_rounds",
               "ep_num_reader_threads",
               "ep_num_value_ejects",
               "ep_num_workers",
@@ -7249,6 +7290,9 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_oom_errors",
               "ep_overhead",
               "ep_pager_active_vb_pcnt",
+              "ep_pager_eviction_strategy",
+              "ep_pager_sampled_eviction_perc",
+              "ep_pager_sampled_eviction_sample_size",
               "ep_pager_sleep_time_ms",
               "ep_pending_compactions",
               "ep_pending_ops",
@@ -7310,6 +7354,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_warmup_batch_size",
               "ep_warmup_min_items_threshold",
               "ep_warmup_min_memory_threshold",
+              "ep_warmup_vbucket_concurrency",
               "ep_workload_pattern",
               "ep_xattr_enabled",
               "mem_used",
@@ -7442,12 +7487,16 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                           "ep_item_flush_failed",
                           "ep_total_persisted",
                           "ep_uncommitted_items",
-                          "ep_chk_persistence_timeout"});
+                          "ep_chk_persistence_timeout",
+                          "ep_compaction_bandwidth",
+                          "ep_compaction_throttled_count",
+                          "ep_compaction_throttled_time"});
 
         // Config variables only valid for persistent
         std::initializer_list<std::string> persistentConfig = {
                 "ep_access_scanner_enabled",
                 "ep_alog_block_size",
+                "ep_alog_format",
                 "ep_alog_max_stored_items",
                 "ep_alog_path",
                 "ep_alog_resident_ratio_threshold",
@@ -7486,10 +7535,14 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
         auto& eng_stats = statsKeys.at("");
         eng_stats.insert(eng_stats.end(),
                          {"ep_ephemeral_full_policy",
+                          "ep_ephemeral_ht_cleaner_lag_ms",
                           "ep_ephemeral_metadata_mark_stale_chunk_duration",
                           "ep_ephemeral_metadata_purge_age",
                           "ep_ephemeral_metadata_purge_interval",
                           "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                          "ep_ephemeral_metadata_purge_stale_threshold",
+                          "ep_ephemeral_metadata_purge_tasks",
+                          "ep_ephemeral_stale_item_deleter_lag_ms",
 
                           "vb_active_auto_delete_count",
                           "vb_active_ht_tombstone_purged_count",
@@ -7544,7 +7597,9 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                  "ep_ephemeral_metadata_mark_stale_chunk_duration",
                  "ep_ephemeral_metadata_purge_age",
                  "ep_ephemeral_metadata_purge_interval",
-                 "ep_ephemeral_metadata_purge_stale_chunk_duration"});
+                 "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                 "ep_ephemeral_metadata_purge_stale_threshold",
+                 "ep_ephemeral_metadata_purge_tasks"});
     }
 
     // In addition to the exact stat keys above, we also use regex patterns
@@ -1877,6 +1877,48 @@ static enum test_result test_dcp_consumer_flow_control_aggressive(
     return SUCCESS;
 }
 
+static enum test_result test_dcp_consumer_flow_control_adaptive(
+        EngineIface* h) {
+    const auto* cookie1 = testHarness->create_cookie(h);
+    const std::string name("unittest");
+    const uint32_t opaque = 0;
+    const uint32_t seqno = 0;
+    const uint32_t flags = 0;
+    /* A large bucket must not change the initial size; the adaptive policy
+       only grows the buffer from measured throughput */
+    set_param(h,
+              cb::mcbp::request::SetParamPayload::Type::Flush,
+              "max_size",
+              "2000000000");
+    checkeq(2000000000, get_int_stat(h, "ep_max_size"), "Incorrect new size.");
+
+    auto dcp = requireDcpIface(h);
+    checkeq(ENGINE_SUCCESS,
+            dcp->open(cookie1,
+                      opaque,
+                      seqno,
+                      flags,
+                      name,
+                      R"({"consumer_name":"replica1"})"),
+            "Failed dcp consumer open connection.");
+
+    const auto stat_prefix("eq_dcpq:" + name + ":");
+    checkeq(10485760,
+            get_int_stat(h, (stat_prefix + "max_buffer_bytes").c_str(), "dcp"),
+            "Flow Control Buffer Size not equal to min");
+    checkeq(0,
+            get_int_stat(h,
+                         (stat_prefix + "bandwidth_delay_product").c_str(),
+                         "dcp"),
+            "Bandwidth-delay product should be zero before any ack");
+    checkeq(0,
+            get_int_stat(h, (stat_prefix + "drain_rate_bytes").c_str(), "dcp"),
+            "Drain rate should be zero before any ack");
+    testHarness->destroy_cookie(cookie1);
+
+    return SUCCESS;
+}
+
 static enum test_result test_dcp_producer_open(EngineIface* h) {
     const auto* cookie1 = testHarness->create_cookie(h);
     const std::string name("unittest");
@@ -7937,6 +7979,10 @@ BaseTestCase testsuite_testcases[] = {
                  test_dcp_consumer_flow_control_aggressive,
                  test_setup, teardown, "dcp_flow_control_policy=aggressive",
                  prepare, cleanup),
+        TestCase("test dcp consumer flow control adaptive",
+                 test_dcp_consumer_flow_control_adaptive,
+                 test_setup, teardown, "dcp_flow_control_policy=adaptive",
+                 prepare, cleanup),
         TestCase("test open producer", test_dcp_producer_open,
                  test_setup, teardown, nullptr, prepare, cleanup),
         TestCase("test open producer same cookie", test_dcp_producer_open_same_cookie,
@@ -61,6 +61,11 @@ public:
         return false;
     }
 
+    /// return if all the streams of the vbid have been notified
+    bool isVBNotified(Vbid vbid) const {
+        return vbNotified[vbid.get()]->load();
+    }
+
     /// return if the named handler exists for the vbid in the vbConns structure
     bool doesConnHandlerExist(Vbid vbid, const std::string& name) const {
         const auto& list = vbConns[vbid.get()];
@@ -22,8 +22,9 @@
 MockDcpConsumer::MockDcpConsumer(EventuallyPersistentEngine& theEngine,
                                  const void* cookie,
                                  const std::string& name,
-                                 const std::string& consumerName)
-    : DcpConsumer(theEngine, cookie, name, consumerName) {
+                                 const std::string& consumerName,
+                                 cb::ProcessClockSource& clock)
+    : DcpConsumer(theEngine, cookie, name, consumerName, clock) {
 }
 
 std::shared_ptr<PassiveStream> MockDcpConsumer::makePassiveStream(
@@ -27,10 +27,12 @@
  */
 class MockDcpConsumer: public DcpConsumer {
 public:
-    MockDcpConsumer(EventuallyPersistentEngine& theEngine,
-                    const void* cookie,
-                    const std::string& name,
-                    const std::string& consumerName = {});
+    MockDcpConsumer(
+            EventuallyPersistentEngine& theEngine,
+            const void* cookie,
+            const std::string& name,
+            const std::string& consumerName = {},
+            cb::ProcessClockSource& clock = cb::defaultProcessClockSource());
 
     void setPendingAddStream(bool value) {
         // The unit tests was written before memcached marked the
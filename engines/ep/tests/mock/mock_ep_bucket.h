@@ -57,4 +57,9 @@ public:
 
     /// @returns a non-const pointer to Flusher object.
     Flusher* getFlusherNonConst(Vbid vbid);
+
+    /// @returns the compaction tasks which are scheduled or running.
+    std::list<CompTaskEntry>& getCompactionTasks() {
+        return compactionTasks;
+    }
 };
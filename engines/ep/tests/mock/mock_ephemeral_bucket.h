@@ -47,4 +47,9 @@ public:
 
     void setDurabilityCompletionTask(
             std::shared_ptr<DurabilityCompletionTask> task);
+
+    std::vector<std::shared_ptr<EphTombstoneHTCleaner>>&
+    getTombstonePurgerTasks() {
+        return tombstonePurgerTasks;
+    }
 };
@@ -56,6 +56,10 @@ public:
         return nextCheckpointItem();
     }
 
+    bool public_itemsReady() const {
+        return itemsReady;
+    }
+
     const std::queue<std::unique_ptr<DcpResponse>>& public_readyQ() {
         return readyQ;
     }
@@ -19,6 +19,7 @@
 #include "ephemeral_vb.h"
 #include "item.h"
 #include "kv_bucket.h"
+#include "stats.h"
 #include "tests/mock/mock_synchronous_ep_engine.h"
 #include "tests/module_tests/collections/test_manifest.h"
 #include "tests/module_tests/evp_store_single_threaded_test.h"
@@ -490,6 +491,37 @@ TEST_P(CollectionsEraserTest, erase_after_warmup) {
     EXPECT_FALSE(vb->lockCollections().exists(CollectionEntry::dairy));
 }
 
+// Test that the memory-tracking slot of a dropped collection is released once
+// the collection is erased, so that more collections than there are slots
+// can be created and dropped over time and still be tracked individually.
+TEST_P(CollectionsEraserTest, MemoryTrackingSlotReleasedOnErase) {
+    auto& stats = engine->getEpStats();
+    CollectionsManifest cm;
+    const size_t collections = EPStats::MaxTrackedCollections + 36;
+    for (size_t ii = 0; ii < collections; ++ii) {
+        CollectionEntry::Entry entry{"c" + std::to_string(ii),
+                                     CollectionID(100 + ii)};
+        store->setCollections({cm.add(entry)});
+        flush_vbucket_to_disk(vbid, 1 /* 1 x system */);
+
+        store_item(vbid, StoredDocKey{"key", entry}, "value");
+        flush_vbucket_to_disk(vbid, 1 /* 1 x items */);
+
+        auto memUsed = stats.getCollectionMemoryUsed();
+        ASSERT_EQ(1, memUsed.count(entry)) << entry.name;
+        EXPECT_GT(memUsed[entry], 0) << entry.name;
+        EXPECT_EQ(0, stats.getUntrackedCollectionMemoryUsed()) << entry.name;
+
+        store->setCollections({cm.remove(entry)});
+        flush_vbucket_to_disk(vbid, 1 /* 1 x system */);
+        EXPECT_EQ(0, stats.getCollectionMemoryUsed().count(entry))
+                << entry.name;
+
+        runCollectionsEraser();
+        EXPECT_EQ(0, vb->getNumItems()) << entry.name;
+    }
+}
+
 // Test cases which run for persistent and ephemeral buckets
 INSTANTIATE_TEST_CASE_P(CollectionsEraserTests,
                         CollectionsEraserTest,
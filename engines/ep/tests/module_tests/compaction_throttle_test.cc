@@ -0,0 +1,176 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "compaction_throttle.h"
+#include "couch-kvstore/couch-fs-throttle.h"
+#include "kvstore_config.h"
+
+#include <fcntl.h>
+#include <folly/portability/GTest.h>
+#include <cstdio>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/**
+ * CompactionThrottle whose waits advance a simulated clock instead of
+ * sleeping.
+ */
+class MockCompactionThrottle : public CompactionThrottle {
+public:
+    using CompactionThrottle::CompactionThrottle;
+
+    Clock::time_point fakeNow = Clock::now();
+
+protected:
+    Clock::time_point now() const override {
+        return fakeNow;
+    }
+
+    void sleepFor(std::chrono::microseconds delay) override {
+        fakeNow += delay;
+    }
+};
+
+class CompactionThrottleTest : public ::testing::Test {
+protected:
+    CompactionThrottle throttle{1000};
+    const CompactionThrottle::Clock::time_point t0 =
+            CompactionThrottle::Clock::now();
+};
+
+// With no rate configured nothing is ever delayed.
+TEST_F(CompactionThrottleTest, Unlimited) {
+    throttle.setRate(0);
+    EXPECT_EQ(0us, throttle.reserve(100 * 1024 * 1024, t0));
+    EXPECT_EQ(0us, throttle.reserve(100 * 1024 * 1024, t0));
+    EXPECT_EQ(0u, throttle.getThrottledCount());
+    EXPECT_EQ(200u * 1024 * 1024, throttle.getTotalBytes());
+}
+
+// A full bucket admits one second's worth of IO without waiting; anything
+// beyond that waits in proportion to the excess.
+TEST_F(CompactionThrottleTest, BurstThenWait) {
+    EXPECT_EQ(0us, throttle.reserve(1000, t0));
+    EXPECT_EQ(500ms, throttle.reserve(500, t0));
+    // Debt accumulates for subsequent callers.
+    EXPECT_EQ(1000ms, throttle.reserve(500, t0));
+    EXPECT_EQ(1000ms, throttle.getDelay(t0));
+    // Only delays which were recorded (by snoozing) are counted.
+    EXPECT_EQ(0u, throttle.getThrottledCount());
+    throttle.recordDelay(1000ms);
+    EXPECT_EQ(1u, throttle.getThrottledCount());
+    EXPECT_EQ(1000000u, throttle.getThrottledTime());
+}
+
+// The debt is repaid over time, after which compaction need not wait.
+TEST_F(CompactionThrottleTest, DelayRepaid) {
+    EXPECT_EQ(0us, throttle.getDelay(t0));
+    throttle.reserve(1000, t0);
+    throttle.reserve(1000, t0);
+    EXPECT_EQ(1000ms, throttle.getDelay(t0));
+    EXPECT_EQ(500ms, throttle.getDelay(t0 + 500ms));
+    EXPECT_EQ(0us, throttle.getDelay(t0 + 1s));
+
+    throttle.setRate(0);
+    throttle.reserve(100 * 1024 * 1024, t0 + 1s);
+    EXPECT_EQ(0us, throttle.getDelay(t0 + 1s));
+}
+
+TEST_F(CompactionThrottleTest, Refill) {
+    EXPECT_EQ(0us, throttle.reserve(1000, t0));
+    // Half a second later half the bucket is available again.
+    EXPECT_EQ(0us, throttle.reserve(500, t0 + 500ms));
+    EXPECT_EQ(100ms, throttle.reserve(100, t0 + 500ms));
+    // Tokens never accumulate beyond one second's worth.
+    EXPECT_EQ(0us, throttle.reserve(1000, t0 + 10s));
+    EXPECT_EQ(1ms, throttle.reserve(1, t0 + 10s));
+}
+
+// Changing the rate discards any debt owed at the old rate.
+TEST_F(CompactionThrottleTest, SetRateResetsDebt) {
+    EXPECT_EQ(0us, throttle.reserve(1000, t0));
+    EXPECT_EQ(1000ms, throttle.reserve(1000, t0));
+    throttle.setRate(2000);
+    EXPECT_EQ(2000u, throttle.getRate());
+    EXPECT_EQ(0us, throttle.reserve(2000, CompactionThrottle::Clock::now()));
+}
+
+TEST_F(CompactionThrottleTest, Bandwidth) {
+    throttle.setRate(0);
+    throttle.reserve(2000, t0);
+    // The window closes on the first request at least one second later.
+    throttle.reserve(0, t0 + 1s);
+    EXPECT_NEAR(2000, throttle.getBandwidth(), 20);
+}
+
+// A single compaction issuing N bytes of IO at rate R is paced to take about
+// N/R (less the one second burst the full bucket admits), and the time it
+// waited is recorded.
+TEST(CompactionThrottlePacingTest, AcquirePacesSingleCompaction) {
+    const size_t rate = 1024 * 1024;
+    const size_t chunk = 4096;
+    const size_t total = 10 * rate;
+    MockCompactionThrottle throttle{rate};
+    const auto start = throttle.fakeNow;
+
+    for (size_t done = 0; done < total; done += chunk) {
+        throttle.acquire(chunk);
+    }
+
+    const auto elapsed = throttle.fakeNow - start;
+    EXPECT_NEAR(9.0, std::chrono::duration<double>(elapsed).count(), 0.01);
+    EXPECT_GT(throttle.getThrottledCount(), 0u);
+    EXPECT_EQ(std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+                      .count(),
+              throttle.getThrottledTime());
+}
+
+// As above, but for the writes of a compaction issued through ThrottleOps.
+TEST(CompactionThrottlePacingTest, ThrottleOpsPacesWrites) {
+    const size_t rate = 64 * 1024;
+    const size_t total = 10 * rate;
+    MockCompactionThrottle throttle{rate};
+    KVStoreConfig config(1, 1, "", "couchdb", 0);
+    auto ops = getCouchstoreThrottleOps(
+            *couchstore_get_default_file_ops(), throttle, config);
+
+    const std::string path = "compaction_throttle_test.couch";
+    couchstore_error_info_t errinfo;
+    auto handle = ops->constructor(&errinfo);
+    ASSERT_EQ(COUCHSTORE_SUCCESS,
+              ops->open(&errinfo, &handle, path.c_str(), O_CREAT | O_RDWR));
+
+    const auto start = throttle.fakeNow;
+    const std::vector<char> buf(4096, 'x');
+    for (size_t offset = 0; offset < total; offset += buf.size()) {
+        ASSERT_EQ(ssize_t(buf.size()),
+                  ops->pwrite(&errinfo,
+                              handle,
+                              buf.data(),
+                              buf.size(),
+                              offset));
+    }
+    const auto elapsed = throttle.fakeNow - start;
+
+    ops->close(&errinfo, handle);
+    ops->destructor(handle);
+    std::remove(path.c_str());
+
+    EXPECT_EQ(total, throttle.getTotalBytes());
+    EXPECT_NEAR(9.0, std::chrono::duration<double>(elapsed).count(), 0.01);
+}
@@ -0,0 +1,174 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "cuckoo_filter.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+
+#include <cstring>
+
+/*
+ * Unit tests for the CuckooFilter class.
+ */
+
+class CuckooFilterTest : public ::testing::Test {
+protected:
+    static std::vector<StoredDocKey> makeKeys(size_t count,
+                                              const std::string& prefix) {
+        std::vector<StoredDocKey> keys;
+        for (size_t ii = 0; ii < count; ++ii) {
+            keys.push_back(makeStoredDocKey(prefix + std::to_string(ii)));
+        }
+        return keys;
+    }
+
+    CuckooFilter filter{1000, BFILTER_ENABLED};
+};
+
+TEST_F(CuckooFilterTest, AddAndRemove) {
+    auto keys = makeKeys(1000, "key");
+    for (const auto& key : keys) {
+        filter.addKey(key);
+    }
+    EXPECT_EQ(1000, filter.getNumOfKeysInFilter());
+    for (const auto& key : keys) {
+        EXPECT_TRUE(filter.maybeKeyExists(key));
+    }
+
+    for (const auto& key : keys) {
+        filter.removeKey(key);
+    }
+    EXPECT_EQ(0, filter.getNumOfKeysInFilter());
+    for (const auto& key : keys) {
+        EXPECT_FALSE(filter.maybeKeyExists(key));
+    }
+}
+
+TEST_F(CuckooFilterTest, KeyInOtherCollection) {
+    filter.addKey(StoredDocKey("key", CollectionID::Default));
+    EXPECT_FALSE(
+            filter.maybeKeyExists(StoredDocKey("key", CollectionID(100))));
+}
+
+TEST_F(CuckooFilterTest, DuplicateKeys) {
+    auto key = makeStoredDocKey("key");
+    filter.addKey(key);
+    filter.addKey(key);
+    EXPECT_EQ(2, filter.getNumOfKeysInFilter());
+
+    // Each removal only removes one copy
+    filter.removeKey(key);
+    EXPECT_TRUE(filter.maybeKeyExists(key));
+    filter.removeKey(key);
+    EXPECT_FALSE(filter.maybeKeyExists(key));
+}
+
+TEST_F(CuckooFilterTest, FalsePositiveRate) {
+    for (const auto& key : makeKeys(1000, "key")) {
+        filter.addKey(key);
+    }
+    size_t falsePositives = 0;
+    for (const auto& key : makeKeys(10000, "other")) {
+        falsePositives += filter.maybeKeyExists(key);
+    }
+    EXPECT_LT(falsePositives, 10);
+}
+
+TEST_F(CuckooFilterTest, GrowsOnline) {
+    CuckooFilter small(16, BFILTER_ENABLED);
+    const auto initialSize = small.getFilterSize();
+    auto keys = makeKeys(1000, "key");
+    for (const auto& key : keys) {
+        small.addKey(key);
+    }
+    EXPECT_GT(small.getNumTables(), 1);
+    EXPECT_GT(small.getFilterSize(), initialSize);
+    for (const auto& key : keys) {
+        EXPECT_TRUE(small.maybeKeyExists(key));
+    }
+
+    for (const auto& key : keys) {
+        small.removeKey(key);
+    }
+    EXPECT_EQ(0, small.getNumOfKeysInFilter());
+    for (const auto& key : keys) {
+        EXPECT_FALSE(small.maybeKeyExists(key));
+    }
+}
+
+TEST_F(CuckooFilterTest, NoRemovalWhileCompacting) {
+    auto key = makeStoredDocKey("key");
+    filter.addKey(key);
+    filter.setStatus(BFILTER_COMPACTING);
+    filter.removeKey(key);
+    EXPECT_TRUE(filter.maybeKeyExists(key));
+    EXPECT_EQ(1, filter.getNumOfKeysInFilter());
+}
+
+TEST_F(CuckooFilterTest, Disabled) {
+    auto key = makeStoredDocKey("key");
+    filter.addKey(key);
+    filter.setStatus(BFILTER_DISABLED);
+    EXPECT_EQ(0, filter.getNumOfKeysInFilter());
+    EXPECT_EQ(0, filter.getFilterSize());
+    // Every key may exist while disabled
+    EXPECT_TRUE(filter.maybeKeyExists(makeStoredDocKey("other")));
+
+    // Once compacting again the filter starts empty
+    filter.setStatus(BFILTER_ENABLED);
+    filter.setStatus(BFILTER_COMPACTING);
+    EXPECT_FALSE(filter.maybeKeyExists(key));
+    filter.addKey(key);
+    EXPECT_TRUE(filter.maybeKeyExists(key));
+}
+
+TEST_F(CuckooFilterTest, Serialize) {
+    CuckooFilter small(16, BFILTER_ENABLED);
+    auto keys = makeKeys(1000, "key");
+    for (const auto& key : keys) {
+        small.addKey(key);
+    }
+    const auto data = small.serialize(10);
+
+    // Only restored at the seqno it was saved at
+    EXPECT_FALSE(CuckooFilter::deserialize(data, 11));
+    EXPECT_FALSE(CuckooFilter::deserialize(data.substr(0, data.size() - 1),
+                                           10));
+    EXPECT_FALSE(CuckooFilter::deserialize("", 10));
+
+    // A bucket count whose size in bytes overflows is rejected. The first
+    // table's bucket count follows the 40 byte header.
+    auto corrupt = data;
+    const uint64_t hugeBuckets = uint64_t(1) << 62;
+    std::memcpy(&corrupt[40], &hugeBuckets, sizeof(hugeBuckets));
+    EXPECT_FALSE(CuckooFilter::deserialize(corrupt, 10));
+
+    auto restored = CuckooFilter::deserialize(data, 10);
+    ASSERT_TRUE(restored);
+    EXPECT_EQ(BFILTER_ENABLED, restored->getStatus());
+    EXPECT_EQ(small.getNumTables(), restored->getNumTables());
+    EXPECT_EQ(small.getFilterSize(), restored->getFilterSize());
+    EXPECT_EQ(1000, restored->getNumOfKeysInFilter());
+    for (const auto& key : keys) {
+        EXPECT_TRUE(restored->maybeKeyExists(key));
+    }
+    for (const auto& key : keys) {
+        restored->removeKey(key);
+    }
+    EXPECT_EQ(0, restored->getNumOfKeysInFilter());
+}
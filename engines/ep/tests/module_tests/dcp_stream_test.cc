@@ -2461,6 +2461,78 @@ TEST_P(SingleThreadedActiveStreamTest,
     EXPECT_EQ(ActiveStream::StreamState::InMemory, stream->getState());
 }
 
+/**
+ * Front-end mutations only fan out to the producers of a vBucket until all
+ * its streams have been told there is data to send; a stream asks for the
+ * next notification once it runs out of data.
+ */
+TEST_P(SingleThreadedActiveStreamTest, SeqnoNotificationIsCoalesced) {
+    auto& connMap = static_cast<MockDcpConnMap&>(engine->getDcpConnMap());
+
+    // The new stream wants to hear about the next mutation
+    EXPECT_FALSE(connMap.isVBNotified(vbid));
+
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    EXPECT_TRUE(connMap.isVBNotified(vbid));
+
+    // Nothing to do for the following mutations
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+    EXPECT_TRUE(connMap.isVBNotified(vbid));
+
+    // Drain the stream; once it has nothing to send it asks to be notified
+    while (stream->next()) {
+    }
+    EXPECT_FALSE(connMap.isVBNotified(vbid));
+
+    store_item(vbid, makeStoredDocKey("key3"), "value");
+    EXPECT_TRUE(connMap.isVBNotified(vbid));
+}
+
+/**
+ * A mutation queued while the stream finds it has nothing to send sees the
+ * vBucket as notified, and doesn't wake the stream; the stream must pick it
+ * up itself once it asks for the next notification. Race front-end
+ * mutations against a stream consumed only when it says it has items ready
+ * (as the producer does).
+ */
+TEST_P(SingleThreadedActiveStreamTest, SeqnoNotificationRacesStreamGoingIdle) {
+    auto& vb = *engine->getVBucket(vbid);
+    producer->createCheckpointProcessorTask();
+    recreateStream(vb);
+    engine->getDcpConnMap().addVBConnByVBId(producer, vbid);
+    auto& processor = *producer->getCheckpointSnapshotTask();
+
+    const size_t numItems = 1000;
+    std::thread frontEnd([this, numItems]() {
+        for (size_t ii = 0; ii < numItems; ++ii) {
+            store_item(vbid,
+                       makeStoredDocKey("key" + std::to_string(ii)),
+                       "value");
+        }
+    });
+
+    size_t received = 0;
+    const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (received < numItems && std::chrono::steady_clock::now() < deadline) {
+        if (processor.queueSize() > 0) {
+            processor.run();
+        }
+        if (!stream->public_itemsReady()) {
+            std::this_thread::yield();
+            continue;
+        }
+        auto response = stream->next();
+        if (response &&
+            response->getEvent() == DcpResponse::Event::Mutation) {
+            ++received;
+        }
+    }
+    frontEnd.join();
+
+    EXPECT_EQ(numItems, received) << "Stream wasn't woken for every mutation";
+}
+
 INSTANTIATE_TEST_CASE_P(
         AllBucketTypes,
         SingleThreadedActiveStreamTest,
@@ -1470,6 +1470,130 @@ TEST_P(ConnectionTest, consumer_get_error_map) {
     }
 }
 
+class AdaptiveFlowControlTest : public ConnectionTest {
+protected:
+    void SetUp() override {
+        // A 10KB minimum buffer, so a few mutations fill it
+        config_string +=
+                "dcp_flow_control_policy=adaptive;"
+                "dcp_conn_buffer_size=10240;"
+                "dcp_conn_buffer_size_adaptive_headroom_perc=1000";
+        ConnectionTest::SetUp();
+    }
+
+    /// Send mutations to the consumer until at least bytes have been sent
+    void sendMutations(MockDcpConsumer& consumer, size_t bytes) {
+        const std::string value(1024, 'x');
+        size_t sent = 0;
+        while (sent < bytes) {
+            const auto key = "key" + std::to_string(seqno);
+            const DocKey docKey{reinterpret_cast<const uint8_t*>(key.data()),
+                                key.size(),
+                                DocKeyEncodesCollectionId::No};
+            ASSERT_EQ(ENGINE_SUCCESS,
+                      consumer.mutation(
+                              opaque,
+                              docKey,
+                              {reinterpret_cast<const uint8_t*>(value.data()),
+                               value.size()},
+                              0, // priv bytes
+                              PROTOCOL_BINARY_RAW_BYTES,
+                              0, // cas
+                              vbid,
+                              0, // flags
+                              seqno++,
+                              0, // rev seqno
+                              0, // exptime
+                              0, // locktime
+                              {}, // meta
+                              0)); // nru
+            sent += key.size() + value.size();
+        }
+    }
+
+    /// Clock for the consumer's flow control, advanced by the test
+    struct ManualClockSource : public cb::ProcessClockSource {
+        std::chrono::steady_clock::time_point now() override {
+            return time;
+        }
+        std::chrono::steady_clock::time_point time =
+                std::chrono::steady_clock::now();
+    };
+
+    const uint32_t opaque = 1;
+    uint64_t seqno = 1;
+    ManualClockSource clock;
+};
+
+/*
+ * Test that the adaptive flow control policy measures the round trip of a
+ * buffer ack to a stalled producer, and sizes the consumer's buffer from
+ * the resulting bandwidth-delay product.
+ */
+TEST_P(AdaptiveFlowControlTest, BufferSizedFromAckRoundTrip) {
+    const size_t minSize = engine->getConfiguration().getDcpConnBufferSize();
+    // Large enough quota that the aggregate threshold does not interfere
+    engine->getEpStats().setMaxDataSize(
+            1000 * engine->getConfiguration().getDcpConnBufferSizeMax());
+
+    const void* cookie = create_mock_cookie(engine);
+    auto consumer = std::make_shared<MockDcpConsumer>(
+            *engine, cookie, "test_consumer", "", clock);
+    auto& flowControl = consumer->getFlowControl();
+    ASSERT_EQ(minSize, flowControl.getFlowControlBufSize());
+
+    ASSERT_EQ(ENGINE_SUCCESS, set_vb_state(vbid, vbucket_state_replica));
+    ASSERT_EQ(ENGINE_SUCCESS, consumer->addStream(/*opaque*/ 0, vbid, 0));
+    ASSERT_EQ(ENGINE_SUCCESS,
+              consumer->snapshotMarker(opaque,
+                                       vbid,
+                                       1,
+                                       std::numeric_limits<uint64_t>::max(),
+                                       /* in-memory snapshot */ 0x1,
+                                       {} /*HCS*/,
+                                       {} /*maxVisibleSeq*/));
+
+    // The first step sends the buffer size to the producer
+    MockDcpMessageProducers producers(engine);
+    ASSERT_EQ(ENGINE_SUCCESS, consumer->step(&producers));
+    ASSERT_EQ(cb::mcbp::ClientOpcode::DcpControl, producers.last_op);
+
+    // Fill the buffer, which takes a while to drain; the producer now waits
+    // for an ack
+    sendMutations(*consumer, minSize);
+    clock.time += std::chrono::milliseconds(10);
+    ASSERT_EQ(ENGINE_SUCCESS, consumer->step(&producers));
+    ASSERT_EQ(cb::mcbp::ClientOpcode::DcpBufferAcknowledgement,
+              producers.last_op);
+    EXPECT_EQ(0, flowControl.getAckLatency().count());
+    EXPECT_GT(flowControl.getDrainRate(), 0);
+    EXPECT_EQ(minSize, flowControl.getFlowControlBufSize());
+
+    // The ack takes a while to reach the producer, and its next message a
+    // while to come back
+    const auto roundTrip = std::chrono::milliseconds(50);
+    clock.time += roundTrip;
+    sendMutations(*consumer, minSize);
+    EXPECT_EQ(roundTrip, flowControl.getAckLatency());
+
+    // The next ack sizes the buffer from the measured bandwidth-delay product
+    ASSERT_EQ(ENGINE_SUCCESS, consumer->step(&producers));
+    ASSERT_EQ(cb::mcbp::ClientOpcode::DcpBufferAcknowledgement,
+              producers.last_op);
+    EXPECT_GT(flowControl.getBandwidthDelayProduct(), 0);
+    EXPECT_GT(flowControl.getFlowControlBufSize(), minSize);
+
+    // Messages received while the producer isn't stalled don't change the
+    // measured latency
+    const auto latency = flowControl.getAckLatency();
+    clock.time += roundTrip;
+    sendMutations(*consumer, 1);
+    EXPECT_EQ(latency, flowControl.getAckLatency());
+
+    EXPECT_EQ(ENGINE_SUCCESS, consumer->closeStream(opaque, vbid));
+    destroy_mock_cookie(cookie);
+}
+
 // Regression test for MB 20645 - ensure that a call to addStats after a
 // connection has been disconnected (and closeAllStreams called) doesn't crash.
 TEST_P(ConnectionTest, test_mb20645_stats_after_closeAllStreams) {
@@ -3091,3 +3215,7 @@ INSTANTIATE_TEST_CASE_P(CompressionStreamTest,
 INSTANTIATE_TEST_CASE_P(PersistentAndEphemeral,
                         ConnectionTest,
                         STParameterizedBucketTest::allConfigValues(), );
+
+INSTANTIATE_TEST_CASE_P(PersistentAndEphemeral,
+                        AdaptiveFlowControlTest,
+                        STParameterizedBucketTest::allConfigValues(), );
@@ -22,14 +22,18 @@
 #include "dcp/dcpconnmap.h"
 #include "dcp/response.h"
 #include "ephemeral_bucket.h"
+#include "ephemeral_tombstone_purger.h"
 #include "test_helpers.h"
 
 #include "../mock/mock_checkpoint_manager.h"
 #include "../mock/mock_dcp_consumer.h"
 #include "../mock/mock_dcp_producer.h"
+#include "../mock/mock_ephemeral_bucket.h"
 #include "../mock/mock_stream.h"
 #include "../mock/mock_synchronous_ep_engine.h"
 
+#include <thread>
+
 /*
  * Test statistics related to an individual VBucket's sequence list.
  */
@@ -297,3 +301,178 @@ TEST_F(SingleThreadedEphemeralPurgerTest, PurgeAcrossAllVbuckets) {
     EXPECT_GT(numPaused, 2 /* 1 run of 'HTCleaner' and more than 1 run of
                               'EphTombstoneStaleItemDeleter' */);
 }
+
+class SingleThreadedEphemeralPartitionedPurgerTest
+    : public SingleThreadedEphemeralPurgerTest {
+protected:
+    void SetUp() override {
+        config_string += "ephemeral_metadata_purge_tasks=2;";
+        SingleThreadedEphemeralPurgerTest::SetUp();
+    }
+};
+
+TEST_F(SingleThreadedEphemeralPartitionedPurgerTest, PurgeAcrossPartitions) {
+    for (int vbid = 0; vbid < numVbs; ++vbid) {
+        const std::string key("keydelete" + std::to_string(vbid));
+        storeAndDeleteItem(Vbid(vbid), makeStoredDocKey(key), "value");
+        /* Add another item as we do not purge last element in the list */
+        store_item(Vbid(vbid),
+                   makeStoredDocKey("afterdelete" + std::to_string(vbid)),
+                   "value");
+    }
+    const uint64_t expPurgeUpto = 2;
+
+    EphemeralBucket* bucket = dynamic_cast<EphemeralBucket*>(store);
+    bucket->enableTombstonePurgerTask();
+
+    /* Each partition has its own pair of tasks */
+    EXPECT_TRUE(task_executor->isTaskScheduled(
+            NONIO_TASK_IDX, "Eph tombstone hashtable cleaner (partition 0)"));
+    EXPECT_TRUE(task_executor->isTaskScheduled(
+            NONIO_TASK_IDX, "Eph tombstone hashtable cleaner (partition 1)"));
+
+    EXPECT_TRUE(task_executor->isTaskScheduled(
+            NONIO_TASK_IDX, "Eph tombstone stale item deleter (partition 0)"));
+    EXPECT_TRUE(task_executor->isTaskScheduled(
+            NONIO_TASK_IDX, "Eph tombstone stale item deleter (partition 1)"));
+
+    /* Between them the tasks of both partitions purge every vBucket */
+    bucket->attemptToFreeMemory();
+    auto& lpNonioQ = *task_executor->getLpTaskQ()[NONIO_TASK_IDX];
+    for (int ii = 0; ii < 20 && !checkAllPurged(expPurgeUpto); ++ii) {
+        runNextTask(lpNonioQ);
+    }
+    EXPECT_TRUE(checkAllPurged(expPurgeUpto));
+}
+
+/**
+ * Test fixture for the tombstone purger tasks, which are run directly (rather
+ * than from the task queue) to control how far through a pass they are.
+ */
+class EphemeralTombstonePurgerTest : public EphemeralBucketStatTest {
+protected:
+    void SetUp() override {
+        // Purge every tombstone, with the HTCleaner pausing once it visited
+        // (at least) 100 items.
+        config_string +=
+                "ephemeral_metadata_purge_age=0;"
+                "ephemeral_metadata_mark_stale_chunk_duration=0;";
+        EphemeralBucketStatTest::SetUp();
+
+        for (int ii = 0; ii < numTombstones; ++ii) {
+            storeAndDeleteItem(vbid,
+                               makeStoredDocKey("key" + std::to_string(ii)),
+                               "value");
+        }
+        /* Add another item as we do not purge last element in the list */
+        store_item(vbid, makeStoredDocKey("afterdelete"), "value");
+    }
+
+    EphTombstoneHTCleaner& getHTCleaner() {
+        auto& tasks = static_cast<MockEphemeralBucket*>(store)
+                              ->getTombstonePurgerTasks();
+        EXPECT_EQ(1, tasks.size());
+        return *tasks.front();
+    }
+
+    /// @return whether the HTCleaner is part way through a pass
+    bool isInPass() {
+        // Look a second ahead: a pass in progress will have been running for
+        // at least that long, whereas the lag is always zero between passes.
+        return getHTCleaner().getPassLag(std::chrono::steady_clock::now() +
+                                         std::chrono::seconds(1)) >=
+               std::chrono::seconds(1);
+    }
+
+    /// @return whether the StaleItemDeleter has been woken, and is yet to
+    ///         complete its pass
+    bool isStaleItemDeleterPending() {
+        return getHTCleaner().getStaleItemDeleterLag(
+                       std::chrono::steady_clock::now() +
+                       std::chrono::seconds(1)) >= std::chrono::seconds(1);
+    }
+
+    /// Run the HTCleaner until it completes its current pass.
+    void completePass() {
+        for (int ii = 0; ii < numTombstones && isInPass(); ++ii) {
+            getHTCleaner().run();
+        }
+        ASSERT_FALSE(isInPass());
+    }
+
+    const int numTombstones = 500;
+};
+
+/*
+ * Test that with ephemeral_metadata_purge_stale_threshold set the
+ * StaleItemDeleter is woken part way through a HTCleaner pass, once enough
+ * bytes have been marked stale, rather than at the end of the pass.
+ */
+TEST_F(EphemeralTombstonePurgerTest, StaleThresholdWakesStaleItemDeleter) {
+    auto& config = engine->getConfiguration();
+    ASSERT_EQ(0, config.getEphemeralMetadataPurgeStaleThreshold());
+
+    // Without a threshold the stale items wait for the end of the pass.
+    auto& cleaner = getHTCleaner();
+    cleaner.run();
+    ASSERT_TRUE(isInPass()) << "HTCleaner should have paused";
+    EXPECT_FALSE(isStaleItemDeleterPending());
+
+    // With a threshold (lower than the size of the items already marked
+    // stale) the next chunk wakes the StaleItemDeleter.
+    config.setEphemeralMetadataPurgeStaleThreshold(1);
+    cleaner.run();
+    ASSERT_TRUE(isInPass()) << "HTCleaner should have paused";
+    EXPECT_TRUE(isStaleItemDeleterPending());
+
+    // The StaleItemDeleter can delete the items marked stale so far, while
+    // the HTCleaner is still part way through its pass.
+    auto& deleter = cleaner.getStaleItemDeleterTask();
+    for (int ii = 0; ii < numTombstones && isStaleItemDeleterPending(); ++ii) {
+        deleter.run();
+    }
+    EXPECT_FALSE(isStaleItemDeleterPending());
+    EXPECT_GT(store->getVBucket(vbid)->getPurgeSeqno(), 0);
+    EXPECT_TRUE(isInPass());
+}
+
+/*
+ * Test that the lag of the tombstone purger tasks is reported, from the
+ * start of a HTCleaner pass until the end of the pass, and from the stale
+ * items being marked until the StaleItemDeleter has deleted them.
+ */
+TEST_F(EphemeralTombstonePurgerTest, LagStats) {
+    auto stats = get_stat(nullptr);
+    EXPECT_EQ("0", stats.at("ep_ephemeral_ht_cleaner_lag_ms"));
+    EXPECT_EQ("0", stats.at("ep_ephemeral_stale_item_deleter_lag_ms"));
+
+    // Start a pass, which pauses part way.
+    auto& cleaner = getHTCleaner();
+    cleaner.run();
+    ASSERT_TRUE(isInPass()) << "HTCleaner should have paused";
+
+    const auto delay = std::chrono::milliseconds(10);
+    std::this_thread::sleep_for(delay);
+    stats = get_stat(nullptr);
+    EXPECT_GE(std::stoi(stats.at("ep_ephemeral_ht_cleaner_lag_ms")),
+              delay.count());
+    EXPECT_EQ("0", stats.at("ep_ephemeral_stale_item_deleter_lag_ms"));
+
+    // Once the pass completes the StaleItemDeleter is pending.
+    completePass();
+    std::this_thread::sleep_for(delay);
+    stats = get_stat(nullptr);
+    EXPECT_EQ("0", stats.at("ep_ephemeral_ht_cleaner_lag_ms"));
+    EXPECT_GE(std::stoi(stats.at("ep_ephemeral_stale_item_deleter_lag_ms")),
+              delay.count());
+
+    // Once the StaleItemDeleter completes its pass neither task lags.
+    auto& deleter = cleaner.getStaleItemDeleterTask();
+    for (int ii = 0; ii < numTombstones && isStaleItemDeleterPending(); ++ii) {
+        deleter.run();
+    }
+    EXPECT_EQ(numTombstones * 2, store->getVBucket(vbid)->getPurgeSeqno());
+    stats = get_stat(nullptr);
+    EXPECT_EQ("0", stats.at("ep_ephemeral_ht_cleaner_lag_ms"));
+    EXPECT_EQ("0", stats.at("ep_ephemeral_stale_item_deleter_lag_ms"));
+}
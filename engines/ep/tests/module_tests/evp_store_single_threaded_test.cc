@@ -21,6 +21,7 @@
 #include "../mock/mock_dcp.h"
 #include "../mock/mock_dcp_consumer.h"
 #include "../mock/mock_dcp_producer.h"
+#include "../mock/mock_ep_bucket.h"
 #include "../mock/mock_global_task.h"
 #include "../mock/mock_item_freq_decayer.h"
 #include "../mock/mock_stream.h"
@@ -52,6 +53,7 @@
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
+#include <limits>
 #include <thread>
 #include <engines/ep/src/ephemeral_vb.h>
 
@@ -2605,6 +2607,136 @@ TEST_P(STParameterizedBucketTest, enable_expiry_output) {
     producer.reset();
 }
 
+/**
+ * MockDcpMessageProducers for a connection with room for wantMoreLimit
+ * messages in its send buffer (per step).
+ */
+class SendBufferDcpMessageProducers : public MockDcpMessageProducers {
+public:
+    SendBufferDcpMessageProducers(EngineIface* engine)
+        : MockDcpMessageProducers(engine) {
+    }
+
+    bool want_more_messages() override {
+        return ++wantMoreCalls < wantMoreLimit;
+    }
+
+    size_t wantMoreCalls = 0;
+    size_t wantMoreLimit = std::numeric_limits<size_t>::max();
+};
+
+class DcpStepTest : public STParameterizedBucketTest {
+protected:
+    void SetUp() override {
+        STParameterizedBucketTest::SetUp();
+        setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+        producerCookie = create_mock_cookie(engine.get());
+        producer = createDcpProducer(producerCookie, IncludeDeleteTime::No);
+        producer->setNoopEnabled(false);
+        // Let engine->step() find the producer, as DCP_OPEN would
+        engine->storeEngineSpecific(producerCookie, producer.get());
+        producers =
+                std::make_unique<SendBufferDcpMessageProducers>(engine.get());
+    }
+
+    void TearDown() override {
+        engine->storeEngineSpecific(producerCookie, nullptr);
+        destroy_mock_cookie(producerCookie);
+        producer->closeAllStreams();
+        producer->cancelCheckpointCreatorTask();
+        producer.reset();
+        producers.reset();
+        STParameterizedBucketTest::TearDown();
+    }
+
+    /// Store the items, and have the stream fetch them from the checkpoint
+    void storeAndStream(size_t numItems) {
+        for (size_t ii = 0; ii < numItems; ++ii) {
+            store_item(vbid, makeStoredDocKey("key" + std::to_string(ii)), "v");
+        }
+        createDcpStream(*producer);
+        runCheckpointProcessor(*producer, *producers);
+    }
+
+    const void* producerCookie = nullptr;
+    std::shared_ptr<MockDcpProducer> producer;
+    std::unique_ptr<SendBufferDcpMessageProducers> producers;
+};
+
+// Test that a single step adds all the messages the producer has, and
+// stops once the producer would block.
+TEST_P(DcpStepTest, SeveralMessagesPerStep) {
+    const size_t numItems = 10;
+    storeAndStream(numItems);
+
+    EXPECT_EQ(ENGINE_EWOULDBLOCK,
+              engine->step(producerCookie, producers.get()));
+    EXPECT_EQ(numItems, producer->getItemsSent());
+    EXPECT_EQ(cb::mcbp::ClientOpcode::DcpMutation, producers->last_op);
+    EXPECT_EQ("key9", producers->last_key);
+    // Asked after each message (the snapshot marker and the mutations)
+    EXPECT_EQ(numItems + 1, producers->wantMoreCalls);
+}
+
+// Test that a step yields once it has added its maximum number of messages,
+// even though the connection wants more.
+TEST_P(DcpStepTest, YieldsAtMessageLimit) {
+    const size_t numItems = 1000;
+    storeAndStream(numItems);
+
+    EXPECT_EQ(ENGINE_SUCCESS, engine->step(producerCookie, producers.get()));
+    const auto sent = producer->getItemsSent();
+    EXPECT_GT(sent, 1);
+    EXPECT_LT(sent, numItems);
+    // The connection isn't asked after the last message of the step; the
+    // step had sent the snapshot marker and 'sent' mutations.
+    EXPECT_EQ(sent, producers->wantMoreCalls);
+
+    // The following steps carry on from there
+    ENGINE_ERROR_CODE ret;
+    size_t steps = 1;
+    while ((ret = engine->step(producerCookie, producers.get())) ==
+                   ENGINE_SUCCESS &&
+           steps < numItems) {
+        ++steps;
+    }
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, ret);
+    EXPECT_EQ(numItems, producer->getItemsSent());
+    EXPECT_LT(steps, numItems);
+}
+
+// Test that a step stops once the connection's send buffer is full.
+TEST_P(DcpStepTest, StopsOnFullSendBuffer) {
+    const size_t numItems = 10;
+    storeAndStream(numItems);
+
+    // Room for the snapshot marker and two mutations
+    producers->wantMoreLimit = 3;
+    EXPECT_EQ(ENGINE_SUCCESS, engine->step(producerCookie, producers.get()));
+    EXPECT_EQ(2, producer->getItemsSent());
+    EXPECT_EQ("key1", producers->last_key);
+
+    // A message which doesn't fit is kept and sent by the next step
+    producers->setMutationStatus(ENGINE_E2BIG);
+    producers->wantMoreCalls = 0;
+    EXPECT_EQ(ENGINE_E2BIG, engine->step(producerCookie, producers.get()));
+    EXPECT_EQ(2, producer->getItemsSent());
+    EXPECT_EQ(0, producers->wantMoreCalls);
+
+    producers->setMutationStatus(ENGINE_SUCCESS);
+    producers->wantMoreLimit = std::numeric_limits<size_t>::max();
+    EXPECT_EQ(ENGINE_EWOULDBLOCK,
+              engine->step(producerCookie, producers.get()));
+    EXPECT_EQ(numItems, producer->getItemsSent());
+    EXPECT_EQ("key9", producers->last_key);
+}
+
+INSTANTIATE_TEST_CASE_P(PersistentAndEphemeral,
+                        DcpStepTest,
+                        STParameterizedBucketTest::allConfigValues(),
+                        STParameterizedBucketTest::PrintToStringParamName);
+
 TEST_P(XattrSystemUserTest, MB_29040) {
     auto& kvbucket = *engine->getKVBucket();
     setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
@@ -3892,6 +4024,76 @@ TEST_F(SingleThreadedEPBucketTest, testValidTombstonePurgeOnRetainErroneousTombs
     EXPECT_EQ(2, store->getVBucket(vbid)->getPurgeSeqno());
 }
 
+static CompactionConfig makeCompactionConfig(Vbid vbid) {
+    CompactionConfig config;
+    config.purge_before_ts = 0;
+    config.purge_before_seq = 0;
+    config.drop_deletes = false;
+    config.db_file_id = vbid;
+    return config;
+}
+
+// When a compaction completes, the snoozed compaction of the most fragmented
+// vBucket is run next.
+TEST_F(SingleThreadedEPBucketTest, CompactionPrioritisedByFragmentation) {
+    for (uint16_t id = 1; id <= 3; ++id) {
+        setVBucketStateAndRunPersistTask(Vbid(id), vbucket_state_active);
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  store->scheduleCompaction(
+                          Vbid(id), makeCompactionConfig(Vbid(id)), nullptr));
+    }
+
+    // Make vb:3 the most fragmented, and leave only vb:1 ready to run.
+    auto& tasks =
+            dynamic_cast<MockEPBucket&>(*store).getCompactionTasks();
+    ASSERT_EQ(3, tasks.size());
+    const size_t fragmentation[] = {0, 10, 50};
+    size_t ii = 0;
+    for (auto& entry : tasks) {
+        entry.fragmentation = fragmentation[ii];
+        if (ii++ > 0) {
+            ExecutorPool::get()->snooze(entry.task->getId(), 60);
+        }
+    }
+
+    auto& writerQueue = *task_executor->getLpTaskQ()[WRITER_TASK_IDX];
+    runNextTask(writerQueue, "Compact DB file 1");
+    runNextTask(writerQueue, "Compact DB file 3");
+    runNextTask(writerQueue, "Compact DB file 2");
+    EXPECT_TRUE(tasks.empty());
+}
+
+// Two compactions of the same vBucket never run at the same time, whichever
+// of them starts first.
+TEST_F(SingleThreadedEPBucketTest, CompactionOfSameVBucketSerialised) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    auto& bucket = dynamic_cast<MockEPBucket&>(*store);
+    const auto config = makeCompactionConfig(vbid);
+    ASSERT_EQ(ENGINE_SUCCESS,
+              store->scheduleCompaction(vbid, config, nullptr));
+    ASSERT_EQ(ENGINE_SUCCESS,
+              store->scheduleCompaction(vbid, config, nullptr));
+    auto& tasks = bucket.getCompactionTasks();
+    ASSERT_EQ(2, tasks.size());
+    const auto first = tasks.front().task->getId();
+    const auto second = tasks.back().task->getId();
+
+    // The second task starts first (e.g. woken by another compaction
+    // completing); the first must wait for it.
+    EXPECT_TRUE(bucket.beginCompaction(vbid, second));
+    EXPECT_FALSE(bucket.beginCompaction(vbid, first));
+    EXPECT_FALSE(tasks.front().running);
+    EXPECT_TRUE(tasks.back().running);
+
+    // Only the entry of the completed compaction is removed, after which the
+    // first task may go ahead.
+    EXPECT_FALSE(bucket.doCompact(config, 0, nullptr, second));
+    ASSERT_EQ(1, tasks.size());
+    EXPECT_EQ(first, tasks.front().task->getId());
+    EXPECT_TRUE(bucket.beginCompaction(vbid, first));
+    EXPECT_TRUE(tasks.front().running);
+}
+
 // MB-34850: Check that a consumer correctly handles (and ignores) stream-level
 // messages (Mutation/Deletion/Prepare/Commit/Abort/...) received after
 // CloseStream response but *before* the Producer sends STREAM_END.
@@ -4203,6 +4405,59 @@ TEST_P(STParameterizedBucketTest, MB_34380) {
     EXPECT_NO_THROW(vb->getShard()->getRWUnderlying()->getDbFileInfo(vbid));
 }
 
+// Test that while a BgFetcher::DeferWakeup is in scope background fetches
+// are queued as usual, but the fetcher task is only woken (once) when it goes
+// out of scope, so all of the misses are read by a single fetch.
+TEST_F(SingleThreadedEPBucketTest, BgFetcherDeferWakeup) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    const auto key1 = makeStoredDocKey("key1");
+    const auto key2 = makeStoredDocKey("key2");
+    store_item(vbid, key1, "value1");
+    store_item(vbid, key2, "value2");
+    flush_vbucket_to_disk(vbid, 2);
+    evict_key(vbid, key1);
+    evict_key(vbid, key2);
+
+    auto isFetcherWoken = [this]() {
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& entry : task_executor->getTaskLocator()) {
+            const auto& task = entry.second.first;
+            if (task->getTaskId() == TaskId::MultiBGFetcherTask &&
+                task->getWaketime() <= now) {
+                return true;
+            }
+        }
+        return false;
+    };
+    ASSERT_FALSE(isFetcherWoken());
+
+    const auto options =
+            static_cast<get_options_t>(QUEUE_BG_FETCH | HONOR_STATES);
+    auto& stats = engine->getEpStats();
+    {
+        BgFetcher::DeferWakeup deferWakeup;
+        EXPECT_EQ(ENGINE_EWOULDBLOCK,
+                  store->get(key1, vbid, cookie, options).getStatus());
+        {
+            // A nested instance defers to the outermost one
+            BgFetcher::DeferWakeup nested;
+            EXPECT_EQ(ENGINE_EWOULDBLOCK,
+                      store->get(key2, vbid, cookie, options).getStatus());
+        }
+        EXPECT_EQ(2, stats.numRemainingBgItems.load());
+        EXPECT_FALSE(isFetcherWoken());
+    }
+    EXPECT_TRUE(isFetcherWoken());
+
+    // Both misses are read by the one run of the task
+    runBGFetcherTask();
+    EXPECT_EQ(0, stats.numRemainingBgItems.load());
+    EXPECT_EQ(ENGINE_SUCCESS,
+              store->get(key1, vbid, cookie, options).getStatus());
+    EXPECT_EQ(ENGINE_SUCCESS,
+              store->get(key2, vbid, cookie, options).getStatus());
+}
+
 INSTANTIATE_TEST_CASE_P(XattrSystemUserTest,
                         XattrSystemUserTest,
                         ::testing::Bool(), );
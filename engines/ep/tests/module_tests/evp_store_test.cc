@@ -29,6 +29,7 @@
 #include "../mock/mock_dcp_producer.h"
 #include "bgfetcher.h"
 #include "checkpoint_remover.h"
+#include "cuckoo_filter.h"
 #include "dcp/dcpconnmap.h"
 #include "ep_bucket.h"
 #include "flusher.h"
@@ -1150,6 +1151,67 @@ TEST_F(EPStoreFullEvictionNoBloomFIlterTest, MB_29816) {
     ASSERT_EQ(ENGINE_KEY_ENOENT, gv.getStatus());
 }
 
+// Run in FE with a cuckoo filter, which removes keys fetched back into memory
+class EPStoreFullEvictionCuckooFilterTest : public EPBucketTest {
+    void SetUp() override {
+        config_string += std::string{"item_eviction_policy=full_eviction;"
+                                     "bfilter_type=cuckoo"};
+        EPBucketTest::SetUp();
+
+        // Have all the objects, activate vBucket zero so we can store data.
+        store->setVBucketState(vbid, vbucket_state_active);
+    }
+};
+
+// Check that an evicted key is removed from the filter once it is fetched
+// back into memory.
+TEST_F(EPStoreFullEvictionCuckooFilterTest, RemoveFetchedKey) {
+    auto key = makeStoredDocKey("key");
+    store_item(vbid, key, "value");
+    flush_vbucket_to_disk(vbid);
+    auto vb = store->getVBucket(vbid);
+    ASSERT_EQ(0, vb->getNumOfKeysInFilter());
+
+    evict_key(vbid, key);
+    EXPECT_EQ(1, vb->getNumOfKeysInFilter());
+    EXPECT_TRUE(vb->maybeKeyExistsInFilter(key));
+
+    get_options_t options = static_cast<get_options_t>(
+            QUEUE_BG_FETCH | HONOR_STATES | TRACK_REFERENCE | DELETE_TEMP |
+            HIDE_LOCKED_CAS | TRACK_STATISTICS);
+    auto gv = store->get(key, vbid, cookie, options);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+    runBGFetcherTask();
+    EXPECT_EQ(0, vb->getNumOfKeysInFilter());
+
+    gv = store->get(key, vbid, cookie, options);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+
+    // Evicted again, the key is back in the filter.
+    evict_key(vbid, key);
+    EXPECT_EQ(1, vb->getNumOfKeysInFilter());
+}
+
+// Check that the saved filter also has the keys which are in memory.
+TEST_F(EPStoreFullEvictionCuckooFilterTest, SnapshotFilter) {
+    auto key = makeStoredDocKey("key");
+    store_item(vbid, key, "value");
+    auto vb = store->getVBucket(vbid);
+
+    // Not saved until every item is persisted.
+    EXPECT_TRUE(vb->snapshotFilter().empty());
+
+    flush_vbucket_to_disk(vbid);
+    const auto data = vb->snapshotFilter();
+    auto filter = CuckooFilter::deserialize(data, vb->getPersistenceSeqno());
+    ASSERT_TRUE(filter);
+    EXPECT_TRUE(filter->maybeKeyExists(key));
+    EXPECT_FALSE(filter->maybeKeyExists(makeStoredDocKey("missing")));
+
+    // The vBucket already has a filter.
+    EXPECT_FALSE(vb->restoreFilter(data, vb->getPersistenceSeqno()));
+}
+
 struct PrintToStringCombinedName {
     std::string operator()(
             const ::testing::TestParamInfo<::testing::tuple<std::string, bool>>&
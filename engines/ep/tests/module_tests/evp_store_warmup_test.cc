@@ -20,6 +20,7 @@
 #include "../mock/mock_ep_bucket.h"
 #include "../mock/mock_item_freq_decayer.h"
 #include "../mock/mock_synchronous_ep_engine.h"
+#include "access_scanner.h"
 #include "checkpoint_manager.h"
 #include "dcp/response.h"
 #include "durability/durability_monitor.h"
@@ -29,11 +30,14 @@
 #include "evp_store_single_threaded_test.h"
 #include "failover-table.h"
 #include "kvstore.h"
+#include "mapped_access_log.h"
 #include "programs/engine_testapp/mock_cookie.h"
 #include "test_helpers.h"
 #include "vbucket_state.h"
 #include "warmup.h"
 
+#include <platform/dirutils.h>
+
 class WarmupTest : public SingleThreadedKVBucketTest {
 public:
     void MB_31450(bool newCheckpoint);
@@ -150,6 +154,40 @@ TEST_F(WarmupTest, fetchDocInDifferentCompressionModes) {
               info1.datatype);
 }
 
+// Test that warmup loads every vBucket when the data loading phases are split
+// into per-vBucket tasks, and that per-vBucket progress is reported.
+TEST_F(WarmupTest, VBucketConcurrency) {
+    const std::vector<Vbid> vbids{Vbid(0), Vbid(1), Vbid(2)};
+    for (const auto vb : vbids) {
+        setVBucketStateAndRunPersistTask(vb, vbucket_state_active);
+        store_item(vb, makeStoredDocKey("key"), "value");
+        flush_vbucket_to_disk(vb);
+    }
+
+    resetEngineAndWarmup("warmup_vbucket_concurrency=2");
+
+    for (const auto vb : vbids) {
+        auto gv = store->get(makeStoredDocKey("key"), vb, nullptr, {});
+        EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus()) << vb;
+    }
+
+    std::map<std::string, std::string> stats;
+    store->getWarmup()->addStats(
+            [&stats](cb::const_char_buffer key,
+                     cb::const_char_buffer value,
+                     gsl::not_null<const void*> cookie) {
+                stats[std::string(key.data(), key.size())] =
+                        std::string(value.data(), value.size());
+            },
+            this);
+    EXPECT_EQ("3", stats["ep_warmup_vb_scan_done"]);
+    EXPECT_EQ("0", stats["ep_warmup_vb_scan_pending"]);
+    for (const auto vb : vbids) {
+        EXPECT_EQ("done",
+                  stats["ep_warmup_vb_" + std::to_string(vb.get()) + "_scan"]);
+    }
+}
+
 TEST_F(WarmupTest, mightContainXattrs) {
     setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
 
@@ -536,6 +574,110 @@ TEST_F(WarmupTest, MB_35599) {
     EXPECT_EQ(0, memcmp("value", gv.item->getData(), 5));
 }
 
+// Check that a mapped access log written by the AccessScanner is used by the
+// next warmup to load the values of the keys it lists.
+TEST_F(WarmupTest, MappedAccessLogRoundTrip) {
+    const std::string alogConfig = "alog_path=" + std::string(test_dbname) +
+                                   "/access.log;alog_format=mapped;"
+                                   "access_scanner_enabled=false;"
+                                   "max_num_shards=1";
+    resetEngineAndWarmup(alogConfig);
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+    // Evict every other key, so only the resident half is logged.
+    const size_t numItems = 10;
+    std::vector<StoredDocKey> accessed;
+    std::vector<StoredDocKey> evicted;
+    for (size_t ii = 0; ii < numItems; ++ii) {
+        auto key = makeStoredDocKey("key" + std::to_string(ii));
+        store_item(vbid, key, "value");
+        (ii % 2 ? evicted : accessed).push_back(key);
+    }
+    flush_vbucket_to_disk(vbid, numItems);
+    for (const auto& key : evicted) {
+        evict_key(vbid, key);
+    }
+
+    auto& stats = engine->getEpStats();
+    AccessScanner scanner(
+            *store, engine->getConfiguration(), stats, 1000 /*sleeptime*/);
+    scanner.run();
+    auto& auxioQueue = *task_executor->getLpTaskQ()[AUXIO_TASK_IDX];
+    runNextTask(auxioQueue, "Item Access Scanner on vb:0");
+    ASSERT_EQ(1, stats.alogRuns);
+    ASSERT_EQ(accessed.size(), stats.alogNumItems);
+
+    const auto alog = std::string(test_dbname) + "/access.log.0";
+    ASSERT_TRUE(MappedAccessLog::isMappedAccessLog(alog));
+
+    // Warm up until the access log has been loaded; the logged keys are then
+    // resident, while the rest are yet to be loaded.
+    resetEngineAndEnableWarmup(alogConfig);
+    auto& readerQueue = *task_executor->getLpTaskQ()[READER_TASK_IDX];
+    bool loadedAccessLog = false;
+    while (store->isWarmingUp()) {
+        const auto state = store->getWarmup()->getWarmupState();
+        if (state == WarmupState::State::LoadingAccessLog) {
+            loadedAccessLog = true;
+        } else if (loadedAccessLog) {
+            break;
+        }
+        runNextTask(readerQueue);
+    }
+    ASSERT_TRUE(loadedAccessLog);
+    EXPECT_EQ(accessed.size(), engine->getEpStats().warmedUpValues);
+
+    auto vb = store->getVBucket(vbid);
+    for (const auto& key : accessed) {
+        auto* v = vb->ht.findForRead(key).storedValue;
+        ASSERT_TRUE(v) << key;
+        EXPECT_TRUE(v->isResident()) << key;
+    }
+    for (const auto& key : evicted) {
+        auto* v = vb->ht.findForRead(key).storedValue;
+        ASSERT_TRUE(v) << key;
+        EXPECT_FALSE(v->isResident()) << key;
+    }
+
+    runReadersUntilWarmedUp();
+}
+
+// Check that the cuckoo filter of a vBucket is saved on a clean shutdown and
+// restored (and the saved file removed) by warmup.
+TEST_F(WarmupTest, CuckooFilterSavedAndRestored) {
+    const std::string filterConfig =
+            "item_eviction_policy=full_eviction;bfilter_type=cuckoo";
+    resetEngineAndWarmup(filterConfig);
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+    // Evict half of the keys; the saved filter has the resident ones too.
+    const size_t numItems = 10;
+    std::vector<StoredDocKey> keys;
+    for (size_t ii = 0; ii < numItems; ++ii) {
+        keys.push_back(makeStoredDocKey("key" + std::to_string(ii)));
+        store_item(vbid, keys.back(), "value");
+    }
+    flush_vbucket_to_disk(vbid, numItems);
+    for (size_t ii = 0; ii < numItems; ii += 2) {
+        evict_key(vbid, keys[ii]);
+    }
+    ASSERT_EQ(numItems / 2, store->getVBucket(vbid)->getNumOfKeysInFilter());
+
+    const auto filterFile =
+            std::string(test_dbname) + "/" + std::to_string(vbid.get()) +
+            ".cuckoo_filter";
+    resetEngineAndEnableWarmup(filterConfig);
+    EXPECT_TRUE(cb::io::isFile(filterFile));
+
+    runReadersUntilWarmedUp();
+    EXPECT_FALSE(cb::io::isFile(filterFile));
+    auto vb = store->getVBucket(vbid);
+    EXPECT_EQ(numItems, vb->getNumOfKeysInFilter());
+    for (const auto& key : keys) {
+        EXPECT_TRUE(vb->maybeKeyExistsInFilter(key)) << key;
+    }
+}
+
 // Check that two state changes don't de-duplicate, that replica is the state
 // which lands in persistence. Note the addition of the key helped find an issue
 // where the flusher re-ordered the flush batch, allowing the older set-vbstate
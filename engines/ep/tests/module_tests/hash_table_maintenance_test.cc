@@ -0,0 +1,196 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the HashTableMaintenanceTask.
+ */
+
+#include "hash_table_maintenance.h"
+#include "compression_dictionary.h"
+#include "evp_store_single_threaded_test.h"
+#include "kv_bucket.h"
+#include "test_helpers.h"
+#include "vbucket.h"
+
+#include <folly/portability/GTest.h>
+
+using ActionType = HashTableMaintenanceTask::ActionType;
+
+/**
+ * HashTableMaintenanceTask whose compressor pauses every chunk (after the
+ * first few items), while the decayer never runs out of time.
+ */
+class MockHashTableMaintenanceTask : public HashTableMaintenanceTask {
+public:
+    MockHashTableMaintenanceTask(EventuallyPersistentEngine* e,
+                                 EPStats& stats)
+        : HashTableMaintenanceTask(e, stats, false /*defragment*/) {
+    }
+
+protected:
+    std::chrono::milliseconds getChunkDuration(ActionType type) const override {
+        if (type == ActionType::Compress) {
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::hours(1);
+    }
+};
+
+class HashTableMaintenanceTest : public SingleThreadedKVBucketTest {
+protected:
+    void SetUp() override {
+        config_string +=
+                "compression_mode=active;item_compressor_interval=0;"
+                "hash_table_fused_scan=true;item_freq_decayer_percent=50";
+        SingleThreadedKVBucketTest::SetUp();
+        setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+        const std::string value(
+                "{\"product\": \"car\",\"price\": \"100\"},"
+                "{\"product\": \"bus\",\"price\": \"1000\"},"
+                "{\"product\": \"Train\",\"price\": \"100000\"}");
+        auto vb = store->getVBucket(vbid);
+        for (size_t ii = 0; ii < numItems; ++ii) {
+            auto key = makeStoredDocKey("key" + std::to_string(ii));
+            store_item(vbid, key, value);
+            auto result = vb->ht.findForWrite(key);
+            ASSERT_TRUE(result.storedValue);
+            result.storedValue->setFreqCounterValue(initialFreqCount);
+        }
+
+        task = std::make_unique<MockHashTableMaintenanceTask>(
+                engine.get(), engine->getEpStats());
+    }
+
+    void TearDown() override {
+        task.reset();
+        SingleThreadedKVBucketTest::TearDown();
+    }
+
+    /// Check that every item was decayed exactly once and compressed
+    void checkItemsVisitedOnce() {
+        auto vb = store->getVBucket(vbid);
+        for (size_t ii = 0; ii < numItems; ++ii) {
+            auto key = makeStoredDocKey("key" + std::to_string(ii));
+            auto* v = vb->ht.findForWrite(key).storedValue;
+            ASSERT_TRUE(v);
+            EXPECT_EQ(initialFreqCount / 2, v->getFreqCounterValue()) << key;
+            EXPECT_TRUE(mcbp::datatype::is_snappy(v->getDatatype())) << key;
+        }
+    }
+
+    const size_t numItems = 1000;
+    const uint8_t initialFreqCount = 200;
+    std::unique_ptr<MockHashTableMaintenanceTask> task;
+};
+
+// Test that actions which start their pass together share every chunk, and
+// each sees every item once.
+TEST_F(HashTableMaintenanceTest, FusedActionsVisitEachItemOnce) {
+    auto& stats = engine->getEpStats();
+    task->wakeupDecayer();
+
+    size_t chunks = 0;
+    do {
+        task->run();
+        ++chunks;
+        // Both actions are visited by every chunk, so are at the same place
+        ASSERT_EQ(task->isPassInProgress(ActionType::Compress),
+                  task->isPassInProgress(ActionType::Decay));
+    } while (task->isPassInProgress(ActionType::Compress) && chunks < 1000);
+
+    EXPECT_GT(chunks, 1) << "Compressor should pause the shared pass";
+    EXPECT_EQ(chunks, stats.freqDecayerRuns.load());
+    EXPECT_EQ(numItems, stats.compressorNumVisited.load());
+    EXPECT_EQ(numItems, stats.compressorNumCompressed.load());
+    checkItemsVisitedOnce();
+}
+
+// Test that actions on different schedules keep their own position, so each
+// still sees every item once per pass.
+TEST_F(HashTableMaintenanceTest, ActionsOnDifferentSchedulesVisitEachItemOnce) {
+    auto& stats = engine->getEpStats();
+
+    // Only the compressor is due; it pauses part way through the pass.
+    task->run();
+    ASSERT_TRUE(task->isPassInProgress(ActionType::Compress));
+    ASSERT_FALSE(task->isPassInProgress(ActionType::Decay));
+    ASSERT_LT(stats.compressorNumVisited.load(), numItems);
+
+    // The decayer starts its pass from the beginning, while the compressor
+    // resumes from where it paused; the decayer isn't held up by the
+    // compressor's deadline.
+    task->wakeupDecayer();
+    task->run();
+    EXPECT_EQ(1, stats.freqDecayerRuns.load());
+    EXPECT_FALSE(task->isPassInProgress(ActionType::Decay));
+
+    size_t chunks = 2;
+    while (task->isPassInProgress(ActionType::Compress) && chunks < 1000) {
+        task->run();
+        ++chunks;
+    }
+    EXPECT_FALSE(task->isPassInProgress(ActionType::Compress));
+
+    // The decay pass is complete; it isn't run again until requested.
+    EXPECT_EQ(1, stats.freqDecayerRuns.load());
+    EXPECT_EQ(numItems, stats.compressorNumVisited.load());
+    EXPECT_EQ(numItems, stats.compressorNumCompressed.load());
+    checkItemsVisitedOnce();
+}
+
+// Test that the dictionaries sampled by a compressor pass are trained by a
+// task of their own, rather than holding up the maintenance task.
+TEST_F(HashTableMaintenanceTest, DictionariesTrainedByOwnTask) {
+    if (!CompressionDictionary::isSupported()) {
+        GTEST_SKIP() << "Built without Zstandard";
+    }
+    auto& stats = engine->getEpStats();
+    engine->getConfiguration().setItemCompressorAlgorithm("zstd_dictionary");
+    auto* dictionaries = store->getCompressionDictionaries();
+    ASSERT_TRUE(dictionaries);
+
+    auto runCompressorPass = [this]() {
+        size_t chunks = 0;
+        do {
+            task->run();
+            ++chunks;
+        } while (task->isPassInProgress(ActionType::Compress) &&
+                 chunks < 1000);
+        ASSERT_FALSE(task->isPassInProgress(ActionType::Compress));
+    };
+
+    // The first pass only samples the documents, and leaves the training to
+    // the CompressionDictionaryTrainerTask.
+    runCompressorPass();
+    EXPECT_EQ(0, stats.compressorNumCompressed.load());
+    EXPECT_EQ(0, dictionaries->getNumDictionaries());
+    EXPECT_GT(dictionaries->getSampleMemory(), 0);
+
+    auto& lpNonioQ = *task_executor->getLpTaskQ()[NONIO_TASK_IDX];
+    runNextTask(lpNonioQ, "Training compression dictionaries");
+    EXPECT_EQ(1, dictionaries->getNumDictionaries());
+    EXPECT_EQ(0, dictionaries->getSampleMemory());
+
+    // The next pass compresses the documents with the dictionary.
+    runCompressorPass();
+    EXPECT_EQ(numItems, stats.compressorNumCompressed.load());
+    auto vb = store->getVBucket(vbid);
+    auto* v = vb->ht.findForWrite(makeStoredDocKey("key0")).storedValue;
+    ASSERT_TRUE(v);
+    EXPECT_TRUE(v->isDictionaryCompressed());
+}
@@ -33,6 +33,7 @@
 #include <algorithm>
 #include <limits>
 #include <string>
+#include <thread>
 
 EPStats global_stats;
 
@@ -770,6 +771,68 @@ TEST_P(HashTableStatsTest, PreparedSyncDelete) {
     EXPECT_TRUE(del(ht, key));
 }
 
+// Ejecting an item lowers the memory stats by exactly the bytes freed - the
+// Blob for value eviction, the whole StoredValue and Blob for full eviction.
+TEST_P(HashTableStatsTest, EjectReducesMemoryByFreedBytes) {
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    const auto* sv = ht.findForRead(key).storedValue;
+    ASSERT_TRUE(sv);
+    const auto objectSize = sv->getObjectSize();
+    const auto valueSize = sv->valuelen();
+    ASSERT_EQ(objectSize + valueSize, ht.getItemMemory());
+    const auto currentSize = stats.getCurrentSize();
+
+    addAndEjectItem();
+
+    if (evictionPolicy == EvictionPolicy::Value) {
+        EXPECT_EQ(objectSize, ht.getItemMemory());
+        EXPECT_EQ(objectSize, ht.getMetadataMemory());
+        EXPECT_EQ(currentSize, stats.getCurrentSize());
+        del(ht, key);
+    } else {
+        EXPECT_EQ(0, ht.getItemMemory());
+        EXPECT_EQ(0, ht.getMetadataMemory());
+        EXPECT_EQ(currentSize - objectSize, stats.getCurrentSize());
+    }
+}
+
+// An inline value is part of the StoredValue, so ejecting just the value
+// would free nothing; value eviction leaves it alone and full eviction frees
+// the whole StoredValue (inline area included).
+TEST_P(HashTableStatsTest, EjectInlineValue) {
+    HashTable inlineHt(
+            stats, std::make_unique<StoredValueFactory>(stats, 16), 5, 1);
+    Item small(key, 0, 0, "value", strlen("value"));
+    small.setBySeqno(10);
+    ASSERT_EQ(MutationStatus::WasClean, inlineHt.set(small));
+
+    auto result = inlineHt.findForWrite(key);
+    ASSERT_TRUE(result.storedValue);
+    ASSERT_TRUE(result.storedValue->hasInlineValue());
+    const auto objectSize = result.storedValue->getObjectSize();
+    // The whole inline area is counted once, as metadata.
+    EXPECT_EQ(objectSize, inlineHt.getItemMemory());
+    EXPECT_EQ(objectSize, inlineHt.getMetadataMemory());
+    EXPECT_EQ(objectSize, inlineHt.getUncompressedItemMemory());
+    const auto currentSize = stats.getCurrentSize();
+
+    result.storedValue->markClean();
+    if (evictionPolicy == EvictionPolicy::Value) {
+        EXPECT_FALSE(inlineHt.unlocked_ejectItem(
+                result.lock, result.storedValue, evictionPolicy));
+        EXPECT_TRUE(result.storedValue->isResident());
+        EXPECT_EQ(objectSize, inlineHt.getItemMemory());
+        EXPECT_EQ(currentSize, stats.getCurrentSize());
+        inlineHt.unlocked_del(result.lock, result.storedValue);
+    } else {
+        EXPECT_TRUE(inlineHt.unlocked_ejectItem(
+                result.lock, result.storedValue, evictionPolicy));
+        EXPECT_EQ(0, inlineHt.getItemMemory());
+        EXPECT_EQ(currentSize - objectSize, stats.getCurrentSize());
+    }
+    EXPECT_EQ(0, inlineHt.getMetadataMemory());
+}
+
 INSTANTIATE_TEST_CASE_P(
         ValueAndFullEviction,
         HashTableStatsTest,
@@ -1051,6 +1114,95 @@ TEST_F(HashTableTest, LockAfterDelete) {
     EXPECT_FALSE(sv->isLocked(1985));
 }
 
+// Check that an optimistic read finds the same StoredValues as findForRead.
+TEST_F(HashTableTest, FindForReadOptimistic) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    auto key = makeStoredDocKey("key");
+    store(ht, key);
+
+    {
+        auto res = ht.findForReadOptimistic(key);
+        ASSERT_TRUE(res.lock.owns_lock());
+        ASSERT_TRUE(res.storedValue);
+        EXPECT_EQ(key, res.storedValue->getKey());
+
+        // Optimistic readers don't block each other.
+        auto res2 = ht.findForReadOptimistic(key);
+        ASSERT_TRUE(res2.lock.owns_lock());
+        EXPECT_EQ(res.storedValue, res2.storedValue);
+    }
+
+    auto missing = ht.findForReadOptimistic(makeStoredDocKey("missing"));
+    EXPECT_TRUE(missing.lock.owns_lock());
+    EXPECT_FALSE(missing.storedValue);
+    missing.lock.unlock();
+
+    {
+        auto toDelete = ht.findForWrite(key);
+        ht.unlocked_softDelete(toDelete.lock,
+                               *toDelete.storedValue,
+                               /* onlyMarkDeleted */ false,
+                               DeleteSource::Explicit);
+    }
+    EXPECT_FALSE(ht.findForReadOptimistic(key).storedValue);
+    EXPECT_TRUE(ht.findForReadOptimistic(key, WantsDeleted::Yes).storedValue);
+}
+
+// Check that an optimistic read backs off while the hash bucket is locked.
+TEST_F(HashTableTest, FindForReadOptimisticLocked) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    auto key = makeStoredDocKey("key");
+    store(ht, key);
+
+    {
+        auto hbl = ht.getLockedBucket(key);
+        auto res = ht.findForReadOptimistic(key);
+        EXPECT_FALSE(res.lock.owns_lock());
+        EXPECT_FALSE(res.storedValue);
+    }
+
+    // Once unlocked it can read again.
+    EXPECT_TRUE(ht.findForReadOptimistic(key).storedValue);
+}
+
+// Check that the lock of a hash bucket waits for an optimistic read to end.
+TEST_F(HashTableTest, LockWaitsForOptimisticRead) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    auto key = makeStoredDocKey("key");
+    store(ht, key);
+
+    auto res = ht.findForReadOptimistic(key);
+    ASSERT_TRUE(res.lock.owns_lock());
+
+    std::atomic<bool> locked{false};
+    std::thread writer([&ht, &key, &locked]() {
+        auto hbl = ht.getLockedBucket(key);
+        locked = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(locked);
+
+    res.lock.unlock();
+    writer.join();
+    EXPECT_TRUE(locked);
+}
+
+// Check that tracking an optimistic read updates the frequency counter.
+TEST_F(HashTableTest, TrackOptimisticRead) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    auto key = makeStoredDocKey("key");
+    store(ht, key);
+    ht.findForWrite(key).storedValue->setFreqCounterValue(0);
+
+    auto res = ht.findForReadOptimistic(key);
+    ASSERT_TRUE(res.lock.owns_lock());
+    ht.trackOptimisticRead(key, res);
+    EXPECT_FALSE(res.lock.owns_lock());
+
+    // A counter of zero is always incremented.
+    EXPECT_EQ(1, ht.findForWrite(key).storedValue->getFreqCounterValue());
+}
+
 // Check that pauseResumeVisit calls with the correct Hash bucket.
 TEST_F(HashTableTest, PauseResumeHashBucket) {
     // Two buckets, one lock.
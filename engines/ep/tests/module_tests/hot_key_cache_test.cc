@@ -0,0 +1,127 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "hot_key_cache.h"
+#include "item.h"
+#include "test_helpers.h"
+
+#include <folly/portability/GTest.h>
+
+/*
+ * Unit tests for the HotKeyCache class.
+ */
+
+class HotKeyCacheTest : public ::testing::Test {
+protected:
+    /// Read the key until it becomes hot; @return the number of reads
+    size_t readUntilHot(const DocKey& key, uint64_t revision) {
+        for (size_t ii = 1; ii <= 1000; ++ii) {
+            auto lookup = cache.get(vbid, key, revision, now);
+            EXPECT_FALSE(lookup.item);
+            if (lookup.publish) {
+                return ii;
+            }
+        }
+        return 0;
+    }
+
+    const Vbid vbid{0};
+    const time_t now = 1000;
+    const StoredDocKey key = makeStoredDocKey("hot");
+    // A single shard, so the test doesn't depend on the core it runs on.
+    HotKeyCache cache{2 /*maxKeys*/, 4 /*threshold*/, 1 /*numShards*/};
+};
+
+TEST_F(HotKeyCacheTest, HotAfterThreshold) {
+    EXPECT_EQ(4 * HotKeyCache::SampleInterval, readUntilHot(key, 1));
+    EXPECT_EQ(0u, cache.getNumSnapshots());
+
+    // Every read is told to publish until a snapshot is published.
+    EXPECT_TRUE(cache.get(vbid, key, 1, now).publish);
+}
+
+TEST_F(HotKeyCacheTest, SnapshotServedWhileRevisionUnchanged) {
+    ASSERT_NE(0u, readUntilHot(key, 1));
+    auto item = make_item(vbid, key, "value");
+    item.setBySeqno(10);
+    cache.publish(vbid, item, 1);
+    EXPECT_EQ(1u, cache.getNumSnapshots());
+
+    auto lookup = cache.get(vbid, key, 1, now);
+    ASSERT_TRUE(lookup.item);
+    EXPECT_FALSE(lookup.publish);
+    EXPECT_EQ(key, lookup.item->getKey());
+    EXPECT_EQ(10, lookup.item->getBySeqno());
+    EXPECT_EQ("value", lookup.item->getValue()->to_s());
+    // The snapshot has its own copy of the value
+    EXPECT_NE(item.getValue().get(), lookup.item->getValue().get());
+    EXPECT_EQ(1u, cache.getNumHits());
+
+    // Another vBucket or key isn't served
+    EXPECT_FALSE(cache.get(Vbid(1), key, 1, now).item);
+    EXPECT_FALSE(cache.get(vbid, makeStoredDocKey("cold"), 1, now).item);
+
+    // Once the revision changes the snapshot is dropped, and the key is to be
+    // published again.
+    lookup = cache.get(vbid, key, 2, now);
+    EXPECT_FALSE(lookup.item);
+    EXPECT_TRUE(lookup.publish);
+    EXPECT_EQ(0u, cache.getNumSnapshots());
+}
+
+TEST_F(HotKeyCacheTest, KeyWithoutCollectionId) {
+    ASSERT_NE(0u, readUntilHot(key, 1));
+    cache.publish(vbid, make_item(vbid, key, "value"), 1);
+
+    // The same key in the DefaultCollection, without an encoded collection-ID
+    DocKey legacyKey("hot", DocKeyEncodesCollectionId::No);
+    EXPECT_TRUE(cache.get(vbid, legacyKey, 1, now).item);
+}
+
+TEST_F(HotKeyCacheTest, ExpiredSnapshotNotServed) {
+    ASSERT_NE(0u, readUntilHot(key, 1));
+    cache.publish(vbid, make_item(vbid, key, "value", now + 10), 1);
+
+    EXPECT_TRUE(cache.get(vbid, key, 1, now + 9).item);
+    EXPECT_FALSE(cache.get(vbid, key, 1, now + 10).item);
+    EXPECT_EQ(0u, cache.getNumSnapshots());
+}
+
+TEST_F(HotKeyCacheTest, MaxKeys) {
+    for (int ii = 0; ii < 3; ++ii) {
+        auto hotKey = makeStoredDocKey("hot" + std::to_string(ii));
+        cache.publish(vbid, make_item(vbid, hotKey, "value"), 1);
+    }
+    EXPECT_EQ(2u, cache.getNumSnapshots());
+
+    cache.clear();
+    EXPECT_EQ(0u, cache.getNumSnapshots());
+}
+
+TEST_F(HotKeyCacheTest, ColdKeyForgotten) {
+    ASSERT_NE(0u, readUntilHot(key, 1));
+    cache.publish(vbid, make_item(vbid, key, "value"), 1);
+
+    // Read other keys until the counts have decayed enough for the key not
+    // to be hot anymore.
+    for (size_t ii = 0;
+         ii < 2 * HotKeyCache::DecayInterval * HotKeyCache::SampleInterval;
+         ++ii) {
+        cache.get(vbid, makeStoredDocKey("cold"), 1, now);
+    }
+    EXPECT_EQ(0u, cache.getNumSnapshots());
+}
@@ -16,6 +16,7 @@
  */
 
 #include "item_compressor_test.h"
+#include "compression_dictionary.h"
 #include "item.h"
 #include "item_compressor_visitor.h"
 #include "test_helpers.h"
@@ -129,6 +130,141 @@ TEST_P(ItemCompressorTest, testStoreUncompressedInActiveMode) {
     EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, v->getDatatype());
 }
 
+// Test that the ItemCompressorVisitor compresses items when run as one of
+// the actions of a FusedHTVisitor, and that every action sees every item.
+TEST_P(ItemCompressorTest, testCompressionInFusedVisitor) {
+    std::string compressibleValue(
+            "{\"product\": \"car\",\"price\": \"100\"},"
+            "{\"product\": \"bus\",\"price\": \"1000\"},"
+            "{\"product\": \"Train\",\"price\": \"100000\"}");
+
+    auto key = makeStoredDocKey("key");
+    auto item = make_item(vbucket->getId(),
+                          key,
+                          compressibleValue,
+                          0,
+                          PROTOCOL_BINARY_DATATYPE_JSON);
+    ASSERT_EQ(MutationStatus::WasClean, public_processSet(item, 0));
+    ASSERT_EQ(MutationStatus::WasClean,
+              public_processSet(make_item(vbucket->getId(),
+                                          makeStoredDocKey("key2"),
+                                          "value"),
+                                0));
+
+    ItemCompressorVisitor compressor;
+    compressor.setCompressionMode(BucketCompressionMode::Active);
+    compressor.setMinCompressionRatio(config.getMinCompressionRatio());
+    ItemCompressorVisitor passive;
+    passive.setCompressionMode(BucketCompressionMode::Passive);
+
+    PauseResumeVBAdapter prAdapter(std::make_unique<FusedHTVisitor>());
+    auto& fused = dynamic_cast<FusedHTVisitor&>(prAdapter.getHTVisitor());
+    fused.setActions({&passive, &compressor});
+    prAdapter.visit(*vbucket);
+
+    EXPECT_EQ(2u, passive.getVisitedCount());
+    EXPECT_EQ(0u, passive.getCompressedCount());
+    EXPECT_EQ(2u, compressor.getVisitedCount());
+    EXPECT_EQ(1u, compressor.getCompressedCount());
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON | PROTOCOL_BINARY_DATATYPE_SNAPPY,
+              findValue(key)->getDatatype());
+}
+
+// Test that with dictionaries the ItemCompressorVisitor first samples the
+// documents of a collection, and once the dictionary is trained compresses
+// them with it; the value read back is the original document.
+TEST_P(ItemCompressorTest, testDictionaryCompression) {
+    if (!CompressionDictionary::isSupported()) {
+        GTEST_SKIP() << "Built without Zstandard";
+    }
+    if (!persistent()) {
+        GTEST_SKIP() << "Ephemeral documents are left to Snappy";
+    }
+
+    std::vector<std::string> values;
+    for (int ii = 0; ii < 200; ++ii) {
+        auto id = std::to_string(ii);
+        values.push_back("{\"product_name\": \"product" + id +
+                         "\", \"price_in_dollars\": " + id +
+                         ", \"description\": \"One of the products in the "
+                         "catalogue\", \"in_stock\": true}");
+        auto item = make_item(vbucket->getId(),
+                              makeStoredDocKey("key" + id),
+                              values.back(),
+                              0,
+                              PROTOCOL_BINARY_DATATYPE_JSON);
+        ASSERT_EQ(MutationStatus::WasClean, public_processSet(item, 0));
+    }
+
+    CollectionDictionaries dictionaries(1024, 1024 * 1024, 1024 * 1024);
+    auto visit = [this, &dictionaries]() {
+        PauseResumeVBAdapter prAdapter(
+                std::make_unique<ItemCompressorVisitor>());
+        auto& visitor = dynamic_cast<ItemCompressorVisitor&>(
+                prAdapter.getHTVisitor());
+        visitor.setCompressionMode(BucketCompressionMode::Active);
+        visitor.setMinCompressionRatio(config.getMinCompressionRatio());
+        visitor.setDictionaries(&dictionaries);
+        prAdapter.visit(*vbucket);
+        return visitor.getCompressedCount();
+    };
+
+    // The first pass only samples the documents.
+    EXPECT_EQ(0u, visit());
+    ASSERT_EQ(1u, dictionaries.train());
+    EXPECT_EQ(1u, dictionaries.getNumDictionaries());
+
+    EXPECT_EQ(values.size(), visit());
+    for (size_t ii = 0; ii < values.size(); ++ii) {
+        auto* v = findValue(makeStoredDocKey("key" + std::to_string(ii)));
+        ASSERT_NE(nullptr, v);
+        EXPECT_TRUE(v->isDictionaryCompressed());
+        EXPECT_FALSE(v->isCompressible());
+        EXPECT_LT(v->valuelen(), values[ii].size());
+        EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, v->getDatatype());
+        EXPECT_EQ(values[ii], v->getValue()->to_s());
+    }
+}
+
+// Test that the samples held for all collections are bounded, and that a
+// dropped collection's samples are released (and it isn't sampled again).
+TEST(CollectionDictionariesTest, SampleMemory) {
+    const std::string value(1000, 'x');
+    CollectionDictionaries dictionaries(1024, 4000, 10000);
+
+    // Each collection is sampled up to its sample size...
+    for (int ii = 0; ii < 5; ++ii) {
+        auto lookup = dictionaries.lookup(CollectionID(8), value);
+        EXPECT_TRUE(lookup.training);
+        EXPECT_FALSE(lookup.dictionary);
+    }
+    EXPECT_EQ(4000, dictionaries.getSampleMemory());
+
+    // ... and all collections up to the total.
+    for (uint32_t cid = 9; cid < 20; ++cid) {
+        for (int ii = 0; ii < 5; ++ii) {
+            EXPECT_TRUE(dictionaries.lookup(CollectionID(cid), value).training);
+        }
+    }
+    EXPECT_EQ(10000, dictionaries.getSampleMemory());
+
+    dictionaries.dropCollection(CollectionID(8));
+    EXPECT_EQ(6000, dictionaries.getSampleMemory());
+    auto lookup = dictionaries.lookup(CollectionID(8), value);
+    EXPECT_FALSE(lookup.training);
+    EXPECT_FALSE(lookup.dictionary);
+    EXPECT_EQ(6000, dictionaries.getSampleMemory());
+
+    // Once a pass completes the sampled collections are to be trained, once.
+    EXPECT_TRUE(dictionaries.passCompleted({CollectionID(8)}));
+    EXPECT_FALSE(dictionaries.passCompleted({}));
+
+    // Training releases the samples.
+    dictionaries.train();
+    EXPECT_EQ(0, dictionaries.getSampleMemory());
+    EXPECT_FALSE(dictionaries.passCompleted({}));
+}
+
 INSTANTIATE_TEST_CASE_P(
         AllVBTypesAllEvictionModes,
         ItemCompressorTest,
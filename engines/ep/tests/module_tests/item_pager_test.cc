@@ -306,6 +306,30 @@ TEST_P(STItemPagerTest, HighWaterMarkTriggersPager) {
     runHighMemoryPager();
 }
 
+// Test that sampled eviction frees memory without a full hash table scan.
+TEST_P(STItemPagerTest, SampledEviction) {
+    engine->getConfiguration().setPagerEvictionStrategy("sampled");
+    engine->getConfiguration().setPagerSampledEvictionSampleSize(16);
+
+    size_t count = populateUntilTmpFail(vbid);
+    ASSERT_GE(count, 50) << "Too few documents stored";
+
+    auto& stats = engine->getEpStats();
+    const auto memBefore = stats.getPreciseTotalMemoryUsed();
+    runHighMemoryPager();
+
+    if (std::get<1>(GetParam()) == "fail_new_data") {
+        // No ItemPager for fail_new_data buckets.
+        return;
+    }
+    EXPECT_GT(stats.pagerSampledRounds, 0);
+    EXPECT_LT(stats.getPreciseTotalMemoryUsed(), memBefore);
+    auto vb = engine->getVBucket(vbid);
+    const auto numResidentItems =
+            vb->getNumItems() - vb->getNumNonResidentItems();
+    EXPECT_LT(numResidentItems, count);
+}
+
 // Tests that for the hifi_mfu eviction algorithm we visit replica vbuckets
 // first.
 TEST_P(STItemPagerTest, ReplicaItemsVisitedFirst) {
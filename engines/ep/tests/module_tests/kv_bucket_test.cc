@@ -32,11 +32,13 @@
 #include "dcp/flow-control-manager.h"
 #include "ep_bucket.h"
 #include "ep_engine.h"
+#include "ep_metrics.h"
 #include "ep_time.h"
 #include "failover-table.h"
 #include "fakes/fake_executorpool.h"
 #include "flusher.h"
 #include "globaltask.h"
+#include "hot_key_cache.h"
 #include "kv_bucket.h"
 #include "lambda_task.h"
 #include "replicationthrottle.h"
@@ -56,7 +58,9 @@
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
+#include <algorithm>
 #include <chrono>
+#include <set>
 #include <thread>
 
 void KVBucketTest::SetUp() {
@@ -453,6 +457,75 @@ TEST_P(KVBucketParamTest, GetKeyStatsNMVB) {
                                    WantsDeleted::No));
 }
 
+// getMulti tests /////////////////////////////////////////////////////////////
+
+// Check that getMulti returns the same result as get() for each request, in
+// the order the requests were given (regardless of how they are grouped
+// internally).
+TEST_P(KVBucketParamTest, GetMulti) {
+    const auto key1 = makeStoredDocKey("key1");
+    const auto key2 = makeStoredDocKey("key2");
+    const auto missing = makeStoredDocKey("missing");
+    store_item(vbid, key1, "value1");
+    store_item(vbid, key2, "value2");
+
+    const auto options =
+            static_cast<get_options_t>(HONOR_STATES | TRACK_REFERENCE);
+    std::vector<GetMultiRequest> requests{{cookie, key2, vbid, options},
+                                          {cookie, key1, Vbid(1), options},
+                                          {cookie, missing, vbid, options},
+                                          {cookie, key1, vbid, options}};
+
+    auto results = store->getMulti(requests);
+    ASSERT_EQ(requests.size(), results.size());
+    for (size_t ii = 0; ii < requests.size(); ++ii) {
+        const auto& req = requests[ii];
+        auto expected = store->get(req.key, req.vbucket, cookie, options);
+        EXPECT_EQ(expected.getStatus(), results[ii].getStatus())
+                << "request " << ii;
+    }
+
+    ASSERT_EQ(ENGINE_SUCCESS, results[0].getStatus());
+    EXPECT_EQ("value2", results[0].item->getValue()->to_s());
+    EXPECT_EQ(ENGINE_NOT_MY_VBUCKET, results[1].getStatus());
+    ASSERT_EQ(ENGINE_SUCCESS, results[3].getStatus());
+    EXPECT_EQ("value1", results[3].item->getValue()->to_s());
+}
+
+// Check that get_metrics returns every metric in ep_metrics.def exactly once,
+// and that the values match the equivalent stats.
+TEST_P(KVBucketParamTest, GetMetrics) {
+    store_item(vbid, makeStoredDocKey("key1"), "value1");
+    store_item(vbid, makeStoredDocKey("key2"), "value2");
+    flushVBucketToDiskIfPersistent(vbid, 2);
+
+    cb::metrics::Collector collector;
+    ASSERT_EQ(cb::engine_errc::success,
+              engine->get_metrics(cookie, collector));
+    EXPECT_EQ(ep_metrics::count, collector.size());
+
+    const auto samples = cb::metrics::Collector::decode(collector.toBinary());
+    std::set<uint16_t> ids;
+    for (const auto& sample : samples) {
+        EXPECT_TRUE(ids.insert(sample.id).second)
+                << "duplicate id " << sample.id;
+    }
+
+    auto find = [&samples](const cb::metrics::Definition& def) {
+        return std::find_if(samples.begin(),
+                            samples.end(),
+                            [&def](const cb::metrics::Sample& sample) {
+                                return sample.id == def.id;
+                            });
+    };
+    auto items = find(ep_metrics::curr_items);
+    ASSERT_NE(samples.end(), items);
+    EXPECT_EQ(2u, items->value);
+    auto active = find(ep_metrics::vb_active_num);
+    ASSERT_NE(samples.end(), active);
+    EXPECT_EQ(1u, active->value);
+}
+
 // Replace tests //////////////////////////////////////////////////////////////
 
 // Test replace against a non-existent key.
@@ -1576,6 +1649,110 @@ TEST_F(ExpiryLimitTest, gat) {
     EXPECT_NE(0, info.exptime);
 }
 
+/**
+ * Test fixture with the HotKeyCache enabled, and keys hot after their first
+ * sampled read.
+ */
+class HotKeyCacheBucketTest : public KVBucketParamTest {
+protected:
+    void SetUp() override {
+        config_string +=
+                "hot_key_cache_enabled=true;hot_key_cache_threshold=1;";
+        KVBucketParamTest::SetUp();
+    }
+
+    GetValue getKey() {
+        return store->get(key, vbid, cookie, options);
+    }
+
+    /// Read the key until a read is served from a snapshot of the key
+    void readUntilCached(const std::string& expected) {
+        auto& cache = store->getHotKeyCache();
+        const auto hits = cache.getNumHits();
+        for (size_t ii = 0; ii < 100 * HotKeyCache::SampleInterval &&
+                            cache.getNumHits() == hits;
+             ++ii) {
+            auto gv = getKey();
+            ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+            EXPECT_EQ(expected, gv.item->getValue()->to_s());
+        }
+        ASSERT_GT(cache.getNumHits(), hits);
+    }
+
+    const StoredDocKey key = makeStoredDocKey("hot");
+
+    /// The options of a GET from a client
+    const get_options_t options = static_cast<get_options_t>(
+            QUEUE_BG_FETCH | HONOR_STATES | TRACK_REFERENCE | DELETE_TEMP |
+            HIDE_LOCKED_CAS | TRACK_STATISTICS);
+};
+
+TEST_P(HotKeyCacheBucketTest, SetReadAfterwards) {
+    store_item(vbid, key, "value");
+    readUntilCached("value");
+
+    store_item(vbid, key, "new");
+    auto gv = getKey();
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("new", gv.item->getValue()->to_s());
+
+    // The new value is cached in turn
+    readUntilCached("new");
+}
+
+TEST_P(HotKeyCacheBucketTest, DeleteReadAfterwards) {
+    store_item(vbid, key, "value");
+    readUntilCached("value");
+
+    delete_item(vbid, key);
+    EXPECT_EQ(ENGINE_KEY_ENOENT, getKey().getStatus());
+}
+
+TEST_P(HotKeyCacheBucketTest, ExpiryReadAfterwards) {
+    store_item(vbid, key, "value", ep_real_time() + 10);
+    readUntilCached("value");
+
+    TimeTraveller docBrown(20);
+    EXPECT_EQ(ENGINE_KEY_ENOENT, getKey().getStatus());
+}
+
+TEST_P(HotKeyCacheBucketTest, GetLockedReadAfterwards) {
+    store_item(vbid, key, "value");
+    readUntilCached("value");
+
+    auto locked = store->getLocked(key, vbid, ep_current_time(), 10, cookie);
+    ASSERT_EQ(ENGINE_SUCCESS, locked.getStatus());
+
+    // Reads while the key is locked hide its CAS, and a locked item isn't
+    // published as a snapshot.
+    for (size_t ii = 0; ii < 10 * HotKeyCache::SampleInterval; ++ii) {
+        auto gv = getKey();
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+        EXPECT_EQ(uint64_t(-1), gv.item->getCas());
+        EXPECT_EQ("value", gv.item->getValue()->to_s());
+    }
+
+    // Once unlocked the real CAS is returned again
+    ASSERT_EQ(ENGINE_SUCCESS,
+              store->unlockKey(key,
+                               vbid,
+                               locked.item->getCas(),
+                               ep_current_time(),
+                               cookie));
+    auto gv = getKey();
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(locked.item->getCas(), gv.item->getCas());
+}
+
+INSTANTIATE_TEST_CASE_P(EphemeralOrPersistent,
+                        HotKeyCacheBucketTest,
+                        ::testing::Values("item_eviction_policy=value_only",
+                                          "item_eviction_policy=full_eviction",
+                                          "bucket_type=ephemeral"),
+                        [](const ::testing::TestParamInfo<std::string>& info) {
+                            return info.param.substr(info.param.find('=') + 1);
+                        });
+
 // Test cases which run for EP (Full and Value eviction) and Ephemeral
 INSTANTIATE_TEST_CASE_P(EphemeralOrPersistent,
                         KVBucketParamTest,
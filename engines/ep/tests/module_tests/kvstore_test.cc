@@ -24,6 +24,7 @@
 #include "item.h"
 #include "kvstore.h"
 #include "kvstore_config.h"
+#include "log-kvstore/log-kvstore_config.h"
 #include "vb_commit.h"
 #ifdef EP_USE_ROCKSDB
 #include "rocksdb-kvstore/rocksdb-kvstore_config.h"
@@ -2231,6 +2232,9 @@ void KVStoreParamTest::SetUp() {
     if (config.getBackend() == "couchdb") {
         kvstoreConfig = std::make_unique<KVStoreConfig>(
                 config, workload.getNumShards(), 0 /*shardId*/);
+    } else if (config.getBackend() == "logstore") {
+        kvstoreConfig = std::make_unique<LogKVStoreConfig>(
+                config, workload.getNumShards(), 0 /*shardId*/);
     }
 #ifdef EP_USE_ROCKSDB
     else if (config.getBackend() == "rocksdb") {
@@ -2740,6 +2744,7 @@ static std::string kvstoreTestParams[] = {
 #ifdef EP_USE_ROCKSDB
         "rocksdb",
 #endif
+        "logstore",
         "couchdb"};
 
 INSTANTIATE_TEST_CASE_P(KVStoreParam,
@@ -2753,6 +2758,7 @@ static std::string kvstoreTestParamsSkipMagma[] = {
 #ifdef EP_USE_ROCKSDB
         "rocksdb",
 #endif
+        "logstore",
         "couchdb"};
 
 INSTANTIATE_TEST_CASE_P(KVStoreParam,
@@ -2766,6 +2772,7 @@ static std::string kvstoreTestParamsSkipRocks[] = {
 #ifdef EP_USE_MAGMA
         "magma",
 #endif
+        "logstore",
         "couchdb"};
 
 INSTANTIATE_TEST_CASE_P(KVStoreParam,
@@ -3027,3 +3034,145 @@ TEST_F(MagmaKVStoreTest, setMaxDataSize) {
     ASSERT_LT(writeCacheQuotaAfter, writeCacheQuota);
 }
 #endif
+
+// Test fixture for tests which run only on the log-structured store.
+class LogKVStoreTest : public KVStoreTest {
+protected:
+    void SetUp() override {
+        KVStoreTest::SetUp();
+        auto configStr = "dbname="s + data_dir + ";backend=logstore"s;
+        Configuration config;
+        config.parseConfiguration(configStr.c_str(), get_mock_server_api());
+        WorkLoadPolicy workload(config.getMaxNumWorkers(),
+                                config.getMaxNumShards());
+        kvstoreConfig = std::make_unique<LogKVStoreConfig>(
+                config, workload.getNumShards(), 0 /*shardId*/);
+        kvstore = setup_kv_store(*kvstoreConfig);
+    }
+
+    void TearDown() override {
+        kvstore.reset();
+        KVStoreTest::TearDown();
+    }
+
+    /// Write numBatches batches of 5 keys, key<seqno>, starting at seqno
+    void writeBatches(int numBatches, uint64_t& seqno, bool overwrite = false) {
+        WriteCallback wc;
+        for (int i = 0; i < numBatches; i++) {
+            kvstore->begin(std::make_unique<TransactionContext>(vbid));
+            for (int j = 0; j < 5; j++) {
+                auto key = overwrite ? "key" + std::to_string(j + 1)
+                                     : "key" + std::to_string(seqno);
+                Item item(makeStoredDocKey(key), 0, 0, "value", 5);
+                item.setBySeqno(seqno++);
+                kvstore->set(item, wc);
+            }
+            ASSERT_TRUE(kvstore->commit(flush));
+        }
+    }
+
+    /// Close the store and open it again, replaying the segments
+    void reopen() {
+        kvstore.reset();
+        auto stores = KVStoreFactory::create(*kvstoreConfig);
+        kvstore = std::move(stores.rw);
+    }
+
+    std::string getSegmentPath(int segment) {
+        return data_dir + "/logstore.0/0.0." + std::to_string(segment) +
+               ".log";
+    }
+
+    std::unique_ptr<KVStoreConfig> kvstoreConfig;
+    std::unique_ptr<KVStore> kvstore;
+};
+
+TEST_F(LogKVStoreTest, Rollback) {
+    uint64_t seqno = 1;
+    writeBatches(2, seqno);
+
+    auto rcb(std::make_shared<CustomRBCallback>());
+    auto result = kvstore->rollback(Vbid(0), 5, rcb);
+    ASSERT_TRUE(result.success);
+    EXPECT_EQ(uint64_t(5), result.highSeqno);
+
+    EXPECT_EQ(ENGINE_SUCCESS,
+              kvstore->get(makeDiskDocKey("key5"), Vbid(0)).getStatus());
+    EXPECT_EQ(ENGINE_KEY_ENOENT,
+              kvstore->get(makeDiskDocKey("key6"), Vbid(0)).getStatus());
+    EXPECT_EQ(5, kvstore->getVBucketState(Vbid(0))->highSeqno);
+    EXPECT_EQ(size_t(5), kvstore->getItemCount(Vbid(0)));
+
+    // The rollback must survive a restart
+    reopen();
+    EXPECT_EQ(ENGINE_KEY_ENOENT,
+              kvstore->get(makeDiskDocKey("key6"), Vbid(0)).getStatus());
+    EXPECT_EQ(5, kvstore->getVBucketState(Vbid(0))->highSeqno);
+    EXPECT_EQ(size_t(5), kvstore->getItemCount(Vbid(0)));
+}
+
+// Once compaction has dropped the versions a commit point needs, rollback
+// to it must fail rather than return a mix of old and new documents.
+TEST_F(LogKVStoreTest, RollbackAfterCompaction) {
+    uint64_t seqno = 1;
+    writeBatches(1, seqno);
+    writeBatches(2, seqno, true /*overwrite*/);
+
+    CompactionConfig config;
+    config.db_file_id = Vbid(0);
+    compaction_ctx cctx(config, 0);
+    ASSERT_TRUE(kvstore->compactDB(&cctx));
+    EXPECT_EQ(size_t(5), kvstore->getItemCount(Vbid(0)));
+
+    auto rcb(std::make_shared<CustomRBCallback>());
+    EXPECT_FALSE(kvstore->rollback(Vbid(0), 5, rcb).success);
+
+    // The latest commit is still available
+    auto result = kvstore->rollback(Vbid(0), 15, rcb);
+    ASSERT_TRUE(result.success);
+    EXPECT_EQ(uint64_t(15), result.highSeqno);
+}
+
+TEST_F(LogKVStoreTest, Reopen) {
+    uint64_t seqno = 1;
+    writeBatches(3, seqno);
+
+    reopen();
+    for (int i = 1; i < 16; i++) {
+        auto gv = kvstore->get(makeDiskDocKey("key" + std::to_string(i)),
+                               Vbid(0));
+        EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus()) << "key" << i;
+    }
+    EXPECT_EQ(15, kvstore->getVBucketState(Vbid(0))->highSeqno);
+    EXPECT_EQ(size_t(15), kvstore->getItemCount(Vbid(0)));
+}
+
+// A partially written batch at the end of a segment is ignored on open.
+TEST_F(LogKVStoreTest, TornWrite) {
+    uint64_t seqno = 1;
+    writeBatches(1, seqno);
+    kvstore.reset();
+
+    auto* fp = fopen(getSegmentPath(0).c_str(), "ab");
+    ASSERT_NE(nullptr, fp);
+    const std::string junk(100, 'x');
+    ASSERT_EQ(junk.size(), fwrite(junk.data(), 1, junk.size(), fp));
+    fclose(fp);
+
+    auto stores = KVStoreFactory::create(*kvstoreConfig);
+    kvstore = std::move(stores.rw);
+    EXPECT_EQ(size_t(5), kvstore->getItemCount(Vbid(0)));
+    EXPECT_EQ(5, kvstore->getVBucketState(Vbid(0))->highSeqno);
+
+    // New writes follow the intact data
+    writeBatches(1, seqno);
+    reopen();
+    EXPECT_EQ(size_t(10), kvstore->getItemCount(Vbid(0)));
+}
+
+TEST_F(LogKVStoreTest, getStat) {
+    size_t val;
+    ASSERT_FALSE(kvstore->getStat("foobar", val));
+    ASSERT_TRUE(kvstore->getStat("logstore_num_segments", val));
+    EXPECT_EQ(size_t(1), val);
+}
@@ -0,0 +1,123 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mapped_access_log.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+#include <platform/dirutils.h>
+
+#include <fstream>
+
+class MappedAccessLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        filename = cb::io::mktemp("malt_test");
+    }
+
+    void TearDown() override {
+        cb::io::rmrf(filename);
+    }
+
+    std::string filename;
+};
+
+// Keys written for each vBucket can be read back, sorted by key.
+TEST_F(MappedAccessLogTest, RoundTrip) {
+    {
+        MappedAccessLogWriter writer(filename);
+        writer.addVBucket(Vbid(3),
+                          {makeStoredDocKey("c"),
+                           makeStoredDocKey("a"),
+                           makeStoredDocKey("b")});
+        writer.addVBucket(Vbid(1), {makeStoredDocKey("key")});
+        writer.addVBucket(Vbid(2), {});
+        EXPECT_EQ(4, writer.commit());
+    }
+
+    ASSERT_TRUE(MappedAccessLog::isMappedAccessLog(filename));
+    MappedAccessLog log(filename);
+    EXPECT_EQ(4, log.getNumKeys());
+    EXPECT_EQ((std::vector<Vbid>{Vbid(3), Vbid(1)}), log.getVBuckets());
+
+    std::vector<StoredDocKey> keys;
+    for (const auto key : log.getKeys(Vbid(3))) {
+        keys.emplace_back(key);
+    }
+    EXPECT_EQ((std::vector<StoredDocKey>{makeStoredDocKey("a"),
+                                         makeStoredDocKey("b"),
+                                         makeStoredDocKey("c")}),
+              keys);
+
+    auto vb1 = log.getKeys(Vbid(1));
+    ASSERT_EQ(1, vb1.size());
+    EXPECT_EQ(makeStoredDocKey("key"), StoredDocKey(vb1.at(0)));
+
+    // Empty and unknown vBuckets have no keys
+    EXPECT_TRUE(log.getKeys(Vbid(2)).empty());
+    EXPECT_TRUE(log.getKeys(Vbid(0)).empty());
+}
+
+// A log which is never committed is removed.
+TEST_F(MappedAccessLogTest, UncommittedIsRemoved) {
+    {
+        MappedAccessLogWriter writer(filename);
+        writer.addVBucket(Vbid(0), {makeStoredDocKey("a")});
+    }
+    EXPECT_FALSE(cb::io::isFile(filename));
+}
+
+TEST_F(MappedAccessLogTest, DuplicateVBucket) {
+    MappedAccessLogWriter writer(filename);
+    writer.addVBucket(Vbid(0), {makeStoredDocKey("a")});
+    EXPECT_THROW(writer.addVBucket(Vbid(0), {makeStoredDocKey("b")}),
+                 std::logic_error);
+}
+
+// A file in another format is not recognised as a mapped access log.
+TEST_F(MappedAccessLogTest, NotMapped) {
+    {
+        std::ofstream out(filename);
+        out << "not an access log";
+    }
+    EXPECT_FALSE(MappedAccessLog::isMappedAccessLog(filename));
+    EXPECT_THROW(MappedAccessLog{filename}, MappedAccessLog::ReadException);
+}
+
+// Corruption of a vBucket's keys is detected by the section CRC.
+TEST_F(MappedAccessLogTest, CorruptSection) {
+    {
+        MappedAccessLogWriter writer(filename);
+        writer.addVBucket(Vbid(0), {makeStoredDocKey("abcdef")});
+        writer.commit();
+    }
+    {
+        // Flip a byte in the key data (the last byte of the section)
+        std::fstream file(filename,
+                          std::ios::in | std::ios::out | std::ios::binary);
+        const auto pos = MappedAccessLogFormat::HeaderSize + 8 +
+                         makeStoredDocKey("abcdef").size() - 1;
+        file.seekg(pos);
+        char c;
+        file.get(c);
+        file.seekp(pos);
+        file.put(c ^ 0xff);
+    }
+
+    MappedAccessLog log(filename);
+    EXPECT_THROW(log.getKeys(Vbid(0)), MappedAccessLog::ReadException);
+}
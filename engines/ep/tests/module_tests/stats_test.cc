@@ -157,6 +157,68 @@ TEST_F(StatTest, vbucket_takeover_stats_stream_not_active) {
     producer->closeStream(/*opaque*/ 0, vbid);
 }
 
+// Check that the memory of each collection's items is attributed to it.
+TEST_F(StatTest, CollectionMemoryUsed) {
+    store_item(Vbid(0), makeStoredDocKey("key1"), std::string(100, 'x'));
+    store_item(Vbid(0), makeStoredDocKey("key2"), std::string(100, 'y'));
+
+    auto& stats = engine->getEpStats();
+    auto vb = store->getVBucket(Vbid(0));
+    auto memUsed = stats.getCollectionMemoryUsed();
+    ASSERT_EQ(1, memUsed.count(CollectionID::Default));
+    EXPECT_EQ(vb->ht.getItemMemory(), memUsed[CollectionID::Default]);
+
+    // Other collections are accounted separately.
+    stats.collectionMemoryChanged(CollectionID(8), 1000);
+    memUsed = stats.getCollectionMemoryUsed();
+    EXPECT_EQ(1000, memUsed[CollectionID(8)]);
+    EXPECT_EQ(vb->ht.getItemMemory(), memUsed[CollectionID::Default]);
+    stats.collectionMemoryChanged(CollectionID(8), -1000);
+
+    // Clearing the HashTable releases the collection's memory.
+    vb->ht.clear();
+    EXPECT_EQ(0, stats.getCollectionMemoryUsed()[CollectionID::Default]);
+}
+
+// Check that releasing the slot of a dropped collection while its memory is
+// still being updated neither loses an update nor leaves one behind for the
+// next collection to claim the slot.
+TEST_F(StatTest, CollectionMemorySlotReleaseRacesWithUpdates) {
+    auto& stats = engine->getEpStats();
+    const CollectionID dropped(8);
+    const CollectionID next(9);
+    const int iterations = 100000;
+
+    stats.collectionMemoryChanged(dropped, 1);
+    stats.collectionDropped(dropped);
+
+    std::atomic<bool> done{false};
+    std::thread updater([&stats, &dropped, &done, iterations]() {
+        // Items of the dropped collection still being purged
+        for (int ii = 0; ii < iterations; ++ii) {
+            stats.collectionMemoryChanged(dropped, 1);
+            stats.collectionMemoryChanged(dropped, -1);
+        }
+        stats.collectionMemoryChanged(dropped, -1);
+        done = true;
+    });
+    std::thread releaser([&stats, &dropped, &done]() {
+        while (!done) {
+            stats.releaseDroppedCollectionSlots();
+            stats.collectionDropped(dropped);
+        }
+    });
+    for (int ii = 0; ii < iterations; ++ii) {
+        stats.collectionMemoryChanged(next, 1);
+    }
+    updater.join();
+    releaser.join();
+
+    EXPECT_EQ(iterations, stats.getCollectionMemoryUsed()[next]);
+    EXPECT_EQ(0, stats.getUntrackedCollectionMemoryUsed());
+    stats.collectionMemoryChanged(next, -iterations);
+}
+
 // MB-32589: Check that _hash-dump stats correctly accounts temporary memory.
 TEST_F(StatTest, HashStatsMemUsed) {
     // Add some items to VBucket 0 so the stats call has some data to
@@ -436,6 +436,119 @@ TYPED_TEST(ValueTest, MB_32568) {
     EXPECT_EQ(DeleteSource::TTL, this->sv->getDeletionSource());
 }
 
+/**
+ * Test fixture for StoredValues with inline values (values up to 16 bytes
+ * stored inline).
+ */
+class InlineStoredValueTest : public ::testing::Test {
+protected:
+    InlineStoredValueTest()
+        : factory(stats, 16),
+          item(make_item(Vbid(0), makeStoredDocKey("key"), "value")) {
+    }
+
+    EPStats stats;
+    StoredValueFactory factory;
+    Item item;
+};
+
+TEST_F(InlineStoredValueTest, SmallValueIsInline) {
+    auto sv = factory(item, {});
+    EXPECT_TRUE(sv->hasInlineValue());
+    EXPECT_FALSE(sv->getValueBlob());
+    EXPECT_TRUE(sv->isResident());
+    EXPECT_EQ(5u, sv->valuelen());
+    EXPECT_EQ("value", std::string(sv->getValueBuffer().data(),
+                                   sv->getValueBuffer().size()));
+    // Value rounded up to 8 bytes, plus the InlineValue header
+    EXPECT_EQ(StoredValue::getRequiredStorage(item.getKey()) + 3 + 8,
+              sv->getObjectSize());
+    // The whole inline area is metadata, and the value is within it
+    EXPECT_EQ(sv->getObjectSize(), sv->metaDataSize());
+    EXPECT_EQ(sv->getObjectSize(), sv->size());
+    EXPECT_EQ(sv->getObjectSize(), sv->uncompressedSize());
+
+    // Sharing the value creates a Blob with a copy of it
+    auto itm = sv->toItem(Vbid(0));
+    EXPECT_EQ("value", itm->getValue()->to_s());
+    EXPECT_TRUE(sv->hasInlineValue());
+}
+
+TEST_F(InlineStoredValueTest, LargeValueUsesBlob) {
+    auto sv = factory(make_item(Vbid(0),
+                                makeStoredDocKey("key"),
+                                "a value too large to be inline"),
+                      {});
+    EXPECT_FALSE(sv->hasInlineValue());
+    EXPECT_TRUE(sv->getValueBlob());
+    EXPECT_EQ(StoredValue::getRequiredStorage(item.getKey()),
+              sv->getObjectSize());
+}
+
+// The inline area stays allocated (and counted) whether or not the value is
+// held in it; a value held in a Blob is counted in addition.
+TEST_F(InlineStoredValueTest, SizeCountsWholeInlineArea) {
+    auto sv = factory(item, {});
+    ASSERT_TRUE(sv->hasInlineValue());
+    const auto objectSize = sv->getObjectSize();
+    EXPECT_EQ(objectSize, sv->size());
+
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "value12345"));
+    ASSERT_FALSE(sv->hasInlineValue());
+    EXPECT_EQ(objectSize, sv->metaDataSize());
+    EXPECT_EQ(objectSize + 10, sv->size());
+    EXPECT_EQ(objectSize + 10, sv->uncompressedSize());
+
+    sv->del(DeleteSource::Explicit);
+    EXPECT_EQ(objectSize, sv->size());
+}
+
+TEST_F(InlineStoredValueTest, ValueMovesBetweenInlineAndBlob) {
+    auto sv = factory(item, {});
+    sv->setFreqCounterValue(100);
+
+    // Doesn't fit in the inline area - stored in a Blob
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "value12345"));
+    EXPECT_FALSE(sv->hasInlineValue());
+    EXPECT_EQ("value12345", sv->getValue()->to_s());
+    EXPECT_EQ(100, sv->getFreqCounterValue());
+
+    // Fits again - back inline
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "value123"));
+    EXPECT_TRUE(sv->hasInlineValue());
+    EXPECT_FALSE(sv->getValueBlob());
+    EXPECT_EQ("value123", sv->getValue()->to_s());
+    EXPECT_EQ(100, sv->getFreqCounterValue());
+
+    // Deleting drops the value
+    sv->del(DeleteSource::Explicit);
+    EXPECT_FALSE(sv->hasInlineValue());
+    EXPECT_FALSE(sv->getValue());
+    EXPECT_EQ(0u, sv->valuelen());
+}
+
+TEST_F(InlineStoredValueTest, EjectValue) {
+    auto sv = factory(item, {});
+    sv->ejectValue();
+    EXPECT_FALSE(sv->isResident());
+    EXPECT_FALSE(sv->getValue());
+    EXPECT_EQ(0u, sv->valuelen());
+
+    sv->restoreValue(item);
+    EXPECT_TRUE(sv->isResident());
+    EXPECT_TRUE(sv->hasInlineValue());
+    EXPECT_EQ("value", sv->getValue()->to_s());
+}
+
+TEST_F(InlineStoredValueTest, Copy) {
+    auto sv = factory(item, {});
+    auto copy = factory.copyStoredValue(*sv, {});
+    EXPECT_TRUE(copy->hasInlineValue());
+    EXPECT_EQ(sv->getObjectSize(), copy->getObjectSize());
+    EXPECT_EQ("value", copy->getValue()->to_s());
+    EXPECT_EQ(*sv, *copy);
+}
+
 /**
  * Test fixture for OrderedStoredValue-only tests.
  */
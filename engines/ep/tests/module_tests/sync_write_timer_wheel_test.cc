@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "durability/sync_write_timer_wheel.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace std::chrono_literals;
+
+/*
+ * Unit tests for the SyncWriteTimerWheel class.
+ */
+
+class SyncWriteTimerWheelTest : public ::testing::Test {
+protected:
+    const SyncWriteTimerWheel::Clock::time_point start =
+            SyncWriteTimerWheel::Clock::now();
+    SyncWriteTimerWheel wheel{start};
+};
+
+TEST_F(SyncWriteTimerWheelTest, Empty) {
+    EXPECT_EQ(0u, wheel.size());
+    EXPECT_EQ(SyncWriteTimerWheel::Clock::time_point::max(),
+              wheel.getNextDueTime());
+    EXPECT_TRUE(wheel.advance(start + 1h).empty());
+}
+
+TEST_F(SyncWriteTimerWheelTest, ExpiresAfterTick) {
+    EXPECT_TRUE(wheel.add(Vbid(0), start + 10ms));
+    EXPECT_EQ(1u, wheel.size());
+    // Only due once the expiry time has been passed (SyncWrites expire
+    // when expiry < now)
+    EXPECT_EQ(start + 11ms, wheel.getNextDueTime());
+
+    EXPECT_TRUE(wheel.advance(start + 10ms).empty());
+    EXPECT_EQ(1u, wheel.size());
+
+    const auto expired = wheel.advance(start + 11ms);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ(Vbid(0), expired[0]);
+    EXPECT_EQ(0u, wheel.size());
+    EXPECT_EQ(SyncWriteTimerWheel::Clock::time_point::max(),
+              wheel.getNextDueTime());
+}
+
+TEST_F(SyncWriteTimerWheelTest, AddReportsEarliest) {
+    EXPECT_TRUE(wheel.add(Vbid(0), start + 100ms));
+    EXPECT_FALSE(wheel.add(Vbid(1), start + 200ms));
+    EXPECT_TRUE(wheel.add(Vbid(2), start + 50ms));
+    EXPECT_EQ(start + 51ms, wheel.getNextDueTime());
+
+    // Already expired; returned by the next advance
+    EXPECT_TRUE(wheel.add(Vbid(3), start - 1s));
+    const auto expired = wheel.advance(start + 1ms);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ(Vbid(3), expired[0]);
+    EXPECT_EQ(start + 51ms, wheel.getNextDueTime());
+}
+
+TEST_F(SyncWriteTimerWheelTest, VBucketsReturnedOnce) {
+    wheel.add(Vbid(1), start + 5ms);
+    wheel.add(Vbid(1), start + 5ms);
+    wheel.add(Vbid(2), start + 5ms);
+    wheel.add(Vbid(1), start + 6ms);
+    // The duplicate for the same vBucket and tick isn't stored
+    EXPECT_EQ(3u, wheel.size());
+
+    const auto expired = wheel.advance(start + 1s);
+    ASSERT_EQ(2u, expired.size());
+    EXPECT_EQ(Vbid(1), expired[0]);
+    EXPECT_EQ(Vbid(2), expired[1]);
+    EXPECT_EQ(0u, wheel.size());
+}
+
+TEST_F(SyncWriteTimerWheelTest, Cascade) {
+    // Expiries at every level of the wheel, including beyond its range
+    const std::vector<std::chrono::milliseconds> timeouts = {
+            30ms, 2s, 45s, 30min, 24h};
+    for (size_t ii = 0; ii < timeouts.size(); ++ii) {
+        wheel.add(Vbid(ii), start + timeouts[ii]);
+    }
+
+    auto now = start;
+    for (size_t ii = 0; ii < timeouts.size(); ++ii) {
+        SCOPED_TRACE(timeouts[ii].count());
+        EXPECT_EQ(start + timeouts[ii] + 1ms, wheel.getNextDueTime());
+        // Advancing just before the expiry doesn't return it...
+        now = start + timeouts[ii];
+        EXPECT_TRUE(wheel.advance(now).empty());
+        // ... and once past it does.
+        now += 1ms;
+        const auto expired = wheel.advance(now);
+        ASSERT_EQ(1u, expired.size());
+        EXPECT_EQ(Vbid(ii), expired[0]);
+    }
+    EXPECT_EQ(0u, wheel.size());
+}
+
+TEST_F(SyncWriteTimerWheelTest, AddWhileAdvancing) {
+    // Add entries relative to a moving current time, which exercises the
+    // slots wrapping around at every level.
+    auto now = start;
+    for (int ii = 0; ii < 1000; ++ii) {
+        now += 15ms;
+        wheel.add(Vbid(0), now + 20s);
+        EXPECT_TRUE(wheel.advance(now).empty());
+    }
+    EXPECT_EQ(1000u, wheel.size());
+    EXPECT_EQ(start + 15ms + 20s + 1ms, wheel.getNextDueTime());
+
+    const auto expired = wheel.advance(now + 20s + 1ms);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ(0u, wheel.size());
+}
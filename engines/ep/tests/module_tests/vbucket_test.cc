@@ -299,6 +299,12 @@ std::pair<MutationStatus, GetValue> VBucketTestBase::public_getAndUpdateTtl(
             hbl.first, hbl.second, exptime, cHandle);
 }
 
+boost::optional<GetValue> VBucketTestBase::public_getInternalOptimistic(
+        const DocKey& key, get_options_t options) {
+    auto cHandle = vbucket->lockCollections(key);
+    return vbucket->getInternalOptimistic(options, GetKeyOnly::No, cHandle);
+}
+
 bool operator==(const SWCompleteTrace& lhs, const SWCompleteTrace& rhs) {
     return lhs.count == rhs.count && lhs.cookie == rhs.cookie &&
            lhs.status == rhs.status;
@@ -612,6 +618,84 @@ TEST_P(VBucketTest, GetItemsToPersist_LimitCkptMoreAvailable) {
     EXPECT_EQ(0, result.items.size());
 }
 
+// Check that a resident, committed item is read without locking its hash
+// bucket.
+TEST_P(VBucketTest, OptimisticGetResidentItem) {
+    auto k = makeStoredDocKey("key");
+    ASSERT_EQ(MutationStatus::WasClean, setOne(k));
+
+    auto gv = public_getInternalOptimistic(k);
+    ASSERT_TRUE(gv);
+    ASSERT_EQ(ENGINE_SUCCESS, gv->getStatus());
+    EXPECT_EQ(k, StoredDocKey(gv->item->getKey()));
+}
+
+// Check that the optimistic read of an expired item falls back to the locked
+// path, which expires it.
+TEST_P(VBucketTest, OptimisticGetFallsBackForExpiredItem) {
+    auto k = makeStoredDocKey("key");
+    ASSERT_EQ(MutationStatus::WasClean, setOne(k, ep_real_time() + 5));
+    ASSERT_TRUE(public_getInternalOptimistic(k));
+
+    TimeTraveller docBrown(6);
+    EXPECT_FALSE(public_getInternalOptimistic(k));
+}
+
+// Check that the optimistic read of a temp item falls back to the locked path,
+// which bg fetches or deletes it.
+TEST_P(VBucketTest, OptimisticGetFallsBackForTempItem) {
+    auto k = makeStoredDocKey("key");
+    ASSERT_EQ(TempAddStatus::BgFetch, addOneTemp(k));
+    EXPECT_FALSE(public_getInternalOptimistic(k));
+
+    {
+        auto hbl_sv = lockAndFind(k);
+        ASSERT_TRUE(hbl_sv.second);
+        hbl_sv.second->setNonExistent();
+    }
+    EXPECT_FALSE(public_getInternalOptimistic(k));
+
+    {
+        auto hbl_sv = lockAndFind(k);
+        ASSERT_TRUE(hbl_sv.second);
+        hbl_sv.second->setTempDeleted();
+    }
+    EXPECT_FALSE(public_getInternalOptimistic(k));
+    EXPECT_FALSE(public_getInternalOptimistic(
+            k, static_cast<get_options_t>(TRACK_STATISTICS | DELETE_TEMP)));
+}
+
+// Check that the optimistic read of a prepare which may already be visible
+// falls back to the locked path.
+TEST_P(VBucketTest, OptimisticGetFallsBackForMaybeVisiblePrepare) {
+    vbucket->setState(
+            vbucket_state_active,
+            {{"topology", nlohmann::json::array({{"active", "replica"}})}});
+
+    auto k = makeStoredDocKey("key");
+    ASSERT_EQ(MutationStatus::WasClean, setOne(k));
+
+    const auto item = makePendingItem(k, "pending");
+    VBQueueItemCtx ctx;
+    ctx.durability =
+            DurabilityItemCtx{item->getDurabilityReqs(), nullptr /*cookie*/};
+    ASSERT_EQ(MutationStatus::WasClean,
+              public_processSet(*item, item->getCas(), ctx));
+
+    // A Pending prepare doesn't hide the committed item.
+    auto gv = public_getInternalOptimistic(k);
+    ASSERT_TRUE(gv);
+    EXPECT_EQ(ENGINE_SUCCESS, gv->getStatus());
+
+    {
+        auto hbl_sv = lockAndFind(k, ctx);
+        ASSERT_TRUE(hbl_sv.second);
+        ASSERT_TRUE(hbl_sv.second->isPending());
+        hbl_sv.second->setCommitted(CommittedState::PreparedMaybeVisible);
+    }
+    EXPECT_FALSE(public_getInternalOptimistic(k));
+}
+
 class VBucketEvictionTest : public VBucketTest {};
 
 // Regression test for MB-21448 - if an attempt is made to perform a CAS
@@ -672,6 +756,41 @@ TEST_P(VBucketEvictionTest, Durability_PendingNeverEjected) {
     EXPECT_EQ(0, ht.getNumInMemoryNonResItems());
 }
 
+// Check that under value eviction, where a non-resident key stays in the
+// HashTable, the optimistic read falls back to the locked path (to bg fetch
+// the value) unless only the metadata is needed, which it returns directly.
+TEST_P(VBucketEvictionTest, OptimisticGetNonResidentItemValueEviction) {
+    if (!persistent() || getEvictionPolicy() != EvictionPolicy::Value) {
+        return;
+    }
+
+    auto k = makeStoredDocKey("key");
+    ASSERT_EQ(MutationStatus::WasClean, setOne(k));
+    uint64_t cas;
+    {
+        auto storedItem = vbucket->ht.findForWrite(k);
+        ASSERT_TRUE(storedItem.storedValue);
+        cas = storedItem.storedValue->getCas();
+        storedItem.storedValue->markClean();
+        ASSERT_TRUE(vbucket->ht.unlocked_ejectItem(storedItem.lock,
+                                                   storedItem.storedValue,
+                                                   getEvictionPolicy()));
+    }
+    ASSERT_TRUE(vbucket->ht.findForRead(k).storedValue);
+
+    EXPECT_FALSE(public_getInternalOptimistic(k));
+
+    auto gv = public_getInternalOptimistic(
+            k, static_cast<get_options_t>(TRACK_STATISTICS | ALLOW_META_ONLY));
+    ASSERT_TRUE(gv);
+    EXPECT_EQ(ENGINE_SUCCESS, gv->getStatus());
+    EXPECT_TRUE(gv->isPartial());
+    ASSERT_TRUE(gv->item);
+    EXPECT_EQ(k, gv->item->getKey());
+    EXPECT_EQ(cas, gv->item->getCas());
+    EXPECT_FALSE(gv->item->getValue());
+}
+
 class VBucketFullEvictionTest : public VBucketTest {};
 
 // This test aims to ensure the vBucket document count is correct in the
@@ -740,6 +859,29 @@ TEST_P(VBucketFullEvictionTest, MB_30137) {
     EXPECT_EQ(1, vbucket->getNumItems());
 }
 
+// Check that the optimistic read of a key which isn't resident falls back to
+// the locked path, which bg fetches it; under full eviction the key may be on
+// disk even if it isn't in the HashTable.
+TEST_P(VBucketFullEvictionTest, OptimisticGetFallsBackForNonResidentItem) {
+    EXPECT_FALSE(public_getInternalOptimistic(makeStoredDocKey("missing")));
+
+    auto k = makeStoredDocKey("key");
+    ASSERT_EQ(MutationStatus::WasClean, setOne(k));
+    ASSERT_TRUE(public_getInternalOptimistic(k));
+
+    {
+        auto storedItem = vbucket->ht.findForWrite(k);
+        ASSERT_TRUE(storedItem.storedValue);
+        storedItem.storedValue->markClean();
+        ASSERT_TRUE(vbucket->ht.unlocked_ejectItem(storedItem.lock,
+                                                   storedItem.storedValue,
+                                                   getEvictionPolicy()));
+    }
+    EXPECT_FALSE(public_getInternalOptimistic(k));
+    EXPECT_FALSE(public_getInternalOptimistic(
+            k, static_cast<get_options_t>(TRACK_STATISTICS | ALLOW_META_ONLY)));
+}
+
 // Test cases which run for persistent and ephemeral, and for each of their
 // respective eviction policies (Value/Full for persistent, Auto-delete and
 // fail new data for Ephemeral).
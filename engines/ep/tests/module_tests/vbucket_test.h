@@ -121,6 +121,11 @@ protected:
     std::pair<MutationStatus, GetValue> public_getAndUpdateTtl(
             const DocKey& key, time_t exptime);
 
+    /// Public access to getInternalOptimistic(); none if the get would fall
+    /// back to the locked path.
+    boost::optional<GetValue> public_getInternalOptimistic(
+            const DocKey& key, get_options_t options = TRACK_STATISTICS);
+
     SWCompleteTrace swCompleteTrace;
 
     // Mock SyncWriteCompleteCallback that helps in testing client-notify for
@@ -0,0 +1,146 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <cbsasl/domain.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace cb {
+namespace sasl {
+namespace server {
+
+/**
+ * A bounded cache of successful PLAIN authentications.
+ *
+ * When a large number of clients reconnect at the same time (for
+ * instance after a network glitch) every connection would need to be
+ * verified against the password database (or worse, by the external auth
+ * provider). The cache remembers that a given user recently authenticated
+ * with a given password, so that identical credentials may be accepted
+ * without redoing the verification.
+ *
+ * The password itself is never stored; the cache keeps a HMAC of the
+ * credentials keyed with a random secret generated when the cache is
+ * created, and compares it in constant time. An entry is valid for the
+ * configured TTL, and the entire cache is invalidated when the password
+ * database is reloaded.
+ */
+class AuthCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+    };
+
+    static constexpr size_t DefaultCapacity = 10000;
+
+    explicit AuthCache(size_t capacity = DefaultCapacity);
+
+    /// The cache used by the PLAIN mechanism and the external auth
+    static AuthCache& instance();
+
+    /**
+     * Set the time a successful authentication stays in the cache.
+     * A TTL of 0 disables (and empties) the cache.
+     */
+    void setTtl(std::chrono::seconds ttl);
+
+    std::chrono::seconds getTtl() const {
+        return ttl.load();
+    }
+
+    /**
+     * Get the generation of the cache. The generation must be read
+     * _before_ the credentials are verified and passed to insert() so
+     * that a verification racing with a reload of the password database
+     * doesn't get cached.
+     */
+    uint64_t getGeneration() const {
+        return generation.load();
+    }
+
+    /**
+     * Check if the user successfully authenticated with the provided
+     * secret (the password, or the entire PLAIN challenge) within the TTL.
+     */
+    bool lookup(Domain domain,
+                const std::string& username,
+                const std::string& secret,
+                std::chrono::steady_clock::time_point now =
+                        std::chrono::steady_clock::now());
+
+    /**
+     * Remember that the user successfully authenticated with the
+     * provided secret.
+     *
+     * @param generation the generation returned by getGeneration() before
+     *                   the credentials were verified
+     */
+    void insert(uint64_t generation,
+                Domain domain,
+                const std::string& username,
+                const std::string& secret,
+                std::chrono::steady_clock::time_point now =
+                        std::chrono::steady_clock::now());
+
+    /// Drop all entries (called when the password database is reloaded)
+    void invalidate();
+
+    Stats getStats() const;
+
+protected:
+    struct Entry {
+        std::string key;
+        std::string digest;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    std::string makeKey(Domain domain, const std::string& username) const;
+    std::string makeDigest(const std::string& key,
+                           const std::string& secret) const;
+
+    /// Remove the entry pointed to by the iterator (lock must be held)
+    void erase(std::list<Entry>::iterator iter);
+
+    const size_t capacity;
+    /// The key used for the HMAC of the credentials
+    std::string hmacKey;
+    std::atomic<std::chrono::seconds> ttl{std::chrono::seconds{60}};
+    std::atomic<uint64_t> generation{0};
+
+    mutable std::mutex mutex;
+    /// The entries ordered by expiry time (oldest first)
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+};
+
+} // namespace server
+} // namespace sasl
+} // namespace cb
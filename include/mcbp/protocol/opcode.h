@@ -324,6 +324,14 @@ enum class ClientOpcode : uint8_t {
     /// Offer to be an Auth[nz] provider
     AuthProvider = 0xf8,
 
+    /**
+     * Get the metrics for the selected bucket in one response. The key
+     * selects the format: empty (compact binary encoding), "prometheus"
+     * (text exposition format) or "schema" (JSON description of the
+     * metric ids). See docs/Metrics.md
+     */
+    GetMetrics = 0xfa,
+
     /**
      * Drop a privilege from the current privilege set.
      *
@@ -352,6 +352,18 @@ struct dcp_message_producers {
                                     const DocKey& key,
                                     uint64_t prepared_seqno,
                                     uint64_t abort_seqno) = 0;
+
+    /**
+     * DcpIface::step may add more than one message per call to save the
+     * overhead of calling into the engine for every message. Before adding
+     * another message in the same call the engine asks if the connection
+     * wants more (for instance if there is room in its send queue).
+     *
+     * @return true if the engine may add another message in this call
+     */
+    virtual bool want_more_messages() {
+        return false;
+    }
 };
 
 typedef ENGINE_ERROR_CODE (*dcp_add_failover_log)(
@@ -369,6 +381,9 @@ struct MEMCACHED_PUBLIC_CLASS DcpIface {
      * @param producers functions the client may use to add messages to
      *                  the DCP stream
      *
+     * The engine may add multiple messages in a single call as long as
+     * producers->want_more_messages() returns true.
+     *
      * @return The appropriate error code returned from the message
      *         producerif it failed, or:
      *         ENGINE_SUCCESS if the engine don't have more messages
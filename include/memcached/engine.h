@@ -12,6 +12,7 @@
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional_fwd.hpp>
 #include <gsl/gsl>
@@ -21,6 +22,7 @@
 
 #include "memcached/collections.h"
 #include "memcached/config_parser.h"
+#include "memcached/dockey.h"
 #include "memcached/engine_common.h"
 #include "memcached/thread_pool_config.h"
 #include "memcached/types.h"
@@ -32,6 +34,12 @@ class Requirements;
 }
 } // namespace cb
 
+namespace cb {
+namespace metrics {
+class Collector;
+} // namespace metrics
+} // namespace cb
+
 namespace cb {
 namespace mcbp {
 class Request;
@@ -108,6 +116,18 @@ struct EngineErrorCasPair {
     engine_errc status;
     uint64_t cas;
 };
+
+/**
+ * A single lookup within a batch passed to EngineIface::get_multi().
+ */
+struct EngineGetRequest {
+    /// The cookie of the command issuing this lookup. If the lookup returns
+    /// would_block it is this cookie which is notified on completion.
+    const void* cookie;
+    DocKey key;
+    Vbid vbucket;
+    DocStateFilter documentStateFilter;
+};
 } // namespace cb
 
 /**
@@ -333,6 +353,34 @@ struct MEMCACHED_PUBLIC_CLASS EngineIface {
                                         Vbid vbucket,
                                         DocStateFilter documentStateFilter) = 0;
 
+    /**
+     * Retrieve a batch of items.
+     *
+     * The result is the same as calling get() for each request in turn, but
+     * engines may override this to amortise the per-key costs (vBucket
+     * lookup, locking, scheduling of background fetches) over the batch.
+     * Each request carries its own cookie; a request which returns
+     * would_block is completed by notifying that cookie, exactly as for
+     * get().
+     *
+     * Optional interface; the default implementation calls get() per key.
+     *
+     * @param requests the lookups to perform
+     * @return one result per request, in the same order as `requests`
+     */
+    virtual std::vector<cb::EngineErrorItemPair> get_multi(
+            const std::vector<cb::EngineGetRequest>& requests) {
+        std::vector<cb::EngineErrorItemPair> results;
+        results.reserve(requests.size());
+        for (const auto& req : requests) {
+            results.emplace_back(get(req.cookie,
+                                     req.key,
+                                     req.vbucket,
+                                     req.documentStateFilter));
+        }
+        return results;
+    }
+
     /**
      * Optionally retrieve an item. Only non-deleted items may be fetched
      * through this interface (Documents in deleted state may be evicted
@@ -524,6 +572,23 @@ struct MEMCACHED_PUBLIC_CLASS EngineIface {
      */
     virtual void reset_stats(gsl::not_null<const void*> cookie) = 0;
 
+    /**
+     * Get the engine's metrics. Unlike get_stats() the values are added
+     * to the collector without being formatted, and the caller renders
+     * them in the format requested by the client (see
+     * include/memcached/metrics.h).
+     *
+     * Optional interface; engines which don't provide metrics return
+     * not_supported.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param collector Where to add the metrics
+     */
+    virtual cb::engine_errc get_metrics(gsl::not_null<const void*> cookie,
+                                        cb::metrics::Collector& collector) {
+        return cb::engine_errc::not_supported;
+    }
+
     /**
      * Any unknown command will be considered engine specific.
      *
@@ -0,0 +1,148 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <nlohmann/json_fwd.hpp>
+#include <platform/sized_buffer.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class HdrHistogram;
+
+namespace cb {
+namespace metrics {
+
+enum class Type : uint8_t { Counter, Gauge, Histogram };
+
+std::string to_string(Type type);
+
+/**
+ * The static description of a metric. The id identifies the metric in
+ * the binary encoding, so once assigned an id must never be renumbered
+ * or reused for a different metric.
+ */
+struct Definition {
+    uint16_t id;
+    Type type;
+    /// The name of the metric (the Prometheus name without prefix)
+    const char* name;
+    const char* help;
+};
+
+/// The content of a histogram metric
+struct HistogramData {
+    /// The number of values recorded
+    uint64_t count = 0;
+    /// The sum of the values recorded
+    uint64_t sum = 0;
+    /// Pairs of (inclusive upper bound, cumulative count) in ascending order
+    std::vector<std::pair<uint64_t, uint64_t>> buckets;
+};
+
+/// A decoded metric value
+struct Sample {
+    uint16_t id;
+    Type type;
+    /// The value of a counter, or a gauge (as two's complement)
+    uint64_t value = 0;
+    HistogramData histogram;
+};
+
+/**
+ * Collects the current value of a set of metrics without formatting them,
+ * and renders them in one of the formats supported by GetMetrics.
+ *
+ * The collector only keeps a pointer to the Definition so they must have
+ * static storage duration (see engines/ep/src/ep_metrics.def).
+ *
+ * The binary encoding is (all integers in network byte order):
+ *
+ *     uint8_t  version (1)
+ *     uint32_t number of metrics
+ *     for each metric:
+ *         uint16_t id
+ *         uint8_t  type
+ *         Counter:   uint64_t value
+ *         Gauge:     int64_t value
+ *         Histogram: uint64_t count
+ *                    uint64_t sum
+ *                    uint16_t number of buckets
+ *                    for each bucket:
+ *                        uint64_t upper bound (inclusive)
+ *                        uint64_t cumulative count
+ */
+class Collector {
+public:
+    static const uint8_t Version = 1;
+
+    void reserve(size_t size) {
+        entries.reserve(size);
+    }
+
+    void addCounter(const Definition& definition, uint64_t value);
+
+    void addGauge(const Definition& definition, int64_t value);
+
+    /// Add a histogram with power-of-two buckets
+    void addHistogram(const Definition& definition,
+                      const HdrHistogram& histogram);
+
+    void addHistogram(const Definition& definition, HistogramData data);
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    /// Render the metrics in the binary encoding
+    std::string toBinary() const;
+
+    /**
+     * Render the metrics in the Prometheus text exposition format
+     *
+     * @param prefix prepended to all metric names
+     * @param labels labels to add to all samples (ex: bucket="default")
+     */
+    std::string toPrometheus(const std::string& prefix,
+                             const std::string& labels) const;
+
+    /// Get a description (id, name, type and help) of the metrics
+    nlohmann::json toSchema() const;
+
+    /**
+     * Decode metrics in the binary encoding
+     *
+     * @throws std::invalid_argument if the encoding is invalid
+     */
+    static std::vector<Sample> decode(cb::const_char_buffer encoded);
+
+protected:
+    struct Entry {
+        const Definition* definition;
+        /// The value for counters and gauges, and the index in histograms
+        /// for histograms
+        uint64_t value;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<HistogramData> histograms;
+};
+
+} // namespace metrics
+} // namespace cb
@@ -48,6 +48,13 @@ enum class Code : uint8_t {
     SyncWriteAckLocal,
     /// Time when a SyncWrite replica ACK is received by the Active.
     SyncWriteAckRemote,
+    /// Time spent by the front end decoding and validating the request
+    Parse,
+    /// Time spent in the command executor (one span per (re)execution)
+    Execute,
+    /// Time spent formatting the response and adding it to the connections
+    /// send queue
+    Send,
 };
 
 using SpanId = std::size_t;
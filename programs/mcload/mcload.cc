@@ -0,0 +1,930 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * mcload - an open-loop load generator for memcached.
+ *
+ * Unlike a closed-loop client (which sends the next request when the
+ * previous one completes, and hence slows down when the server does),
+ * mcload sends requests on a fixed schedule derived from the requested
+ * rate. The latency of each operation is measured from the time it was
+ * _scheduled_ to be sent rather than from when it was actually sent, so
+ * that any time a request spent queued behind a slow one (on the client
+ * or the server) is included in the numbers instead of being silently
+ * omitted ("coordinated omission"). The uncorrected service time (from
+ * the actual send) is reported alongside for comparison.
+ *
+ * The result is written as JSON so that runs against different builds
+ * can be compared mechanically.
+ */
+
+#include <getopt.h>
+#include <mcbp/protocol/header.h>
+#include <mcbp/protocol/request.h>
+#include <mcbp/protocol/response.h>
+#include <memcached/protocol_binary.h>
+#include <nlohmann/json.hpp>
+#include <openssl/bio.h>
+#include <programs/getpass.h>
+#include <programs/hostname_utils.h>
+#include <protocol/connection/client_connection.h>
+#include <protocol/connection/client_mcbp_commands.h>
+#include <utilities/hdrhistogram.h>
+#include <utilities/terminate_handler.h>
+
+#include <poll.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+/// Latencies above this value (in microseconds) are clamped
+static const uint64_t MaxLatency = 60 * 1000 * 1000;
+
+enum class OpType : uint8_t { Get, Set, Subdoc, Dcp };
+static const size_t NumOpTypes = 4;
+
+static const char* to_string(OpType type) {
+    switch (type) {
+    case OpType::Get:
+        return "get";
+    case OpType::Set:
+        return "set";
+    case OpType::Subdoc:
+        return "subdoc";
+    case OpType::Dcp:
+        return "dcp";
+    }
+    return "invalid";
+}
+
+struct Config {
+    std::string host{"localhost"};
+    std::string port{"11210"};
+    std::string user;
+    std::string password;
+    std::string bucket;
+    std::string ssl_cert;
+    std::string ssl_key;
+    std::string output;
+    sa_family_t family = AF_UNSPEC;
+    bool secure = false;
+
+    size_t threads = 1;
+    size_t connections = 1;
+    double rate = 1000;
+    std::chrono::seconds duration{10};
+    std::chrono::seconds warmup{0};
+    size_t keys = 10000;
+    size_t valueSize = 256;
+    size_t window = 256;
+    size_t vbuckets = 1;
+    bool populate = false;
+    bool dcp = false;
+    /// Percentage of get, set and subdoc operations
+    std::array<unsigned int, 3> mix{{100, 0, 0}};
+
+    nlohmann::json to_json() const {
+        return {{"host", host},
+                {"port", port},
+                {"bucket", bucket},
+                {"ssl", secure},
+                {"threads", threads},
+                {"connections", connections},
+                {"rate", rate},
+                {"duration", duration.count()},
+                {"warmup", warmup.count()},
+                {"keys", keys},
+                {"value_size", valueSize},
+                {"window", window},
+                {"vbuckets", vbuckets},
+                {"dcp", dcp},
+                {"mix",
+                 {{"get", mix[0]}, {"set", mix[1]}, {"subdoc", mix[2]}}}};
+    }
+};
+
+/**
+ * Latency and outcome counters for one operation type.
+ */
+struct OpStats {
+    OpStats() : latency(1, MaxLatency, 3), service(1, MaxLatency, 3) {
+    }
+
+    void record(Clock::time_point intended,
+                Clock::time_point sent,
+                Clock::time_point now) {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        ++count;
+        latency.addValue(std::min(
+                uint64_t(duration_cast<microseconds>(now - intended).count()),
+                MaxLatency));
+        service.addValue(std::min(
+                uint64_t(duration_cast<microseconds>(now - sent).count()),
+                MaxLatency));
+    }
+
+    OpStats& operator+=(const OpStats& other) {
+        latency += other.latency;
+        service += other.service;
+        count += other.count;
+        errors += other.errors;
+        misses += other.misses;
+        return *this;
+    }
+
+    static nlohmann::json to_json(const HdrHistogram& histogram) {
+        if (histogram.getValueCount() == 0) {
+            return nullptr;
+        }
+        return {{"min", histogram.getMinValue()},
+                {"mean", histogram.getMean()},
+                {"p50", histogram.getValueAtPercentile(50)},
+                {"p90", histogram.getValueAtPercentile(90)},
+                {"p99", histogram.getValueAtPercentile(99)},
+                {"p99.9", histogram.getValueAtPercentile(99.9)},
+                {"p99.99", histogram.getValueAtPercentile(99.99)},
+                {"max", histogram.getMaxValue()}};
+    }
+
+    nlohmann::json to_json(double seconds) const {
+        return {{"count", count},
+                {"errors", errors},
+                {"misses", misses},
+                {"throughput", seconds > 0 ? count / seconds : 0},
+                {"latency_us", to_json(latency)},
+                {"service_time_us", to_json(service)}};
+    }
+
+    /// Latency from the time the operation was scheduled
+    HdrHistogram latency;
+    /// Latency from the time the operation was actually sent
+    HdrHistogram service;
+    uint64_t count = 0;
+    uint64_t errors = 0;
+    uint64_t misses = 0;
+};
+
+using Results = std::array<OpStats, NumOpTypes>;
+
+/**
+ * MemcachedConnection giving access to what's needed to multiplex many
+ * connections in one thread with poll().
+ */
+class LoadConnection : public MemcachedConnection {
+public:
+    using MemcachedConnection::MemcachedConnection;
+
+    SOCKET getSocket() const {
+        return sock;
+    }
+
+    /// Has the TLS layer buffered data which poll() can't see?
+    bool hasBufferedData() const {
+        return bio != nullptr && BIO_pending(bio) > 0;
+    }
+};
+
+static std::unique_ptr<LoadConnection> createConnection(
+        const Config& config, const std::string& name) {
+    in_port_t port;
+    sa_family_t family;
+    std::string host;
+    std::tie(host, port, family) =
+            cb::inet::parse_hostname(config.host, config.port);
+    if (config.family != AF_UNSPEC) {
+        family = config.family;
+    }
+
+    auto ret = std::make_unique<LoadConnection>(
+            host, port, family, config.secure);
+    ret->setSslCertFile(config.ssl_cert);
+    ret->setSslKeyFile(config.ssl_key);
+    ret->connect();
+    // MEMCACHED_VERSION contains the git sha
+    ret->hello(name, MEMCACHED_VERSION, "open-loop load generator");
+    ret->setXerrorSupport(true);
+    if (!config.user.empty()) {
+        ret->authenticate(
+                config.user, config.password, ret->getSaslMechanisms());
+    }
+    if (!config.bucket.empty()) {
+        ret->selectBucket(config.bucket);
+    }
+    return ret;
+}
+
+static std::string makeKey(size_t index) {
+    return "mcload-" + std::to_string(index);
+}
+
+static Vbid makeVbid(const Config& config, const std::string& key) {
+    return Vbid(std::hash<std::string>()(key) % config.vbuckets);
+}
+
+/**
+ * Create a JSON document carrying the time the mutation was scheduled at,
+ * so that DCP consumers can measure the replication latency.
+ */
+static std::string makeValue(const Config& config, Clock::time_point time) {
+    std::string ret = R"({"ts":)" +
+                      std::to_string(time.time_since_epoch().count()) +
+                      R"(,"pad":")";
+    if (ret.size() + 2 < config.valueSize) {
+        ret.append(config.valueSize - ret.size() - 2, 'x');
+    }
+    ret.append(R"("})");
+    return ret;
+}
+
+/// Extract the timestamp written by makeValue (0 if not present)
+static Clock::rep parseTimestamp(cb::const_byte_buffer value) {
+    const std::string prefix = R"({"ts":)";
+    if (value.size() <= prefix.size() ||
+        !std::equal(prefix.begin(), prefix.end(), value.begin())) {
+        return 0;
+    }
+    Clock::rep ret = 0;
+    for (auto it = value.begin() + prefix.size();
+         it != value.end() && *it >= '0' && *it <= '9';
+         ++it) {
+        ret = ret * 10 + (*it - '0');
+    }
+    return ret;
+}
+
+/**
+ * Store all of the keys in the key space (closed loop, pipelined) so
+ * that gets and subdoc lookups hit.
+ */
+static void populate(const Config& config,
+                     LoadConnection& connection,
+                     size_t first,
+                     size_t last) {
+    const auto value = makeValue(config, Clock::time_point{});
+    const size_t batch = 100;
+    Frame frame;
+    for (size_t ii = first; ii < last; ii += batch) {
+        const auto end = std::min(last, ii + batch);
+        for (size_t jj = ii; jj < end; ++jj) {
+            BinprotMutationCommand cmd;
+            const auto key = makeKey(jj);
+            cmd.setMutationType(MutationType::Set);
+            cmd.setKey(key);
+            cmd.setVBucket(makeVbid(config, key));
+            cmd.addValueBuffer({reinterpret_cast<const uint8_t*>(value.data()),
+                                value.size()});
+            frame.reset();
+            cmd.encode(frame.payload);
+            connection.sendFrame(frame);
+        }
+        for (size_t jj = ii; jj < end; ++jj) {
+            connection.recvFrame(frame);
+            const auto status = frame.getResponse()->getStatus();
+            if (status != cb::mcbp::Status::Success) {
+                throw std::runtime_error("populate: Failed to store " +
+                                         makeKey(jj) + ": " +
+                                         to_string(status));
+            }
+        }
+    }
+}
+
+/**
+ * A worker thread drives a set of connections from a single poll() loop.
+ * Each connection sends requests on its own fixed schedule.
+ */
+class Worker {
+public:
+    Worker(const Config& config, size_t id, size_t firstConnection)
+        : config(config), id(id), random(id) {
+        const auto perThread = config.connections / config.threads +
+                               (id < config.connections % config.threads);
+        const std::chrono::duration<double> interval(config.connections /
+                                                     config.rate);
+        for (size_t ii = 0; ii < perThread; ++ii) {
+            clients.emplace_back();
+            auto& client = clients.back();
+            client.connection = createConnection(
+                    config, "mcload-" + std::to_string(firstConnection + ii));
+            client.interval =
+                    std::chrono::duration_cast<Clock::duration>(interval);
+            // Spread the connections evenly over the interval
+            client.offset = std::chrono::duration_cast<Clock::duration>(
+                    interval * double(firstConnection + ii) /
+                    double(config.connections));
+        }
+
+        if (config.dcp) {
+            setupDcp();
+        }
+    }
+
+    void populate(size_t first, size_t last) {
+        ::populate(config, *clients.front().connection, first, last);
+    }
+
+    void start(Clock::time_point begin, Clock::time_point measure,
+               Clock::time_point end) {
+        thread = std::thread([this, begin, measure, end]() {
+            run(begin, measure, end);
+        });
+    }
+
+    void join() {
+        thread.join();
+    }
+
+    const Results& getResults() const {
+        return results;
+    }
+
+    /// Operations which were scheduled but never sent before the end
+    uint64_t getUnsent() const {
+        return unsent;
+    }
+
+protected:
+    struct Pending {
+        uint32_t opaque;
+        OpType type;
+        Clock::time_point intended;
+        Clock::time_point sent;
+    };
+
+    struct Client {
+        std::unique_ptr<LoadConnection> connection;
+        Clock::duration interval;
+        Clock::duration offset;
+        Clock::time_point next;
+        uint32_t opaque = 0;
+        std::deque<Pending> pending;
+    };
+
+    void setupDcp() {
+        dcp = createConnection(config, "mcload-dcp-" + std::to_string(id));
+        std::vector<std::pair<Vbid, nlohmann::json>> streams;
+        for (size_t vb = id; vb < config.vbuckets; vb += config.threads) {
+            const Vbid vbid(vb);
+            streams.emplace_back(vbid,
+                                 dcp->stats("vbucket-seqno " +
+                                            std::to_string(vb)));
+        }
+
+        BinprotDcpOpenCommand open("mcload-dcp-" + std::to_string(id));
+        open.makeProducer();
+        const auto rsp = dcp->execute(open);
+        if (!rsp.isSuccess()) {
+            throw ConnectionError("Failed to open DCP producer", rsp);
+        }
+
+        // Stream everything from "now" on. The responses are handled by
+        // the main loop as DCP messages may arrive before the last one.
+        Frame frame;
+        for (const auto& stream : streams) {
+            const auto prefix = "vb_" + std::to_string(stream.first.get());
+            const auto seqno =
+                    stream.second[prefix + ":high_seqno"].get<uint64_t>();
+            BinprotDcpStreamRequestCommand req;
+            req.setDcpStartSeqno(seqno)
+                    .setDcpSnapStartSeqno(seqno)
+                    .setDcpSnapEndSeqno(seqno)
+                    .setDcpVbucketUuid(
+                            stream.second[prefix + ":uuid"].get<uint64_t>());
+            req.setVBucket(stream.first);
+            frame.reset();
+            req.encode(frame.payload);
+            dcp->sendFrame(frame);
+        }
+    }
+
+    OpType pickOperation() {
+        const auto dice = std::uniform_int_distribution<unsigned int>(
+                0, 99)(random);
+        if (dice < config.mix[0]) {
+            return OpType::Get;
+        } else if (dice < config.mix[0] + config.mix[1]) {
+            return OpType::Set;
+        }
+        return OpType::Subdoc;
+    }
+
+    void send(Client& client, Clock::time_point intended) {
+        const auto type = pickOperation();
+        const auto key = makeKey(std::uniform_int_distribution<size_t>(
+                0, config.keys - 1)(random));
+        const auto vbid = makeVbid(config, key);
+        const auto opaque = client.opaque++;
+
+        frame.reset();
+        switch (type) {
+        case OpType::Get: {
+            BinprotGetCommand cmd;
+            cmd.setKey(key);
+            cmd.setVBucket(vbid);
+            cmd.setOpaque(opaque);
+            cmd.encode(frame.payload);
+            break;
+        }
+        case OpType::Set: {
+            const auto value = makeValue(config, intended);
+            BinprotMutationCommand cmd;
+            cmd.setMutationType(MutationType::Set);
+            cmd.setKey(key);
+            cmd.setVBucket(vbid);
+            cmd.setOpaque(opaque);
+            cmd.addValueBuffer({reinterpret_cast<const uint8_t*>(value.data()),
+                                value.size()});
+            cmd.encode(frame.payload);
+            break;
+        }
+        case OpType::Subdoc: {
+            BinprotSubdocCommand cmd(
+                    cb::mcbp::ClientOpcode::SubdocGet, key, "ts");
+            cmd.setVBucket(vbid);
+            cmd.setOpaque(opaque);
+            cmd.encode(frame.payload);
+            break;
+        }
+        case OpType::Dcp:
+            throw std::logic_error("Worker::send: can't send a DCP operation");
+        }
+
+        client.connection->sendFrame(frame);
+        client.pending.push_back({opaque, type, intended, Clock::now()});
+    }
+
+    void receive(Client& client) {
+        do {
+            client.connection->recvFrame(frame);
+            const auto now = Clock::now();
+            const auto* response = frame.getResponse();
+            if (client.pending.empty() ||
+                client.pending.front().opaque != response->getOpaque()) {
+                throw std::runtime_error(
+                        "Worker::receive: Unexpected response with opaque " +
+                        std::to_string(response->getOpaque()));
+            }
+            const auto op = client.pending.front();
+            client.pending.pop_front();
+            if (op.intended < measureStart) {
+                continue;
+            }
+
+            auto& stats = results[size_t(op.type)];
+            stats.record(op.intended, op.sent, now);
+            const auto status = response->getStatus();
+            if (status == cb::mcbp::Status::KeyEnoent) {
+                ++stats.misses;
+            } else if (status != cb::mcbp::Status::Success) {
+                ++stats.errors;
+            }
+        } while (client.connection->hasBufferedData());
+    }
+
+    void receiveDcp() {
+        do {
+            dcp->recvFrame(frame);
+            const auto now = Clock::now();
+            const auto magic = frame.getMagic();
+            if (magic == cb::mcbp::Magic::ClientResponse ||
+                magic == cb::mcbp::Magic::AltClientResponse) {
+                const auto* response = frame.getResponse();
+                if (response->getStatus() != cb::mcbp::Status::Success) {
+                    ++results[size_t(OpType::Dcp)].errors;
+                    std::cerr << "DCP "
+                              << to_string(response->getClientOpcode())
+                              << " failed: "
+                              << to_string(response->getStatus())
+                              << std::endl;
+                }
+                continue;
+            }
+
+            const auto* request = frame.getRequest();
+            if (request->getClientOpcode() !=
+                cb::mcbp::ClientOpcode::DcpMutation) {
+                continue;
+            }
+            const Clock::time_point intended(
+                    Clock::duration(parseTimestamp(request->getValue())));
+            if (intended >= measureStart) {
+                results[size_t(OpType::Dcp)].record(intended, intended, now);
+            }
+        } while (dcp->hasBufferedData());
+    }
+
+    void run(Clock::time_point begin,
+             Clock::time_point measure,
+             Clock::time_point end) {
+        measureStart = measure;
+        for (auto& client : clients) {
+            client.next = begin + client.offset;
+        }
+
+        std::vector<pollfd> fds(clients.size() + (dcp ? 1 : 0));
+        for (size_t ii = 0; ii < clients.size(); ++ii) {
+            fds[ii].fd = clients[ii].connection->getSocket();
+            fds[ii].events = POLLIN;
+        }
+        if (dcp) {
+            fds.back().fd = dcp->getSocket();
+            fds.back().events = POLLIN;
+        }
+
+        // Keep running until the end, and then until the outstanding
+        // operations complete (or we give up on them).
+        const auto deadline = end + 5s;
+        while (true) {
+            auto now = Clock::now();
+            bool sending = now < end;
+            bool outstanding = false;
+            auto wakeup = sending ? end : deadline;
+            for (auto& client : clients) {
+                while (sending && client.next <= now &&
+                       client.pending.size() < config.window) {
+                    send(client, client.next);
+                    client.next += client.interval;
+                }
+                if (sending && client.pending.size() < config.window) {
+                    wakeup = std::min(wakeup, client.next);
+                }
+                outstanding |= !client.pending.empty();
+            }
+
+            if ((!sending && !outstanding) || now >= deadline) {
+                break;
+            }
+
+            // poll() only has millisecond resolution; spin rather than
+            // oversleep when the next send is due sooner than that.
+            now = Clock::now();
+            int timeout = 0;
+            if (wakeup > now + 1ms) {
+                timeout = int(std::chrono::duration_cast<
+                                      std::chrono::milliseconds>(wakeup - now)
+                                      .count());
+            }
+            if (::poll(fds.data(), fds.size(), timeout) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno,
+                                        std::system_category(),
+                                        "Worker::run: poll() failed");
+            }
+
+            for (size_t ii = 0; ii < clients.size(); ++ii) {
+                if (fds[ii].revents != 0) {
+                    receive(clients[ii]);
+                }
+            }
+            if (dcp && fds.back().revents != 0) {
+                receiveDcp();
+            }
+        }
+
+        for (const auto& client : clients) {
+            if (client.next < end) {
+                unsent += (end - client.next) / client.interval + 1;
+            }
+            unsent += client.pending.size();
+        }
+    }
+
+    const Config& config;
+    const size_t id;
+    std::mt19937_64 random;
+    std::vector<Client> clients;
+    std::unique_ptr<LoadConnection> dcp;
+    Clock::time_point measureStart;
+    Frame frame;
+    Results results;
+    uint64_t unsent = 0;
+    std::thread thread;
+};
+
+static std::array<unsigned int, 3> parseMix(const std::string& spec) {
+    std::array<unsigned int, 3> ret{{0, 0, 0}};
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        auto end = spec.find(',', pos);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        const auto entry = spec.substr(pos, end - pos);
+        const auto eq = entry.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("Invalid mix entry: " + entry);
+        }
+        const auto name = entry.substr(0, eq);
+        const auto value = std::stoul(entry.substr(eq + 1));
+        if (name == "get") {
+            ret[0] = value;
+        } else if (name == "set") {
+            ret[1] = value;
+        } else if (name == "subdoc") {
+            ret[2] = value;
+        } else {
+            throw std::invalid_argument("Unknown operation in mix: " + name);
+        }
+        pos = end + 1;
+    }
+    if (ret[0] + ret[1] + ret[2] != 100) {
+        throw std::invalid_argument("The mix must add up to 100");
+    }
+    return ret;
+}
+
+static void usage() {
+    std::cerr << R"(Usage: mcload [options]
+
+Generate an open-loop (fixed rate) workload and report the latencies
+measured from the time each operation was scheduled, as JSON.
+
+Options:
+
+  -h or --host hostname[:port]   The host (with an optional port) to connect to
+                                 (for IPv6 use: [address]:port if you'd like to
+                                 specify port)
+  -p or --port port              The port number to connect to
+  -b or --bucket bucketname      The name of the bucket to operate on
+  -u or --user username          The name of the user to authenticate as
+  -P or --password password      The password to use for authentication
+                                 (use '-' to read from standard input)
+  -s or --ssl                    Connect to the server over SSL
+  -C or --ssl-cert filename      Read the SSL certificate from the specified file
+  -K or --ssl-key filename       Read the SSL private key from the specified file
+  -4 or --ipv4                   Connect over IPv4
+  -6 or --ipv6                   Connect over IPv6
+  -t or --threads num            The number of worker threads (default 1)
+  -c or --connections num        The total number of connections (default 1)
+  -r or --rate ops               Total operations per second (default 1000)
+  -d or --duration seconds       The length of the run (default 10)
+  -w or --warmup seconds         Initial part of the run to leave out of the
+                                 results (default 0)
+  -k or --keys num               The size of the key space (default 10000)
+  -v or --value-size bytes       The size of the documents (default 256)
+  -m or --mix spec               Operation mix in percent
+                                 (default get=100,set=0,subdoc=0)
+  -W or --window num             Max outstanding operations per connection
+                                 (default 256)
+  -V or --vbuckets num           Spread the keys over this many vbuckets
+                                 (default 1)
+  -D or --dcp                    Stream the vbuckets over DCP and report the
+                                 delay until the sets are received
+  -L or --populate               Store all the keys before starting the run
+  -o or --output filename        Write the result to a file instead of stdout
+  --help                         This help text
+)";
+
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    // Make sure that we dump callstacks on the console
+    install_backtrace_terminate_handler();
+
+    Config config;
+    int cmd;
+
+    /* Initialize the socket subsystem */
+    cb_initialize_sockets();
+
+    struct option long_options[] = {
+            {"ipv4", no_argument, nullptr, '4'},
+            {"ipv6", no_argument, nullptr, '6'},
+            {"host", required_argument, nullptr, 'h'},
+            {"port", required_argument, nullptr, 'p'},
+            {"bucket", required_argument, nullptr, 'b'},
+            {"password", required_argument, nullptr, 'P'},
+            {"user", required_argument, nullptr, 'u'},
+            {"ssl", no_argument, nullptr, 's'},
+            {"ssl-cert", required_argument, nullptr, 'C'},
+            {"ssl-key", required_argument, nullptr, 'K'},
+            {"threads", required_argument, nullptr, 't'},
+            {"connections", required_argument, nullptr, 'c'},
+            {"rate", required_argument, nullptr, 'r'},
+            {"duration", required_argument, nullptr, 'd'},
+            {"warmup", required_argument, nullptr, 'w'},
+            {"keys", required_argument, nullptr, 'k'},
+            {"value-size", required_argument, nullptr, 'v'},
+            {"mix", required_argument, nullptr, 'm'},
+            {"window", required_argument, nullptr, 'W'},
+            {"vbuckets", required_argument, nullptr, 'V'},
+            {"dcp", no_argument, nullptr, 'D'},
+            {"populate", no_argument, nullptr, 'L'},
+            {"output", required_argument, nullptr, 'o'},
+            {"help", no_argument, nullptr, 0},
+            {nullptr, 0, nullptr, 0}};
+
+    try {
+        while ((cmd = getopt_long(argc,
+                                  argv,
+                                  "46h:p:u:b:P:sC:K:t:c:r:d:w:k:v:m:W:V:DLo:",
+                                  long_options,
+                                  nullptr)) != EOF) {
+            switch (cmd) {
+            case '6':
+                config.family = AF_INET6;
+                break;
+            case '4':
+                config.family = AF_INET;
+                break;
+            case 'h':
+                config.host.assign(optarg);
+                break;
+            case 'p':
+                config.port.assign(optarg);
+                break;
+            case 'b':
+                config.bucket.assign(optarg);
+                break;
+            case 'u':
+                config.user.assign(optarg);
+                break;
+            case 'P':
+                config.password.assign(optarg);
+                break;
+            case 's':
+                config.secure = true;
+                break;
+            case 'C':
+                config.ssl_cert.assign(optarg);
+                break;
+            case 'K':
+                config.ssl_key.assign(optarg);
+                break;
+            case 't':
+                config.threads = std::stoul(optarg);
+                break;
+            case 'c':
+                config.connections = std::stoul(optarg);
+                break;
+            case 'r':
+                config.rate = std::stod(optarg);
+                break;
+            case 'd':
+                config.duration = std::chrono::seconds(std::stoul(optarg));
+                break;
+            case 'w':
+                config.warmup = std::chrono::seconds(std::stoul(optarg));
+                break;
+            case 'k':
+                config.keys = std::stoul(optarg);
+                break;
+            case 'v':
+                config.valueSize = std::stoul(optarg);
+                break;
+            case 'm':
+                config.mix = parseMix(optarg);
+                break;
+            case 'W':
+                config.window = std::stoul(optarg);
+                break;
+            case 'V':
+                config.vbuckets = std::stoul(optarg);
+                break;
+            case 'D':
+                config.dcp = true;
+                break;
+            case 'L':
+                config.populate = true;
+                break;
+            case 'o':
+                config.output.assign(optarg);
+                break;
+            default:
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (config.threads == 0 || config.connections < config.threads ||
+        config.rate <= 0 || config.keys == 0 || config.window == 0 ||
+        config.vbuckets == 0) {
+        std::cerr << "mcload: need at least one connection per thread, and "
+                     "a positive rate, key space, window and vbucket count"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (config.password == "-") {
+        config.password.assign(getpass());
+    } else if (config.password.empty()) {
+        const char* env_password = std::getenv("CB_PASSWORD");
+        if (env_password) {
+            config.password = env_password;
+        }
+    }
+
+    try {
+        std::vector<std::unique_ptr<Worker>> workers;
+        size_t first = 0;
+        for (size_t ii = 0; ii < config.threads; ++ii) {
+            workers.emplace_back(std::make_unique<Worker>(config, ii, first));
+            first += config.connections / config.threads +
+                     (ii < config.connections % config.threads);
+        }
+
+        if (config.populate) {
+            std::vector<std::thread> threads;
+            const auto perThread =
+                    (config.keys + config.threads - 1) / config.threads;
+            for (size_t ii = 0; ii < config.threads; ++ii) {
+                const auto begin = std::min(config.keys, ii * perThread);
+                const auto end = std::min(config.keys, begin + perThread);
+                threads.emplace_back([&workers, ii, begin, end]() {
+                    workers[ii]->populate(begin, end);
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+        }
+
+        // Give all of the threads the same schedule
+        const auto begin = Clock::now() + 100ms;
+        const auto measure = begin + config.warmup;
+        const auto end = measure + config.duration;
+        for (auto& w : workers) {
+            w->start(begin, measure, end);
+        }
+        for (auto& w : workers) {
+            w->join();
+        }
+
+        Results total;
+        uint64_t unsent = 0;
+        for (const auto& w : workers) {
+            for (size_t ii = 0; ii < NumOpTypes; ++ii) {
+                total[ii] += w->getResults()[ii];
+            }
+            unsent += w->getUnsent();
+        }
+
+        const double seconds =
+                std::chrono::duration<double>(config.duration).count();
+        nlohmann::json json;
+        json["version"] = MEMCACHED_VERSION;
+        json["config"] = config.to_json();
+        json["unsent"] = unsent;
+        uint64_t completed = 0;
+        for (size_t ii = 0; ii < NumOpTypes; ++ii) {
+            if (total[ii].count == 0) {
+                continue;
+            }
+            json["ops"][to_string(OpType(ii))] = total[ii].to_json(seconds);
+            if (OpType(ii) != OpType::Dcp) {
+                completed += total[ii].count;
+            }
+        }
+        json["throughput"] = completed / seconds;
+
+        if (config.output.empty()) {
+            std::cout << json.dump(4) << std::endl;
+        } else {
+            std::ofstream out(config.output);
+            out << json.dump(4) << std::endl;
+        }
+    } catch (const ConnectionError& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
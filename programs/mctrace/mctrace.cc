@@ -31,6 +31,9 @@
 #include <programs/hostname_utils.h>
 #include <protocol/connection/client_connection.h>
 
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <iostream>
@@ -46,6 +49,49 @@ static void sigint_handler() {
     caughtSigInt = true;
 }
 
+/// Block until the user press ctrl-c
+static void waitForSigint() {
+    // Register our SIGINT handler
+    cb::console::set_sigint_handler(sigint_handler);
+
+    do {
+        // In the ideal world we'd use a condition variable to do this
+        // so we can bail out quickly. Unfortunately it's illegal to do
+        // that from a signal handler.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    } while (!caughtSigInt);
+}
+
+/**
+ * Fetch the content of the request trace rings from the server
+ *
+ * @param connection the connection to the server
+ * @param since ignore records for requests started before this time
+ *              (µs since epoch)
+ * @return a JSON array with the records from all threads ordered by
+ *         the time the request started
+ */
+static nlohmann::json getRequestTraces(MemcachedConnection& connection,
+                                       uint64_t since) {
+    const auto stats = connection.stats("request_traces");
+    auto records = nlohmann::json::array();
+    for (const auto& thread : stats.items()) {
+        for (auto record : thread.value()) {
+            if (record["timestamp"].get<uint64_t>() >= since) {
+                record["thread"] = std::stoi(thread.key());
+                records.push_back(std::move(record));
+            }
+        }
+    }
+    std::sort(records.begin(),
+              records.end(),
+              [](const nlohmann::json& a, const nlohmann::json& b) {
+                  return a["timestamp"].get<uint64_t>() <
+                         b["timestamp"].get<uint64_t>();
+              });
+    return records;
+}
+
 static void usage() {
     static const char* text = R"(Usage: mctrace [options]
 
@@ -69,11 +115,16 @@ Options:
                       when the program terminates).
                       ex:
                       "buffer-mode:ring;buffer-size:2000000;enabled-categories:*"
+    --requests / -r   Dump the per-request trace breakdown of the sampled
+                      and slow requests kept by the server (see
+                      "stats request_traces") instead of the phosphor trace.
     --output / -o     Store the trace information in the named file.
     --wait / -w       Wait until the user press ctrl-c before returning the
                       data. This option clears the data on the server before
                       waiting for the user to press ctrl-c and may be used
-                      to get information for a known window of time.
+                      to get information for a known window of time. (With
+                      --requests only requests started after the program
+                      was started are returned)
     --help            This help text
 
 )";
@@ -95,6 +146,7 @@ int main(int argc, char** argv) {
     std::string trace_config;
     std::string output("-");
     bool interactive = false;
+    bool requests = false;
 
     /* Initialize the socket subsystem */
     cb_initialize_sockets();
@@ -110,11 +162,12 @@ int main(int argc, char** argv) {
             {"config", required_argument, nullptr, 'c'},
             {"output", required_argument, nullptr, 'o'},
             {"wait", no_argument, nullptr, 'w'},
+            {"requests", no_argument, nullptr, 'r'},
             {"help", no_argument, nullptr, 0},
             {nullptr, 0, nullptr, 0}};
 
     while ((cmd = getopt_long(
-                    argc, argv, "46h:p:u:P:sc:o:w", long_options, nullptr)) !=
+                    argc, argv, "46h:p:u:P:sc:o:wr", long_options, nullptr)) !=
            EOF) {
         switch (cmd) {
         case '6':
@@ -169,6 +222,9 @@ int main(int argc, char** argv) {
         case 'w':
             interactive = true;
             break;
+        case 'r':
+            requests = true;
+            break;
         default:
             usage();
         }
@@ -217,34 +273,41 @@ int main(int argc, char** argv) {
                     user, password, connection.getSaslMechanisms());
         }
 
-        if (!trace_config.empty()) {
-            // Start the trace
-            connection.ioctl_set("trace.config", trace_config);
-            connection.ioctl_set("trace.start", {});
+        uint64_t since = 0;
+        if (requests) {
+            // The request trace rings are always on; there is nothing
+            // to configure
+            if (interactive) {
+                since = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::system_clock::now()
+                                        .time_since_epoch())
+                                .count();
+                std::cerr << "Press CTRL-C to stop trace" << std::endl;
+                waitForSigint();
+            }
         } else {
-            if (connection.ioctl_get("trace.status") != "enabled") {
-                std::cerr << "Trace is not running. Specify a configuration."
-                          << std::endl;
-                exit(EXIT_FAILURE);
+            if (!trace_config.empty()) {
+                // Start the trace
+                connection.ioctl_set("trace.config", trace_config);
+                connection.ioctl_set("trace.start", {});
+            } else {
+                if (connection.ioctl_get("trace.status") != "enabled") {
+                    std::cerr
+                            << "Trace is not running. Specify a configuration."
+                            << std::endl;
+                    exit(EXIT_FAILURE);
+                }
             }
-        }
 
-        if (interactive) {
-            // Clear the trace by stopping and starting it
-            connection.ioctl_set("trace.stop", {});
-            connection.ioctl_set("trace.start", {});
-
-            // Register our SIGINT handler
-            cb::console::set_sigint_handler(sigint_handler);
-
-            std::cerr << "Press CTRL-C to stop trace" << std::endl;
-            // Wait for the trace to automatically stop or ctrl+c
-            do {
-                // In the ideal world we'd use a condition variable to do this
-                // so we can bail out quickly. Unfortunately it's illegal to do
-                // that from a signal handler.
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            } while (!caughtSigInt);
+            if (interactive) {
+                // Clear the trace by stopping and starting it
+                connection.ioctl_set("trace.stop", {});
+                connection.ioctl_set("trace.start", {});
+
+                std::cerr << "Press CTRL-C to stop trace" << std::endl;
+                // Wait for the trace to automatically stop or ctrl+c
+                waitForSigint();
+            }
         }
 
         FILE* destination = stdout;
@@ -259,6 +322,16 @@ int main(int argc, char** argv) {
             }
         }
 
+        if (requests) {
+            const auto records = getRequestTraces(connection, since).dump();
+            fwrite(records.data(), records.size(), 1, destination);
+            fprintf(destination, "\n");
+            if (destination != stdout) {
+                fclose(destination);
+            }
+            return EXIT_SUCCESS;
+        }
+
         // Start a dump
         auto uuid = connection.ioctl_get("trace.dump.begin");
         const std::string chunk_key = "trace.dump.chunk?id=" + uuid;
@@ -1238,6 +1238,17 @@ void MemcachedConnection::ioctl_set(const std::string& key,
     }
 }
 
+std::string MemcachedConnection::getMetrics(const std::string& format,
+                                            GetFrameInfoFunction getFrameInfo) {
+    BinprotGenericCommand command(cb::mcbp::ClientOpcode::GetMetrics, format);
+    applyFrameInfos(command, getFrameInfo);
+    const auto response = execute(command);
+    if (!response.isSuccess()) {
+        throw ConnectionError("getMetrics '" + format + "' failed", response);
+    }
+    return response.getDataString();
+}
+
 uint64_t MemcachedConnection::increment(const std::string& key,
                                         uint64_t delta,
                                         uint64_t initial,
@@ -641,6 +641,16 @@ public:
                    const std::string& value,
                    GetFrameInfoFunction getFrameInfo = {});
 
+    /**
+     * Get the metrics for the selected bucket
+     *
+     * @param format the format to request ("" for the binary encoding,
+     *               "prometheus" or "schema")
+     * @return the metrics in the requested format
+     */
+    std::string getMetrics(const std::string& format = {},
+                           GetFrameInfoFunction getFrameInfo = {});
+
     /**
      * Perform an arithmetic operation on a document (increment or decrement)
      *
@@ -184,6 +184,7 @@ bool is_valid_opcode(ClientOpcode opcode) {
     case ClientOpcode::UpdateExternalUserPermissions:
     case ClientOpcode::RbacRefresh:
     case ClientOpcode::AuthProvider:
+    case ClientOpcode::GetMetrics:
     case ClientOpcode::DropPrivilege:
     case ClientOpcode::AdjustTimeofday:
     case ClientOpcode::EwouldblockCtl:
@@ -367,6 +368,7 @@ bool is_durability_supported(ClientOpcode opcode) {
     case ClientOpcode::UpdateExternalUserPermissions:
     case ClientOpcode::RbacRefresh:
     case ClientOpcode::AuthProvider:
+    case ClientOpcode::GetMetrics:
     case ClientOpcode::DropPrivilege:
     case ClientOpcode::AdjustTimeofday:
     case ClientOpcode::EwouldblockCtl:
@@ -542,6 +544,7 @@ bool is_reorder_supported(ClientOpcode opcode) {
     case ClientOpcode::UpdateExternalUserPermissions:
     case ClientOpcode::RbacRefresh:
     case ClientOpcode::AuthProvider:
+    case ClientOpcode::GetMetrics:
     case ClientOpcode::DropPrivilege:
     case ClientOpcode::AdjustTimeofday:
     case ClientOpcode::EwouldblockCtl:
@@ -876,6 +879,8 @@ std::string to_string(cb::mcbp::ClientOpcode opcode) {
         return "RBAC_REFRESH";
     case ClientOpcode::AuthProvider:
         return "AUTH_PROVIDER";
+    case ClientOpcode::GetMetrics:
+        return "GET_METRICS";
     case ClientOpcode::DropPrivilege:
         return "DROP_PRIVILEGES";
     case ClientOpcode::AdjustTimeofday:
@@ -188,6 +188,7 @@ const std::map<cb::mcbp::ClientOpcode, std::string> client_blueprint = {
           "UPDATE_USER_PERMISSIONS"},
          {ClientOpcode::RbacRefresh, "RBAC_REFRESH"},
          {ClientOpcode::AuthProvider, "AUTH_PROVIDER"},
+         {ClientOpcode::GetMetrics, "GET_METRICS"},
          {ClientOpcode::DropPrivilege, "DROP_PRIVILEGES"},
          {ClientOpcode::AdjustTimeofday, "ADJUST_TIMEOFDAY"},
          {ClientOpcode::EwouldblockCtl, "EWB_CTL"},
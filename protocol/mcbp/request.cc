@@ -235,6 +235,7 @@ bool Request::isQuiet() const {
         case ClientOpcode::UpdateExternalUserPermissions:
         case ClientOpcode::RbacRefresh:
         case ClientOpcode::AuthProvider:
+        case ClientOpcode::GetMetrics:
         case ClientOpcode::DropPrivilege:
         case ClientOpcode::AdjustTimeofday:
         case ClientOpcode::EwouldblockCtl:
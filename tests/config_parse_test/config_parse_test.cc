@@ -226,6 +226,48 @@ TEST_F(SettingsTest, AlwaysCollectTraceInfo) {
     }
 }
 
+TEST_F(SettingsTest, RequestTraceSampleRate) {
+    nonNumericValuesShouldFail("request_trace_sample_rate");
+
+    nlohmann::json json;
+    Settings defaults(json);
+    EXPECT_EQ(1000u, defaults.getRequestTraceSampleRate());
+    EXPECT_FALSE(defaults.has.request_trace_sample_rate);
+
+    json["request_trace_sample_rate"] = 0;
+    Settings settings(json);
+    EXPECT_EQ(0u, settings.getRequestTraceSampleRate());
+    EXPECT_TRUE(settings.has.request_trace_sample_rate);
+}
+
+TEST_F(SettingsTest, RequestTraceSlowOps) {
+    nonBooleanValuesShouldFail("request_trace_slow_ops");
+
+    nlohmann::json json;
+    Settings defaults(json);
+    EXPECT_TRUE(defaults.isRequestTraceSlowOpsEnabled());
+    EXPECT_FALSE(defaults.has.request_trace_slow_ops);
+
+    json["request_trace_slow_ops"] = false;
+    Settings settings(json);
+    EXPECT_FALSE(settings.isRequestTraceSlowOpsEnabled());
+    EXPECT_TRUE(settings.has.request_trace_slow_ops);
+}
+
+TEST_F(SettingsTest, SaslAuthCacheTtl) {
+    nonNumericValuesShouldFail("sasl_auth_cache_ttl");
+
+    nlohmann::json json;
+    Settings defaults(json);
+    EXPECT_EQ(std::chrono::seconds(60), defaults.getSaslAuthCacheTtl());
+    EXPECT_FALSE(defaults.has.sasl_auth_cache_ttl);
+
+    json["sasl_auth_cache_ttl"] = 0;
+    Settings settings(json);
+    EXPECT_EQ(std::chrono::seconds(0), settings.getSaslAuthCacheTtl());
+    EXPECT_TRUE(settings.has.sasl_auth_cache_ttl);
+}
+
 TEST_F(SettingsTest, AuditFile) {
     // Ensure that we detect non-string values for admin
     nonStringValuesShouldFail("audit_file");
@@ -795,6 +837,34 @@ TEST_F(SettingsTest, SslCipherOrder) {
     }
 }
 
+TEST_F(SettingsTest, SslSessionTickets) {
+    nonBooleanValuesShouldFail("ssl_session_tickets");
+
+    nlohmann::json obj;
+    Settings defaults(obj);
+    EXPECT_TRUE(defaults.isSslSessionTickets());
+    EXPECT_FALSE(defaults.has.ssl_session_tickets);
+
+    obj["ssl_session_tickets"] = false;
+    Settings settings(obj);
+    EXPECT_FALSE(settings.isSslSessionTickets());
+    EXPECT_TRUE(settings.has.ssl_session_tickets);
+}
+
+TEST_F(SettingsTest, SslKtls) {
+    nonBooleanValuesShouldFail("ssl_ktls");
+
+    nlohmann::json obj;
+    Settings defaults(obj);
+    EXPECT_FALSE(defaults.isSslKtls());
+    EXPECT_FALSE(defaults.has.ssl_ktls);
+
+    obj["ssl_ktls"] = true;
+    Settings settings(obj);
+    EXPECT_TRUE(settings.isSslKtls());
+    EXPECT_TRUE(settings.has.ssl_ktls);
+}
+
 TEST_F(SettingsTest, SslMinimumProtocol) {
     nonStringValuesShouldFail("ssl_minimum_protocol");
 
@@ -21,7 +21,9 @@
 #include <mcbp/protocol/unsigned_leb128.h>
 #include <memcached/limits.h>
 #include <platform/compress.h>
+#include <protocol/mcbp/ewb_encode.h>
 #include <algorithm>
+#include <functional>
 #include <gsl/gsl>
 
 class GetSetTest : public TestappXattrClientTest {
@@ -608,6 +610,114 @@ TEST_P(GetSetTest, TestGetSuccess) {
     EXPECT_EQ(document.value, stored.value);
 }
 
+/// Encode the commands back to back in a single frame, so that the server
+/// reads them in one go (and may look up a run of GETs as a batch)
+static Frame encodePipeline(
+        const std::vector<std::reference_wrapper<const BinprotCommand>>&
+                commands) {
+    Frame frame;
+    for (const auto& cmd : commands) {
+        std::vector<uint8_t> buf;
+        cmd.get().encode(buf);
+        frame.payload.insert(frame.payload.end(), buf.begin(), buf.end());
+    }
+    return frame;
+}
+
+static BinprotGetCommand makeGet(const std::string& key, uint32_t opaque) {
+    BinprotGetCommand cmd;
+    cmd.setKey(key);
+    cmd.setOpaque(opaque);
+    return cmd;
+}
+
+// Test that GETs pipelined around mutations are answered in order, and
+// each sees the mutations sent before it.
+TEST_P(GetSetTest, TestPipelinedGetsAndMutations) {
+    MemcachedConnection& conn = getConnection();
+    for (int ii = 0; ii < 3; ++ii) {
+        conn.store(name + std::to_string(ii), Vbid(0), "value");
+    }
+
+    BinprotMutationCommand set;
+    set.setMutationType(MutationType::Set);
+    set.setKey(name + "1");
+    set.addValueBuffer({reinterpret_cast<const uint8_t*>("new"), 3});
+    set.setOpaque(2);
+    BinprotRemoveCommand remove;
+    remove.setKey(name + "2");
+    remove.setOpaque(5);
+
+    const auto get0 = makeGet(name + "0", 0);
+    const auto get1 = makeGet(name + "1", 1);
+    const auto get1After = makeGet(name + "1", 3);
+    const auto get2 = makeGet(name + "2", 4);
+    const auto get2After = makeGet(name + "2", 6);
+    const auto getMissing = makeGet(name + "missing", 7);
+    conn.sendFrame(encodePipeline(
+            {get0, get1, set, get1After, get2, remove, get2After, getMissing}));
+
+    const std::vector<std::pair<cb::mcbp::ClientOpcode, cb::mcbp::Status>>
+            expected = {{cb::mcbp::ClientOpcode::Get, cb::mcbp::Status::Success},
+                        {cb::mcbp::ClientOpcode::Get, cb::mcbp::Status::Success},
+                        {cb::mcbp::ClientOpcode::Set, cb::mcbp::Status::Success},
+                        {cb::mcbp::ClientOpcode::Get, cb::mcbp::Status::Success},
+                        {cb::mcbp::ClientOpcode::Get, cb::mcbp::Status::Success},
+                        {cb::mcbp::ClientOpcode::Delete,
+                         cb::mcbp::Status::Success},
+                        {cb::mcbp::ClientOpcode::Get,
+                         cb::mcbp::Status::KeyEnoent},
+                        {cb::mcbp::ClientOpcode::Get,
+                         cb::mcbp::Status::KeyEnoent}};
+    for (uint32_t ii = 0; ii < expected.size(); ++ii) {
+        BinprotResponse rsp;
+        conn.recvResponse(rsp);
+        EXPECT_EQ(ii, rsp.getResponse().getOpaque());
+        EXPECT_EQ(expected[ii].first, rsp.getOp()) << ii;
+        EXPECT_EQ(expected[ii].second, rsp.getStatus()) << ii;
+        if (ii == 1) {
+            EXPECT_EQ("value", rsp.getDataString());
+        } else if (ii == 3) {
+            EXPECT_EQ("new", rsp.getDataString());
+        }
+    }
+}
+
+// Test that a GET of a batch which would block doesn't let the GETs behind
+// it overtake it.
+TEST_P(GetSetTest, TestPipelinedGetsWouldBlock) {
+    MemcachedConnection& conn = getConnection();
+    const size_t numGets = 8;
+    for (size_t ii = 0; ii < numGets; ++ii) {
+        conn.store(name + std::to_string(ii), Vbid(0), std::to_string(ii));
+    }
+
+    // Only the command reusing the connection's cookie (the first GET of
+    // the batch) is affected; the engine notifies it once it would block.
+    conn.configureEwouldBlockEngine(
+            EWBEngineMode::Sequence,
+            /*unused*/ {},
+            /*unused*/ {},
+            ewb::encodeSequence({cb::engine_errc::would_block,
+                                 ewb::Passthrough,
+                                 ewb::Passthrough}));
+
+    std::vector<BinprotGetCommand> gets;
+    for (size_t ii = 0; ii < numGets; ++ii) {
+        gets.push_back(makeGet(name + std::to_string(ii), uint32_t(ii)));
+    }
+    conn.sendFrame(encodePipeline({gets.begin(), gets.end()}));
+
+    for (size_t ii = 0; ii < numGets; ++ii) {
+        BinprotResponse rsp;
+        conn.recvResponse(rsp);
+        EXPECT_EQ(ii, rsp.getResponse().getOpaque());
+        EXPECT_EQ(cb::mcbp::Status::Success, rsp.getStatus()) << ii;
+        EXPECT_EQ(std::to_string(ii), rsp.getDataString());
+    }
+    conn.disableEwouldBlockEngine();
+}
+
 TEST_P(GetSetTest, TestAppend) {
     MemcachedConnection& conn = getConnection();
     document.info.datatype = cb::mcbp::Datatype::Raw;
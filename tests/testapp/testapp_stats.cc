@@ -16,6 +16,7 @@
  */
 
 #include "testapp_client_test.h"
+#include <memcached/metrics.h>
 #include <protocol/mcbp/ewb_encode.h>
 #include <gsl/gsl>
 
@@ -540,6 +541,90 @@ TEST_P(StatsTest, TestTracingStats) {
     EXPECT_NE(stats.end(), enabled);
 }
 
+TEST_P(StatsTest, RequestTracesIsPrivileged) {
+    MemcachedConnection& conn = getConnection();
+
+    try {
+        conn.stats("request_traces");
+        FAIL() << "request_traces is a privileged operation";
+    } catch (ConnectionError& error) {
+        EXPECT_TRUE(error.isAccessDenied());
+    }
+
+    conn.authenticate("@admin", "password", "PLAIN");
+    auto stats = conn.stats("request_traces");
+    // We should at least have a ring for the first thread
+    ASSERT_NE(stats.end(), stats.find("0"));
+    EXPECT_TRUE(stats["0"].is_array());
+}
+
+TEST_P(StatsTest, GetMetrics) {
+    TESTAPP_SKIP_IF_UNSUPPORTED(cb::mcbp::ClientOpcode::GetMetrics);
+    MemcachedConnection& conn = getConnection();
+    conn.authenticate("@admin", "password", "PLAIN");
+    conn.selectBucket("default");
+
+    const auto samples = cb::metrics::Collector::decode(conn.getMetrics());
+    EXPECT_FALSE(samples.empty());
+
+    // The schema describes the same metrics (in the same order)
+    const auto schema = nlohmann::json::parse(conn.getMetrics("schema"));
+    ASSERT_EQ(samples.size(), schema.size());
+    for (size_t ii = 0; ii < samples.size(); ++ii) {
+        EXPECT_EQ(samples[ii].id, schema[ii]["id"].get<uint16_t>());
+    }
+
+    const auto text = conn.getMetrics("prometheus");
+    EXPECT_NE(std::string::npos, text.find("kv_mem_used{bucket=\"default\"}"));
+    EXPECT_NE(std::string::npos, text.find("kv_get_cmd_bucket{"));
+
+    try {
+        conn.getMetrics("xml");
+        FAIL() << "Unsupported formats should be rejected";
+    } catch (ConnectionError& error) {
+        EXPECT_TRUE(error.isInvalidArguments());
+    }
+}
+
+// A slow request is recorded in the request trace ring even if it wasn't
+// sampled (and so wasn't traced); its record holds just its total duration.
+TEST_P(StatsTest, RequestTracesRecordsUntracedSlowOps) {
+    memcached_cfg["request_trace_sample_rate"] = 0;
+    reconfigure();
+
+    auto& admin = getAdminConnection();
+    const auto sla = nlohmann::json::parse(admin.ioctl_get("sla"));
+    const auto noop = sla.find("NOOP");
+    // Every NOOP is now slow
+    admin.ioctl_set("sla", R"({"version":1, "NOOP":{"slow":0}})");
+
+    MemcachedConnection& conn = getConnection();
+    conn.setFeature(cb::mcbp::Feature::Tracing, false);
+    const auto rsp =
+            conn.execute(BinprotGenericCommand{cb::mcbp::ClientOpcode::Noop});
+    ASSERT_TRUE(rsp.isSuccess());
+
+    auto stats = admin.stats("request_traces");
+    bool found = false;
+    for (const auto& ring : stats) {
+        for (const auto& record : ring) {
+            if (record["opcode"] == "NOOP" && record["reason"] == "slow") {
+                found = true;
+                EXPECT_EQ(1, record["trace"].size());
+                EXPECT_EQ("request",
+                          record["trace"].front()["name"].get<std::string>());
+            }
+        }
+    }
+    EXPECT_TRUE(found) << stats.dump();
+
+    nlohmann::json restore = {{"version", 1}};
+    restore["NOOP"] = noop != sla.end() ? *noop : sla["default"];
+    admin.ioctl_set("sla", restore.dump());
+    memcached_cfg["request_trace_sample_rate"] = 1000;
+    reconfigure();
+}
+
 TEST_P(StatsTest, TestSingleBucketOpStats) {
     MemcachedConnection& conn = getConnection();
     conn.authenticate("@admin", "password", "PLAIN");
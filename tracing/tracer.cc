@@ -156,6 +156,12 @@ MEMCACHED_PUBLIC_API std::string to_string(const cb::tracing::Code tracecode) {
         return "sync_write.ack_local";
     case Code::SyncWriteAckRemote:
         return "sync_write.ack_remote";
+    case Code::Parse:
+        return "parse";
+    case Code::Execute:
+        return "execute";
+    case Code::Send:
+        return "send";
     }
     return "unknown tracecode";
 }
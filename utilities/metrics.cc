@@ -0,0 +1,243 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <memcached/metrics.h>
+
+#include "hdrhistogram.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
+namespace cb {
+namespace metrics {
+
+std::string to_string(Type type) {
+    switch (type) {
+    case Type::Counter:
+        return "counter";
+    case Type::Gauge:
+        return "gauge";
+    case Type::Histogram:
+        return "histogram";
+    }
+    throw std::invalid_argument("cb::metrics::to_string: Unknown type " +
+                                std::to_string(int(type)));
+}
+
+void Collector::addCounter(const Definition& definition, uint64_t value) {
+    entries.push_back({&definition, value});
+}
+
+void Collector::addGauge(const Definition& definition, int64_t value) {
+    entries.push_back({&definition, uint64_t(value)});
+}
+
+void Collector::addHistogram(const Definition& definition,
+                             const HdrHistogram& histogram) {
+    HistogramData data;
+    data.count = histogram.getValueCount();
+    if (data.count != 0) {
+        data.sum = uint64_t(std::llround(histogram.getMean() * data.count));
+    }
+
+    uint64_t cumulative = 0;
+    auto iter = histogram.makeLogIterator(1, 2);
+    while (auto bucket = histogram.getNextBucketLowHighAndCount(iter)) {
+        cumulative += std::get<2>(*bucket);
+        data.buckets.emplace_back(std::get<1>(*bucket), cumulative);
+    }
+    addHistogram(definition, std::move(data));
+}
+
+void Collector::addHistogram(const Definition& definition,
+                             HistogramData data) {
+    entries.push_back({&definition, histograms.size()});
+    histograms.emplace_back(std::move(data));
+}
+
+static void append(std::string& buffer, uint64_t value, size_t size) {
+    for (size_t ii = size; ii > 0; --ii) {
+        buffer.push_back(char((value >> ((ii - 1) * 8)) & 0xff));
+    }
+}
+
+std::string Collector::toBinary() const {
+    std::string ret;
+    // Counters and gauges need 11 bytes each, histograms more
+    ret.reserve(5 + entries.size() * 11);
+    append(ret, Version, 1);
+    append(ret, entries.size(), 4);
+    for (const auto& entry : entries) {
+        const auto& def = *entry.definition;
+        append(ret, def.id, 2);
+        append(ret, uint8_t(def.type), 1);
+        if (def.type != Type::Histogram) {
+            append(ret, entry.value, 8);
+            continue;
+        }
+        const auto& histogram = histograms[entry.value];
+        append(ret, histogram.count, 8);
+        append(ret, histogram.sum, 8);
+        append(ret, histogram.buckets.size(), 2);
+        for (const auto& bucket : histogram.buckets) {
+            append(ret, bucket.first, 8);
+            append(ret, bucket.second, 8);
+        }
+    }
+    return ret;
+}
+
+std::string Collector::toPrometheus(const std::string& prefix,
+                                    const std::string& labels) const {
+    std::string ret;
+    ret.reserve(entries.size() * 128);
+    const auto suffix = labels.empty() ? std::string{} : "{" + labels + "}";
+    const auto sep = labels.empty() ? std::string{} : labels + ",";
+
+    for (const auto& entry : entries) {
+        const auto& def = *entry.definition;
+        const auto name = prefix + def.name;
+        ret.append("# HELP ").append(name).append(" ").append(def.help);
+        ret.append("\n# TYPE ").append(name).append(" ");
+        ret.append(to_string(def.type)).append("\n");
+
+        switch (def.type) {
+        case Type::Counter:
+            ret.append(name).append(suffix).append(" ");
+            ret.append(std::to_string(entry.value)).append("\n");
+            break;
+        case Type::Gauge:
+            ret.append(name).append(suffix).append(" ");
+            ret.append(std::to_string(int64_t(entry.value))).append("\n");
+            break;
+        case Type::Histogram: {
+            const auto& histogram = histograms[entry.value];
+            for (const auto& bucket : histogram.buckets) {
+                ret.append(name).append("_bucket{").append(sep);
+                ret.append("le=\"").append(std::to_string(bucket.first));
+                ret.append("\"} ").append(std::to_string(bucket.second));
+                ret.append("\n");
+            }
+            ret.append(name).append("_bucket{").append(sep);
+            ret.append("le=\"+Inf\"} ");
+            ret.append(std::to_string(histogram.count)).append("\n");
+            ret.append(name).append("_sum").append(suffix).append(" ");
+            ret.append(std::to_string(histogram.sum)).append("\n");
+            ret.append(name).append("_count").append(suffix).append(" ");
+            ret.append(std::to_string(histogram.count)).append("\n");
+            break;
+        }
+        }
+    }
+    return ret;
+}
+
+nlohmann::json Collector::toSchema() const {
+    auto ret = nlohmann::json::array();
+    for (const auto& entry : entries) {
+        const auto& def = *entry.definition;
+        ret.push_back({{"id", def.id},
+                       {"name", def.name},
+                       {"type", to_string(def.type)},
+                       {"help", def.help}});
+    }
+    return ret;
+}
+
+namespace {
+/// Helper class to read integers from the binary encoding
+class Reader {
+public:
+    explicit Reader(cb::const_char_buffer buffer) : buffer(buffer) {
+    }
+
+    uint64_t read(size_t size) {
+        if (offset + size > buffer.size()) {
+            throw std::invalid_argument(
+                    "cb::metrics::Collector::decode: Truncated input");
+        }
+        uint64_t ret = 0;
+        for (size_t ii = 0; ii < size; ++ii) {
+            ret = (ret << 8) | uint8_t(buffer[offset++]);
+        }
+        return ret;
+    }
+
+    bool empty() const {
+        return offset == buffer.size();
+    }
+
+private:
+    cb::const_char_buffer buffer;
+    size_t offset = 0;
+};
+} // namespace
+
+std::vector<Sample> Collector::decode(cb::const_char_buffer encoded) {
+    Reader reader(encoded);
+    const auto version = reader.read(1);
+    if (version != Version) {
+        throw std::invalid_argument(
+                "cb::metrics::Collector::decode: Unsupported version " +
+                std::to_string(version));
+    }
+
+    const auto count = reader.read(4);
+    std::vector<Sample> ret;
+    // Don't trust the count for the allocation; each metric needs at
+    // least 11 bytes
+    ret.reserve(std::min(count, uint64_t(encoded.size() / 11)));
+    for (uint64_t ii = 0; ii < count; ++ii) {
+        Sample sample;
+        sample.id = uint16_t(reader.read(2));
+        sample.type = Type(reader.read(1));
+        switch (sample.type) {
+        case Type::Counter:
+        case Type::Gauge:
+            sample.value = reader.read(8);
+            break;
+        case Type::Histogram: {
+            sample.histogram.count = reader.read(8);
+            sample.histogram.sum = reader.read(8);
+            const auto buckets = reader.read(2);
+            sample.histogram.buckets.reserve(buckets);
+            for (uint64_t jj = 0; jj < buckets; ++jj) {
+                const auto bound = reader.read(8);
+                sample.histogram.buckets.emplace_back(bound, reader.read(8));
+            }
+            break;
+        }
+        default:
+            throw std::invalid_argument(
+                    "cb::metrics::Collector::decode: Unknown type " +
+                    std::to_string(int(sample.type)));
+        }
+        ret.emplace_back(std::move(sample));
+    }
+
+    if (!reader.empty()) {
+        throw std::invalid_argument(
+                "cb::metrics::Collector::decode: Trailing data");
+    }
+    return ret;
+}
+
+} // namespace metrics
+} // namespace cb
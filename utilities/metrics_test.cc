@@ -0,0 +1,103 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <memcached/metrics.h>
+
+#include "hdrhistogram.h"
+
+#include <folly/portability/GTest.h>
+#include <nlohmann/json.hpp>
+
+using namespace cb::metrics;
+
+static const Definition counter{1, Type::Counter, "ops", "Number of ops"};
+static const Definition gauge{2, Type::Gauge, "delta", "Some delta"};
+static const Definition histogram{3, Type::Histogram, "latency", "Latency"};
+
+class MetricsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        collector.addCounter(counter, 10);
+        collector.addGauge(gauge, -5);
+        HdrHistogram hdr(1, 1000, 2);
+        hdr.addValue(1);
+        hdr.addValue(3);
+        hdr.addValue(3);
+        collector.addHistogram(histogram, hdr);
+    }
+
+    Collector collector;
+};
+
+TEST_F(MetricsTest, BinaryRoundTrip) {
+    const auto encoded = collector.toBinary();
+    const auto samples =
+            Collector::decode({encoded.data(), encoded.size()});
+    ASSERT_EQ(3u, samples.size());
+
+    EXPECT_EQ(1, samples[0].id);
+    EXPECT_EQ(Type::Counter, samples[0].type);
+    EXPECT_EQ(10u, samples[0].value);
+
+    EXPECT_EQ(2, samples[1].id);
+    EXPECT_EQ(-5, int64_t(samples[1].value));
+
+    EXPECT_EQ(Type::Histogram, samples[2].type);
+    const auto& data = samples[2].histogram;
+    EXPECT_EQ(3u, data.count);
+    EXPECT_EQ(7u, data.sum);
+    ASSERT_FALSE(data.buckets.empty());
+    // Buckets are cumulative, so the last one holds all values
+    EXPECT_EQ(3u, data.buckets.back().second);
+}
+
+TEST_F(MetricsTest, DecodeInvalid) {
+    auto encoded = collector.toBinary();
+    encoded.pop_back();
+    EXPECT_THROW(Collector::decode({encoded.data(), encoded.size()}),
+                 std::invalid_argument);
+
+    encoded = collector.toBinary();
+    encoded[0] = 2;
+    EXPECT_THROW(Collector::decode({encoded.data(), encoded.size()}),
+                 std::invalid_argument);
+
+    encoded = collector.toBinary() + "x";
+    EXPECT_THROW(Collector::decode({encoded.data(), encoded.size()}),
+                 std::invalid_argument);
+}
+
+TEST_F(MetricsTest, Prometheus) {
+    const auto text = collector.toPrometheus("kv_", R"(bucket="default")");
+    EXPECT_NE(std::string::npos, text.find("# TYPE kv_ops counter\n"));
+    EXPECT_NE(std::string::npos, text.find("kv_ops{bucket=\"default\"} 10\n"));
+    EXPECT_NE(std::string::npos,
+              text.find("kv_delta{bucket=\"default\"} -5\n"));
+    EXPECT_NE(std::string::npos,
+              text.find("kv_latency_bucket{bucket=\"default\",le=\"+Inf\"} "
+                        "3\n"));
+    EXPECT_NE(std::string::npos,
+              text.find("kv_latency_count{bucket=\"default\"} 3\n"));
+}
+
+TEST_F(MetricsTest, Schema) {
+    const auto schema = collector.toSchema();
+    ASSERT_EQ(3u, schema.size());
+    EXPECT_EQ(3, schema[2]["id"].get<int>());
+    EXPECT_EQ("latency", schema[2]["name"].get<std::string>());
+    EXPECT_EQ("histogram", schema[2]["type"].get<std::string>());
+}